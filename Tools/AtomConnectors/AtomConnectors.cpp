@@ -0,0 +1,409 @@
+//
+// Atom Connectors
+// Computes RadeonFramebuffer connector tables from ATOM VBIOS images without loading AMD drivers.
+//
+// Usage:
+//   AtomConnectors [-l] [-j threads] <rom|directory>...
+//
+//   -l           print LegacyConnector (16 bytes) tables instead of ModernConnector (24 bytes) ones
+//   -j threads   amount of worker threads, defaults to the amount of online CPUs
+//
+// Transmitter, encoder and sense are detected with the kern_atom.hpp helpers RAD::autocorrectConnectors uses,
+// and priorities are assigned by RADConnectors::ConnectorView in the type order of RAD::reprioritiseConnectors.
+// Flags, features and hotplug are defaults from the stock framebuffer personalities and may need tuning per board.
+// The resulting connectors and connector-count values can be injected as device properties.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "../../WhateverGreen/kern_atom.hpp"
+#include "../../WhateverGreen/kern_con.hpp"
+
+using RADConnectors::Connector;
+using RADConnectors::ConnectorView;
+using RADConnectors::ModernConnector;
+
+// Standard PCI expansion ROM and ATOM BIOS layout, see atombios.h.
+static constexpr uint16_t PciRomSignature = 0xAA55;
+static constexpr size_t AtomRomHeaderPointer = 0x48;
+static constexpr size_t AtomRomSignature = 0x04;
+static constexpr size_t AtomRomMasterData = 0x20;
+static constexpr size_t AtomMasterDataObject = 4 + 22 * sizeof(uint16_t);
+static constexpr size_t AtomObjectConnectors = 0x06;
+static constexpr size_t AtomObjectDisplayPaths = 0x0E;
+static constexpr size_t AtomRomMaxSize = 1024 * 1024;
+
+struct Rom {
+	std::vector<uint8_t> data;
+
+	// All ROM accesses go through these, a malformed image must never be read out of bounds.
+	bool range(size_t off, size_t size) const {
+		return off <= data.size() && size <= data.size() - off;
+	}
+
+	bool read16(size_t off, uint16_t &value) const {
+		if (!range(off, sizeof(uint16_t)))
+			return false;
+		value = static_cast<uint16_t>(data[off] | (data[off + 1] << 8));
+		return true;
+	}
+
+	bool read8(size_t off, uint8_t &value) const {
+		if (!range(off, sizeof(uint8_t)))
+			return false;
+		value = data[off];
+		return true;
+	}
+};
+
+struct Job {
+	std::string path;
+	std::string output;
+};
+
+static std::vector<Job> jobs;
+static std::atomic<size_t> jobNext;
+
+static void appendf(std::string &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+static void appendf(std::string &out, const char *format, ...) {
+	char buf[1024];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	out += buf;
+}
+
+// getSenseID stops at the first I2C or the last record, but checks neither the image end nor empty records.
+// Only pass it records it is going to stop in.
+static bool isSenseReadable(const Rom &rom, size_t off) {
+	uint8_t value, size;
+	while (rom.read8(off, value)) {
+		auto type = static_cast<AtomRecordType>(value);
+		if (type == AtomRecordType::Max)
+			return true;
+		if (type == AtomRecordType::I2C)
+			return rom.range(off, 3);
+		if (!rom.read8(off + 1, size) || size < sizeof(AtomCommonRecordHeader))
+			return false;
+		off += size;
+	}
+	return false;
+}
+
+// The hotplug pin is the first non-zero HPD record value.
+static uint8_t getHotplug(const Rom &rom, size_t off) {
+	uint8_t value, size, hotplug;
+	while (rom.read8(off, value) && rom.read8(off + 1, size) && size >= sizeof(AtomCommonRecordHeader)) {
+		auto type = static_cast<AtomRecordType>(value);
+		if (type == AtomRecordType::Max)
+			break;
+		if (type == AtomRecordType::HPD && rom.read8(off + 2, hotplug) && hotplug != 0)
+			return hotplug;
+		off += size;
+	}
+	return 0;
+}
+
+static bool getConnectorType(uint8_t object, ModernConnector &con) {
+	switch (object) {
+		case CONNECTOR_OBJECT_ID_SINGLE_LINK_DVI_I:
+		case CONNECTOR_OBJECT_ID_DUAL_LINK_DVI_I:
+		case CONNECTOR_OBJECT_ID_SINGLE_LINK_DVI_D:
+		case CONNECTOR_OBJECT_ID_DUAL_LINK_DVI_D:
+		case CONNECTOR_OBJECT_ID_HARDCODE_DVI:
+			con.type = RADConnectors::ConnectorDigitalDVI;
+			con.flags = 0x214;
+			con.features = 0x100;
+			return true;
+		case CONNECTOR_OBJECT_ID_VGA:
+			con.type = RADConnectors::ConnectorVGA;
+			con.flags = 0x10;
+			con.features = 0x100;
+			return true;
+		case CONNECTOR_OBJECT_ID_HDMI_TYPE_A:
+		case CONNECTOR_OBJECT_ID_HDMI_TYPE_B:
+			con.type = RADConnectors::ConnectorHDMI;
+			con.flags = 0x204;
+			con.features = 0x100;
+			return true;
+		case CONNECTOR_OBJECT_ID_DISPLAYPORT:
+			con.type = RADConnectors::ConnectorDP;
+			con.flags = 0x304;
+			con.features = 0x100;
+			return true;
+		case CONNECTOR_OBJECT_ID_LVDS:
+		case CONNECTOR_OBJECT_ID_eDP:
+		case CONNECTOR_OBJECT_ID_LVDS_eDP:
+			con.type = RADConnectors::ConnectorLVDS;
+			con.flags = 0x40;
+			con.features = 0x9;
+			return true;
+		default:
+			return false;
+	}
+}
+
+static uint8_t parseConnectors(Rom &rom, ModernConnector *connectors, uint8_t *objects, std::string &out) {
+	uint16_t value = 0, romHeader = 0, masterData = 0, objectHeader = 0, connectorTable = 0, pathTable = 0;
+	if (!rom.read16(0, value) || value != PciRomSignature) {
+		appendf(out, "  not a PCI expansion ROM\n");
+		return 0;
+	}
+
+	if (!rom.read16(AtomRomHeaderPointer, romHeader) || !rom.range(romHeader + AtomRomSignature, 4) ||
+		memcmp(&rom.data[romHeader + AtomRomSignature], "ATOM", 4) != 0) {
+		appendf(out, "  missing ATOM ROM header\n");
+		return 0;
+	}
+
+	if (!rom.read16(romHeader + AtomRomMasterData, masterData) ||
+		!rom.read16(masterData + AtomMasterDataObject, objectHeader) || objectHeader == 0 ||
+		!rom.read16(objectHeader + AtomObjectConnectors, connectorTable) ||
+		!rom.read16(objectHeader + AtomObjectDisplayPaths, pathTable)) {
+		appendf(out, "  missing object header\n");
+		return 0;
+	}
+
+	uint8_t pathNum = 0, connectorObjectNum = 0;
+	if (!rom.read8(objectHeader + pathTable, pathNum) || !rom.read8(objectHeader + connectorTable, connectorObjectNum)) {
+		appendf(out, "  invalid object tables\n");
+		return 0;
+	}
+
+	appendf(out, "  object header %04X with %u display paths and %u connector objects\n", objectHeader, pathNum, connectorObjectNum);
+
+	uint8_t num = 0;
+	// Display paths have variable size, walk them by usSize instead of assuming a fixed stride.
+	size_t pathOff = objectHeader + pathTable + 4;
+	for (uint8_t i = 0; i < pathNum; i++) {
+		AtomDisplayObjectPath path;
+		if (!rom.range(pathOff, sizeof(path))) {
+			appendf(out, "  display path %u is out of bounds\n", i);
+			break;
+		}
+		memcpy(&path, &rom.data[pathOff], sizeof(path));
+		if (path.usSize < sizeof(path)) {
+			appendf(out, "  display path %u has invalid size %u\n", i, path.usSize);
+			break;
+		}
+		pathOff += path.usSize;
+
+		if (((path.usConnObjectId & OBJECT_TYPE_MASK) >> OBJECT_TYPE_SHIFT) != GRAPH_OBJECT_TYPE_CONNECTOR)
+			continue;
+
+		ModernConnector con {};
+		auto object = getConnectorID(path.usConnObjectId);
+		if (!getConnectorType(object, con)) {
+			appendf(out, "  display path %u has unsupported connector %02X\n", i, object);
+			continue;
+		}
+
+		if (!isEncoder(path.usGraphicObjIds) || !getTxEnc(path.usGraphicObjIds, con.transmitter, con.encoder)) {
+			appendf(out, "  display path %u has unsupported encoder %04X\n", i, path.usGraphicObjIds);
+			continue;
+		}
+
+		// Connector objects are matched by id, the kext relies on both tables having the same order.
+		for (uint8_t j = 0; j < connectorObjectNum; j++) {
+			AtomConnectorObject connectorObject;
+			size_t objectOff = objectHeader + connectorTable + 4 + j * sizeof(connectorObject);
+			if (!rom.range(objectOff, sizeof(connectorObject)))
+				break;
+			memcpy(&connectorObject, &rom.data[objectOff], sizeof(connectorObject));
+			if (connectorObject.usObjectID == path.usConnObjectId) {
+				size_t recordOff = objectHeader + connectorObject.usRecordOffset;
+				if (isSenseReadable(rom, recordOff))
+					con.sense = getSenseID(&rom.data[recordOff]);
+				con.hotplug = getHotplug(rom, recordOff);
+				break;
+			}
+		}
+
+		if (con.sense == 0) {
+			appendf(out, "  display path %u has no sense id\n", i);
+			continue;
+		}
+
+		if (num == ConnectorView::MaxConnectors) {
+			appendf(out, "  too many connectors\n");
+			break;
+		}
+		objects[num] = object;
+		connectors[num++] = con;
+	}
+
+	return num;
+}
+
+// Connectors are laid out in the format of the selected kernel version like in the kext properties
+static void printConnectors(const Connector *con, const uint8_t *objects, uint8_t num, std::string &out) {
+	char tmp[192];
+	bool isModern = RADConnectors::modern();
+	for (uint8_t i = 0; i < num; i++)
+		appendf(out, "  object %02X %s\n", objects[i], isModern ?
+				RADConnectors::printConnector(tmp, (&con->modern)[i]) : RADConnectors::printConnector(tmp, (&con->legacy)[i]));
+
+	// Both values are raw little endian data like in the kext properties
+	uint32_t count = num;
+	auto bytes = reinterpret_cast<const uint8_t *>(&count);
+	appendf(out, "  connector-count ");
+	for (size_t i = 0; i < sizeof(count); i++)
+		appendf(out, "%02X", bytes[i]);
+	appendf(out, "\n  connectors ");
+	bytes = reinterpret_cast<const uint8_t *>(con);
+	size_t size = num * (isModern ? sizeof(RADConnectors::ModernConnector) : sizeof(RADConnectors::LegacyConnector));
+	for (size_t i = 0; i < size; i++)
+		appendf(out, "%02X", bytes[i]);
+	appendf(out, "\n");
+}
+
+static void processJob(Job &job) {
+	appendf(job.output, "%s\n", job.path.c_str());
+
+	FILE *file = fopen(job.path.c_str(), "rb");
+	if (!file) {
+		appendf(job.output, "  failed to open\n");
+		return;
+	}
+
+	Rom rom;
+	rom.data.resize(AtomRomMaxSize);
+	rom.data.resize(fread(rom.data.data(), 1, AtomRomMaxSize, file));
+	fclose(file);
+
+	ModernConnector found[ConnectorView::MaxConnectors];
+	uint8_t objects[ConnectorView::MaxConnectors];
+	uint8_t num = parseConnectors(rom, found, objects, job.output);
+	if (num == 0) {
+		appendf(job.output, "  no connectors detected\n");
+		return;
+	}
+
+	// Same storage for both formats, legacy connectors are simply packed tighter
+	ModernConnector storage[ConnectorView::MaxConnectors];
+	auto con = reinterpret_cast<Connector *>(storage);
+	bool isModern = RADConnectors::modern();
+	for (uint8_t i = 0; i < num; i++) {
+		if (isModern)
+			Connector::assign((&con->modern)[i], found[i]);
+		else
+			Connector::assign((&con->legacy)[i], found[i]);
+	}
+
+	// Same as RAD::reprioritiseConnectors without a connector-priority property
+	ConnectorView view;
+	view.load(con, num);
+	view.prioritise(nullptr, 0, RADConnectors::PriorityTypes, RADConnectors::PriorityTypeNum);
+	view.store(con);
+
+	printConnectors(con, objects, num, job.output);
+}
+
+static void worker() {
+	while (true) {
+		size_t index = jobNext.fetch_add(1, std::memory_order_relaxed);
+		if (index >= jobs.size())
+			break;
+		processJob(jobs[index]);
+	}
+}
+
+static bool addPath(const char *path) {
+	struct stat st;
+	if (stat(path, &st) != 0) {
+		fprintf(stderr, "Cannot access %s\n", path);
+		return false;
+	}
+
+	if (!S_ISDIR(st.st_mode)) {
+		jobs.push_back({path, {}});
+		return true;
+	}
+
+	DIR *dir = opendir(path);
+	if (!dir) {
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != nullptr) {
+		if (entry->d_name[0] == '.')
+			continue;
+		std::string child = std::string(path) + "/" + entry->d_name;
+		if (stat(child.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+			jobs.push_back({child, {}});
+	}
+
+	closedir(dir);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	bool legacyOutput = false;
+	int opt;
+	while ((opt = getopt(argc, argv, "lj:")) != -1) {
+		if (opt == 'l') {
+			legacyOutput = true;
+		} else if (opt == 'j') {
+			threads = strtol(optarg, nullptr, 0);
+		} else {
+			fprintf(stderr, "Usage: %s [-l] [-j threads] <rom|directory>...\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (optind >= argc) {
+		fprintf(stderr, "Usage: %s [-l] [-j threads] <rom|directory>...\n", argv[0]);
+		return 1;
+	}
+
+	// Legacy connectors are used before 10.12, see RADConnectors::modern
+	hostKernelVersion = legacyOutput ? KernelVersion::ElCapitan : KernelVersion::Sierra;
+
+	for (int i = optind; i < argc; i++) {
+		if (!addPath(argv[i]))
+			return 1;
+	}
+
+	// Keep the output stable regardless of directory and thread order.
+	std::sort(jobs.begin(), jobs.end(), [](const Job &a, const Job &b) { return a.path < b.path; });
+
+	if (threads < 1)
+		threads = 1;
+	if (static_cast<size_t>(threads) > jobs.size())
+		threads = static_cast<long>(jobs.size());
+
+	std::vector<std::thread> workers;
+	for (long i = 0; i < threads; i++) {
+		try {
+			workers.emplace_back(worker);
+		} catch (const std::system_error &) {
+			break;
+		}
+	}
+
+	// The main thread helps out, so processing completes even if no worker could be started.
+	worker();
+	for (auto &w : workers)
+		w.join();
+
+	for (auto &job : jobs)
+		fputs(job.output.c_str(), stdout);
+
+	return 0;
+}
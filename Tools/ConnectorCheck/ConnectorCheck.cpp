@@ -0,0 +1,261 @@
+//
+// Connector Check
+// Runs the connector priority and DVI transmitter fix-ups from RADConnectors::ConnectorView in kern_con.hpp
+// and the per-pass connector scans they replaced over the same connector tables, and compares the results.
+//
+// Usage:
+//   ConnectorCheck [-r rounds] [-s seed] [-p senses] [-t sense:txmit]... [connectors...]
+//
+//   -r rounds        amount of random connector tables to check (default 10000 without explicit tables)
+//   -s seed          random seed (default 1)
+//   -p senses        connector-priority property value as hexadecimal sense ids, e.g. 0504
+//   -t sense:txmit   transmitter detected by -raddvi autocorrection for a sense id, e.g. 05:10
+//
+// Connector tables are hexadecimal connectors property values in 16 or 24 byte format, for example the
+// connectors value printed by AtomConnectors for a captured VBIOS image. Every table is checked both as
+// legacy and as modern connectors. Random tables use few sense ids and types to produce duplicates.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../../WhateverGreen/kern_con.hpp"
+#include "../Include/tool_check.hpp"
+
+using RADConnectors::Connector;
+using RADConnectors::ConnectorView;
+using RADConnectors::PriorityTypes;
+using RADConnectors::PriorityTypeNum;
+
+struct Transmitter {
+	uint8_t sense;
+	uint8_t txmit;
+};
+
+// Previous RAD::reprioritiseConnectors
+static void reprioritiseOld(const uint8_t *senseList, uint8_t senseNum, Connector *connectors, uint8_t sz) {
+	bool isModern = RADConnectors::modern();
+	uint16_t priCount = 1;
+	for (uint8_t i = 0; i < senseNum + PriorityTypeNum + 1; i++) {
+		for (uint8_t j = 0; j < sz; j++) {
+			auto reorder = [&](auto &con) {
+				if (i == senseNum + PriorityTypeNum) {
+					if (con.priority == 0)
+						con.priority = priCount++;
+				} else if (i < senseNum) {
+					if (con.sense == senseList[i]) {
+						con.priority = priCount++;
+						return true;
+					}
+				} else {
+					if (con.priority == 0 && con.type == PriorityTypes[i-senseNum])
+						con.priority = priCount++;
+				}
+				return false;
+			};
+
+			if ((isModern && reorder((&connectors->modern)[j])) ||
+				(!isModern && reorder((&connectors->legacy)[j])))
+				break;
+		}
+	}
+}
+
+// Previous RAD::autocorrectConnector with -raddvi
+static void autocorrectOld(uint8_t sense, uint8_t txmit, Connector *connectors, uint8_t sz) {
+	auto fixTransmit = [](auto &con, uint8_t sense, uint8_t txmit) {
+		if (con.sense == sense) {
+			if (con.transmitter != txmit && (con.transmitter & 0xCF) == con.transmitter)
+				con.transmitter = txmit;
+			return true;
+		}
+		return false;
+	};
+
+	bool isModern = RADConnectors::modern();
+	for (uint8_t j = 0; j < sz; j++) {
+		if (isModern) {
+			if (fixTransmit((&connectors->modern)[j], sense, txmit))
+				break;
+		} else {
+			if (fixTransmit((&connectors->legacy)[j], sense, txmit))
+				break;
+		}
+	}
+}
+
+// Current RAD::autocorrectConnectors and RAD::reprioritiseConnectors
+static bool fixNew(const uint8_t *senseList, uint8_t senseNum, const std::vector<Transmitter> &transmitters, Connector *connectors, uint8_t sz) {
+	ConnectorView view;
+	if (!view.load(connectors, sz))
+		return false;
+	for (auto &t : transmitters)
+		view.correctTransmitter(t.sense, t.txmit);
+	view.store(connectors);
+
+	if (!view.load(connectors, sz))
+		return false;
+	view.prioritise(senseList, senseNum, PriorityTypes, PriorityTypeNum);
+	view.store(connectors);
+	return true;
+}
+
+static void printConnectors(const char *title, const uint8_t *data, size_t size) {
+	printf("  %s ", title);
+	for (size_t i = 0; i < size; i++)
+		printf("%02X", data[i]);
+	printf("\n");
+}
+
+static bool check(const std::vector<uint8_t> &table, const std::vector<uint8_t> &senses,
+				  const std::vector<Transmitter> &transmitters, bool verbose) {
+	bool ok = true;
+	for (auto version : {KernelVersion::ElCapitan, KernelVersion::Sierra}) {
+		hostKernelVersion = version;
+		size_t connectorSize = RADConnectors::modern() ? sizeof(RADConnectors::ModernConnector) : sizeof(RADConnectors::LegacyConnector);
+		auto num = static_cast<uint8_t>(table.size() / connectorSize);
+		if (table.size() % connectorSize != 0 || num == 0) {
+			if (verbose)
+				printf("%s: skipped, %zu bytes is not a multiple of %zu\n", RADConnectors::modern() ? "modern" : "legacy",
+					   table.size(), connectorSize);
+			continue;
+		}
+
+		if (num > ConnectorView::MaxConnectors) {
+			if (verbose)
+				printf("%s: skipped, %u connectors exceed the fix-up limit\n", RADConnectors::modern() ? "modern" : "legacy", num);
+			continue;
+		}
+
+		std::vector<uint8_t> before(table), after(table);
+		auto oldConnectors = reinterpret_cast<Connector *>(before.data());
+		auto newConnectors = reinterpret_cast<Connector *>(after.data());
+		for (auto &t : transmitters)
+			autocorrectOld(t.sense, t.txmit, oldConnectors, num);
+		reprioritiseOld(senses.data(), static_cast<uint8_t>(senses.size()), oldConnectors, num);
+		bool loaded = fixNew(senses.data(), static_cast<uint8_t>(senses.size()), transmitters, newConnectors, num);
+
+		bool same = loaded && before == after;
+		if (verbose || !same) {
+			printf("%s, %u connectors: %s\n", RADConnectors::modern() ? "modern" : "legacy", num, same ? "same" : "different");
+			printConnectors("old", before.data(), before.size());
+			printConnectors("new", after.data(), after.size());
+		}
+		ok = ok && same;
+	}
+	return ok;
+}
+
+static bool parseHex(const char *text, std::vector<uint8_t> &bytes) {
+	size_t length = strlen(text);
+	if (length % 2 != 0)
+		return false;
+	bytes.clear();
+	for (size_t i = 0; i < length; i += 2) {
+		char digits[3] = {text[i], text[i + 1], '\0'};
+		char *end = nullptr;
+		bytes.push_back(static_cast<uint8_t>(strtoul(digits, &end, 16)));
+		if (*end != '\0')
+			return false;
+	}
+	return true;
+}
+
+static void randomTable(std::vector<uint8_t> &table, std::vector<uint8_t> &senses, std::vector<Transmitter> &transmitters) {
+	static const uint32_t types[] {
+		RADConnectors::ConnectorLVDS, RADConnectors::ConnectorDigitalDVI, RADConnectors::ConnectorHDMI,
+		RADConnectors::ConnectorDP, RADConnectors::ConnectorVGA, RADConnectors::ConnectorAnalogDVI
+	};
+	static const uint8_t txmits[] {0x00, 0x01, 0x02, 0x10, 0x11, 0x12, 0x20, 0x21, 0x22};
+
+	hostKernelVersion = KernelVersion::Sierra;
+	// Keep the table within the fix-up limit when read as legacy connectors as well
+	size_t num = 1 + next() % (ConnectorView::MaxConnectors * sizeof(RADConnectors::LegacyConnector) / sizeof(RADConnectors::ModernConnector));
+	table.assign(num * sizeof(RADConnectors::ModernConnector), 0);
+	auto connectors = reinterpret_cast<RADConnectors::ModernConnector *>(table.data());
+	for (size_t i = 0; i < num; i++) {
+		auto &con = connectors[i];
+		con.type = types[next() % arrsize(types)];
+		con.flags = next();
+		con.features = static_cast<uint16_t>(next());
+		// Autodetected connectors have no priority, but user connectors may
+		con.priority = next() % 4 == 0 ? static_cast<uint16_t>(1 + next() % 8) : 0;
+		con.transmitter = txmits[next() % arrsize(txmits)];
+		con.encoder = static_cast<uint8_t>(next() % 6);
+		con.hotplug = static_cast<uint8_t>(next() % 8);
+		con.sense = static_cast<uint8_t>(next() % 10);
+	}
+
+	senses.clear();
+	size_t senseNum = next() % 8;
+	for (size_t i = 0; i < senseNum; i++)
+		senses.push_back(static_cast<uint8_t>(next() % 12));
+
+	transmitters.clear();
+	size_t transmitterNum = next() % 4;
+	for (size_t i = 0; i < transmitterNum; i++)
+		transmitters.push_back({static_cast<uint8_t>(next() % 10), txmits[next() % arrsize(txmits)]});
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long rounds = 0;
+	bool explicitRounds = false;
+	std::vector<uint8_t> senses;
+	std::vector<Transmitter> transmitters;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "r:s:p:t:")) != -1) {
+		if (opt == 'r') {
+			rounds = strtoul(optarg, nullptr, 0);
+			explicitRounds = true;
+		} else if (opt == 's') {
+			seed(strtoull(optarg, nullptr, 0));
+		} else if (opt == 'p') {
+			if (!parseHex(optarg, senses) || senses.size() > UINT8_MAX) {
+				fprintf(stderr, "Invalid sense list %s\n", optarg);
+				return 1;
+			}
+		} else if (opt == 't') {
+			unsigned sense, txmit;
+			if (sscanf(optarg, "%x:%x", &sense, &txmit) != 2 || sense > UINT8_MAX || txmit > UINT8_MAX) {
+				fprintf(stderr, "Invalid transmitter %s\n", optarg);
+				return 1;
+			}
+			transmitters.push_back({static_cast<uint8_t>(sense), static_cast<uint8_t>(txmit)});
+		} else {
+			fprintf(stderr, "Usage: %s [-r rounds] [-s seed] [-p senses] [-t sense:txmit]... [connectors...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	bool ok = true;
+	for (int i = optind; i < argc; i++) {
+		std::vector<uint8_t> table;
+		if (!parseHex(argv[i], table) || table.empty()) {
+			fprintf(stderr, "Invalid connectors %s\n", argv[i]);
+			return 1;
+		}
+		ok = check(table, senses, transmitters, true) && ok;
+	}
+
+	if (optind == argc && !explicitRounds)
+		rounds = 10000;
+
+	unsigned long mismatches = 0;
+	for (unsigned long round = 0; round < rounds; round++) {
+		std::vector<uint8_t> table;
+		randomTable(table, senses, transmitters);
+		if (!check(table, senses, transmitters, false)) {
+			printf("round %lu mismatch\n", round);
+			mismatches++;
+		}
+	}
+
+	if (rounds > 0)
+		printf("%lu random connector tables, %lu mismatches\n", rounds, mismatches);
+
+	return ok && mismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,384 @@
+//
+// FB Patch Replay
+// Replays framebuffer-patchN find/replace pairs over a platform table with the per-patch search used before
+// MultiPatternPatcher and with the current applyFramebufferPatches logic, and diffs the results byte for byte.
+//
+// Usage:
+//   FbPatchReplay [-p framebufferid] [-r rounds] [-s seed] [table.bin [framebufferid:find:replace[:count]]...]
+//
+//   -p framebufferid  current framebuffer, hexadecimal (default the framebuffer of the first patch)
+//   -r rounds         amount of random patch sets to replay (default 10000 without explicit patches)
+//   -s seed           random seed (default 1)
+//
+// find and replace are hexadecimal byte strings of the same length, framebufferid and count are hexadecimal
+// and decimal numbers like in framebuffer-patchN properties. Explicit patches are replayed once, random patch
+// sets are built from the table contents and include chained and overlapping patches. Every replay is done
+// with framebuffer lookups in the patched table, as without the platform index, and in the original table.
+//
+// A platform table can be obtained with dump_platformlist.sh (native.bin). Without a table a synthetic one
+// is used. The framebuffer binary is assumed to continue for a page past the table.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../../WhateverGreen/kern_pattern.hpp"
+#include "../Include/tool_check.hpp"
+
+static const size_t kPageSize = 4096;
+static const size_t kMaxPatchCount = 10;
+
+struct Patch {
+	uint32_t framebufferId;
+	std::vector<uint8_t> find;
+	std::vector<uint8_t> replace;
+	size_t count;
+};
+
+struct Framebuffer {
+	std::vector<uint8_t> data;
+	size_t tableSize;
+};
+
+// Same as IGFX::findFramebufferId, the index is built before anything is patched
+static const uint8_t *indexTable;
+
+static uint8_t *findFramebufferId(uint8_t *table, uint32_t framebufferId) {
+	const uint8_t *search = indexTable ? indexTable : table;
+	for (size_t i = 0; i + sizeof(uint32_t) <= kPageSize; i += sizeof(uint32_t)) {
+		uint32_t value;
+		memcpy(&value, search + i, sizeof(value));
+		if (value == framebufferId)
+			return table + i;
+	}
+	return nullptr;
+}
+
+// Same as IGFX::applyPatch
+static bool applyPatch(const Patch &patch, uint8_t *framebufferStart, size_t framebufferSize, uint8_t *startingAddress, size_t maxSize) {
+	bool r = false;
+	size_t i = 0, patchCount = 0;
+	size_t size = patch.find.size();
+	uint8_t *startAddress = startingAddress;
+	uint8_t *endAddress = startingAddress + maxSize - size;
+
+	if (startAddress < framebufferStart)
+		startAddress = framebufferStart;
+	if (endAddress > framebufferStart + framebufferSize)
+		endAddress = framebufferStart + framebufferSize;
+
+	while (startAddress < endAddress) {
+		for (i = 0; i < size; i++) {
+			if (startAddress[i] != patch.find[i])
+				break;
+		}
+		if (i == size) {
+			for (i = 0; i < size; i++)
+				startAddress[i] = patch.replace[i];
+
+			r = true;
+
+			if (++patchCount >= patch.count)
+				break;
+
+			startAddress += size;
+			continue;
+		}
+
+		startAddress++;
+	}
+
+	return r;
+}
+
+// Previous applyFramebufferPatches loop
+static uint32_t applyOld(uint32_t framebufferId, const std::vector<Patch> &patches, uint8_t *framebuffer, size_t framebufferSize) {
+	uint32_t applied = 0;
+	uint8_t *platformInformationAddress = findFramebufferId(framebuffer, framebufferId);
+	if (!platformInformationAddress)
+		return 0;
+	for (size_t i = 0; i < patches.size(); i++) {
+		if (patches[i].framebufferId != framebufferId) {
+			framebufferId = patches[i].framebufferId;
+			platformInformationAddress = findFramebufferId(framebuffer, framebufferId);
+		}
+		if (!platformInformationAddress)
+			continue;
+		if (applyPatch(patches[i], framebuffer, framebufferSize, platformInformationAddress, kPageSize))
+			applied |= 1U << i;
+	}
+	return applied;
+}
+
+// Current applyFramebufferPatches, returns whether the single pass was used
+static uint32_t applyNew(uint32_t framebufferId, const std::vector<Patch> &patches, uint8_t *framebuffer, size_t framebufferSize, bool &single) {
+	auto tableStart = framebuffer;
+	auto tableEnd = framebuffer + framebufferSize;
+	auto lastEntry = tableStart + kPageSize;
+	if (lastEntry < tableEnd && static_cast<size_t>(tableEnd - lastEntry) > kPageSize)
+		tableEnd = lastEntry + kPageSize;
+
+	uint32_t primaryId = framebufferId;
+	uint32_t applied = 0;
+	single = false;
+	uint8_t *platformInformationAddress = findFramebufferId(framebuffer, framebufferId);
+	if (!platformInformationAddress)
+		return 0;
+
+	MultiPatternPatcher<kMaxPatchCount> patcher;
+	int patternIndices[kMaxPatchCount];
+	bool ordered = false;
+
+	for (size_t i = 0; i < patches.size(); i++) {
+		patternIndices[i] = -1;
+		if (patches[i].framebufferId != framebufferId) {
+			framebufferId = patches[i].framebufferId;
+			platformInformationAddress = findFramebufferId(framebuffer, framebufferId);
+		}
+		if (!platformInformationAddress)
+			continue;
+
+		auto size = patches[i].find.size();
+		auto from = platformInformationAddress > tableStart ? static_cast<size_t>(platformInformationAddress - tableStart) : 0;
+		auto end = platformInformationAddress + kPageSize - size;
+		auto to = end > tableStart ? static_cast<size_t>((end < tableEnd ? end : tableEnd) - tableStart) : 0;
+		patternIndices[i] = patcher.add(patches[i].find.data(), size, patches[i].replace.data(), size,
+										patches[i].count, from, to);
+		if (patternIndices[i] < 0)
+			ordered = true;
+	}
+
+	if (!indexTable) {
+		ordered = ordered || patcher.touches(&primaryId, sizeof(primaryId));
+		for (size_t i = 0; i < patches.size() && !ordered; i++)
+			ordered = patcher.touches(&patches[i].framebufferId, sizeof(patches[i].framebufferId));
+	}
+
+	if (!ordered && patcher.independent()) {
+		single = true;
+		uint32_t matched = patcher.apply(tableStart, static_cast<size_t>(tableEnd - tableStart));
+		for (size_t i = 0; i < patches.size(); i++)
+			if (patternIndices[i] >= 0 && (matched & (1U << patternIndices[i])))
+				applied |= 1U << i;
+	} else {
+		applied = applyOld(primaryId, patches, framebuffer, framebufferSize);
+	}
+
+	return applied;
+}
+
+static bool replay(const Framebuffer &framebuffer, uint32_t framebufferId, const std::vector<Patch> &patches, bool indexed, bool verbose, bool &single) {
+	indexTable = indexed ? framebuffer.data.data() : nullptr;
+	auto before = framebuffer.data;
+	auto after = framebuffer.data;
+	uint32_t appliedOld = applyOld(framebufferId, patches, before.data(), before.size());
+	uint32_t appliedNew = applyNew(framebufferId, patches, after.data(), after.size(), single);
+
+	size_t differences = 0;
+	for (size_t i = 0; i < before.size(); i++) {
+		if (before[i] != after[i]) {
+			if (verbose && differences < 16)
+				printf("  0x%04zx: old %02X new %02X\n", i, before[i], after[i]);
+			differences++;
+		}
+	}
+
+	if (verbose || differences > 0 || appliedOld != appliedNew)
+		printf("%s, %s pass, applied old %03X new %03X, %zu bytes differ\n", indexed ? "indexed" : "not indexed",
+			   single ? "single" : "ordered", appliedOld, appliedNew, differences);
+
+	return differences == 0 && appliedOld == appliedNew;
+}
+
+static bool parseHex(const char *text, size_t length, std::vector<uint8_t> &bytes) {
+	if (length == 0 || length % 2 != 0)
+		return false;
+	bytes.clear();
+	for (size_t i = 0; i < length; i += 2) {
+		char digits[3] = {text[i], text[i + 1], '\0'};
+		char *end = nullptr;
+		bytes.push_back(static_cast<uint8_t>(strtoul(digits, &end, 16)));
+		if (*end != '\0')
+			return false;
+	}
+	return true;
+}
+
+static bool parsePatch(const char *text, Patch &patch) {
+	char *end = nullptr;
+	patch.framebufferId = static_cast<uint32_t>(strtoul(text, &end, 16));
+	if (*end != ':')
+		return false;
+	auto find = end + 1;
+	auto colon = strchr(find, ':');
+	if (!colon || !parseHex(find, static_cast<size_t>(colon - find), patch.find))
+		return false;
+	auto replace = colon + 1;
+	colon = strchr(replace, ':');
+	size_t length = colon ? static_cast<size_t>(colon - replace) : strlen(replace);
+	if (!parseHex(replace, length, patch.replace) || patch.replace.size() != patch.find.size())
+		return false;
+	patch.count = 1;
+	if (colon) {
+		patch.count = strtoul(colon + 1, &end, 10);
+		if (*end != '\0' || patch.count == 0)
+			return false;
+	}
+	return true;
+}
+
+static bool loadTable(const char *path, Framebuffer &framebuffer) {
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size < static_cast<long>(sizeof(uint32_t))) {
+		fclose(file);
+		return false;
+	}
+	framebuffer.tableSize = static_cast<size_t>(size);
+	framebuffer.data.assign(framebuffer.tableSize + kPageSize, 0);
+	bool ok = fread(framebuffer.data.data(), 1, framebuffer.tableSize, file) == framebuffer.tableSize;
+	fclose(file);
+	return ok;
+}
+
+static void syntheticTable(Framebuffer &framebuffer) {
+	// 0x98 bytes per entry as on Skylake, with few distinct byte values to produce many matches
+	static const uint8_t alphabet[] = {0x00, 0x01, 0x02, 0x05, 0x10, 0x87, 0xFF};
+	static const size_t entrySize = 0x98;
+	framebuffer.tableSize = entrySize * 40;
+	framebuffer.data.assign(framebuffer.tableSize + kPageSize, 0);
+	for (size_t i = 0; i < framebuffer.tableSize; i++)
+		framebuffer.data[i] = alphabet[next() % arrsize(alphabet)];
+	for (size_t i = 0; i < framebuffer.tableSize / entrySize; i++) {
+		uint32_t framebufferId = 0x19160000 + static_cast<uint32_t>(i);
+		memcpy(&framebuffer.data[i * entrySize], &framebufferId, sizeof(framebufferId));
+	}
+}
+
+static void randomPatches(const Framebuffer &framebuffer, std::vector<Patch> &patches) {
+	patches.clear();
+	size_t patchCount = 1 + next() % kMaxPatchCount;
+	size_t searchable = framebuffer.tableSize < kPageSize ? framebuffer.tableSize : kPageSize;
+	for (size_t i = 0; i < patchCount; i++) {
+		Patch patch;
+		// Reuse the previous framebuffer most of the time like real configurations
+		auto entry = (next() % (searchable / sizeof(uint32_t))) * sizeof(uint32_t);
+		if (i > 0 && next() % 4 != 0)
+			patch.framebufferId = patches[i - 1].framebufferId;
+		else
+			memcpy(&patch.framebufferId, &framebuffer.data[entry], sizeof(patch.framebufferId));
+
+		size_t size = 1 + next() % 12;
+		auto source = entry + next() % kPageSize;
+		if (source + size > framebuffer.tableSize)
+			source = framebuffer.tableSize > size ? framebuffer.tableSize - size : 0;
+		patch.find.assign(framebuffer.data.begin() + source, framebuffer.data.begin() + source + size);
+
+		// Chain to an earlier patch, overlap with one or use table bytes
+		auto kind = next() % 4;
+		if (i > 0 && kind == 0) {
+			auto &other = patches[next() % i];
+			patch.find = other.replace;
+		} else if (i > 0 && kind == 1) {
+			auto &other = patches[next() % i];
+			size = other.find.size();
+			patch.find = other.find;
+			auto shift = next() % size;
+			patch.find.erase(patch.find.begin(), patch.find.begin() + shift);
+			patch.find.push_back(framebuffer.data[next() % framebuffer.tableSize]);
+		}
+
+		patch.replace = patch.find;
+		for (auto &byte : patch.replace)
+			if (next() % 2 == 0)
+				byte = static_cast<uint8_t>(next());
+		patch.count = next() % 3 == 0 ? 1 + next() % 4 : 1;
+		patches.push_back(patch);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long rounds = 0;
+	bool explicitRounds = false;
+	uint32_t primaryId = 0;
+	bool primary = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "p:r:s:")) != -1) {
+		if (opt == 'p') {
+			primaryId = static_cast<uint32_t>(strtoul(optarg, nullptr, 16));
+			primary = true;
+		} else if (opt == 'r') {
+			rounds = strtoul(optarg, nullptr, 0);
+			explicitRounds = true;
+		} else if (opt == 's') {
+			seed(strtoull(optarg, nullptr, 0));
+		} else {
+			fprintf(stderr, "Usage: %s [-p framebufferid] [-r rounds] [-s seed] [table.bin [framebufferid:find:replace[:count]]...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Framebuffer framebuffer;
+	if (optind < argc) {
+		if (!loadTable(argv[optind], framebuffer)) {
+			fprintf(stderr, "Failed to load %s\n", argv[optind]);
+			return 1;
+		}
+		optind++;
+	} else {
+		syntheticTable(framebuffer);
+	}
+
+	std::vector<Patch> patches;
+	for (int i = optind; i < argc; i++) {
+		Patch patch;
+		if (!parsePatch(argv[i], patch)) {
+			fprintf(stderr, "Invalid patch %s\n", argv[i]);
+			return 1;
+		}
+		patches.push_back(patch);
+	}
+
+	if (patches.size() > kMaxPatchCount) {
+		fprintf(stderr, "At most %zu patches are supported\n", kMaxPatchCount);
+		return 1;
+	}
+
+	bool ok = true;
+	bool single = false;
+	if (!patches.empty()) {
+		auto framebufferId = primary ? primaryId : patches[0].framebufferId;
+		ok = replay(framebuffer, framebufferId, patches, false, true, single);
+		ok = replay(framebuffer, framebufferId, patches, true, true, single) && ok;
+	} else if (!explicitRounds) {
+		rounds = 10000;
+	}
+
+	unsigned long mismatches = 0, singlePasses = 0;
+	for (unsigned long round = 0; round < rounds; round++) {
+		randomPatches(framebuffer, patches);
+		// The current framebuffer is usually the one patched first
+		auto framebufferId = next() % 4 != 0 ? patches[0].framebufferId : patches[next() % patches.size()].framebufferId;
+		bool indexed = round % 2 != 0;
+		if (!replay(framebuffer, framebufferId, patches, indexed, false, single)) {
+			printf("round %lu mismatch\n", round);
+			mismatches++;
+		}
+		if (single)
+			singlePasses++;
+	}
+
+	if (rounds > 0)
+		printf("%lu random patch sets, %lu single pass, %lu ordered pass, %lu mismatches\n",
+			   rounds, singlePasses, rounds - singlePasses, mismatches);
+
+	return ok && mismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,310 @@
+//
+// GuC Pack
+// Compresses GuC firmware images for kern_guc.cpp and checks the embedded ones.
+//
+// Usage:
+//   GuCPack pack <name> <firmware.bin>   print LZSS compressed firmware with the signature as kern_guc.cpp definitions
+//   GuCPack check [skl.bin kbl.bin]      decompress every embedded firmware and compare it with its digest,
+//                                        and with the original images when given
+//
+// The firmware images are taken from:
+// https://git.kernel.org/pub/scm/linux/kernel/git/firmware/linux-firmware.git/tree/i915
+// Each image consists of the firmware + RSA signature (last 256 bytes).
+//
+// The compressed format is the kernelcache LZSS decompressed by Lilu Compression::ModeLZSS.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../WhateverGreen/kern_guc.cpp"
+
+// Keep in sync with decompress_lzss used by Lilu.
+#define LZSS_N         4096
+#define LZSS_F         18
+#define LZSS_THRESHOLD 2
+
+static size_t lzssDecompress(uint8_t *dst, size_t dstlen, const uint8_t *src, size_t srclen) {
+	uint8_t text[LZSS_N + LZSS_F - 1];
+	const uint8_t *srcend = src + srclen;
+	uint8_t *dststart = dst, *dstend = dst + dstlen;
+	uint32_t r = LZSS_N - LZSS_F, flags = 0;
+
+	memset(text, ' ', LZSS_N - LZSS_F);
+	while (1) {
+		if (((flags >>= 1) & 0x100) == 0) {
+			if (src >= srcend)
+				break;
+			flags = *src++ | 0xFF00;
+		}
+		if (flags & 1) {
+			if (src >= srcend || dst >= dstend)
+				break;
+			uint8_t c = *src++;
+			*dst++ = c;
+			text[r++] = c;
+			r &= LZSS_N - 1;
+		} else {
+			if (src + 1 >= srcend)
+				break;
+			uint32_t i = *src++;
+			uint32_t j = *src++;
+			i |= (j & 0xF0) << 4;
+			j = (j & 0x0F) + LZSS_THRESHOLD;
+			for (uint32_t k = 0; k <= j; k++) {
+				if (dst >= dstend)
+					return (size_t)(dst - dststart);
+				uint8_t c = text[(i + k) & (LZSS_N - 1)];
+				*dst++ = c;
+				text[r++] = c;
+				r &= LZSS_N - 1;
+			}
+		}
+	}
+
+	return (size_t)(dst - dststart);
+}
+
+// Greedy encoder with hash chains over 3-byte prefixes, references only point to already written data.
+static size_t lzssCompress(uint8_t *dst, const uint8_t *src, size_t srclen) {
+	enum { HashSize = 1 << 16, MaxDistance = LZSS_N - LZSS_F, MaxLength = LZSS_F };
+	int32_t *head = static_cast<int32_t *>(malloc(HashSize * sizeof(int32_t)));
+	int32_t *prev = static_cast<int32_t *>(malloc(srclen * sizeof(int32_t)));
+	if (!head || !prev) {
+		free(head);
+		free(prev);
+		return 0;
+	}
+	for (size_t i = 0; i < HashSize; i++)
+		head[i] = -1;
+
+	size_t out = 0, flagPos = 0, pos = 0;
+	uint32_t bit = 8;
+
+	#define HASH(p) ((uint32_t)(((src[p] << 16) | (src[(p) + 1] << 8) | src[(p) + 2]) * 2654435761U) >> 16)
+	#define INSERT(p) do { if ((p) + 2 < srclen) { uint32_t h = HASH(p); prev[p] = head[h]; head[h] = (int32_t)(p); } } while (0)
+
+	while (pos < srclen) {
+		if (bit == 8) {
+			flagPos = out++;
+			dst[flagPos] = 0;
+			bit = 0;
+		}
+
+		size_t bestLength = 0, bestPos = 0;
+		if (pos + 2 < srclen) {
+			for (int32_t cand = head[HASH(pos)]; cand >= 0 && pos - (size_t)cand <= MaxDistance; cand = prev[cand]) {
+				size_t length = 0;
+				while (length < MaxLength && pos + length < srclen && src[cand + length] == src[pos + length])
+					length++;
+				if (length > bestLength) {
+					bestLength = length;
+					bestPos = (size_t)cand;
+					if (length == MaxLength)
+						break;
+				}
+			}
+		}
+
+		if (bestLength > LZSS_THRESHOLD) {
+			uint32_t ring = (uint32_t)((LZSS_N - LZSS_F + bestPos) & (LZSS_N - 1));
+			dst[out++] = (uint8_t)ring;
+			dst[out++] = (uint8_t)(((ring >> 4) & 0xF0) | (bestLength - LZSS_THRESHOLD - 1));
+			for (size_t i = 0; i < bestLength; i++, pos++)
+				INSERT(pos);
+		} else {
+			dst[flagPos] |= 1U << bit;
+			dst[out++] = src[pos];
+			INSERT(pos);
+			pos++;
+		}
+		bit++;
+	}
+
+	#undef INSERT
+	#undef HASH
+
+	free(head);
+	free(prev);
+	return out;
+}
+
+// Minimal SHA-256, FIPS 180-4.
+static void sha256(const uint8_t *data, size_t size, uint8_t digest[32]) {
+	static const uint32_t k[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+	uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+	#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+	size_t total = ((size + 9 + 63) / 64) * 64;
+	for (size_t block = 0; block < total; block += 64) {
+		uint8_t chunk[64];
+		for (size_t i = 0; i < 64; i++) {
+			size_t p = block + i;
+			if (p < size)
+				chunk[i] = data[p];
+			else if (p == size)
+				chunk[i] = 0x80;
+			else if (p >= total - 8)
+				chunk[i] = (uint8_t)(((uint64_t)size * 8) >> (8 * (total - 1 - p)));
+			else
+				chunk[i] = 0;
+		}
+
+		uint32_t w[64];
+		for (size_t i = 0; i < 16; i++)
+			w[i] = ((uint32_t)chunk[i * 4] << 24) | ((uint32_t)chunk[i * 4 + 1] << 16) | ((uint32_t)chunk[i * 4 + 2] << 8) | chunk[i * 4 + 3];
+		for (size_t i = 16; i < 64; i++) {
+			uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+			uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+			w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+		}
+
+		uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+		for (size_t i = 0; i < 64; i++) {
+			uint32_t t1 = hh + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+			uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+			hh = g; g = f; f = e; e = d + t1; d = c; c = b; b = a; a = t1 + t2;
+		}
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+	}
+
+	#undef ROR
+
+	for (size_t i = 0; i < 8; i++) {
+		digest[i * 4] = (uint8_t)(h[i] >> 24);
+		digest[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+		digest[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+		digest[i * 4 + 3] = (uint8_t)h[i];
+	}
+}
+
+static uint8_t *readFile(const char *path, size_t *size) {
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t *data = length > 0 ? static_cast<uint8_t *>(malloc((size_t)length)) : NULL;
+	if (data && fread(data, 1, (size_t)length, file) != (size_t)length) {
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+	*size = data ? (size_t)length : 0;
+	return data;
+}
+
+static void printArray(const char *name, const uint8_t *data, size_t size) {
+	printf("static const uint8_t %s[] = {\n", name);
+	for (size_t i = 0; i < size; i++) {
+		if (i % 16 == 0)
+			printf("\t");
+		printf("0x%02X%s", data[i], i + 1 == size ? "\n" : (i % 16 == 15 ? ",\n" : ", "));
+	}
+	printf("};\n\n");
+}
+
+static int pack(const char *name, const char *path) {
+	size_t size;
+	uint8_t *image = readFile(path, &size);
+	if (!image || size <= GuCFirmwareSignatureSize) {
+		fprintf(stderr, "Failed to read %s\n", path);
+		free(image);
+		return 1;
+	}
+
+	// Worst case is a flag byte per 8 literals
+	uint8_t *compressed = static_cast<uint8_t *>(malloc(size + size / 8 + 1));
+	size_t compressedSize = compressed ? lzssCompress(compressed, image, size) : 0;
+	uint8_t *roundtrip = static_cast<uint8_t *>(malloc(size));
+	if (compressedSize == 0 || !roundtrip || lzssDecompress(roundtrip, size, compressed, compressedSize) != size ||
+		memcmp(roundtrip, image, size) != 0) {
+		fprintf(stderr, "Failed to compress %s\n", path);
+		free(image);
+		free(compressed);
+		free(roundtrip);
+		return 1;
+	}
+
+	uint8_t digest[GuCFirmwareDigestSize];
+	sha256(image, size, digest);
+
+	char arrayName[64];
+	snprintf(arrayName, sizeof(arrayName), "GuCFirmware%sBlob", name);
+	printArray(arrayName, compressed, compressedSize);
+	snprintf(arrayName, sizeof(arrayName), "GuCFirmware%sDigestBlob", name);
+	printArray(arrayName, digest, sizeof(digest));
+
+	printf("const uint8_t *GuCFirmware%s = &GuCFirmware%sBlob[0];\n", name, name);
+	printf("const uint8_t *GuCFirmware%sDigest = &GuCFirmware%sDigestBlob[0];\n", name, name);
+	printf("const size_t GuCFirmware%sCompressedSize = sizeof(GuCFirmware%sBlob);\n", name, name);
+	printf("const size_t GuCFirmware%sSize = %zu - GuCFirmwareSignatureSize;\n", name, size);
+
+	fprintf(stderr, "%s: %zu -> %zu bytes\n", name, size, compressedSize);
+	free(image);
+	free(compressed);
+	free(roundtrip);
+	return 0;
+}
+
+static int checkFirmware(const char *name, const uint8_t *blob, size_t blobSize, size_t fwSize, const uint8_t *expectedDigest, const char *original) {
+	size_t size = fwSize + GuCFirmwareSignatureSize;
+	uint8_t *image = static_cast<uint8_t *>(malloc(size));
+	if (!image || lzssDecompress(image, size, blob, blobSize) != size) {
+		fprintf(stderr, "%s: decompressed size mismatch\n", name);
+		free(image);
+		return 1;
+	}
+
+	uint8_t digest[GuCFirmwareDigestSize];
+	sha256(image, size, digest);
+	if (memcmp(digest, expectedDigest, sizeof(digest)) != 0) {
+		fprintf(stderr, "%s: digest mismatch\n", name);
+		free(image);
+		return 1;
+	}
+
+	if (original) {
+		size_t originalSize;
+		uint8_t *originalImage = readFile(original, &originalSize);
+		if (!originalImage || originalSize != size || memcmp(originalImage, image, size) != 0) {
+			fprintf(stderr, "%s: differs from %s\n", name, original);
+			free(originalImage);
+			free(image);
+			return 1;
+		}
+		free(originalImage);
+	}
+
+	printf("%s: %zu -> %zu bytes, OK\n", name, size, blobSize);
+	free(image);
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc == 4 && strcmp(argv[1], "pack") == 0)
+		return pack(argv[2], argv[3]);
+
+	if ((argc == 2 || argc == 4) && strcmp(argv[1], "check") == 0) {
+		int failed = 0;
+		failed |= checkFirmware("SKL", GuCFirmwareSKL, GuCFirmwareSKLCompressedSize, GuCFirmwareSKLSize, GuCFirmwareSKLDigest, argc == 4 ? argv[2] : NULL);
+		failed |= checkFirmware("KBL", GuCFirmwareKBL, GuCFirmwareKBLCompressedSize, GuCFirmwareKBLSize, GuCFirmwareKBLDigest, argc == 4 ? argv[3] : NULL);
+		return failed;
+	}
+
+	fprintf(stderr, "Usage:\n  %s pack <name> <firmware.bin>\n  %s check [skl.bin kbl.bin]\n", argv[0], argv[0]);
+	return 1;
+}
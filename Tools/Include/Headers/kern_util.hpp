@@ -0,0 +1,85 @@
+//
+// kern_util.hpp
+// Minimal host replacement of the Lilu header for the tools including WhateverGreen sources.
+// Only the helpers used by those sources are provided, pass -I../Include to use it.
+//
+
+#ifndef kern_util_hpp
+#define kern_util_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LIKELY(x)   __builtin_expect(!!(x), 1)
+#define UNLIKELY(x) __builtin_expect(!!(x), 0)
+
+#define PACKED __attribute__((packed))
+
+// Parameter nullability attributes are only supported by clang
+#ifdef __clang__
+#define NONNULL __attribute__((nonnull))
+#else
+#define NONNULL
+#endif
+
+// Logging is disabled unless a tool defines HOST_LOG
+#ifdef HOST_LOG
+#define SYSLOG(module, str, ...) printf("%s: " str "\n", module, ## __VA_ARGS__)
+#define DBGLOG(module, str, ...) printf("%s: " str "\n", module, ## __VA_ARGS__)
+#else
+#define SYSLOG(module, str, ...) do { } while (0)
+#define DBGLOG(module, str, ...) do { } while (0)
+#endif
+
+static inline void lilu_os_memcpy(void *dst, const void *src, size_t len) {
+	memcpy(dst, src, len);
+}
+
+namespace Buffer {
+	template <typename T>
+	inline T *create(size_t size) {
+		return static_cast<T *>(malloc(sizeof(T) * size));
+	}
+
+	template <typename T>
+	inline void deleter(T *buf) {
+		free(buf);
+	}
+}
+
+template <typename T, size_t N>
+constexpr size_t arrsize(const T (&)[N]) {
+	return N;
+}
+
+enum KernelVersion {
+	Unsupported = 0,
+	SnowLeopard = 10,
+	Lion = 11,
+	MountainLion = 12,
+	Mavericks = 13,
+	Yosemite = 14,
+	ElCapitan = 15,
+	Sierra = 16,
+	HighSierra = 17,
+	Mojave = 18,
+	Catalina = 19,
+	BigSur = 20,
+	Monterey = 21,
+	Ventura = 22,
+	Sonoma = 23,
+	Sequoia = 24,
+	Tahoe = 25,
+};
+
+// Emulated kernel version, tools may change it to test version dependent code
+inline KernelVersion hostKernelVersion = KernelVersion::Sequoia;
+
+static inline KernelVersion getKernelVersion() {
+	return hostKernelVersion;
+}
+
+#endif /* kern_util_hpp */
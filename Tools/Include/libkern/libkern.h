@@ -0,0 +1,12 @@
+//
+// libkern.h
+// Minimal host replacement of the kernel header for the tools including WhateverGreen sources.
+//
+
+#ifndef libkern_h
+#define libkern_h
+
+#include <stdio.h>
+#include <string.h>
+
+#endif /* libkern_h */
@@ -0,0 +1,77 @@
+//
+// tool_check.hpp
+// Check reporting and the random number generator shared by the tools, include it as "../Include/tool_check.hpp".
+//
+
+#ifndef tool_check_hpp
+#define tool_check_hpp
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ *  Amount of performed and failed checks
+ */
+inline unsigned long checks;
+inline unsigned long failures;
+
+/**
+ *  Count a check and report it when its condition does not hold
+ *
+ *  @param file    source file of the check
+ *  @param line    source line of the check
+ *  @param text    check condition as written
+ *  @param cond    check condition
+ *  @param format  optional printf format describing the check, reported instead of the condition
+ */
+inline void checkResult(const char *file, int line, const char *text, bool cond, const char *format = nullptr, ...) __attribute__((format(printf, 5, 6)));
+inline void checkResult(const char *file, int line, const char *text, bool cond, const char *format, ...) {
+	checks++;
+	if (cond)
+		return;
+	failures++;
+	printf("FAIL %s:%d: ", file, line);
+	if (format) {
+		va_list args;
+		va_start(args, format);
+		vprintf(format, args);
+		va_end(args);
+	} else {
+		printf("%s", text);
+	}
+	printf("\n");
+}
+
+/**
+ *  CHECK(cond) or CHECK(cond, format, ...)
+ */
+#define CHECK(...) checkResult(__FILE__, __LINE__, #__VA_ARGS__, __VA_ARGS__)
+
+/**
+ *  xorshift64 generator state, never 0
+ */
+inline uint64_t state = 1;
+
+/**
+ *  Set the generator seed, 0 is replaced with 1
+ *
+ *  @param value  seed value
+ */
+inline void seed(uint64_t value) {
+	state = value != 0 ? value : 1;
+}
+
+/**
+ *  Next pseudo-random value
+ *
+ *  @return low 32 bits of the generator state
+ */
+inline uint32_t next() {
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return static_cast<uint32_t>(state);
+}
+
+#endif /* tool_check_hpp */
@@ -0,0 +1,387 @@
+//
+// Inject Check
+// Tests InjectionCoordinator from kern_igfx_inject.hpp, comparing the frozen dispatch table with the descriptor lists,
+// checks the priority ordered injector chains and their pass-through semantics, and measures the cost of a register
+// access through the coordinator with a fake framebuffer controller.
+//
+// Usage:
+//   InjectCheck [-r rounds] [-s seed] [-n accesses]
+//
+//   -r rounds     amount of random descriptor sets to compare (default 10000)
+//   -s seed       random seed (default 1)
+//   -n accesses   amount of register accesses per benchmark run (default 10000000)
+//
+// The benchmark replays random display engine register accesses, 1% of them to monitored registers, through
+// ReadRegister32 and WriteRegister32 wrappers identical to MMIORegistersReadSupport and MMIORegistersWriteSupport.
+// It reports ns per access for the original function alone, for the descriptor lists and for the frozen table.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+
+#include "../../WhateverGreen/kern_igfx_inject.hpp"
+#include "../Include/tool_check.hpp"
+
+static const size_t kRuns = 5;
+
+// Same as kern_igfx_backlight.hpp
+static constexpr uint32_t BLC_PWM_CPU_CTL = 0x48254;
+static constexpr uint32_t BXT_BLC_PWM_CTL1 = 0xC8250;
+static constexpr uint32_t BXT_BLC_PWM_FREQ1 = 0xC8254;
+static constexpr uint32_t BXT_BLC_PWM_DUTY1 = 0xC8258;
+
+// Same as kern_igfx.hpp
+using MMIOReadPrologue = InjectionDescriptor<uint32_t, void (*)(void *, uint32_t)>;
+using MMIOReadReplacer = InjectionDescriptor<uint32_t, uint32_t (*)(void *, uint32_t)>;
+using MMIOReadEpilogue = InjectionDescriptor<uint32_t, uint32_t (*)(void *, uint32_t, uint32_t)>;
+using MMIOWriteInjectionDescriptor = InjectionDescriptor<uint32_t, void (*)(void *, uint32_t, uint32_t)>;
+using ReadCoordinator = InjectionCoordinator<MMIOReadPrologue, MMIOReadReplacer, MMIOReadEpilogue>;
+using WriteCoordinator = InjectionCoordinator<MMIOWriteInjectionDescriptor, MMIOWriteInjectionDescriptor, MMIOWriteInjectionDescriptor>;
+
+// Keeps the values read in the benchmark alive
+uint32_t sink;
+
+// Fake framebuffer controller with the display engine register file
+struct Controller {
+	uint32_t registers[0x100000 / sizeof(uint32_t)];
+	uint64_t reads;
+	uint64_t writes;
+};
+
+__attribute__((noinline)) static uint32_t orgReadRegister32(void *that, uint32_t address) {
+	auto controller = static_cast<Controller *>(that);
+	controller->reads++;
+	return __atomic_load_n(&controller->registers[(address & 0xFFFFF) / sizeof(uint32_t)], __ATOMIC_RELAXED);
+}
+
+__attribute__((noinline)) static void orgWriteRegister32(void *that, uint32_t address, uint32_t value) {
+	auto controller = static_cast<Controller *>(that);
+	controller->writes++;
+	__atomic_store_n(&controller->registers[(address & 0xFFFFF) / sizeof(uint32_t)], value, __ATOMIC_RELAXED);
+}
+
+// Same as MMIORegistersReadSupport::wrapReadRegister32
+static uint32_t wrapReadRegister32(ReadCoordinator &self, void *controller, uint32_t address) {
+	MMIOReadPrologue::Injector prologueInjector {nullptr};
+	MMIOReadReplacer::Injector replacerInjector {nullptr};
+	MMIOReadEpilogue::Injector epilogueInjector {nullptr};
+	if (LIKELY(!self.lookup(address, prologueInjector, replacerInjector, epilogueInjector)))
+		return orgReadRegister32(controller, address);
+
+	if (prologueInjector)
+		prologueInjector(controller, address);
+
+	if (replacerInjector)
+		return replacerInjector(controller, address);
+
+	uint32_t retVal = orgReadRegister32(controller, address);
+
+	if (epilogueInjector)
+		return epilogueInjector(controller, address, retVal);
+
+	return retVal;
+}
+
+// Same as MMIORegistersWriteSupport::wrapWriteRegister32
+static void wrapWriteRegister32(WriteCoordinator &self, void *controller, uint32_t address, uint32_t value) {
+	MMIOWriteInjectionDescriptor::Injector prologueInjector {nullptr};
+	MMIOWriteInjectionDescriptor::Injector replacerInjector {nullptr};
+	MMIOWriteInjectionDescriptor::Injector epilogueInjector {nullptr};
+	if (LIKELY(!self.lookup(address, prologueInjector, replacerInjector, epilogueInjector))) {
+		orgWriteRegister32(controller, address, value);
+		return;
+	}
+
+	if (prologueInjector)
+		prologueInjector(controller, address, value);
+
+	if (replacerInjector)
+		return replacerInjector(controller, address, value);
+
+	orgWriteRegister32(controller, address, value);
+
+	if (epilogueInjector)
+		return epilogueInjector(controller, address, value);
+}
+
+// Injectors identify themselves by the value they write
+template <uint32_t Tag>
+static void writeInjector(void *controller, uint32_t address, uint32_t value) {
+	orgWriteRegister32(controller, address, value ^ Tag);
+}
+
+template <uint32_t Tag>
+static uint32_t readInjector(void *controller, uint32_t address) {
+	return orgReadRegister32(controller, address) ^ Tag;
+}
+
+static void (*const writeInjectors[])(void *, uint32_t, uint32_t) {
+	writeInjector<0x1>, writeInjector<0x2>, writeInjector<0x4>, writeInjector<0x8>,
+	writeInjector<0x10>, writeInjector<0x20>, writeInjector<0x40>, writeInjector<0x80>
+};
+
+static void checkBacklightSetup() {
+	// BLR and BLS on Coffee Lake
+	MMIOWriteInjectionDescriptor blrFreq {BXT_BLC_PWM_FREQ1, writeInjectors[0], 100};
+	MMIOWriteInjectionDescriptor blrDuty {BXT_BLC_PWM_DUTY1, writeInjectors[1], 100};
+	MMIOWriteInjectionDescriptor blsDuty {BXT_BLC_PWM_DUTY1, writeInjectors[2], 200};
+	WriteCoordinator coordinator;
+	coordinator.replacerList.add(&blsDuty);
+	coordinator.replacerList.add(&blrFreq);
+	coordinator.replacerList.add(&blrDuty);
+
+	for (bool frozen : {false, true}) {
+		if (frozen)
+			CHECK(coordinator.freeze());
+		MMIOWriteInjectionDescriptor::Injector prologue {}, replacer {}, epilogue {};
+		CHECK(coordinator.lookup(BXT_BLC_PWM_DUTY1, prologue, replacer, epilogue));
+		CHECK(prologue == nullptr && replacer == writeInjectors[1] && epilogue == nullptr);
+		CHECK(coordinator.lookup(BXT_BLC_PWM_FREQ1, prologue, replacer, epilogue) && replacer == writeInjectors[0]);
+		CHECK(!coordinator.lookup(BXT_BLC_PWM_CTL1, prologue, replacer, epilogue));
+		// Same filter bit as BXT_BLC_PWM_FREQ1
+		CHECK(!coordinator.lookup(BLC_PWM_CPU_CTL, prologue, replacer, epilogue));
+	}
+}
+
+static void checkTooManyTriggers() {
+	std::vector<MMIOWriteInjectionDescriptor> descriptors;
+	for (uint32_t i = 0; i < 17; i++)
+		descriptors.push_back({0xC8000 + i * 4, writeInjectors[i % 8]});
+	WriteCoordinator coordinator;
+	for (auto &descriptor : descriptors)
+		coordinator.epilogueList.add(&descriptor);
+	CHECK(!coordinator.freeze());
+	// The lists are still used
+	MMIOWriteInjectionDescriptor::Injector prologue {}, replacer {}, epilogue {};
+	CHECK(coordinator.lookup(0xC8000 + 16 * 4, prologue, replacer, epilogue) && epilogue == writeInjectors[0]);
+}
+
+static void checkChainOrder() {
+	// Smaller priority values come first, equal ones in the order they were added
+	MMIOWriteInjectionDescriptor a {BXT_BLC_PWM_DUTY1, writeInjectors[0], 200};
+	MMIOWriteInjectionDescriptor b {BXT_BLC_PWM_DUTY1, writeInjectors[1], 100};
+	MMIOWriteInjectionDescriptor c {BXT_BLC_PWM_DUTY1, writeInjectors[2], 200};
+	MMIOWriteInjectionDescriptor d {BXT_BLC_PWM_DUTY1, writeInjectors[3], 50};
+	MMIOWriteInjectionDescriptor e {BXT_BLC_PWM_FREQ1, writeInjectors[4], 300};
+	InjectionDescriptorList<MMIOWriteInjectionDescriptor> list;
+	for (auto descriptor : {&a, &b, &e, &c, &d})
+		list.add(descriptor);
+
+	std::vector<MMIOWriteInjectionDescriptor *> order;
+	list.forEach([&](MMIOWriteInjectionDescriptor *descriptor) { order.push_back(descriptor); });
+	CHECK(order.size() == 5 && order[0] == &d && order[1] == &b && order[2] == &a && order[3] == &c && order[4] == &e);
+
+	CHECK(list.getInjector(BXT_BLC_PWM_DUTY1) == writeInjectors[3]);
+	CHECK(list.getInjector(BXT_BLC_PWM_DUTY1, 50) == writeInjectors[1]);
+	CHECK(list.getInjector(BXT_BLC_PWM_DUTY1, 100) == writeInjectors[0]);
+	// Same priority injectors are not reachable from each other
+	CHECK(list.getInjector(BXT_BLC_PWM_DUTY1, 200) == nullptr);
+	CHECK(list.getInjector(BXT_BLC_PWM_FREQ1, 100) == writeInjectors[4]);
+	CHECK(list.getInjector(BXT_BLC_PWM_CTL1) == nullptr);
+}
+
+// Backlight chain of BLR rescaling the duty cycle and BLS smoothing it
+static WriteCoordinator *chain;
+static std::vector<uint32_t> smootherTargets;
+
+// Same as MMIORegistersWriteSupport::passThrough
+static void passThrough(void *controller, uint32_t address, uint32_t value, uint32_t priority) {
+	auto replacer = chain->replacerList.getInjector(address, priority);
+	if (replacer)
+		replacer(controller, address, value);
+	else
+		orgWriteRegister32(controller, address, value);
+}
+
+static void fixDuty(void *controller, uint32_t address, uint32_t value) {
+	passThrough(controller, address, value * 2, 100);
+}
+
+static void smoothDuty(void *controller, uint32_t address, uint32_t value) {
+	smootherTargets.push_back(value);
+	passThrough(controller, address, value, 200);
+}
+
+static void checkPassThrough() {
+	MMIOWriteInjectionDescriptor bls {BXT_BLC_PWM_DUTY1, smoothDuty, 200};
+	MMIOWriteInjectionDescriptor blr {BXT_BLC_PWM_DUTY1, fixDuty, 100};
+	MMIOWriteInjectionDescriptor blrFreq {BXT_BLC_PWM_FREQ1, writeInjectors[0], 100};
+	WriteCoordinator coordinator;
+	chain = &coordinator;
+	// The smoother registers first, the order of the submodules no longer matters
+	coordinator.replacerList.add(&bls);
+	coordinator.replacerList.add(&blr);
+	coordinator.replacerList.add(&blrFreq);
+
+	auto controller = new Controller {};
+	for (bool frozen : {false, true}) {
+		if (frozen)
+			CHECK(coordinator.freeze());
+		smootherTargets.clear();
+		controller->writes = 0;
+		wrapWriteRegister32(coordinator, controller, BXT_BLC_PWM_DUTY1, 0x1000);
+		// A single register write per brightness change, rescaled by BLR before BLS sees it
+		CHECK(controller->writes == 1);
+		CHECK(controller->registers[BXT_BLC_PWM_DUTY1 / sizeof(uint32_t)] == 0x2000);
+		CHECK(smootherTargets.size() == 1 && smootherTargets[0] == 0x2000);
+		// Registers without a chain are not affected
+		wrapWriteRegister32(coordinator, controller, BXT_BLC_PWM_FREQ1, 0x10);
+		CHECK(controller->writes == 2 && controller->registers[BXT_BLC_PWM_FREQ1 / sizeof(uint32_t)] == (0x10 ^ 0x1));
+		CHECK(smootherTargets.size() == 1);
+	}
+	delete controller;
+	chain = nullptr;
+}
+
+// Random descriptor sets must resolve to the same injectors with and without the frozen table
+static void checkRandom(unsigned long rounds) {
+	unsigned long mismatches = 0, frozen = 0;
+	for (unsigned long round = 0; round < rounds; round++) {
+		WriteCoordinator coordinator;
+		std::vector<MMIOWriteInjectionDescriptor> descriptors;
+		size_t num = next() % 24;
+		descriptors.reserve(num);
+		for (size_t i = 0; i < num; i++)
+			descriptors.push_back({0xC8000 + (next() % 12) * 0x404, writeInjectors[next() % 8], next() % 4 * 100});
+		for (auto &descriptor : descriptors) {
+			switch (next() % 3) {
+				case 0: coordinator.prologueList.add(&descriptor); break;
+				case 1: coordinator.replacerList.add(&descriptor); break;
+				default: coordinator.epilogueList.add(&descriptor); break;
+			}
+		}
+
+		std::vector<uint32_t> triggers;
+		for (uint32_t i = 0; i < 12; i++)
+			triggers.push_back(0xC8000 + i * 0x404);
+		for (uint32_t i = 0; i < 16; i++)
+			triggers.push_back(next() & 0xFFFFC);
+
+		struct Result {
+			bool found;
+			MMIOWriteInjectionDescriptor::Injector prologue {}, replacer {}, epilogue {};
+		};
+		std::vector<Result> expected;
+		for (auto trigger : triggers) {
+			Result result {};
+			result.found = coordinator.lookup(trigger, result.prologue, result.replacer, result.epilogue);
+			expected.push_back(result);
+		}
+
+		if (!coordinator.freeze())
+			continue;
+		frozen++;
+		for (size_t i = 0; i < triggers.size(); i++) {
+			Result result {};
+			result.found = coordinator.lookup(triggers[i], result.prologue, result.replacer, result.epilogue);
+			auto &e = expected[i];
+			if (result.found != e.found || (e.found && (result.prologue != e.prologue || result.replacer != e.replacer ||
+														 result.epilogue != e.epilogue))) {
+				if (mismatches++ < 10)
+					printf("round %lu trigger 0x%x mismatch\n", round, triggers[i]);
+			}
+		}
+	}
+
+	printf("%lu random descriptor sets, %lu frozen, %lu mismatches\n", rounds, frozen, mismatches);
+	checks++;
+	if (mismatches != 0)
+		failures++;
+}
+
+struct Access {
+	uint32_t address;
+	uint32_t value;
+};
+
+template <typename F>
+static double measure(const std::vector<Access> &accesses, F access) {
+	double best = 0;
+	for (size_t run = 0; run < kRuns; run++) {
+		auto start = std::chrono::steady_clock::now();
+		for (auto &a : accesses)
+			access(a);
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		auto perAccess = elapsed.count() / accesses.size();
+		if (best == 0 || perAccess < best)
+			best = perAccess;
+	}
+	return best;
+}
+
+static void benchmark(size_t count, size_t triggers) {
+	if (count == 0)
+		return;
+
+	static const uint32_t backlight[] {BXT_BLC_PWM_FREQ1, BXT_BLC_PWM_DUTY1, BXT_BLC_PWM_CTL1, BLC_PWM_CPU_CTL};
+	std::vector<uint32_t> monitored;
+	for (size_t i = 0; i < triggers; i++)
+		monitored.push_back(i < arrsize(backlight) ? backlight[i] : 0xC8000 + static_cast<uint32_t>(i) * 0x404);
+
+	// Each trigger in a different list, the last one added is looked up last
+	std::vector<MMIOWriteInjectionDescriptor> writeDescriptors;
+	std::vector<MMIOReadEpilogue> readDescriptors;
+	writeDescriptors.reserve(triggers);
+	readDescriptors.reserve(triggers);
+	WriteCoordinator writes;
+	ReadCoordinator reads;
+	for (size_t i = 0; i < triggers; i++) {
+		writeDescriptors.push_back({monitored[i], writeInjectors[i % 8]});
+		readDescriptors.push_back({monitored[i], [](void *, uint32_t, uint32_t value) { return value + 1; }});
+		(i % 2 ? writes.replacerList : writes.epilogueList).add(&writeDescriptors.back());
+		reads.epilogueList.add(&readDescriptors.back());
+	}
+
+	std::vector<Access> accesses(count);
+	for (auto &a : accesses) {
+		a.address = next() % 100 == 0 && !monitored.empty() ? monitored[next() % monitored.size()] : 0x40000 + (next() % 0x24000) * 4;
+		a.value = next();
+	}
+
+	auto controller = new Controller {};
+	auto readDirect = measure(accesses, [&](const Access &a) { sink += orgReadRegister32(controller, a.address); });
+	auto writeDirect = measure(accesses, [&](const Access &a) { orgWriteRegister32(controller, a.address, a.value); });
+	auto readLists = measure(accesses, [&](const Access &a) { sink += wrapReadRegister32(reads, controller, a.address); });
+	auto writeLists = measure(accesses, [&](const Access &a) { wrapWriteRegister32(writes, controller, a.address, a.value); });
+	bool frozen = reads.freeze() && writes.freeze();
+	auto readFrozen = measure(accesses, [&](const Access &a) { sink += wrapReadRegister32(reads, controller, a.address); });
+	auto writeFrozen = measure(accesses, [&](const Access &a) { wrapWriteRegister32(writes, controller, a.address, a.value); });
+	delete controller;
+
+	printf("%2zu triggers%s | read: original %5.2f lists %5.2f frozen %5.2f ns | write: original %5.2f lists %5.2f frozen %5.2f ns\n",
+		   triggers, frozen ? "" : " (not frozen)", readDirect, readLists, readFrozen, writeDirect, writeLists, writeFrozen);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long rounds = 10000;
+	size_t accesses = 10000000;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "r:s:n:")) != -1) {
+		if (opt == 'r') {
+			rounds = strtoul(optarg, nullptr, 0);
+		} else if (opt == 's') {
+			seed(strtoull(optarg, nullptr, 0));
+		} else if (opt == 'n') {
+			accesses = strtoul(optarg, nullptr, 0);
+		} else {
+			fprintf(stderr, "Usage: %s [-r rounds] [-s seed] [-n accesses]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	checkBacklightSetup();
+	checkTooManyTriggers();
+	checkChainOrder();
+	checkPassThrough();
+	checkRandom(rounds);
+	printf("%lu checks, %lu failures\n", checks, failures);
+
+	for (size_t triggers : {0, 3, 8, 16})
+		benchmark(accesses, triggers);
+	return failures == 0 ? 0 : 2;
+}
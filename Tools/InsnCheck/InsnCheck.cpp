@@ -0,0 +1,315 @@
+//
+// Insn Check
+// Self-contained checks of the instruction pattern engine from kern_insn.hpp, no Lilu checkout is needed.
+//
+// Usage:
+//   InsnCheck
+//
+// The checks use a small decoder for the handful of encodings the patches look for and reject everything
+// else, which also stands in for instructions hde64 fails to decode. Decoding of real binaries is covered
+// by InsnProbe, which uses the hde64 disassembler from Lilu.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../../WhateverGreen/kern_insn.hpp"
+#include "../Include/tool_check.hpp"
+
+// Subset of hde64: REX, 90, C3, 00/89/8B/8D, 05/25 imm32, 80/C1/C6 imm8, 81/C7 imm32, 0F 85 rel32
+static size_t decode(uint64_t address, hde64s *hs) {
+	auto p = reinterpret_cast<const uint8_t *>(address);
+	auto s = p;
+	memset(hs, 0, sizeof(*hs));
+	if ((*p & 0xF0) == 0x40) {
+		hs->rex = *p;
+		hs->rex_w = (*p >> 3) & 1;
+		hs->rex_r = (*p >> 2) & 1;
+		hs->rex_x = (*p >> 1) & 1;
+		hs->rex_b = *p & 1;
+		p++;
+	}
+
+	hs->opcode = *p++;
+	bool modrm = false;
+	size_t imm = 0;
+	switch (hs->opcode) {
+		case 0x90: case 0xC3:
+			break;
+		case 0x05: case 0x25:
+			imm = 4;
+			break;
+		case 0x80: case 0xC1: case 0xC6:
+			modrm = true;
+			imm = 1;
+			break;
+		case 0x81: case 0xC7:
+			modrm = true;
+			imm = 4;
+			break;
+		case 0x00: case 0x89: case 0x8B: case 0x8D:
+			modrm = true;
+			break;
+		case 0x0F:
+			hs->opcode2 = *p++;
+			if (hs->opcode2 != 0x85)
+				goto error;
+			imm = 4;
+			break;
+		default:
+			goto error;
+	}
+
+	if (modrm) {
+		hs->modrm = *p++;
+		hs->modrm_mod = hs->modrm >> 6;
+		hs->modrm_reg = (hs->modrm >> 3) & 7;
+		hs->modrm_rm = hs->modrm & 7;
+		bool disp32 = hs->modrm_mod == 2 || (hs->modrm_mod == 0 && hs->modrm_rm == 5);
+		if (hs->modrm_mod != 3 && hs->modrm_rm == 4) {
+			hs->sib = *p++;
+			if (hs->modrm_mod == 0 && (hs->sib & 7) == 5)
+				disp32 = true;
+		}
+		if (hs->modrm_mod == 1) {
+			hs->disp.disp8 = *p++;
+		} else if (disp32) {
+			memcpy(&hs->disp.disp32, p, sizeof(uint32_t));
+			p += sizeof(uint32_t);
+		}
+	}
+
+	if (imm == 1) {
+		hs->imm.imm8 = *p++;
+	} else if (imm == 4) {
+		memcpy(&hs->imm.imm32, p, sizeof(uint32_t));
+		p += sizeof(uint32_t);
+	}
+
+	hs->len = static_cast<uint8_t>(p - s);
+	return hs->len;
+
+error:
+	hs->flags = F_ERROR;
+	hs->len = 1;
+	return 1;
+}
+
+// Code buffer padded with int3, which the decoder rejects
+struct Code {
+	std::vector<uint8_t> bytes;
+
+	Code(std::initializer_list<std::initializer_list<uint8_t>> instructions) {
+		for (auto &insn : instructions)
+			bytes.insert(bytes.end(), insn.begin(), insn.end());
+		bytes.insert(bytes.end(), 16, 0xCC);
+	}
+
+	uint64_t address(size_t offset = 0) const {
+		return reinterpret_cast<uint64_t>(bytes.data()) + offset;
+	}
+};
+
+static void checkFields() {
+	static constexpr InstructionPattern movb = InstructionPattern().opcode(0xC6).reg(0).mod(2).disp(0x37C).imm(0);
+	Code code {
+		{0xC6, 0x83, 0x7C, 0x03, 0x00, 0x00, 0x00},       // movb $0, 0x37c(%rbx)
+		{0x41, 0xC6, 0x85, 0x7C, 0x03, 0x00, 0x00, 0x00}, // movb $0, 0x37c(%r13)
+		{0x41, 0xC6, 0x84, 0x24, 0x7C, 0x03, 0x00, 0x00, 0x00}, // movb $0, 0x37c(%r12)
+		{0xC6, 0x83, 0x7C, 0x03, 0x00, 0x00, 0x01},       // movb $1, 0x37c(%rbx)
+		{0x41, 0x80, 0x3F, 0x00},                         // cmpb $0, (%r15)
+	};
+
+	DecodedFunction function {decode, code.address(), 16};
+	CHECK(function.at(0) && movb.matches(*function.at(0)) && function.at(0)->rm() == 3);
+	CHECK(function.at(1) && movb.matches(*function.at(1)) && function.at(1)->rm() == 13);
+	CHECK(function.at(2) && movb.matches(*function.at(2)) && function.at(2)->rm() == 12);
+	CHECK(function.at(3) && !movb.matches(*function.at(3)));
+	CHECK(function.at(4) && InstructionPattern().opcode(0x80).reg(7).rm(15).matches(*function.at(4)));
+	CHECK(function.at(4) && !InstructionPattern().opcode(0x80).reg(7).rm(7).matches(*function.at(4)));
+	CHECK(function.at(4) && InstructionPattern().opcode(0x80).rexW(0).matches(*function.at(4)));
+	CHECK(function.at(4) && !InstructionPattern().opcode(0x80).rexW(1).matches(*function.at(4)));
+	// Captured comparisons need captures
+	CHECK(function.at(4) && !InstructionPattern().opcode(0x80).rmCaptured(0).matches(*function.at(4)));
+}
+
+static void checkFind() {
+	// The RCS check in submitExecList
+	static constexpr InstructionPattern rcs[] {
+		InstructionPattern().opcode(0x80).reg(7).rm(1),
+		InstructionPattern().opcode(0x0F).opcode2(0x85),
+	};
+	Code code {
+		{0x0F, 0x85, 0x10, 0x00, 0x00, 0x00}, // jnz
+		{0x90},
+		{0x80, 0x39, 0x00},                   // cmpb $0, (%rcx)
+		{0x89, 0xC8},                         // movl %ecx, %eax
+		{0x0F, 0x85, 0x20, 0x00, 0x00, 0x00}, // jnz
+		{0xC3},
+	};
+
+	DecodedFunction function {decode, code.address(), 64};
+	const DecodedInstruction *matches[2];
+	InstructionCaptures captures;
+	CHECK(function.find(rcs, 2, matches, captures, 64));
+	CHECK(matches[0] && matches[0]->address == code.address(7));
+	CHECK(matches[1] && matches[1]->address == code.address(12));
+
+	// In any order the search ends as soon as every pattern matched
+	CHECK(function.find(rcs, 2, matches, captures, 64, false));
+	CHECK(matches[0] && matches[0]->address == code.address(7));
+	CHECK(matches[1] && matches[1]->address == code.address(0));
+
+	// The limit is in instructions
+	CHECK(!function.find(rcs, 2, matches, captures, 4));
+	CHECK(matches[0] && !matches[1]);
+
+	// Decoding stops at int3, which the decoder rejects
+	CHECK(function.at(5) != nullptr && function.at(6) == nullptr);
+	CHECK(function.hasError());
+	CHECK(function.getEnd() == code.address(19));
+}
+
+static void checkCaptures() {
+	// The DVMT shll and andl instructions on the same register, in any order
+	static constexpr InstructionPattern dvmt[] {
+		InstructionPattern().opcode(0x25, 0x81).imm(0xFE000000).capture(InstructionPattern::Field::Rm, 0),
+		InstructionPattern().opcode(0xC1).imm(0x11).rmCaptured(0),
+	};
+	Code code {
+		{0x41, 0x81, 0xE0, 0x00, 0x00, 0x00, 0xFE}, // andl $0xfe000000, %r8d
+		{0xC1, 0xE0, 0x11},                         // shll $0x11, %eax
+		{0x41, 0xC1, 0xE0, 0x11},                   // shll $0x11, %r8d
+		{0xC3},
+	};
+
+	DecodedFunction function {decode, code.address(), 64};
+	const DecodedInstruction *matches[2];
+	InstructionCaptures captures;
+	CHECK(function.find(dvmt, 2, matches, captures, 64));
+	CHECK(captures.value[0] == 8);
+	CHECK(matches[1] && matches[1]->address == code.address(10));
+}
+
+static void checkStorage() {
+	Code code {{0xC3}};
+	code.bytes.insert(code.bytes.begin(), 300, 0x90);
+
+	DecodedFunction function {decode, code.address(), 301};
+	auto first = function.at(0);
+	auto match = function.at(5);
+	CHECK(first && match);
+	// Instructions stay in place while more are decoded
+	CHECK(function.at(300) && function.at(300)->handle.opcode == 0xC3);
+	CHECK(function.at(0) == first && function.at(5) == match && first->address == code.address());
+	// The capacity is not an error
+	CHECK(function.at(301) == nullptr && !function.hasError());
+
+	// Reinitialising with the same or a smaller capacity reuses the storage
+	Code other {{0xC3}};
+	function.init(decode, other.address(), 64);
+	CHECK(function.at(0) == first && first->address == other.address() && first->handle.opcode == 0xC3);
+	CHECK(function.at(64) == nullptr);
+	function.init(decode, code.address(), 1024);
+	CHECK(function.at(300) && function.at(300)->handle.opcode == 0xC3);
+}
+
+// Same as the PreSubmit site search in NGFX::processKext, returns the patch offset or -1
+static long findPreSubmit(uint64_t addr, size_t maxLookup, bool &decoded) {
+	static const uint8_t seqRbx[] {0xC6, 0x83, 0x7C, 0x03, 0x00, 0x00, 0x00};
+	static const uint8_t seqR13[] {0x41, 0xC6, 0x85, 0x7C, 0x03, 0x00, 0x00, 0x00};
+	static const uint8_t seqR12[] {0x41, 0xC6, 0x84, 0x24, 0x7C, 0x03, 0x00, 0x00, 0x00};
+	struct {
+		const uint8_t *patch;
+		size_t sz;
+	} patches[] {
+		{seqRbx, sizeof(seqRbx)},
+		{seqR13, sizeof(seqR13)},
+		{seqR12, sizeof(seqR12)}
+	};
+	static constexpr InstructionPattern movb = InstructionPattern().opcode(0xC6).reg(0).mod(2).disp(0x37C).imm(0);
+
+	DecodedFunction function {decode, addr, maxLookup / 4};
+	const DecodedInstruction *insn = nullptr;
+	bool found = false;
+	size_t off = 0;
+	for (size_t i = 0; !found && (insn = function.at(i)) != nullptr && insn->address - addr < maxLookup; i++) {
+		if (!movb.matches(*insn))
+			continue;
+		for (auto &patch : patches) {
+			if (insn->handle.len == patch.sz && !memcmp(reinterpret_cast<uint8_t *>(insn->address), patch.patch, patch.sz)) {
+				found = true;
+				off = static_cast<size_t>(insn->address - addr);
+				break;
+			}
+		}
+	}
+
+	decoded = found;
+	auto decodedSize = static_cast<size_t>(function.getEnd() - addr);
+	if (!found && decodedSize < maxLookup) {
+		for (size_t i = function.hasError() ? 0 : decodedSize; !found && i < maxLookup; i++) {
+			for (auto &patch : patches) {
+				if (!memcmp(reinterpret_cast<uint8_t *>(addr+i), patch.patch, patch.sz)) {
+					found = true;
+					off = i;
+					break;
+				}
+			}
+		}
+	}
+
+	return found ? static_cast<long>(off) : -1;
+}
+
+static void checkPreSubmit() {
+	bool decoded = false;
+
+	Code plain {
+		{0x48, 0x89, 0xFB},                                     // movq %rdi, %rbx
+		{0x41, 0xC6, 0x84, 0x24, 0x7C, 0x03, 0x00, 0x00, 0x00}, // movb $0, 0x37c(%r12)
+		{0xC3},
+	};
+	CHECK(findPreSubmit(plain.address(), 64, decoded) == 3 && decoded);
+
+	// The sequence inside an immediate and the following instructions is not an instruction, the four instructions
+	// reach the instruction cap and their bytes are not searched again
+	Code immediate {
+		{0xC7, 0x80, 0x00, 0x00, 0x00, 0x00, 0xC6, 0x83, 0x7C, 0x03}, // movl $0x37c83c6, 0(%rax)
+		{0x00, 0x00},                                                 // addb %al, (%rax)
+		{0x00, 0x00},                                                 // addb %al, (%rax)
+		{0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90, 0x90},
+	};
+	CHECK(findPreSubmit(immediate.address(), 16, decoded) == -1 && !decoded);
+
+	// Instructions the decoder rejects fall back to the byte search
+	Code unsupported {
+		{0xE8, 0x00, 0x00, 0x00, 0x00},                   // call, not in the subset
+		{0x41, 0xC6, 0x85, 0x7C, 0x03, 0x00, 0x00, 0x00}, // movb $0, 0x37c(%r13)
+		{0xC3},
+	};
+	CHECK(findPreSubmit(unsupported.address(), 32, decoded) == 5 && !decoded);
+
+	// The byte search starts within the lookup size like the decoded one
+	CHECK(findPreSubmit(unsupported.address(), 6, decoded) == 5);
+	CHECK(findPreSubmit(unsupported.address(), 5, decoded) == -1);
+
+	// Short instructions exhaust the instruction cap before the lookup size, the rest is searched by bytes
+	Code nops {{0x41, 0xC6, 0x85, 0x7C, 0x03, 0x00, 0x00, 0x00}};
+	nops.bytes.insert(nops.bytes.begin(), 20, 0x90);
+	CHECK(findPreSubmit(nops.address(), 32, decoded) == 20 && !decoded);
+	CHECK(findPreSubmit(nops.address(), 128, decoded) == 20 && decoded);
+}
+
+int main() {
+	checkFields();
+	checkFind();
+	checkCaptures();
+	checkStorage();
+	checkPreSubmit();
+
+	printf("%lu checks, %lu failures\n", checks, failures);
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+//
+// Insn Probe
+// Matches instruction patterns from kern_insn.hpp against extracted function bytes.
+//
+// Usage:
+//   InsnProbe [-b base] [-n limit] [-u] function.bin pattern...
+//
+//   -b base      address of the first byte, only used for printing (default 0)
+//   -n limit     the number of instructions to look through (default 256)
+//   -u           match the patterns in any order, otherwise in the given order
+//
+// A pattern is a comma separated list of fields, every field not listed is a wildcard:
+//   op=80 or op=05/81, op2=85, mod=2, reg=7, rm=1, w=0, imm=fe000000, disp=37c (hexadecimal)
+//   reg=$0 or rm=$0 to compare against capture slot 0
+//   cap=rm:0 to capture reg, rm, imm or disp into slot 0
+//
+// e.g. the RCS check in submitExecList:
+//   InsnProbe submitExecList.bin op=80,reg=7,rm=1 op=0f,op2=85
+//
+// Function bytes can be extracted from a kext with e.g.
+//   dd if=AppleIntelKBLGraphics bs=1 skip=$((offset)) count=4096 of=function.bin
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+extern "C" {
+#include <Headers/hde64.h>
+}
+
+#include "../../WhateverGreen/kern_insn.hpp"
+
+static uint8_t *image;
+static size_t imageSize;
+static uint64_t imageBase;
+
+static size_t decode(uint64_t address, hde64s *handle) {
+	// The image is padded, so that an instruction starting within it can always be decoded
+	auto offset = address - imageBase;
+	if (offset >= imageSize) {
+		memset(handle, 0, sizeof(*handle));
+		handle->flags = F_ERROR;
+		return 0;
+	}
+	return hde64_disasm(image + offset, handle);
+}
+
+static bool parseField(InstructionPattern &pattern, const char *key, const char *value) {
+	char *end = nullptr;
+	if (value[0] == '$') {
+		auto slot = static_cast<uint8_t>(strtoul(value + 1, &end, 10));
+		if (*end != '\0' || slot >= InstructionCaptures::MaxCaptures)
+			return false;
+		if (strcmp(key, "reg") == 0)
+			pattern = pattern.regCaptured(slot);
+		else if (strcmp(key, "rm") == 0)
+			pattern = pattern.rmCaptured(slot);
+		else
+			return false;
+		return true;
+	}
+
+	if (strcmp(key, "cap") == 0) {
+		auto colon = strchr(value, ':');
+		if (!colon)
+			return false;
+		auto slot = static_cast<uint8_t>(strtoul(colon + 1, &end, 10));
+		if (*end != '\0' || slot >= InstructionCaptures::MaxCaptures)
+			return false;
+		auto len = static_cast<size_t>(colon - value);
+		InstructionPattern::Field field;
+		if (len == 3 && strncmp(value, "reg", 3) == 0)
+			field = InstructionPattern::Field::Reg;
+		else if (len == 2 && strncmp(value, "rm", 2) == 0)
+			field = InstructionPattern::Field::Rm;
+		else if (len == 3 && strncmp(value, "imm", 3) == 0)
+			field = InstructionPattern::Field::Imm;
+		else if (len == 4 && strncmp(value, "disp", 4) == 0)
+			field = InstructionPattern::Field::Disp;
+		else
+			return false;
+		pattern = pattern.capture(field, slot);
+		return true;
+	}
+
+	auto number = strtoull(value, &end, 16);
+	if (strcmp(key, "op") == 0 && *end == '/') {
+		auto alternative = strtoull(end + 1, &end, 16);
+		if (*end != '\0')
+			return false;
+		pattern = pattern.opcode(static_cast<uint8_t>(number), static_cast<uint8_t>(alternative));
+		return true;
+	}
+
+	if (*end != '\0' || end == value)
+		return false;
+
+	if (strcmp(key, "op") == 0)
+		pattern = pattern.opcode(static_cast<uint8_t>(number));
+	else if (strcmp(key, "op2") == 0)
+		pattern = pattern.opcode2(static_cast<uint8_t>(number));
+	else if (strcmp(key, "mod") == 0)
+		pattern = pattern.mod(static_cast<uint8_t>(number));
+	else if (strcmp(key, "reg") == 0)
+		pattern = pattern.reg(static_cast<uint8_t>(number));
+	else if (strcmp(key, "rm") == 0)
+		pattern = pattern.rm(static_cast<uint8_t>(number));
+	else if (strcmp(key, "w") == 0)
+		pattern = pattern.rexW(static_cast<uint8_t>(number));
+	else if (strcmp(key, "imm") == 0)
+		pattern = pattern.imm(number);
+	else if (strcmp(key, "disp") == 0)
+		pattern = pattern.disp(static_cast<uint32_t>(number));
+	else
+		return false;
+	return true;
+}
+
+static bool parsePattern(const char *text, InstructionPattern &pattern) {
+	char buffer[256];
+	if (strlen(text) >= sizeof(buffer))
+		return false;
+	strcpy(buffer, text);
+	pattern = InstructionPattern();
+	for (char *save = nullptr, *token = strtok_r(buffer, ",", &save); token; token = strtok_r(nullptr, ",", &save)) {
+		auto equals = strchr(token, '=');
+		if (!equals)
+			return false;
+		*equals = '\0';
+		if (!parseField(pattern, token, equals + 1))
+			return false;
+	}
+	return true;
+}
+
+static bool loadImage(const char *path) {
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	if (size <= 0) {
+		fclose(file);
+		return false;
+	}
+	// Pad with the maximum instruction length
+	image = static_cast<uint8_t *>(calloc(static_cast<size_t>(size) + 15, 1));
+	imageSize = static_cast<size_t>(size);
+	bool ok = image && fread(image, 1, imageSize, file) == imageSize;
+	fclose(file);
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	size_t limit = 256;
+	bool ordered = true;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "b:n:u")) != -1) {
+		if (opt == 'b') {
+			imageBase = strtoull(optarg, nullptr, 0);
+		} else if (opt == 'n') {
+			limit = strtoul(optarg, nullptr, 0);
+		} else if (opt == 'u') {
+			ordered = false;
+		} else {
+			fprintf(stderr, "Usage: %s [-b base] [-n limit] [-u] function.bin pattern...\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (argc - optind < 2) {
+		fprintf(stderr, "Usage: %s [-b base] [-n limit] [-u] function.bin pattern...\n", argv[0]);
+		return 1;
+	}
+
+	if (!loadImage(argv[optind])) {
+		fprintf(stderr, "Failed to load %s\n", argv[optind]);
+		return 1;
+	}
+
+	std::vector<InstructionPattern> patterns;
+	for (int i = optind + 1; i < argc; i++) {
+		InstructionPattern pattern;
+		if (!parsePattern(argv[i], pattern)) {
+			fprintf(stderr, "Invalid pattern %s\n", argv[i]);
+			return 1;
+		}
+		patterns.push_back(pattern);
+	}
+
+	DecodedFunction function;
+	function.init(decode, imageBase, limit);
+	std::vector<const DecodedInstruction *> matches(patterns.size());
+	InstructionCaptures captures;
+	bool found = function.find(patterns.data(), patterns.size(), matches.data(), captures, limit, ordered);
+
+	for (size_t i = 0; i < patterns.size(); i++) {
+		if (matches[i])
+			printf("pattern %zu: 0x%llx (+0x%llx) length %u\n", i, static_cast<unsigned long long>(matches[i]->address),
+				   static_cast<unsigned long long>(matches[i]->address - imageBase), matches[i]->handle.len);
+		else
+			printf("pattern %zu: not found\n", i);
+	}
+
+	for (size_t i = 0; i < InstructionCaptures::MaxCaptures; i++)
+		printf("capture %zu: 0x%llx\n", i, static_cast<unsigned long long>(captures.value[i]));
+
+	if (function.hasError())
+		printf("decoding stopped at 0x%llx\n", static_cast<unsigned long long>(function.getEnd()));
+
+	function.deinit();
+	free(image);
+	return found ? 0 : 2;
+}
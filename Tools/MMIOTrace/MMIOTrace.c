@@ -0,0 +1,147 @@
+//
+// MMIO Trace
+// Decodes the MMIO register access trace recorded by WhateverGreen with -igfxvamregs.
+//
+// Usage:
+//   MMIOTrace               read igfx-mmio-trace from IOService:/IOResources/WhateverGreen
+//   MMIOTrace <file>        read a raw dump of igfx-mmio-trace
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <IOKit/IOKitLib.h>
+#include <CoreFoundation/CoreFoundation.h>
+
+// Keep in sync with IGFX::MMIOTraceRecord in kern_igfx.hpp.
+typedef struct __attribute__((packed)) {
+	uint64_t sequence;
+	uint64_t timestamp;
+	uint64_t controller;
+	uint32_t address;
+	uint32_t value;
+	uint32_t direction;
+	uint32_t reserved;
+} MMIOTraceRecord;
+
+// Keep in sync with the register definitions in kern_igfx*.cpp and kern_igfx*.hpp.
+static const struct {
+	uint32_t address;
+	const char *name;
+} registerNames[] = {
+	{0x0D84,   "FORCEWAKE_ACK_RENDER_GEN9"},
+	{0x0D88,   "FORCEWAKE_ACK_MEDIA_GEN9"},
+	{0xA188,   "FORCEWAKE_BLITTER_GEN9"},
+	{0xA270,   "FORCEWAKE_MEDIA_GEN9"},
+	{0xA278,   "FORCEWAKE_RENDER_GEN9"},
+	{0x46000,  "ICL_REG_CDCLK_CTL"},
+	{0x48254,  "BLC_PWM_CPU_CTL"},
+	{0x51004,  "ICL_REG_DSSM"},
+	{0x60100,  "WESTMERE_TXA_CTL"},
+	{0xC2014,  "SFUSE_STRAP"},
+	{0xC8250,  "BXT_BLC_PWM_CTL1"},
+	{0xC8254,  "BXT_BLC_PWM_FREQ1"},
+	{0xC8258,  "BXT_BLC_PWM_DUTY1"},
+	{0xF000C,  "WESTMERE_RXA_CTL"},
+	{0x130044, "FORCEWAKE_ACK_BLITTER_GEN9"},
+	{0x145998, "GEN6_RP_STATE_CAP"},
+};
+
+static const char *registerName(uint32_t address) {
+	for (size_t i = 0; i < sizeof(registerNames) / sizeof(registerNames[0]); i++)
+		if (registerNames[i].address == address)
+			return registerNames[i].name;
+	return "";
+}
+
+static uint8_t *readRegistry(size_t *size) {
+	io_registry_entry_t entry = IORegistryEntryFromPath(kIOMasterPortDefault, "IOService:/IOResources/WhateverGreen");
+	if (entry == MACH_PORT_NULL) {
+		fprintf(stderr, "WhateverGreen is not loaded\n");
+		return NULL;
+	}
+
+	uint8_t *buffer = NULL;
+	CFTypeRef data = IORegistryEntryCreateCFProperty(entry, CFSTR("igfx-mmio-trace"), kCFAllocatorDefault, 0);
+	if (data != NULL && CFGetTypeID(data) == CFDataGetTypeID()) {
+		*size = (size_t)CFDataGetLength(data);
+		buffer = malloc(*size);
+		if (buffer != NULL)
+			memcpy(buffer, CFDataGetBytePtr(data), *size);
+	} else {
+		fprintf(stderr, "No trace found, boot with -igfxvamregs\n");
+	}
+
+	if (data != NULL)
+		CFRelease(data);
+	IOObjectRelease(entry);
+	return buffer;
+}
+
+static uint8_t *readFile(const char *path, size_t *size) {
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		return NULL;
+	}
+
+	uint8_t *buffer = NULL;
+	if (fseek(file, 0, SEEK_END) == 0) {
+		long length = ftell(file);
+		if (length > 0 && fseek(file, 0, SEEK_SET) == 0) {
+			buffer = malloc((size_t)length);
+			if (buffer != NULL && fread(buffer, 1, (size_t)length, file) == (size_t)length) {
+				*size = (size_t)length;
+			} else {
+				free(buffer);
+				buffer = NULL;
+				fprintf(stderr, "Failed to read %s\n", path);
+			}
+		}
+	}
+
+	fclose(file);
+	return buffer;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc > 2) {
+		fprintf(stderr, "Usage: %s [trace dump]\n", argv[0]);
+		return 1;
+	}
+
+	size_t size = 0;
+	uint8_t *buffer = argc == 2 ? readFile(argv[1], &size) : readRegistry(&size);
+	if (buffer == NULL)
+		return 1;
+
+	if (size % sizeof(MMIOTraceRecord) != 0)
+		fprintf(stderr, "Trace size %zu is not a multiple of the record size, ignoring the tail\n", size);
+
+	size_t count = size / sizeof(MMIOTraceRecord);
+	uint64_t start = 0;
+	uint64_t lastSequence = 0;
+	for (size_t i = 0; i < count; i++) {
+		MMIOTraceRecord record;
+		memcpy(&record, buffer + i * sizeof(MMIOTraceRecord), sizeof(record));
+		if (i == 0)
+			start = record.timestamp;
+		else if (record.sequence != lastSequence + 1)
+			printf("... %llu records lost\n", (unsigned long long)(record.sequence - lastSequence - 1));
+		lastSequence = record.sequence;
+
+		printf("%8llu +%12.3f us 0x%016llx %s 0x%06x = 0x%08x %s\n",
+			   (unsigned long long)record.sequence,
+			   (record.timestamp - start) / 1000.0,
+			   (unsigned long long)record.controller,
+			   record.direction == 0 ? "R" : "W",
+			   record.address,
+			   record.value,
+			   registerName(record.address));
+	}
+
+	free(buffer);
+	return 0;
+}
@@ -0,0 +1,322 @@
+//
+// Pattern Check
+// Tests MultiPatternPatcher from kern_pattern.hpp against consecutive KernelPatcher::findAndReplace calls
+// and measures the scan throughput of both.
+//
+// Usage:
+//   PatternCheck [-r rounds] [-s seed] [-b megabytes]
+//
+//   -r rounds     amount of random pattern sets to compare (default 100000)
+//   -s seed       random seed (default 1)
+//   -b megabytes  amount of page data to scan in the benchmark (default 256)
+//
+// The benchmark scans 4 KiB pages for the unfair dyld shared cache patterns, 29 and 18 bytes long,
+// like csValidatePage does with both UnfairRelaxHdcpRequirements and UnfairCustomAppleGvaBoardId set.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+
+#include "../../WhateverGreen/kern_pattern.hpp"
+#include "../Include/tool_check.hpp"
+
+static const size_t kPageSize = 4096;
+static const size_t kRuns = 5;
+
+// Same as kern_unfair.cpp
+static const uint8_t relaxedDrmModelFind[29] = {
+	0x4D, 0x61, 0x63, 0x50, 0x72, 0x6F, 0x35, 0x2C, 0x31, 0x00, 0x4D, 0x61, 0x63, 0x50, 0x72, 0x6F,
+	0x36, 0x2C, 0x31, 0x00, 0x49, 0x4F, 0x53, 0x65, 0x72, 0x76, 0x69, 0x63, 0x65
+};
+
+static const uint8_t hwgvaIdFind[18] = {
+	0x62, 0x6F, 0x61, 0x72, 0x64, 0x2D, 0x69, 0x64, 0x00, 0x68, 0x77, 0x2E, 0x6D, 0x6F, 0x64, 0x65,
+	0x6C
+};
+
+static const uint8_t hwgvaIdReplace[5] = {
+	0x68, 0x77, 0x67, 0x76, 0x61
+};
+
+static const char modelIdentifier[20] = "iMacPro1,1";
+
+// KernelPatcher::findAndReplace with a count, replacing non-overlapping occurrences in order
+static bool findAndReplace(void *data, size_t dataSize, const void *find, size_t findSize, const void *replace, size_t replaceSize,
+						   size_t count = 1, size_t from = 0, size_t to = SIZE_MAX) {
+	auto d = static_cast<uint8_t *>(data);
+	bool found = false;
+	for (size_t i = from; i + findSize <= dataSize && i < to && count > 0; i++) {
+		if (memcmp(d + i, find, findSize) == 0) {
+			memcpy(d + i, replace, replaceSize);
+			found = true;
+			count--;
+			i += findSize - 1;
+		}
+	}
+	return found;
+}
+
+static void checkFirstOccurrence() {
+	uint8_t data[] = {1, 2, 3, 9, 1, 2, 3, 9, 4, 5};
+	static const uint8_t find[] = {1, 2, 3};
+	static const uint8_t replace[] = {7, 7};
+	MultiPatternPatcher<2> patcher;
+	CHECK(patcher.empty());
+	CHECK(patcher.add(find, sizeof(find), replace, sizeof(replace)) == 0);
+	CHECK(!patcher.empty());
+	CHECK(patcher.apply(data, sizeof(data)) == 1);
+	static const uint8_t expected[] = {7, 7, 3, 9, 1, 2, 3, 9, 4, 5};
+	CHECK(memcmp(data, expected, sizeof(data)) == 0);
+	// The replaced occurrence no longer matches, the next one does
+	CHECK(patcher.apply(data, sizeof(data)) == 1);
+	CHECK(data[4] == 7 && data[5] == 7);
+	CHECK(patcher.apply(data, sizeof(data)) == 0);
+}
+
+static void checkMatch() {
+	uint8_t data[] = {9, 1, 2, 3, 1, 2, 3, 4, 5};
+	uint8_t copy[sizeof(data)];
+	memcpy(copy, data, sizeof(data));
+	static const uint8_t findA[] = {1, 2, 3};
+	static const uint8_t findB[] = {4, 5};
+	static const uint8_t findC[] = {6, 6};
+	static const uint8_t replace[] = {7, 7};
+	MultiPatternPatcher<3> patcher;
+	CHECK(patcher.add(findA, sizeof(findA), replace, sizeof(replace), 2) == 0);
+	CHECK(patcher.add(findB, sizeof(findB), replace, 0) == 1);
+	CHECK(patcher.add(findC, sizeof(findC), replace, sizeof(replace)) == 2);
+	// Matching reports the patterns apply would replace without writing
+	CHECK(patcher.match(data, sizeof(data)) == 3);
+	CHECK(memcmp(data, copy, sizeof(data)) == 0);
+	CHECK(patcher.apply(data, sizeof(data)) == 3);
+	// An empty replacement keeps matching, like the patched unfair patterns do
+	CHECK(patcher.match(data, sizeof(data)) == 2);
+}
+
+static void checkInvalid() {
+	static const uint8_t find[] = {1, 2};
+	static const uint8_t replace[] = {3, 4, 5};
+	MultiPatternPatcher<1> patcher;
+	CHECK(patcher.add(find, 0, replace, 0) == -1);
+	CHECK(patcher.add(find, sizeof(find), replace, sizeof(replace)) == -1);
+	CHECK(patcher.add(find, sizeof(find), replace, 2, 0) == -1);
+	CHECK(patcher.add(find, sizeof(find), replace, 2, 1, 4, 4) == -1);
+	CHECK(patcher.add(find, sizeof(find), replace, 2) == 0);
+	// Capacity exhausted
+	CHECK(patcher.add(find, sizeof(find), replace, 2) == -1);
+	uint8_t small[] = {1};
+	CHECK(patcher.apply(small, sizeof(small)) == 0);
+}
+
+static void checkCountAndWindow() {
+	uint8_t data[16] {};
+	for (size_t i = 0; i < sizeof(data); i += 2) {
+		data[i] = 0xAA;
+		data[i + 1] = 0xBB;
+	}
+	static const uint8_t find[] = {0xAA, 0xBB};
+	static const uint8_t replace[] = {0x11, 0x22};
+	MultiPatternPatcher<1> patcher;
+	// Occurrences at 2, 4 and 6, the one at 8 is past the window
+	CHECK(patcher.add(find, sizeof(find), replace, sizeof(replace), 5, 1, 8) == 0);
+	CHECK(patcher.apply(data, sizeof(data)) == 1);
+	CHECK(data[0] == 0xAA && data[2] == 0x11 && data[4] == 0x11 && data[6] == 0x11 && data[8] == 0xAA);
+}
+
+static void checkUnfairPatterns() {
+	uint8_t page[kPageSize];
+	memset(page, 'x', sizeof(page));
+	memcpy(page + 100, hwgvaIdFind, sizeof(hwgvaIdFind));
+	memcpy(page + 3000, relaxedDrmModelFind, sizeof(relaxedDrmModelFind));
+	uint8_t expected[kPageSize];
+	memcpy(expected, page, sizeof(page));
+	findAndReplace(expected, sizeof(expected), relaxedDrmModelFind, sizeof(relaxedDrmModelFind), modelIdentifier, sizeof(modelIdentifier));
+	findAndReplace(expected, sizeof(expected), hwgvaIdFind, sizeof(hwgvaIdFind), hwgvaIdReplace, sizeof(hwgvaIdReplace));
+
+	MultiPatternPatcher<2> patcher;
+	auto drm = patcher.add(relaxedDrmModelFind, sizeof(relaxedDrmModelFind), modelIdentifier, sizeof(modelIdentifier));
+	auto hwgva = patcher.add(hwgvaIdFind, sizeof(hwgvaIdFind), hwgvaIdReplace, sizeof(hwgvaIdReplace));
+	CHECK(drm == 0 && hwgva == 1);
+	CHECK(patcher.independent());
+	CHECK(patcher.apply(page, sizeof(page)) == 3);
+	CHECK(memcmp(page, expected, sizeof(page)) == 0);
+	// Patterns at the very end of the buffer
+	memset(page, 'x', sizeof(page));
+	memcpy(page + sizeof(page) - sizeof(hwgvaIdFind), hwgvaIdFind, sizeof(hwgvaIdFind));
+	CHECK(patcher.apply(page, sizeof(page)) == 2);
+	CHECK(memcmp(page + sizeof(page) - sizeof(hwgvaIdFind), hwgvaIdReplace, sizeof(hwgvaIdReplace)) == 0);
+}
+
+static void checkDependent() {
+	static const uint8_t findA[] = {1, 2, 3};
+	static const uint8_t replaceA[] = {4, 5, 6};
+	static const uint8_t findB[] = {5, 6};
+	static const uint8_t replaceB[] = {7, 7};
+	static const uint8_t findC[] = {9, 9};
+
+	// B matches bytes produced by A
+	MultiPatternPatcher<2> chained;
+	chained.add(findA, sizeof(findA), replaceA, sizeof(replaceA));
+	chained.add(findB, sizeof(findB), replaceB, sizeof(replaceB));
+	CHECK(!chained.independent());
+
+	// C cannot meet A or its replacement
+	MultiPatternPatcher<2> separate;
+	separate.add(findA, sizeof(findA), replaceA, sizeof(replaceA));
+	separate.add(findC, sizeof(findC), replaceB, sizeof(replaceB));
+	CHECK(separate.independent());
+	static const uint8_t other[] = {8};
+	CHECK(separate.touches(findA + 1, 2));
+	CHECK(separate.touches(replaceA + 2, 1));
+	CHECK(!separate.touches(other, sizeof(other)));
+}
+
+static void checkAllPatterns() {
+	static uint8_t finds[32][4];
+	static const uint8_t replace[4] {0, 0, 0, 0};
+	MultiPatternPatcher<32> patcher;
+	std::vector<uint8_t> data(32 * 8, 0xEE);
+	for (size_t i = 0; i < 32; i++) {
+		for (size_t j = 0; j < 4; j++)
+			finds[i][j] = static_cast<uint8_t>(0x80 + i);
+		CHECK(patcher.add(finds[i], sizeof(finds[i]), replace, sizeof(replace)) == static_cast<int>(i));
+		memcpy(&data[(31 - i) * 8], finds[i], sizeof(finds[i]));
+	}
+	CHECK(patcher.add(finds[0], sizeof(finds[0]), replace, sizeof(replace)) == -1);
+	CHECK(patcher.apply(data.data(), data.size()) == 0xFFFFFFFFU);
+	for (size_t i = 0; i < data.size(); i++)
+		CHECK(data[i] == ((i % 8) < 4 ? 0 : 0xEE));
+}
+
+// Independent random pattern sets must give the same result as consecutive findAndReplace calls
+static void checkRandom(unsigned long rounds) {
+	unsigned long compared = 0, mismatches = 0;
+	for (unsigned long round = 0; round < rounds; round++) {
+		// A small alphabet produces plenty of matches and overlaps
+		std::vector<uint8_t> data(64 + next() % 512);
+		for (auto &byte : data)
+			byte = static_cast<uint8_t>(next() % 4);
+
+		size_t num = 1 + next() % 4;
+		std::vector<std::vector<uint8_t>> finds(num), replaces(num);
+		std::vector<size_t> counts(num), froms(num), tos(num);
+		MultiPatternPatcher<4> patcher;
+		for (size_t i = 0; i < num; i++) {
+			finds[i].resize(2 + next() % 6);
+			for (auto &byte : finds[i])
+				byte = static_cast<uint8_t>(next() % 4);
+			replaces[i].resize(1 + next() % finds[i].size());
+			for (auto &byte : replaces[i])
+				byte = static_cast<uint8_t>(4 + next() % 4);
+			counts[i] = 1 + next() % 3;
+			froms[i] = next() % 2 ? 0 : next() % data.size();
+			tos[i] = next() % 2 ? SIZE_MAX : froms[i] + 1 + next() % data.size();
+			patcher.add(finds[i].data(), finds[i].size(), replaces[i].data(), replaces[i].size(), counts[i], froms[i], tos[i]);
+		}
+
+		if (!patcher.independent())
+			continue;
+
+		auto expected = data;
+		uint32_t expectedApplied = 0;
+		for (size_t i = 0; i < num; i++) {
+			if (findAndReplace(expected.data(), expected.size(), finds[i].data(), finds[i].size(),
+							   replaces[i].data(), replaces[i].size(), counts[i], froms[i], tos[i]))
+				expectedApplied |= 1U << i;
+		}
+
+		compared++;
+		auto applied = patcher.apply(data.data(), data.size());
+		if (applied != expectedApplied || data != expected) {
+			if (mismatches++ < 10)
+				printf("round %lu mismatch\n", round);
+		}
+	}
+
+	printf("%lu random pattern sets, %lu independent, %lu mismatches\n", rounds, compared, mismatches);
+	checks++;
+	if (mismatches != 0)
+		failures++;
+}
+
+static void benchmark(size_t megabytes) {
+	size_t pages = megabytes * 1024 * 1024 / kPageSize;
+	if (pages == 0)
+		return;
+
+	// Shared cache pages are mostly text and symbol names
+	std::vector<uint8_t> source(256 * kPageSize);
+	for (auto &byte : source)
+		byte = static_cast<uint8_t>(32 + next() % 96);
+	for (size_t i = 0; i < source.size() / kPageSize; i += 64) {
+		memcpy(&source[i * kPageSize + next() % (kPageSize - sizeof(relaxedDrmModelFind))], relaxedDrmModelFind, sizeof(relaxedDrmModelFind));
+		memcpy(&source[(i + 1) * kPageSize + next() % (kPageSize - sizeof(hwgvaIdFind))], hwgvaIdFind, sizeof(hwgvaIdFind));
+	}
+
+	MultiPatternPatcher<2> patcher;
+	patcher.add(relaxedDrmModelFind, sizeof(relaxedDrmModelFind), modelIdentifier, sizeof(modelIdentifier));
+	patcher.add(hwgvaIdFind, sizeof(hwgvaIdFind), hwgvaIdReplace, sizeof(hwgvaIdReplace));
+
+	auto run = [&](auto scan) {
+		uint8_t page[kPageSize];
+		double best = 0;
+		for (size_t r = 0; r < kRuns; r++) {
+			auto start = std::chrono::steady_clock::now();
+			for (size_t i = 0; i < pages; i++) {
+				memcpy(page, &source[(i % (source.size() / kPageSize)) * kPageSize], kPageSize);
+				scan(page);
+			}
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			if (elapsed.count() > 0 && pages * kPageSize / elapsed.count() > best)
+				best = pages * kPageSize / elapsed.count();
+		}
+		return best;
+	};
+
+	auto sequential = run([](uint8_t *page) {
+		findAndReplace(page, kPageSize, relaxedDrmModelFind, sizeof(relaxedDrmModelFind), modelIdentifier, sizeof(modelIdentifier));
+		findAndReplace(page, kPageSize, hwgvaIdFind, sizeof(hwgvaIdFind), hwgvaIdReplace, sizeof(hwgvaIdReplace));
+	});
+	auto single = run([&](uint8_t *page) {
+		patcher.apply(page, kPageSize);
+	});
+
+	printf("sequential findAndReplace: %8.1f MB/s\n", sequential / (1024 * 1024));
+	printf("MultiPatternPatcher:       %8.1f MB/s (%.2fx)\n", single / (1024 * 1024), sequential > 0 ? single / sequential : 0);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long rounds = 100000;
+	size_t megabytes = 256;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "r:s:b:")) != -1) {
+		if (opt == 'r') {
+			rounds = strtoul(optarg, nullptr, 0);
+		} else if (opt == 's') {
+			seed(strtoull(optarg, nullptr, 0));
+		} else if (opt == 'b') {
+			megabytes = strtoul(optarg, nullptr, 0);
+		} else {
+			fprintf(stderr, "Usage: %s [-r rounds] [-s seed] [-b megabytes]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	checkFirstOccurrence();
+	checkMatch();
+	checkInvalid();
+	checkCountAndWindow();
+	checkUnfairPatterns();
+	checkDependent();
+	checkAllPatterns();
+	checkRandom(rounds);
+	printf("%lu checks, %lu failures\n", checks, failures);
+
+	benchmark(megabytes);
+	return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,368 @@
+//
+// Platform Index
+// Builds the PlatformInformationIndex from kern_fb_index.hpp over platform tables with the stride of the generation
+// structure from kern_fb.hpp, and compares its lookups with the linear framebuffer id search it replaced.
+//
+// Usage:
+//   PlatformIndex [-r rounds] [-s seed] [generation:table.bin...]
+//
+//   -r rounds   amount of random tables to check per generation (default 10000 without explicit tables)
+//   -s seed     random seed (default 1)
+//
+// Generations are ivb, hsw, bdw, skl, cfl, cnl, icllp and iclhp. A platform table can be obtained with
+// dump_platformlist.sh (native.bin) from a DEBUG build. The framebuffer binary is assumed to continue for a page
+// of zeroes past the table. Random tables contain framebuffer ids of other entries in their connector and
+// other fields and occasionally duplicate ids, tables without a terminator and tables with too many entries.
+//
+// The Coffee Lake table from the framebuffer listing in the manual is always checked as a fixture.
+//
+// Every entry must be found by the index at its stride offset, ids that are not in the table must not be found.
+// The previous search is reported for comparison: false matches are ids found inside a field of an earlier entry,
+// misses are entries past the first page, phantoms are absent ids found inside a field.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../../WhateverGreen/kern_fb.hpp"
+#include "../../WhateverGreen/kern_fb_index.hpp"
+#include "../Include/tool_check.hpp"
+
+static const size_t kPageSize = 4096;
+
+struct Comparison {
+	size_t entries {0};
+	size_t falseMatches {0};
+	size_t misses {0};
+	size_t phantoms {0};
+};
+
+// Previous IGFX::findFramebufferId
+static uint8_t *findOld(uint8_t *startingAddress, uint32_t framebufferId) {
+	for (size_t i = 0; i + sizeof(uint32_t) <= kPageSize; i += sizeof(uint32_t)) {
+		uint32_t value;
+		memcpy(&value, startingAddress + i, sizeof(value));
+		if (value == framebufferId)
+			return startingAddress + i;
+	}
+	return nullptr;
+}
+
+template <typename T>
+static uint32_t getId(const uint8_t *entry) {
+	uint32_t value;
+	memcpy(&value, entry + offsetof(T, framebufferId), sizeof(value));
+	return value;
+}
+
+template <typename T>
+static void setId(uint8_t *entry, uint32_t value) {
+	memcpy(entry + offsetof(T, framebufferId), &value, sizeof(value));
+}
+
+// Check a table, which must be followed by a page of memory
+template <typename T>
+static bool checkTable(const char *title, uint8_t *table, size_t size, Comparison &comparison, bool verbose) {
+	PlatformInformationIndex index;
+	auto status = index.build(reinterpret_cast<T *>(table), table + size + kPageSize);
+
+	// Expected results, too many entries are detected before the missing terminator
+	size_t entries = 0;
+	while ((entries + 1) * sizeof(T) <= size + kPageSize && getId<T>(table + entries * sizeof(T)) != 0xFFFFFFFF)
+		entries++;
+	bool terminated = (entries + 1) * sizeof(T) <= size + kPageSize;
+
+	if (entries > PlatformInformationIndex::MaxEntries) {
+		CHECK(status == PlatformInformationIndex::Status::TooManyEntries && index.size() == 0, "%s: %zu entries are not indexed", title, entries);
+		return status == PlatformInformationIndex::Status::TooManyEntries;
+	}
+
+	if (!terminated) {
+		CHECK(status == PlatformInformationIndex::Status::NoTerminator && index.size() == 0, "%s: unterminated table is not indexed", title);
+		return status == PlatformInformationIndex::Status::NoTerminator;
+	}
+
+	bool ok = status == PlatformInformationIndex::Status::Indexed && index.size() == entries;
+	ok = ok && index.last() == (entries > 0 ? table + (entries - 1) * sizeof(T) : nullptr);
+	for (size_t i = 0; i < entries; i++) {
+		auto id = getId<T>(table + i * sizeof(T));
+		// The first entry with the id, like the previous search would find without false matches
+		uint8_t *expected = nullptr;
+		for (size_t j = 0; j <= i && expected == nullptr; j++) {
+			if (getId<T>(table + j * sizeof(T)) == id)
+				expected = table + j * sizeof(T);
+		}
+
+		auto found = index.find(id);
+		if (found != expected) {
+			if (verbose || ok)
+				printf("%s: entry %zu id %08X found at %+ld, expected %+ld\n", title, i, id,
+					   found ? static_cast<long>(found - table) : -1L, static_cast<long>(expected - table));
+			ok = false;
+		}
+
+		if (expected != table + i * sizeof(T))
+			continue;
+		comparison.entries++;
+		auto old = findOld(table, id);
+		if (old == nullptr) {
+			comparison.misses++;
+		} else if (old != expected) {
+			comparison.falseMatches++;
+			if (verbose)
+				printf("%s: id %08X of entry %zu was found at +%ld inside entry %ld\n", title, id, i,
+					   static_cast<long>(old - table), static_cast<long>((old - table) / static_cast<long>(sizeof(T))));
+		}
+	}
+
+	// Absent ids, including ones that appear inside other fields
+	for (size_t i = 0; i < 8; i++) {
+		uint32_t id;
+		if (i % 2 == 0 && size >= sizeof(uint32_t))
+			memcpy(&id, table + (next() % (size / sizeof(uint32_t))) * sizeof(uint32_t), sizeof(id));
+		else
+			id = next();
+		bool present = id == 0xFFFFFFFF;
+		for (size_t j = 0; j < entries && !present; j++)
+			present = getId<T>(table + j * sizeof(T)) == id;
+		if (present)
+			continue;
+		if (index.find(id) != nullptr) {
+			if (verbose || ok)
+				printf("%s: absent id %08X was found\n", title, id);
+			ok = false;
+		}
+		if (findOld(table, id) != nullptr)
+			comparison.phantoms++;
+	}
+
+	CHECK(ok, "%s: %zu entries are indexed", title, entries);
+	return ok;
+}
+
+template <typename T>
+static void randomTables(const char *generation, unsigned long rounds, Comparison &comparison) {
+	for (unsigned long round = 0; round < rounds; round++) {
+		// Mostly tables within the index limit, sometimes past it or without a terminator
+		size_t entries = next() % 16 == 0 ? PlatformInformationIndex::MaxEntries + 1 + next() % 4 : next() % (PlatformInformationIndex::MaxEntries + 1);
+		bool terminated = next() % 16 != 0;
+		size_t size = (entries + (terminated ? 1 : 0)) * sizeof(T);
+		// The page following the table is filled with entries as well without a terminator
+		size_t total = size + kPageSize;
+		std::vector<uint8_t> data(total + sizeof(T));
+		for (auto &byte : data)
+			byte = static_cast<uint8_t>(next() % 4 == 0 ? next() : 0);
+
+		std::vector<uint32_t> ids;
+		for (size_t i = 0; i * sizeof(T) + sizeof(T) <= total; i++) {
+			uint32_t id;
+			if (!ids.empty() && next() % 32 == 0)
+				id = ids[next() % ids.size()];
+			else
+				id = 0x01000000 * (next() % 0x90) + 0x10000 * (next() % 0x40) + 0x100 * (next() % 4) + next() % 8;
+			if (id == 0xFFFFFFFF)
+				id = 0;
+			setId<T>(data.data() + i * sizeof(T), id);
+			if (i < entries)
+				ids.push_back(id);
+		}
+		if (terminated) {
+			memset(data.data() + entries * sizeof(T), 0, sizeof(T));
+			setId<T>(data.data() + entries * sizeof(T), 0xFFFFFFFF);
+		}
+
+		// Plant framebuffer ids of the entries into other fields
+		for (size_t i = 0; i < entries && !ids.empty(); i++) {
+			if (next() % 2 != 0)
+				continue;
+			size_t offset = (next() % (sizeof(T) / sizeof(uint32_t))) * sizeof(uint32_t);
+			if (offset == offsetof(T, framebufferId))
+				continue;
+			uint32_t id = ids[next() % ids.size()];
+			memcpy(data.data() + i * sizeof(T) + offset, &id, sizeof(id));
+		}
+
+		char title[64];
+		snprintf(title, sizeof(title), "%s round %lu", generation, round);
+		if (!checkTable<T>(title, data.data(), terminated ? size : total - kPageSize, comparison, false))
+			return;
+	}
+}
+
+// Coffee Lake platform table as listed in Manual/FAQ.IntelHD.en.md, which was dumped from AppleIntelCFLGraphicsFramebuffer.
+// Connectors are hexadecimal bytes in the order of the listing, the ones past the port count are not listed and stay empty.
+struct FixtureEntry {
+	uint32_t framebufferId;
+	uint8_t fMobile;
+	uint8_t fPipeCount;
+	uint8_t fPortCount;
+	uint8_t fFBMemoryCount;
+	uint32_t fStolenMemorySize;
+	uint32_t fFramebufferMemorySize;
+	uint32_t fUnifiedMemorySize;
+	uint32_t flags;
+	uint32_t camelliaVersion;
+	const char *connectors;
+};
+
+static const FixtureEntry cflFixture[] {
+	{0x3EA50009, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x00830B0A, 3, "00000800 02000000 98000000 01050900 00040000 C7010000 02040A00 00040000 C7010000"},
+	{0x3E920009, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x0083130A, 3, "00000800 02000000 98000000 FF000000 01000000 20000000 FF000000 01000000 20000000"},
+	{0x3E9B0009, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x0083130A, 3, "00000800 02000000 98000000 01050900 00040000 87010000 02040A00 00040000 87010000"},
+	{0x3EA50000, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x00030B0B, 0, "00000800 02000000 98000000 01050900 00040000 87010000 02040A00 00040000 87010000"},
+	{0x3E920000, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x0000130B, 0, "00000800 02000000 98000000 01050900 00040000 87010000 02040A00 00040000 87010000"},
+	{0x3E000000, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x0000130B, 0, "00000800 02000000 98000000 01050900 00040000 87010000 02040A00 00040000 87010000"},
+	{0x3E9B0000, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x0000130B, 0, "00000800 02000000 98000000 01050900 00040000 87010000 02040A00 00040000 87010000"},
+	{0x3EA50004, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x00E30B0A, 3, "00000800 02000000 98040000 01050900 00040000 C7030000 02040A00 00040000 C7030000"},
+	{0x3EA50005, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x00E30B0A, 3, "00000800 02000000 98040000 01050900 00040000 C7030000 02040A00 00040000 C7030000"},
+	{0x3EA60005, 1, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x00E30B0A, 3, "00000800 02000000 98040000 01050900 00040000 C7030000 02040A00 00040000 C7030000"},
+	{0x3E9B0006, 1, 1, 1, 1, 0x02600000, 0x00000000, 0x60000000, 0x00131302, 3, "00000800 02000000 98040000"},
+	{0x3E9B0008, 1, 1, 1, 1, 0x03900000, 0x00000000, 0x60000000, 0x00031302, 3, "00000800 02000000 98000000"},
+	{0x3E9B0007, 0, 3, 3, 3, 0x03900000, 0x00000000, 0x60000000, 0x00801302, 0, "01050900 00040000 C7030000 02040A00 00040000 C7030000 03060800 00040000 C7030000"},
+	{0x3E920003, 0, 0, 0, 0, 0x00000000, 0x00000000, 0x60000000, 0x00001000, 0, ""},
+	{0x3E910003, 0, 0, 0, 0, 0x00000000, 0x00000000, 0x60000000, 0x00001000, 0, ""},
+	{0x3E980003, 0, 0, 0, 0, 0x00000000, 0x00000000, 0x60000000, 0x00001000, 0, ""},
+	{0x9BC80003, 0, 0, 0, 0, 0x00000000, 0x00000000, 0x60000000, 0x00001000, 0, ""},
+	{0x9BC50003, 0, 0, 0, 0, 0x00000000, 0x00000000, 0x60000000, 0x00001000, 0, ""},
+	{0x9BC40003, 0, 0, 0, 0, 0x00000000, 0x00000000, 0x60000000, 0x00001000, 0, ""},
+};
+
+static void fixtureTable(Comparison &comparison) {
+	size_t entries = arrsize(cflFixture);
+	size_t size = (entries + 1) * sizeof(FramebufferCFL);
+	std::vector<uint8_t> data(size + kPageSize + sizeof(FramebufferCFL));
+	auto table = reinterpret_cast<FramebufferCFL *>(data.data());
+	for (size_t i = 0; i < entries; i++) {
+		auto &entry = cflFixture[i];
+		auto &fb = table[i];
+		fb.framebufferId = entry.framebufferId;
+		fb.fMobile = entry.fMobile;
+		fb.fPipeCount = entry.fPipeCount;
+		fb.fPortCount = entry.fPortCount;
+		fb.fFBMemoryCount = entry.fFBMemoryCount;
+		fb.fStolenMemorySize = entry.fStolenMemorySize;
+		fb.fFramebufferMemorySize = entry.fFramebufferMemorySize;
+		fb.fUnifiedMemorySize = entry.fUnifiedMemorySize;
+		fb.flags.value = entry.flags;
+		fb.camelliaVersion = entry.camelliaVersion;
+
+		auto connectors = reinterpret_cast<uint8_t *>(fb.connectors);
+		size_t length = 0;
+		for (auto p = entry.connectors; p[0] != '\0' && p[1] != '\0' && length < sizeof(fb.connectors); p++) {
+			unsigned byte;
+			if (p[0] != ' ' && sscanf(p, "%2x", &byte) == 1) {
+				connectors[length++] = static_cast<uint8_t>(byte);
+				p++;
+			}
+		}
+		CHECK(length == entry.fPortCount * sizeof(ConnectorInfo), "cfl fixture: %08X has %zu connector bytes", entry.framebufferId, length);
+	}
+	table[entries].framebufferId = 0xFFFFFFFF;
+
+	checkTable<FramebufferCFL>("cfl fixture", data.data(), size, comparison, true);
+	CHECK(comparison.entries == entries, "cfl fixture: %zu of %zu entries are found", comparison.entries, entries);
+}
+
+template <typename T>
+static bool loadTable(const char *title, const char *path, Comparison &comparison) {
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return false;
+	std::vector<uint8_t> data;
+	uint8_t buffer[4096];
+	size_t length;
+	while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + length);
+	fclose(file);
+	if (data.empty())
+		return false;
+
+	size_t size = data.size();
+	data.resize(size + kPageSize + sizeof(T), 0);
+	checkTable<T>(title, data.data(), size, comparison, true);
+	return true;
+}
+
+static void printComparison(const char *title, const Comparison &comparison) {
+	printf("%-24s %8zu entries | previous search: %6zu false matches %6zu misses %6zu phantoms\n", title,
+		   comparison.entries, comparison.falseMatches, comparison.misses, comparison.phantoms);
+}
+
+struct Generation {
+	const char *name;
+	size_t size;
+	void (*random)(const char *, unsigned long, Comparison &);
+	bool (*load)(const char *, const char *, Comparison &);
+};
+
+static const Generation generations[] {
+	{"ivb", sizeof(FramebufferIVB), randomTables<FramebufferIVB>, loadTable<FramebufferIVB>},
+	{"hsw", sizeof(FramebufferHSW), randomTables<FramebufferHSW>, loadTable<FramebufferHSW>},
+	{"bdw", sizeof(FramebufferBDW), randomTables<FramebufferBDW>, loadTable<FramebufferBDW>},
+	{"skl", sizeof(FramebufferSKL), randomTables<FramebufferSKL>, loadTable<FramebufferSKL>},
+	{"cfl", sizeof(FramebufferCFL), randomTables<FramebufferCFL>, loadTable<FramebufferCFL>},
+	{"cnl", sizeof(FramebufferCNL), randomTables<FramebufferCNL>, loadTable<FramebufferCNL>},
+	{"icllp", sizeof(FramebufferICLLP), randomTables<FramebufferICLLP>, loadTable<FramebufferICLLP>},
+	{"iclhp", sizeof(FramebufferICLHP), randomTables<FramebufferICLHP>, loadTable<FramebufferICLHP>},
+};
+
+int main(int argc, char *argv[]) {
+	unsigned long rounds = 0;
+	bool explicitRounds = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "r:s:")) != -1) {
+		if (opt == 'r') {
+			rounds = strtoul(optarg, nullptr, 0);
+			explicitRounds = true;
+		} else if (opt == 's') {
+			seed(strtoull(optarg, nullptr, 0));
+		} else {
+			fprintf(stderr, "Usage: %s [-r rounds] [-s seed] [generation:table.bin...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	for (int i = optind; i < argc; i++) {
+		auto colon = strchr(argv[i], ':');
+		const Generation *generation = nullptr;
+		for (auto &candidate : generations) {
+			if (colon && strlen(candidate.name) == static_cast<size_t>(colon - argv[i]) && strncmp(candidate.name, argv[i], colon - argv[i]) == 0)
+				generation = &candidate;
+		}
+		if (generation == nullptr) {
+			fprintf(stderr, "Invalid table %s, expected generation:table.bin\n", argv[i]);
+			return 1;
+		}
+
+		Comparison comparison;
+		if (!generation->load(argv[i], colon + 1, comparison)) {
+			fprintf(stderr, "Failed to load %s\n", colon + 1);
+			return 1;
+		}
+		printComparison(argv[i], comparison);
+	}
+
+	if (optind == argc && !explicitRounds)
+		rounds = 10000;
+
+	for (auto &generation : generations) {
+		if (rounds == 0)
+			break;
+		Comparison comparison;
+		generation.random(generation.name, rounds, comparison);
+		char title[64];
+		snprintf(title, sizeof(title), "%s, %zu bytes", generation.name, generation.size);
+		printComparison(title, comparison);
+	}
+
+	Comparison fixture;
+	fixtureTable(fixture);
+	printComparison("cfl fixture", fixture);
+
+	printf("%lu checks, %lu failures\n", checks, failures);
+	return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,171 @@
+//
+// Poll Sim
+// Simulates the PollBackoff register polling from kern_poll.hpp and back to back polling against acknowledgement
+// latency distributions.
+//
+// Usage:
+//   PollSim [-n samples] [-s seed] [-r read] [latencies...]
+//
+//   -n samples   amount of acknowledgements per distribution (default 100000)
+//   -s seed      random seed (default 1)
+//   -r read      duration of one register read in nanoseconds (default 300)
+//
+// Latencies are text files with one acknowledgement latency in microseconds per line, e.g. converted from the
+// igfx-forcewake-ack histograms. Without files a few synthetic distributions are simulated.
+//
+// An acknowledgement is seen by the first register read that completes at or after its latency. Total wait is
+// the time from the first read to that read, overshoot is the time past the latency. Both are averaged, and the
+// 99th percentile and maximum overshoot are reported with the average amount of register reads.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../../WhateverGreen/kern_poll.hpp"
+
+// FORCEWAKE_ACK_TIMEOUT_MS
+static const double kTimeout = 50000.0;
+
+struct Result {
+	double wait;
+	double overshoot;
+	double overshoot99;
+	double overshootMax;
+	double reads;
+	uint64_t timeouts;
+};
+
+static double poll(double latency, double read, bool backoff, uint64_t &reads) {
+	double now = 0;
+	for (uint32_t attempt = 0; ; attempt++) {
+		now += read;
+		reads++;
+		if (now >= latency || now >= kTimeout)
+			return now;
+		if (backoff)
+			now += PollBackoff::delay(attempt);
+	}
+}
+
+static Result simulate(const std::vector<double> &latencies, double read, bool backoff) {
+	Result result {};
+	std::vector<double> overshoots;
+	overshoots.reserve(latencies.size());
+	uint64_t reads = 0;
+	for (auto latency : latencies) {
+		auto done = poll(latency, read, backoff, reads);
+		if (done < latency) {
+			result.timeouts++;
+			continue;
+		}
+		result.wait += done;
+		overshoots.push_back(done - latency);
+		result.overshoot += done - latency;
+	}
+
+	if (!overshoots.empty()) {
+		auto seen = static_cast<double>(overshoots.size());
+		result.wait /= seen;
+		result.overshoot /= seen;
+		std::sort(overshoots.begin(), overshoots.end());
+		result.overshoot99 = overshoots[(overshoots.size() - 1) * 99 / 100];
+		result.overshootMax = overshoots.back();
+	}
+	result.reads = latencies.empty() ? 0 : static_cast<double>(reads) / latencies.size();
+	return result;
+}
+
+static std::vector<double> synthetic(const char *name, size_t samples, std::mt19937_64 &random) {
+	std::vector<double> latencies;
+	std::lognormal_distribution<double> typical(1.0, 0.6);
+	std::lognormal_distribution<double> slow(4.0, 1.0);
+	std::exponential_distribution<double> exponential(1.0 / 20.0);
+	std::uniform_real_distribution<double> uniform(0, 200);
+	std::uniform_real_distribution<double> chance(0, 1);
+	for (size_t i = 0; i < samples; i++) {
+		double value = 0;
+		if (strcmp(name, "lognormal") == 0)
+			value = typical(random);
+		else if (strcmp(name, "slow-lognormal") == 0)
+			value = slow(random);
+		else if (strcmp(name, "exponential") == 0)
+			value = exponential(random);
+		else if (strcmp(name, "uniform") == 0)
+			value = uniform(random);
+		else if (strcmp(name, "bimodal") == 0)
+			// Mostly quick acknowledgements with a tail of package C-state exits
+			value = chance(random) < 0.95 ? typical(random) : 100 + uniform(random) * 5;
+		latencies.push_back(value);
+	}
+	return latencies;
+}
+
+static bool loadLatencies(const char *path, std::vector<double> &latencies) {
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return false;
+	double value;
+	while (fscanf(file, "%lf", &value) == 1)
+		latencies.push_back(value < 0 ? 0 : value);
+	fclose(file);
+	return !latencies.empty();
+}
+
+static void report(const char *name, const std::vector<double> &latencies, double read) {
+	auto spin = simulate(latencies, read, false);
+	auto back = simulate(latencies, read, true);
+	printf("%-16s | spin: wait %8.2f us reads %8.1f | backoff: wait %8.2f us reads %6.1f overshoot %6.2f us p99 %6.2f us max %6.2f us",
+		   name, spin.wait, spin.reads, back.wait, back.reads, back.overshoot, back.overshoot99, back.overshootMax);
+	if (back.timeouts > 0)
+		printf(" timeouts %llu", static_cast<unsigned long long>(back.timeouts));
+	printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+	size_t samples = 100000;
+	double read = 0.3;
+	std::mt19937_64 random(1);
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:s:r:")) != -1) {
+		if (opt == 'n') {
+			samples = strtoul(optarg, nullptr, 0);
+		} else if (opt == 's') {
+			random.seed(strtoull(optarg, nullptr, 0));
+		} else if (opt == 'r') {
+			read = strtod(optarg, nullptr) / 1000.0;
+		} else {
+			fprintf(stderr, "Usage: %s [-n samples] [-s seed] [-r read] [latencies...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (read <= 0 || samples == 0) {
+		fprintf(stderr, "Invalid read duration or sample amount\n");
+		return 1;
+	}
+
+	printf("read %.0f ns, %u spin reads, %u us maximum delay\n", read * 1000, PollBackoff::kSpinReads, PollBackoff::kMaxDelay);
+
+	if (optind == argc) {
+		for (auto name : {"lognormal", "slow-lognormal", "exponential", "uniform", "bimodal"})
+			report(name, synthetic(name, samples, random), read);
+		return 0;
+	}
+
+	for (int i = optind; i < argc; i++) {
+		std::vector<double> latencies;
+		if (!loadLatencies(argv[i], latencies)) {
+			fprintf(stderr, "Failed to load %s\n", argv[i]);
+			return 1;
+		}
+		report(argv[i], latencies, read);
+	}
+
+	return 0;
+}
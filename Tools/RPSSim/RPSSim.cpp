@@ -0,0 +1,178 @@
+//
+// RPS Sim
+// Replays GPU utilization traces against RPSGovernor from kern_rps.hpp and the default maximum frequency policy.
+//
+// Usage:
+//   RPSSim [-f floor] [-c ceiling] [-u up] [-d down] [-U uphold] [-D downhold] [trace...]
+//
+//   -f floor     lowest frequency in 50 MHz units (default 6, 300 MHz)
+//   -c ceiling   highest frequency in 50 MHz units (default 22, 1100 MHz)
+//   -u up        governor up threshold in percent
+//   -d down      governor down threshold in percent
+//   -U uphold    governor busy intervals needed to go up
+//   -D downhold  governor idle intervals needed to go down
+//
+// A trace is a text file with one frame per line holding the GPU work of the frame in percent of a 60 Hz frame
+// at the ceiling frequency. Without traces a few synthetic workloads are replayed.
+//
+// The GPU runs the work of each frame at the requested frequency in 1 ms steps, a frame not completed by the next
+// one is a deadline miss. The energy proxy charges (f / ceiling)^3 per busy millisecond and a small RC6 cost per
+// idle millisecond, and is reported relative to the maximum frequency policy.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../../WhateverGreen/kern_rps.hpp"
+
+static const double kFramePeriod = 1000.0 / 60.0;
+static const uint32_t kGovernorInterval = 10;
+static const double kIdlePower = 0.02;
+
+struct Result {
+	double energy;
+	uint64_t misses;
+	uint64_t frames;
+	double meanFrequency;
+};
+
+static Result replay(const std::vector<double> &trace, RPSGovernor *governor, uint32_t ceiling) {
+	Result result {};
+	double pending = 0, nextFrame = 0, frequencyTime = 0;
+	uint64_t busyInInterval = 0, ms = 0;
+	size_t frame = 0;
+	uint32_t frequency = governor ? governor->current() : ceiling;
+
+	while (frame < trace.size() || pending > 0) {
+		// New frame arrives, the previous one must be done by now
+		if (ms >= nextFrame && frame < trace.size()) {
+			if (pending > 0)
+				result.misses++;
+			pending += trace[frame++] / 100.0 * kFramePeriod;
+			nextFrame += kFramePeriod;
+			result.frames++;
+		}
+
+		double speed = static_cast<double>(frequency) / ceiling;
+		if (pending > 0) {
+			double done = pending < speed ? pending : speed;
+			pending -= done;
+			busyInInterval++;
+			result.energy += speed * speed * speed;
+		} else {
+			result.energy += kIdlePower;
+		}
+
+		frequencyTime += frequency;
+		ms++;
+
+		if (governor && ms % kGovernorInterval == 0) {
+			frequency = governor->update(busyInInterval, kGovernorInterval);
+			busyInInterval = 0;
+		}
+
+		// Safety net for traces that can never be completed
+		if (ms > trace.size() * 1000)
+			break;
+	}
+
+	result.meanFrequency = ms ? frequencyTime / ms : 0;
+	return result;
+}
+
+static bool loadTrace(const char *path, std::vector<double> &trace) {
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return false;
+	double value;
+	while (fscanf(file, "%lf", &value) == 1)
+		trace.push_back(value < 0 ? 0 : value);
+	fclose(file);
+	return !trace.empty();
+}
+
+static std::vector<double> synthetic(const char *name) {
+	std::vector<double> trace;
+	srand(1);
+	auto noise = [](double amplitude) {
+		return (static_cast<double>(rand()) / RAND_MAX * 2 - 1) * amplitude;
+	};
+	for (size_t i = 0; i < 60 * 60; i++) {
+		double value = 0;
+		if (strcmp(name, "desktop") == 0)
+			value = 5 + noise(3);
+		else if (strcmp(name, "video") == 0)
+			value = 25 + noise(5);
+		else if (strcmp(name, "game") == 0)
+			value = 70 + noise(20);
+		else if (strcmp(name, "bursty") == 0)
+			value = (i / 60) % 3 == 2 ? 90 + noise(5) : 5 + noise(3);
+		trace.push_back(value < 0 ? 0 : value);
+	}
+	return trace;
+}
+
+static void report(const char *name, const std::vector<double> &trace, const RPSGovernor::Config &config) {
+	RPSGovernor governor;
+	governor.configure(config);
+	auto base = replay(trace, nullptr, config.ceiling);
+	auto gov = replay(trace, &governor, config.ceiling);
+	printf("%-20s frames %6llu | max: misses %5llu | governor: misses %5llu energy %5.1f%% mean freq %5.0f MHz\n",
+		   name, static_cast<unsigned long long>(base.frames), static_cast<unsigned long long>(base.misses),
+		   static_cast<unsigned long long>(gov.misses), base.energy > 0 ? gov.energy * 100 / base.energy : 0,
+		   gov.meanFrequency * 50);
+}
+
+int main(int argc, char *argv[]) {
+	RPSGovernor::Config config;
+	config.floor = 6;
+	config.ceiling = 22;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "f:c:u:d:U:D:")) != -1) {
+		auto value = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+		if (opt == 'f') {
+			config.floor = value;
+		} else if (opt == 'c') {
+			config.ceiling = value;
+		} else if (opt == 'u') {
+			config.upThreshold = value;
+		} else if (opt == 'd') {
+			config.downThreshold = value;
+		} else if (opt == 'U') {
+			config.upHold = value;
+		} else if (opt == 'D') {
+			config.downHold = value;
+		} else {
+			fprintf(stderr, "Usage: %s [-f floor] [-c ceiling] [-u up] [-d down] [-U uphold] [-D downhold] [trace...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	RPSGovernor check;
+	if (!check.configure(config)) {
+		fprintf(stderr, "Invalid governor tunables\n");
+		return 1;
+	}
+
+	if (optind == argc) {
+		for (auto name : {"desktop", "video", "game", "bursty"})
+			report(name, synthetic(name), config);
+		return 0;
+	}
+
+	for (int i = optind; i < argc; i++) {
+		std::vector<double> trace;
+		if (!loadTrace(argv[i], trace)) {
+			fprintf(stderr, "Failed to load %s\n", argv[i]);
+			return 1;
+		}
+		report(argv[i], trace, config);
+	}
+
+	return 0;
+}
@@ -0,0 +1,474 @@
+//
+// Ramp Sim
+// Tests the BrightnessRamp step engine from kern_igfx_ramp.hpp and simulates the timer driven backlight smoother
+// against the previous smoother that slept on its workloop, over the same brightness request traces.
+//
+// Usage:
+//   RampSim [-r rounds] [-s seed] [-n steps] [-i interval] [-t threshold] [traces...]
+//
+//   -r rounds      amount of random ramps to check (default 100000)
+//   -s seed        random seed (default 1)
+//   -n steps       steps of a transition (default 35)
+//   -i interval    milliseconds between steps (default 7)
+//   -t threshold   transitions shorter than or equal to this distance complete in a single step (default 0)
+//
+// Traces are text files with one request per line: time in milliseconds, register number and target level, e.g.
+//   120 0 4000
+// Without files a few synthetic traces are simulated.
+//
+// Latency is the time from a request to the write of its target level, requests superseded by a newer request
+// for the same register before that are not counted. Blocked is the time the workloop thread spent sleeping.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#include "../../WhateverGreen/kern_igfx_ramp.hpp"
+#include "../Include/tool_check.hpp"
+
+static uint32_t steps = 35;
+static uint32_t interval = 7;
+static uint32_t threshold = 0;
+
+static const uint32_t kRegisters = 4;
+
+// Levels written by the previous smoother for a request that is not superseded
+static std::vector<uint32_t> rampOld(uint32_t current, uint32_t target, uint32_t steps, uint32_t threshold) {
+	std::vector<uint32_t> levels;
+	if (current == target)
+		return levels;
+	uint32_t distance = std::max(current, target) - std::min(current, target);
+	if (distance > threshold) {
+		for (uint32_t i = 1; i < steps; i++) {
+			if (current < target)
+				levels.push_back(current + i * distance / steps);
+			else
+				levels.push_back(current - i * distance / steps);
+		}
+	}
+	levels.push_back(target);
+	return levels;
+}
+
+static std::vector<uint32_t> rampNew(BrightnessRamp &ramp) {
+	std::vector<uint32_t> levels;
+	while (ramp.isActive())
+		levels.push_back(ramp.advance());
+	return levels;
+}
+
+static std::vector<uint32_t> gammaCurve(uint32_t steps) {
+	std::vector<uint32_t> curve(steps + 1);
+	for (uint32_t i = 0; i <= steps; i++)
+		curve[i] = static_cast<uint32_t>(lround(pow(static_cast<double>(i) / steps, 2.2) * BrightnessCurveOne));
+	return curve;
+}
+
+static void checkLinear(unsigned long rounds) {
+	for (unsigned long round = 0; round < rounds; round++) {
+		uint32_t rampSteps = 1 + next() % 64;
+		uint32_t rampThreshold = next() % 4 == 0 ? next() % 0x800 : 0;
+		// The previous smoother computed i * distance in 32 bits, keep the levels in the 16-bit duty cycle range
+		uint32_t from = next() % 0x10000;
+		uint32_t to = next() % 4 == 0 ? from : next() % 0x10000;
+
+		BrightnessRamp ramp;
+		ramp.configure(rampSteps, rampThreshold);
+		ramp.start(from, to);
+		auto expected = rampOld(from, to, rampSteps, rampThreshold);
+		auto actual = rampNew(ramp);
+		if (expected != actual) {
+			CHECK(false, "linear ramp 0x%x -> 0x%x in %u steps, threshold %u: %zu levels, expected %zu",
+				  from, to, rampSteps, rampThreshold, actual.size(), expected.size());
+			return;
+		}
+	}
+	CHECK(true, "linear ramps");
+}
+
+static void checkRetarget(unsigned long rounds) {
+	for (unsigned long round = 0; round < rounds; round++) {
+		uint32_t rampSteps = 2 + next() % 64;
+		uint32_t from = next() % 0x10000;
+		uint32_t to = next() % 0x10000;
+		uint32_t other = next() % 0x10000;
+
+		BrightnessRamp ramp;
+		ramp.configure(rampSteps, 0);
+		ramp.start(from, to);
+		uint32_t written = from;
+		uint32_t taken = next() % rampSteps;
+		for (uint32_t i = 0; i < taken && ramp.isActive(); i++)
+			written = ramp.advance();
+
+		// The previous smoother read the register back and started over from the last written level
+		ramp.retarget(other);
+		auto expected = rampOld(written, other, rampSteps, 0);
+		auto actual = rampNew(ramp);
+		if (expected != actual) {
+			CHECK(false, "retarget 0x%x -> 0x%x after %u steps -> 0x%x: %zu levels, expected %zu",
+				  from, to, taken, other, actual.size(), expected.size());
+			return;
+		}
+	}
+	CHECK(true, "retargeted ramps");
+}
+
+static void checkCurve(unsigned long rounds) {
+	for (unsigned long round = 0; round < rounds; round++) {
+		uint32_t rampSteps = 1 + next() % 128;
+		auto curve = gammaCurve(rampSteps);
+		uint32_t low = next();
+		uint32_t high = next();
+		if (low > high)
+			std::swap(low, high);
+		if (high - low <= 1)
+			continue;
+
+		BrightnessRamp up, down;
+		up.configure(rampSteps, 0, curve.data());
+		down.configure(rampSteps, 0, curve.data());
+		up.start(low, high);
+		down.start(high, low);
+		auto rising = rampNew(up);
+		auto falling = rampNew(down);
+
+		bool ok = rising.size() == rampSteps && falling.size() == rampSteps &&
+			rising.back() == high && falling.back() == low;
+		for (uint32_t i = 0; ok && i < rampSteps; i++) {
+			ok = rising[i] >= low && rising[i] <= high && falling[i] >= low && falling[i] <= high &&
+				(i == 0 || (rising[i] >= rising[i - 1] && falling[i] <= falling[i - 1]));
+			// A falling ramp mirrors the rising one, which may differ by rounding
+			if (ok && i + 1 < rampSteps) {
+				uint32_t mirrored = rising[rampSteps - 2 - i];
+				ok = std::max(mirrored, falling[i]) - std::min(mirrored, falling[i]) <= 1;
+			}
+		}
+		if (!ok) {
+			CHECK(false, "curve ramp 0x%x <-> 0x%x in %u steps", low, high, rampSteps);
+			return;
+		}
+	}
+	CHECK(true, "curve ramps");
+}
+
+static void checkEdges() {
+	BrightnessRamp ramp;
+	ramp.configure(35, 0);
+	ramp.start(100, 100);
+	CHECK(!ramp.isActive(), "a ramp to the current level has no steps");
+
+	ramp.configure(35, 50);
+	ramp.start(100, 150);
+	CHECK(ramp.isActive() && ramp.advance() == 150 && !ramp.isActive(), "a ramp within the threshold takes a single step");
+	ramp.start(100, 151);
+	CHECK(rampNew(ramp).size() == 35, "a ramp beyond the threshold takes every step");
+
+	ramp.configure(1, 0);
+	ramp.start(0, UINT32_MAX);
+	CHECK(ramp.advance() == UINT32_MAX && !ramp.isActive(), "a single step ramp writes the target");
+
+	ramp.configure(1023, 0);
+	ramp.start(UINT32_MAX, 0);
+	auto levels = rampNew(ramp);
+	CHECK(levels.size() == 1023 && levels.back() == 0 && levels[511] == UINT32_MAX - static_cast<uint32_t>(512ULL * UINT32_MAX / 1023),
+		  "the full range does not overflow");
+
+	ramp.configure(10, 0);
+	ramp.start(0, 1000);
+	ramp.advance();
+	ramp.advance();
+	ramp.retarget(200);
+	CHECK(!ramp.isActive(), "retargeting to the last written level has no steps");
+}
+
+//
+// Smoother simulation
+//
+
+struct Request {
+	uint64_t time;
+	uint32_t reg;
+	uint32_t target;
+};
+
+struct Result {
+	uint64_t completed {0};
+	uint64_t latencySum {0};
+	uint64_t latencyMax {0};
+	uint64_t reads {0};
+	uint64_t writes {0};
+	uint64_t blocked {0};
+	uint64_t end {0};
+	std::vector<uint32_t> levels;
+};
+
+struct Pending {
+	bool pending {false};
+	Request request {};
+};
+
+static void complete(Result &result, const Request &request, uint64_t now) {
+	result.completed++;
+	result.latencySum += now - request.time;
+	result.latencyMax = std::max(result.latencyMax, now - request.time);
+}
+
+// Previous BrightnessRequestEventSource::checkForWork sleeping between steps
+static Result simulateOld(const std::vector<Request> &requests) {
+	Result result;
+	result.levels.assign(kRegisters, 0);
+	Pending pending[kRegisters];
+	size_t arrived = 0;
+	uint64_t now = 0;
+
+	auto collect = [&]() {
+		for (; arrived < requests.size() && requests[arrived].time <= now; arrived++) {
+			pending[requests[arrived].reg].pending = true;
+			pending[requests[arrived].reg].request = requests[arrived];
+		}
+	};
+
+	for (;;) {
+		collect();
+		Pending *taken = nullptr;
+		for (auto &candidate : pending) {
+			if (candidate.pending) {
+				taken = &candidate;
+				break;
+			}
+		}
+		if (taken == nullptr) {
+			if (arrived == requests.size())
+				break;
+			now = requests[arrived].time;
+			continue;
+		}
+
+		taken->pending = false;
+		auto request = taken->request;
+		auto &level = result.levels[request.reg];
+		result.reads++;
+		auto current = level;
+		uint32_t distance = std::max(current, request.target) - std::min(current, request.target);
+		bool superseded = false;
+		if (current != request.target && distance > threshold) {
+			for (uint32_t i = 1; i < steps; i++) {
+				level = current < request.target ? current + i * distance / steps : current - i * distance / steps;
+				result.writes++;
+				now += interval;
+				result.blocked += interval;
+				collect();
+				if (pending[request.reg].pending) {
+					superseded = true;
+					break;
+				}
+			}
+		}
+		if (superseded)
+			continue;
+		if (current != request.target) {
+			level = request.target;
+			result.writes++;
+		}
+		complete(result, request, now);
+	}
+
+	result.end = now;
+	return result;
+}
+
+// Current BacklightSmoother::submitTransition and BacklightSmoother::advanceTransitions
+static Result simulateNew(const std::vector<Request> &requests) {
+	Result result;
+	result.levels.assign(kRegisters, 0);
+	struct Transition {
+		bool used {false};
+		Request request {};
+		BrightnessRamp ramp;
+	} transitions[kRegisters];
+	bool armed = false;
+	uint64_t deadline = 0;
+	uint64_t now = 0;
+
+	auto advance = [&]() {
+		bool active = false;
+		for (auto &transition : transitions) {
+			if (!transition.used || !transition.ramp.isActive())
+				continue;
+			result.levels[transition.request.reg] = transition.ramp.advance();
+			result.writes++;
+			if (transition.ramp.isActive())
+				active = true;
+			else
+				complete(result, transition.request, now);
+		}
+		armed = active;
+		deadline = now + interval;
+	};
+
+	size_t arrived = 0;
+	while (arrived < requests.size() || armed) {
+		// Requests are taken before a timer tick at the same time
+		if (arrived < requests.size() && (!armed || requests[arrived].time <= deadline)) {
+			auto &request = requests[arrived++];
+			now = request.time;
+			bool ticking = false;
+			for (auto &transition : transitions)
+				ticking |= transition.used && transition.ramp.isActive();
+
+			auto &transition = transitions[request.reg];
+			bool active = transition.used && transition.ramp.isActive();
+			transition.used = true;
+			transition.request = request;
+			if (active) {
+				transition.ramp.retarget(request.target);
+			} else {
+				result.reads++;
+				transition.ramp.configure(steps, threshold);
+				transition.ramp.start(result.levels[request.reg], request.target);
+				if (!transition.ramp.isActive()) {
+					complete(result, request, now);
+					continue;
+				}
+			}
+
+			if (!ticking)
+				advance();
+		} else {
+			now = deadline;
+			advance();
+		}
+	}
+
+	result.end = now;
+	return result;
+}
+
+static std::vector<Request> synthetic(const char *name) {
+	std::vector<Request> requests;
+	uint64_t time = 0;
+	uint32_t level = 0x8000;
+	for (uint32_t burst = 0; burst < 200; burst++) {
+		if (strcmp(name, "isolated") == 0) {
+			// Occasional changes far apart
+			requests.push_back({time, 0, next() % 0x10000});
+			time += 1000 + next() % 2000;
+		} else if (strcmp(name, "keys") == 0) {
+			// Brightness key taps of a sixteenth of the range
+			bool up = next() % 2 == 0;
+			uint32_t taps = 1 + next() % 8;
+			for (uint32_t i = 0; i < taps; i++) {
+				level = up ? std::min<uint32_t>(level + 0x1000, 0xFFFF) : (level > 0x1000 ? level - 0x1000 : 0);
+				requests.push_back({time, 0, level});
+				time += 80 + next() % 200;
+			}
+			time += 2000;
+		} else if (strcmp(name, "slider") == 0) {
+			// Dimming animations and slider drags writing every frame
+			uint32_t target = next() % 0x10000;
+			for (uint32_t i = 1; i <= 60; i++) {
+				requests.push_back({time, 0, level + static_cast<uint32_t>((static_cast<int64_t>(target) - level) * i / 60)});
+				time += 16;
+			}
+			level = target;
+			time += 1500;
+		} else if (strcmp(name, "two-registers") == 0) {
+			// Changes of two panels close to each other
+			requests.push_back({time, 0, next() % 0x10000});
+			requests.push_back({time + next() % 50, 1, next() % 0x10000});
+			time += 1000 + next() % 2000;
+		}
+	}
+	return requests;
+}
+
+static bool loadTrace(const char *path, std::vector<Request> &requests) {
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return false;
+	unsigned long long time;
+	unsigned reg, target;
+	bool ok = true;
+	while (fscanf(file, "%llu %u %u", &time, &reg, &target) == 3) {
+		if (reg >= kRegisters || (!requests.empty() && time < requests.back().time)) {
+			ok = false;
+			break;
+		}
+		requests.push_back({time, reg, target});
+	}
+	fclose(file);
+	return ok && !requests.empty();
+}
+
+static void report(const char *name, const std::vector<Request> &requests) {
+	auto before = simulateOld(requests);
+	auto after = simulateNew(requests);
+	CHECK(before.levels == after.levels, "%s: both smoothers end at the same levels", name);
+
+	auto print = [](const char *title, const Result &result) {
+		printf(" | %s: latency %6.1f ms max %5llu ms reads %5llu writes %6llu blocked %7llu ms", title,
+			   result.completed > 0 ? static_cast<double>(result.latencySum) / result.completed : 0.0,
+			   static_cast<unsigned long long>(result.latencyMax), static_cast<unsigned long long>(result.reads),
+			   static_cast<unsigned long long>(result.writes), static_cast<unsigned long long>(result.blocked));
+	};
+	printf("%-14s %5zu requests", name, requests.size());
+	print("sleep", before);
+	print("timer", after);
+	printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long rounds = 100000;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "r:s:n:i:t:")) != -1) {
+		if (opt == 'r') {
+			rounds = strtoul(optarg, nullptr, 0);
+		} else if (opt == 's') {
+			seed(strtoull(optarg, nullptr, 0));
+		} else if (opt == 'n') {
+			steps = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+		} else if (opt == 'i') {
+			interval = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+		} else if (opt == 't') {
+			threshold = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+		} else {
+			fprintf(stderr, "Usage: %s [-r rounds] [-s seed] [-n steps] [-i interval] [-t threshold] [traces...]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (steps == 0 || interval == 0) {
+		fprintf(stderr, "Invalid steps or interval\n");
+		return 1;
+	}
+
+	checkEdges();
+	checkLinear(rounds);
+	checkRetarget(rounds);
+	checkCurve(rounds);
+
+	printf("%u steps, %u ms interval, threshold %u\n", steps, interval, threshold);
+	if (optind == argc) {
+		for (auto name : {"isolated", "keys", "slider", "two-registers"})
+			report(name, synthetic(name));
+	}
+
+	for (int i = optind; i < argc; i++) {
+		std::vector<Request> requests;
+		if (!loadTrace(argv[i], requests)) {
+			fprintf(stderr, "Failed to load %s\n", argv[i]);
+			return 1;
+		}
+		report(argv[i], requests);
+	}
+
+	printf("%lu checks, %lu failures\n", checks, failures);
+	return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,255 @@
+//
+// Route Walk
+// Measures the symbol table walks IGFX submodules cause when routing their functions in the framebuffer kext,
+// as KernelPatcher::solveSymbol performs them, per submodule and for a single pass resolving every symbol at once.
+//
+// Usage:
+//   RouteWalk [-n symbols] [-s seed] [symbols.txt]
+//
+//   -n symbols   amount of symbols in the synthetic symbol table (default 12000)
+//   -s seed      random seed (default 1)
+//
+// A symbol list is a text file with one symbol per line in symbol table order, e.g. obtained with
+// nm -jp AppleIntelCFLGraphicsFramebuffer. Without a list a synthetic table of framebuffer-like C++ symbols
+// is used, with the requested symbols at random positions.
+//
+// Each lookup walks the table from the start and compares every name, like MachInfo::solveSymbol does.
+// RouteBatch::flush resolves every batched symbol with its own lookup before a single routeMultiple call,
+// so the walks are the same with and without the batch, only their caller changes. The last line shows what
+// resolving all batched symbols in one walk would cost instead.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../Include/tool_check.hpp"
+
+static const size_t kRuns = 20;
+
+// Submodules routing through RouteBatch in the CFL framebuffer kext, in processFramebufferKext order
+struct Request {
+	const char *submodule;
+	const char *symbol;
+};
+
+static const Request requests[] {
+	{"FCM", "__ZN31AppleIntelFramebufferController16hwRegsNeedUpdateEP21AppleIntelFramebufferP21AppleIntelDisplayPathPNS_10CRTCParamsEPK29IODetailedTimingInformationV2"},
+	{"FOD", "__ZN21AppleIntelFramebuffer16getDisplayStatusEP21AppleIntelDisplayPath"},
+	{"AGDCD", "__ZN20IntelFBClientControl11doAttributeEjPmmS0_S0_P25IOExternalMethodArguments"},
+	{"TCCD", "__ZN31AppleIntelFramebufferController17IsTypeCOnlySystemEv"},
+	{"MLR", "__ZN31AppleIntelFramebufferController7ReadAUXEP21AppleIntelFramebufferjtPvP21AppleIntelDisplayPath"},
+	{"HDC", "__ZN31AppleIntelFramebufferController17ComputeHdmiP0P1P2EjP21AppleIntelDisplayPathPNS_10CRTCParamsE"},
+	{"MPC", "__ZN21AppleIntelFramebuffer15connectionProbeEjj"},
+	{"DBEO", "__ZN31AppleIntelFramebufferController17getFeatureControlEv"},
+	{"RPSC", "__ZL15pmNotifyWrapperjjPyPj"},
+};
+
+static const size_t kRequests = sizeof(requests) / sizeof(requests[0]);
+
+// nlist_64 without the fields the lookup ignores
+struct Symbol {
+	uint32_t strx;
+	uint64_t value;
+};
+
+struct Table {
+	std::vector<char> strings;
+	std::vector<Symbol> symbols;
+
+	void add(const std::string &name, uint64_t value) {
+		symbols.push_back({static_cast<uint32_t>(strings.size()), value});
+		strings.insert(strings.end(), name.begin(), name.end());
+		strings.push_back('\0');
+	}
+};
+
+static std::string mangle(const char *name) {
+	return std::to_string(strlen(name)) + name;
+}
+
+static Table synthetic(size_t count) {
+	static const char *classes[] {
+		"AppleIntelFramebufferController", "AppleIntelFramebuffer", "AppleIntelDisplayPath", "IntelFBClientControl",
+		"AppleIntelPortHAL", "AppleIntelBaseController", "AppleIntelRegisterAccessManager", "AppleIntelPowerWell",
+	};
+	static const char *words[] {
+		"get", "set", "Read", "Write", "Display", "Link", "Training", "AUX", "Port", "Pipe", "Mode", "Clock",
+		"Power", "State", "Config", "Timing", "Hdmi", "DP", "Backlight", "Feature", "Control", "Status", "Update",
+	};
+	static const char *params[] {"Ev", "Ej", "Ejj", "EPv", "EP21AppleIntelDisplayPath", "EjPvm", "EPNS_10CRTCParamsE"};
+
+	std::vector<std::string> names;
+	while (names.size() + kRequests < count) {
+		std::string method;
+		auto parts = 1 + next() % 4;
+		for (uint32_t i = 0; i < parts; i++)
+			method += words[next() % (sizeof(words) / sizeof(words[0]))];
+		auto cls = classes[next() % (sizeof(classes) / sizeof(classes[0]))];
+		names.push_back("__ZN" + mangle(cls) + mangle(method.c_str()) + params[next() % (sizeof(params) / sizeof(params[0]))]);
+	}
+	for (auto &request : requests)
+		names.insert(names.begin() + next() % (names.size() + 1), request.symbol);
+
+	Table table;
+	for (size_t i = 0; i < names.size(); i++)
+		table.add(names[i], 0x1000 + i * 0x10);
+	return table;
+}
+
+static bool load(const char *path, Table &table) {
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return false;
+	char line[4096];
+	while (fgets(line, sizeof(line), file)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] != '\0')
+			table.add(line, 0x1000 + table.symbols.size() * 0x10);
+	}
+	fclose(file);
+	return !table.symbols.empty();
+}
+
+// MachInfo::solveSymbol
+static uint64_t solveSymbol(const Table &table, const char *symbol) {
+	for (auto &entry : table.symbols) {
+		if (strcmp(&table.strings[entry.strx], symbol) == 0)
+			return entry.value;
+	}
+	return 0;
+}
+
+// Every symbol resolved in one walk by a binary search over the sorted names, stopping once all of them are found
+static size_t solveMultiple(const Table &table, const size_t *sorted, uint64_t *values) {
+	size_t pending = kRequests;
+	for (size_t i = 0; i < kRequests; i++)
+		values[i] = 0;
+	for (auto &entry : table.symbols) {
+		auto name = &table.strings[entry.strx];
+		size_t low = 0, high = kRequests;
+		while (low < high) {
+			auto mid = (low + high) / 2;
+			auto cmp = strcmp(name, requests[sorted[mid]].symbol);
+			if (cmp == 0) {
+				if (values[sorted[mid]] == 0) {
+					values[sorted[mid]] = entry.value;
+					if (--pending == 0)
+						return kRequests;
+				}
+				break;
+			}
+			if (cmp < 0)
+				high = mid;
+			else
+				low = mid + 1;
+		}
+	}
+	return kRequests - pending;
+}
+
+template <typename F>
+static double measure(F f) {
+	double best = 0;
+	for (size_t run = 0; run < kRuns; run++) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		if (run == 0 || elapsed.count() < best)
+			best = elapsed.count();
+	}
+	return best;
+}
+
+int main(int argc, char *argv[]) {
+	size_t count = 12000;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+		if (opt == 'n') {
+			count = strtoul(optarg, nullptr, 0);
+		} else if (opt == 's') {
+			seed(strtoull(optarg, nullptr, 0));
+		} else {
+			fprintf(stderr, "Usage: %s [-n symbols] [-s seed] [symbols.txt]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Table table;
+	if (optind < argc) {
+		if (!load(argv[optind], table)) {
+			fprintf(stderr, "Failed to load %s\n", argv[optind]);
+			return 1;
+		}
+	} else {
+		table = synthetic(count);
+	}
+
+	printf("%zu symbols, %zu bytes of names\n", table.symbols.size(), table.strings.size());
+	printf("%-8s %12s %12s\n", "module", "before ns", "batched ns");
+
+	volatile uint64_t sink = 0;
+	double before = 0, batched = 0;
+	size_t missing = 0;
+	for (auto &request : requests) {
+		if (solveSymbol(table, request.symbol) == 0) {
+			printf("%-8s %12s %12s (symbol not found)\n", request.submodule, "-", "-");
+			missing++;
+		}
+	}
+
+	// Without the batch every submodule resolves its symbol inside its own routeMultiple call
+	double walks[kRequests];
+	for (size_t i = 0; i < kRequests; i++) {
+		walks[i] = measure([&]() {
+			sink = sink + solveSymbol(table, requests[i].symbol);
+		});
+		before += walks[i];
+	}
+
+	// RouteBatch::flush resolves the same symbols one by one before routing them together
+	double flushed[kRequests];
+	for (size_t i = 0; i < kRequests; i++)
+		flushed[i] = 0;
+	for (size_t run = 0; run < kRuns; run++) {
+		for (size_t i = 0; i < kRequests; i++) {
+			auto start = std::chrono::steady_clock::now();
+			sink = sink + solveSymbol(table, requests[i].symbol);
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			if (run == 0 || elapsed.count() < flushed[i])
+				flushed[i] = elapsed.count();
+		}
+	}
+
+	for (size_t i = 0; i < kRequests; i++) {
+		printf("%-8s %12.0f %12.0f\n", requests[i].submodule, walks[i], flushed[i]);
+		batched += flushed[i];
+	}
+
+	size_t sorted[kRequests];
+	for (size_t i = 0; i < kRequests; i++) {
+		size_t j = i;
+		while (j > 0 && strcmp(requests[sorted[j - 1]].symbol, requests[i].symbol) > 0) {
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = i;
+	}
+
+	uint64_t values[kRequests];
+	size_t found = 0;
+	auto single = measure([&]() {
+		found = solveMultiple(table, sorted, values);
+		sink = sink + values[0];
+	});
+
+	printf("%-8s %12.0f %12.0f\n", "total", before, batched);
+	printf("%zu walks before and with the batch, a single pass resolving %zu symbols takes %.0f ns (%.1fx)\n",
+		   kRequests, found, single, single > 0 ? batched / single : 0);
+	return missing == 0 ? 0 : 2;
+}
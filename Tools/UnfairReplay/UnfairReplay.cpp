@@ -0,0 +1,463 @@
+//
+// Unfair Replay
+// Replays codesign page validation streams through the unfair page hook as it was before the vnode classification
+// cache and through the current one built from kern_unfair_cache.hpp and kern_pattern.hpp, and measures pages/sec.
+// Afterwards the dyld shared cache page index is validated concurrently from several threads.
+//
+// Usage:
+//   UnfairReplay [-n pages] [-s seed] [-g gva] [-t threads] [stream]
+//
+//   -n pages     amount of pages in the synthetic stream (default 1000000)
+//   -s seed      random seed (default 1)
+//   -g gva       unfairgva bitmask (default 6, i.e. both dyld shared cache patches)
+//   -t threads   amount of threads validating pages concurrently in the page index stress test (default 4)
+//
+// A stream is a text file with one validated page per line: vnode vid offset path, where vnode is any hexadecimal
+// vnode identifier, e.g. recorded with dtrace -n 'fbt::cs_validate_page:entry { printf("%p %u %llu %s\n", arg0,
+// ((struct vnode *)arg0)->v_id, arg2, stringof(((struct vnode *)arg0)->v_name)); }' and the full paths filled in.
+// Without a stream a synthetic one is used, where most pages belong to unrelated binaries. Page contents are
+// synthetic in both cases, a few dyld shared cache pages contain the patched strings.
+//
+// Synthetic pages are faulted in clusters of up to 16 pages of one file. vn_getpath is modelled by copying the
+// recorded path, the real one walks the name cache under a lock, so the difference for unrelated pages is a lower
+// bound. Every fourth page is validated again after patching, like pages that stay in memory. Both passes must
+// produce the same page contents.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../../WhateverGreen/kern_pattern.hpp"
+#include "../../WhateverGreen/kern_unfair_cache.hpp"
+#include "../Include/tool_check.hpp"
+
+static const size_t kPageSize = 4096;
+static const size_t kPathMax = 1024;
+static const size_t kTemplates = 256;
+static const size_t kRuns = 5;
+
+// Same as kern_unfair.cpp
+static const uint8_t relaxedDrmModelFind[29] = {
+	0x4D, 0x61, 0x63, 0x50, 0x72, 0x6F, 0x35, 0x2C, 0x31, 0x00, 0x4D, 0x61, 0x63, 0x50, 0x72, 0x6F,
+	0x36, 0x2C, 0x31, 0x00, 0x49, 0x4F, 0x53, 0x65, 0x72, 0x76, 0x69, 0x63, 0x65
+};
+
+static const uint8_t hwgvaIdFind[18] = {
+	0x62, 0x6F, 0x61, 0x72, 0x64, 0x2D, 0x69, 0x64, 0x00, 0x68, 0x77, 0x2E, 0x6D, 0x6F, 0x64, 0x65,
+	0x6C
+};
+
+static const uint8_t hwgvaIdReplace[5] = {
+	0x68, 0x77, 0x67, 0x76, 0x61
+};
+
+static const uint8_t streamingCpuidFind[] = {0xC7, 0xC0, 0x01, 0x00, 0x00, 0x00, 0x0F, 0xA2};
+static const uint8_t streamingCpuidReplace[] = {0xC7, 0xC0, 0xC3, 0x06, 0x03, 0x00, 0x90, 0x90};
+
+static const char modelIdentifier[20] = "iMacPro1,1";
+
+static const char *coreLSKDMSEPath = "/System/Library/PrivateFrameworks/CoreLSKDMSE.framework/Versions/A/CoreLSKDMSE";
+static const char *coreLSKDPath = "/System/Library/PrivateFrameworks/CoreLSKD.framework/Versions/A/CoreLSKD";
+
+enum : uint32_t {
+	UnfairAllowHardwareDrmStreamDecoderOnOldCpuid = 1,
+	UnfairRelaxHdcpRequirements = 2,
+	UnfairCustomAppleGvaBoardId = 4,
+};
+
+struct Vnode {
+	std::string path;
+};
+
+struct Page {
+	uint32_t vnode;
+	uint32_t vid;
+	uint64_t offset;
+};
+
+struct Stream {
+	std::vector<Vnode> vnodes;
+	std::vector<Page> pages;
+};
+
+// Same prefixes as UserPatcher::matchSharedCachePath
+static bool matchSharedCachePath(const char *path) {
+	static const char *prefixes[] {
+		"/private/var/db/dyld/dyld_shared_cache_",
+		"/System/Library/dyld/dyld_shared_cache_",
+		"/System/Cryptexes/OS/System/Library/dyld/dyld_shared_cache_",
+		"/System/Volumes/Preboot/Cryptexes/OS/System/Library/dyld/dyld_shared_cache_",
+	};
+	for (auto prefix : prefixes) {
+		if (strncmp(path, prefix, strlen(prefix)) == 0)
+			return true;
+	}
+	return false;
+}
+
+// vn_getpath model
+static int getPath(const Stream &stream, const Page &page, char *path, int *len) {
+	auto &name = stream.vnodes[page.vnode].path;
+	if (name.size() + 1 > static_cast<size_t>(*len))
+		return 1;
+	memcpy(path, name.c_str(), name.size() + 1);
+	*len = static_cast<int>(name.size() + 1);
+	return 0;
+}
+
+// KernelPatcher::findAndReplace
+static bool findAndReplace(void *data, size_t dataSize, const void *find, size_t findSize, const void *replace, size_t replaceSize) {
+	if (dataSize < findSize)
+		return false;
+	auto d = static_cast<uint8_t *>(data);
+	for (size_t i = 0; i <= dataSize - findSize; i++) {
+		if (memcmp(d + i, find, findSize) == 0) {
+			memcpy(d + i, replace, replaceSize);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Previous UNFAIR::csValidatePage
+static void validateOld(const Stream &stream, const Page &page, uint8_t *data, uint32_t gva) {
+	char path[kPathMax];
+	int pathlen = kPathMax;
+	if (getPath(stream, page, path, &pathlen) != 0)
+		return;
+
+	if (matchSharedCachePath(path)) {
+		if (gva & UnfairRelaxHdcpRequirements)
+			findAndReplace(data, kPageSize, relaxedDrmModelFind, sizeof(relaxedDrmModelFind), modelIdentifier, sizeof(modelIdentifier));
+		if (gva & UnfairCustomAppleGvaBoardId)
+			findAndReplace(data, kPageSize, hwgvaIdFind, sizeof(hwgvaIdFind), hwgvaIdReplace, sizeof(hwgvaIdReplace));
+	} else if (UNLIKELY(strcmp(path, coreLSKDMSEPath) == 0) || UNLIKELY(strcmp(path, coreLSKDPath) == 0)) {
+		if (gva & UnfairAllowHardwareDrmStreamDecoderOnOldCpuid)
+			findAndReplace(data, kPageSize, streamingCpuidFind, sizeof(streamingCpuidFind), streamingCpuidReplace, sizeof(streamingCpuidReplace));
+	}
+}
+
+// Current UNFAIR::csValidatePage
+struct Unfair {
+	VnodeKindCache vnodeCache;
+	MultiPatternPatcher<2> sharedCachePatcher;
+	MultiPatternPatcher<2> sharedCachePatchedMatcher;
+	uint8_t relaxedDrmModelPatched[sizeof(relaxedDrmModelFind)] {};
+	uint8_t hwgvaIdPatched[sizeof(hwgvaIdFind)] {};
+	MultiPatternPatcher<1> coreLSKDPatcher;
+	SharedCachePageIndex sharedCacheIndex;
+	std::vector<std::vector<uint64_t>> cleanPages;
+	uint64_t misses {0};
+	uint64_t hits {0};
+
+	explicit Unfair(uint32_t gva) : cleanPages(SharedCachePageIndex::Slots, std::vector<uint64_t>(SharedCachePageIndex::BitmapWords)) {
+		for (size_t i = 0; i < SharedCachePageIndex::Slots; i++)
+			sharedCacheIndex.attach(i, cleanPages[i].data());
+		if (gva & UnfairRelaxHdcpRequirements) {
+			sharedCachePatcher.add(relaxedDrmModelFind, sizeof(relaxedDrmModelFind), modelIdentifier, sizeof(modelIdentifier));
+			memcpy(relaxedDrmModelPatched, relaxedDrmModelFind, sizeof(relaxedDrmModelPatched));
+			memcpy(relaxedDrmModelPatched, modelIdentifier, sizeof(modelIdentifier));
+			sharedCachePatchedMatcher.add(relaxedDrmModelPatched, sizeof(relaxedDrmModelPatched), relaxedDrmModelPatched, 0);
+		}
+		if (gva & UnfairCustomAppleGvaBoardId) {
+			sharedCachePatcher.add(hwgvaIdFind, sizeof(hwgvaIdFind), hwgvaIdReplace, sizeof(hwgvaIdReplace));
+			memcpy(hwgvaIdPatched, hwgvaIdFind, sizeof(hwgvaIdPatched));
+			memcpy(hwgvaIdPatched, hwgvaIdReplace, sizeof(hwgvaIdReplace));
+			sharedCachePatchedMatcher.add(hwgvaIdPatched, sizeof(hwgvaIdPatched), hwgvaIdPatched, 0);
+		}
+		if (gva & UnfairAllowHardwareDrmStreamDecoderOnOldCpuid)
+			coreLSKDPatcher.add(streamingCpuidFind, sizeof(streamingCpuidFind), streamingCpuidReplace, sizeof(streamingCpuidReplace));
+	}
+
+	uint64_t classifyVnode(const Stream &stream, const Page &page) {
+		auto vp = &stream.vnodes[page.vnode];
+		auto kind = vnodeCache.lookup(vp, page.vid);
+		if (LIKELY(kind != VnodeKindCache::Unknown))
+			return kind;
+
+		misses++;
+		char path[kPathMax];
+		int pathlen = kPathMax;
+		if (getPath(stream, page, path, &pathlen) != 0)
+			return VnodeKindCache::Unknown;
+
+		kind = VnodeKindCache::Irrelevant;
+		if (matchSharedCachePath(path))
+			kind = VnodeKindCache::SharedCache;
+		else if (UNLIKELY(strcmp(path, coreLSKDMSEPath) == 0) || UNLIKELY(strcmp(path, coreLSKDPath) == 0))
+			kind = VnodeKindCache::CoreLSKD;
+
+		vnodeCache.store(vp, page.vid, kind);
+		return kind;
+	}
+
+	void patchSharedCachePage(const Stream &stream, const Page &page, uint8_t *data) {
+		auto number = page.offset / kPageSize;
+		SharedCachePageIndex::Slot *index = nullptr;
+		if (number < SharedCachePageIndex::Pages) {
+			index = sharedCacheIndex.acquire(&stream.vnodes[page.vnode], page.vid);
+			if (index && SharedCachePageIndex::isClean(index, number)) {
+				sharedCacheIndex.release(index);
+				hits++;
+				return;
+			}
+		}
+
+		auto applied = sharedCachePatcher.apply(data, kPageSize);
+		if (index) {
+			if (applied == 0 && sharedCachePatchedMatcher.match(data, kPageSize) == 0)
+				SharedCachePageIndex::markClean(index, number);
+			sharedCacheIndex.release(index);
+		}
+	}
+
+	void validate(const Stream &stream, const Page &page, uint8_t *data) {
+		auto kind = classifyVnode(stream, page);
+		if (LIKELY(kind == VnodeKindCache::Irrelevant || kind == VnodeKindCache::Unknown))
+			return;
+
+		if (kind == VnodeKindCache::SharedCache) {
+			if (!sharedCachePatcher.empty())
+				patchSharedCachePage(stream, page, data);
+		} else if (kind == VnodeKindCache::CoreLSKD) {
+			coreLSKDPatcher.apply(data, kPageSize);
+		}
+	}
+};
+
+static std::vector<std::vector<uint8_t>> makeTemplates() {
+	std::vector<std::vector<uint8_t>> templates(kTemplates, std::vector<uint8_t>(kPageSize));
+	for (size_t t = 0; t < kTemplates; t++) {
+		auto &page = templates[t];
+		for (auto &byte : page)
+			byte = static_cast<uint8_t>(next() % 96 + 32);
+		// A few pages carry the patched strings, the rest only partial matches
+		auto place = [&](const uint8_t *find, size_t size, bool full) {
+			auto offset = next() % (kPageSize - size);
+			memcpy(&page[offset], find, full ? size : size - 1);
+		};
+		place(relaxedDrmModelFind, sizeof(relaxedDrmModelFind), t % 64 == 0);
+		place(hwgvaIdFind, sizeof(hwgvaIdFind), t % 64 == 1);
+		place(streamingCpuidFind, sizeof(streamingCpuidFind), t % 64 == 2);
+	}
+	return templates;
+}
+
+static const std::vector<uint8_t> &pageTemplate(const std::vector<std::vector<uint8_t>> &templates, const Page &page) {
+	auto hash = (page.offset / kPageSize) * 0x9E3779B97F4A7C15ULL ^ page.vnode * 0xC2B2AE3D27D4EB4FULL;
+	return templates[(hash >> 32) % kTemplates];
+}
+
+static Stream synthetic(size_t pages) {
+	Stream stream;
+	stream.vnodes.push_back({"/System/Volumes/Preboot/Cryptexes/OS/System/Library/dyld/dyld_shared_cache_x86_64h"});
+	stream.vnodes.push_back({"/System/Volumes/Preboot/Cryptexes/OS/System/Library/dyld/dyld_shared_cache_x86_64h.01"});
+	stream.vnodes.push_back({coreLSKDPath});
+	static const size_t binaries = 2000;
+	for (size_t i = 0; i < binaries; i++)
+		stream.vnodes.push_back({"/Applications/Application" + std::to_string(i) + ".app/Contents/Frameworks/Framework" +
+			std::to_string(i % 37) + ".framework/Versions/A/Framework" + std::to_string(i % 37)});
+
+	// Pages are faulted in clusters of a single file
+	std::vector<uint32_t> vids(stream.vnodes.size(), 1);
+	while (stream.pages.size() < pages) {
+		uint32_t vnode;
+		uint64_t first, range;
+		auto kind = next() % 100;
+		if (kind < 14) {
+			vnode = next() % 2;
+			range = 16384;
+		} else if (kind < 15) {
+			vnode = 2;
+			range = 64;
+		} else {
+			// Popular binaries are paged in more often
+			auto a = next() % binaries, b = next() % binaries;
+			vnode = static_cast<uint32_t>(3 + (a < b ? a : b));
+			range = 256;
+			// Recycle unrelated vnodes from time to time
+			if (next() % 100 == 0)
+				vids[vnode]++;
+		}
+		first = next() % range;
+		auto run = 1 + next() % 16;
+		for (uint64_t i = 0; i < run && stream.pages.size() < pages; i++)
+			stream.pages.push_back({vnode, vids[vnode], ((first + i) % range) * kPageSize});
+	}
+	return stream;
+}
+
+static bool loadStream(const char *path, Stream &stream) {
+	FILE *file = fopen(path, "r");
+	if (!file)
+		return false;
+	std::vector<std::pair<unsigned long long, std::string>> known;
+	unsigned long long vnode, offset;
+	unsigned vid;
+	char name[kPathMax];
+	while (fscanf(file, "%llx %u %llu %1023s", &vnode, &vid, &offset, name) == 4) {
+		size_t index = 0;
+		while (index < known.size() && (known[index].first != vnode || known[index].second != name))
+			index++;
+		if (index == known.size()) {
+			known.push_back({vnode, name});
+			stream.vnodes.push_back({name});
+		}
+		stream.pages.push_back({static_cast<uint32_t>(index), vid, offset});
+	}
+	fclose(file);
+	return !stream.pages.empty();
+}
+
+// Best rate of a few runs to reduce the noise
+template <typename F>
+static double measure(const Stream &stream, const std::vector<std::vector<uint8_t>> &templates, F validate) {
+	uint8_t data[kPageSize];
+	double best = 0;
+	for (size_t run = 0; run < kRuns; run++) {
+		auto start = std::chrono::steady_clock::now();
+		for (auto &page : stream.pages) {
+			memcpy(data, pageTemplate(templates, page).data(), kPageSize);
+			validate(page, data);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() > 0 && stream.pages.size() / elapsed.count() > best)
+			best = stream.pages.size() / elapsed.count();
+	}
+	return best;
+}
+
+template <typename F, typename G>
+static size_t compare(const Stream &stream, const std::vector<std::vector<uint8_t>> &templates, F validateOld, G validateNew) {
+	uint8_t oldData[kPageSize], newData[kPageSize];
+	size_t mismatches = 0;
+	for (size_t i = 0; i < stream.pages.size(); i++) {
+		auto &page = stream.pages[i];
+		memcpy(oldData, pageTemplate(templates, page).data(), kPageSize);
+		memcpy(newData, oldData, kPageSize);
+		validateOld(page, oldData);
+		validateNew(page, newData);
+		// Pages are validated again while they stay in memory, after they were patched
+		if (i % 4 == 0) {
+			validateOld(page, oldData);
+			validateNew(page, newData);
+		}
+		if (memcmp(oldData, newData, kPageSize) != 0)
+			mismatches++;
+	}
+	return mismatches;
+}
+
+// Files with more pages marked clean than the index can hold, validated concurrently. A page must only be
+// found clean in the file it was marked in, whichever slot the file had at the time.
+static size_t stressIndex(size_t threads, size_t iterations) {
+	static const size_t files = SharedCachePageIndex::Slots * 2;
+	static const size_t pages = 4096;
+	SharedCachePageIndex index;
+	std::vector<std::vector<uint64_t>> storage(SharedCachePageIndex::Slots, std::vector<uint64_t>(SharedCachePageIndex::BitmapWords));
+	for (size_t i = 0; i < SharedCachePageIndex::Slots; i++)
+		index.attach(i, storage[i].data());
+
+	// Vnodes are recycled, so the same pointer comes with several ids
+	uint8_t vnodes[files / 2];
+	auto clean = [](size_t file, size_t page) {
+		return ((file * 0x9E3779B1U) ^ (page * 0x85EBCA77U)) % 3 != 0;
+	};
+
+	std::atomic<size_t> failures {0}, acquired {0};
+	std::vector<std::thread> workers;
+	for (size_t t = 0; t < threads; t++) {
+		workers.emplace_back([&, t]() {
+			uint64_t local = t + 1;
+			for (size_t i = 0; i < iterations; i++) {
+				local ^= local << 13;
+				local ^= local >> 7;
+				local ^= local << 17;
+				// Files are used in bursts, so that slots are both reused and reassigned
+				auto file = (local >> 8) % (i % 1024 < 512 ? SharedCachePageIndex::Slots : files);
+				auto page = (local >> 24) % pages;
+				auto slot = index.acquire(&vnodes[file / 2], static_cast<uint32_t>(file % 2 + 1));
+				if (!slot)
+					continue;
+				acquired++;
+				if (SharedCachePageIndex::isClean(slot, page)) {
+					if (!clean(file, page))
+						failures++;
+				} else if (clean(file, page)) {
+					SharedCachePageIndex::markClean(slot, page);
+				}
+				index.release(slot);
+			}
+		});
+	}
+	for (auto &worker : workers)
+		worker.join();
+
+	printf("index stress: %zu threads, %zu of %zu validations indexed, %zu stale clean pages\n", threads,
+		   acquired.load(), threads * iterations, failures.load());
+	return failures;
+}
+
+int main(int argc, char *argv[]) {
+	size_t pages = 1000000;
+	size_t threads = 4;
+	uint32_t gva = UnfairRelaxHdcpRequirements | UnfairCustomAppleGvaBoardId;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:s:g:t:")) != -1) {
+		if (opt == 'n') {
+			pages = strtoul(optarg, nullptr, 0);
+		} else if (opt == 's') {
+			seed(strtoull(optarg, nullptr, 0));
+		} else if (opt == 'g') {
+			gva = static_cast<uint32_t>(strtoul(optarg, nullptr, 0));
+		} else if (opt == 't') {
+			threads = strtoul(optarg, nullptr, 0);
+		} else {
+			fprintf(stderr, "Usage: %s [-n pages] [-s seed] [-g gva] [-t threads] [stream]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	auto templates = makeTemplates();
+	Stream stream;
+	if (optind < argc) {
+		if (!loadStream(argv[optind], stream)) {
+			fprintf(stderr, "Failed to load %s\n", argv[optind]);
+			return 1;
+		}
+	} else {
+		stream = synthetic(pages);
+	}
+
+	auto old = [&](const Page &page, uint8_t *data) {
+		validateOld(stream, page, data, gva);
+	};
+	Unfair checked(gva);
+	auto mismatches = compare(stream, templates, old, [&](const Page &page, uint8_t *data) {
+		checked.validate(stream, page, data);
+	});
+
+	auto oldRate = measure(stream, templates, old);
+	Unfair unfair(gva);
+	auto newRate = measure(stream, templates, [&](const Page &page, uint8_t *data) {
+		unfair.validate(stream, page, data);
+	});
+
+	printf("%zu pages, %zu vnodes, unfairgva %u\n", stream.pages.size(), stream.vnodes.size(), gva);
+	printf("old: %12.0f pages/sec\n", oldRate);
+	printf("new: %12.0f pages/sec, %.2f%% path lookups\n", newRate,
+		   stream.pages.empty() ? 0 : checked.misses * 100.0 / stream.pages.size());
+	printf("%zu pages with different contents, %.2f%% dyld shared cache pages skipped by the index\n", mismatches,
+		   stream.pages.empty() ? 0 : checked.hits * 100.0 / stream.pages.size());
+
+	auto stale = stressIndex(threads, 1000000);
+	return mismatches == 0 && stale == 0 ? 0 : 2;
+}
@@ -41,6 +41,7 @@ struct AtomConnectorObject {
 enum class AtomRecordType : uint8_t {
 	Unknown = 0,
 	I2C = 1,
+	HPD = 2,
 	Max = 0xFF
 };
 
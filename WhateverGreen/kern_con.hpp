@@ -97,6 +97,18 @@ namespace RADConnectors {
 		ConnectorAnalogDVI = 0x2000
 	};
 
+	/**
+	 *  Connector types in order of priority for connectors without a user-defined priority
+	 */
+	static constexpr uint32_t PriorityTypes[] {
+		ConnectorLVDS,
+		ConnectorDigitalDVI,
+		ConnectorHDMI,
+		ConnectorDP,
+		ConnectorVGA
+	};
+	static constexpr uint8_t PriorityTypeNum {static_cast<uint8_t>(arrsize(PriorityTypes))};
+
 	/**
 	 *  Prints connector type
 	 *
@@ -203,6 +215,172 @@ namespace RADConnectors {
 
 		}
 	}
+
+	/**
+	 *  Structure of arrays view of the connector fields used for fix-ups, loaded and written back once
+	 */
+	class ConnectorView {
+	public:
+		/**
+		 *  Maximum amount of connectors in the view
+		 */
+		static constexpr uint8_t MaxConnectors = 32;
+
+		/**
+		 *  Missing connector index
+		 */
+		static constexpr uint8_t None = 0xFF;
+
+		/**
+		 *  Maximum amount of connector types in a priority list
+		 */
+		static constexpr uint8_t MaxTypes = 8;
+
+		/**
+		 *  Amount of loaded connectors
+		 */
+		uint8_t count {0};
+
+		/**
+		 *  Connector fields
+		 */
+		uint32_t type[MaxConnectors];
+		uint16_t priority[MaxConnectors];
+		uint8_t transmitter[MaxConnectors];
+		uint8_t sense[MaxConnectors];
+
+		/**
+		 *  Index of the first connector with the given sense id or None
+		 */
+		uint8_t firstBySense[256];
+
+		/**
+		 *  Load connectors in the current format
+		 *
+		 *  @param con  pointer to an array of legacy or modern connectors (depends on the kernel version)
+		 *  @param num  number of connectors in con
+		 *
+		 *  @return false if there are too many connectors
+		 */
+		bool load(const Connector *con, uint8_t num) {
+			if (num > MaxConnectors)
+				return false;
+
+			count = num;
+			memset(firstBySense, None, sizeof(firstBySense));
+			bool isModern = modern();
+			for (uint8_t i = 0; i < num; i++) {
+				if (isModern)
+					load(i, (&con->modern)[i]);
+				else
+					load(i, (&con->legacy)[i]);
+				if (firstBySense[sense[i]] == None)
+					firstBySense[sense[i]] = i;
+			}
+			return true;
+		}
+
+		/**
+		 *  Assign priorities to connectors without a priority, firstly by sense id list, then by type list,
+		 *  then in connector order
+		 *
+		 *  @param senseList  sense ids in order of priority, the first connector with a listed sense id is updated
+		 *  @param senseNum   number of sense ids in the list
+		 *  @param typeList   connector types in order of priority
+		 *  @param typeNum    number of connector types in the list, cannot exceed MaxTypes
+		 */
+		void prioritise(const uint8_t *senseList, uint8_t senseNum, const uint32_t *typeList, uint8_t typeNum) {
+			if (typeNum > MaxTypes)
+				typeNum = MaxTypes;
+
+			uint16_t priCount = 1;
+			for (uint8_t i = 0; i < senseNum; i++) {
+				auto idx = firstBySense[senseList[i]];
+				if (idx != None) {
+					DBGLOG("con", "setting priority of sense %02X to %u by sense", senseList[i], priCount);
+					priority[idx] = priCount++;
+				}
+			}
+
+			// The remaining connectors are ordered by type rank with unlisted types last, keeping the connector order
+			// within the same rank. Counting sort is stable and needs a single pass to rank the connectors.
+			uint8_t rank[MaxConnectors];
+			uint8_t rankStart[MaxTypes + 3] {};
+			for (uint8_t j = 0; j < count; j++) {
+				if (priority[j] != 0)
+					continue;
+				uint8_t r = 0;
+				while (r < typeNum && type[j] != typeList[r])
+					r++;
+				rank[j] = r;
+				rankStart[r + 2]++;
+			}
+			for (uint8_t r = 2; r < typeNum + 2; r++)
+				rankStart[r] += rankStart[r - 1];
+
+			uint8_t order[MaxConnectors];
+			uint8_t orderNum = 0;
+			for (uint8_t j = 0; j < count; j++) {
+				if (priority[j] == 0) {
+					order[rankStart[rank[j] + 1]++] = j;
+					orderNum++;
+				}
+			}
+
+			for (uint8_t k = 0; k < orderNum; k++) {
+				auto j = order[k];
+				if (rank[j] < typeNum)
+					DBGLOG("con", "setting priority of sense %02X to %u by type", sense[j], priCount);
+				priority[j] = priCount++;
+			}
+		}
+
+		/**
+		 *  Restore the transmitter of the first connector with the given sense id if it was masked with 0xCF
+		 *
+		 *  @param connectorSense  sense id
+		 *  @param txmit           correct transmitter
+		 *
+		 *  @return index of the updated connector or None
+		 */
+		uint8_t correctTransmitter(uint8_t connectorSense, uint8_t txmit) {
+			auto idx = firstBySense[connectorSense];
+			if (idx == None || transmitter[idx] == txmit || (transmitter[idx] & 0xCF) != transmitter[idx])
+				return None;
+			transmitter[idx] = txmit;
+			return idx;
+		}
+
+		/**
+		 *  Write back modified priority and transmitter fields
+		 *
+		 *  @param con  pointer to an array of legacy or modern connectors (depends on the kernel version)
+		 */
+		void store(Connector *con) const {
+			bool isModern = modern();
+			for (uint8_t i = 0; i < count; i++) {
+				if (isModern)
+					store(i, (&con->modern)[i]);
+				else
+					store(i, (&con->legacy)[i]);
+			}
+		}
+
+	private:
+		template <typename T>
+		void load(uint8_t i, const T &con) {
+			type[i] = con.type;
+			priority[i] = con.priority;
+			transmitter[i] = con.transmitter;
+			sense[i] = con.sense;
+		}
+
+		template <typename T>
+		void store(uint8_t i, T &con) const {
+			con.priority = priority[i];
+			con.transmitter = transmitter[i];
+		}
+	};
 };
 
 #endif /* kern_con_hpp */
@@ -0,0 +1,137 @@
+//
+//  kern_fb_index.hpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_fb_index_hpp
+#define kern_fb_index_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  Platform information list entries sorted by framebuffer id
+ *
+ *  @note The list is walked with the stride of the generation structure from kern_fb.hpp, so framebuffer ids
+ *        cannot be matched inside other fields of an entry.
+ *  @note The index has no dependencies on the kernel, so that it can be tested against captured platform tables on any host.
+ */
+class PlatformInformationIndex {
+public:
+	/**
+	 *  Maximum amount of indexed platform information entries
+	 */
+	static constexpr size_t MaxEntries = 64;
+
+	/**
+	 *  Result of building the index
+	 */
+	enum class Status {
+		Indexed,
+		TooManyEntries,
+		NoTerminator
+	};
+
+private:
+	/**
+	 *  Index entry
+	 */
+	struct Entry {
+		uint32_t framebufferId;
+		uint8_t *address;
+	};
+
+	/**
+	 *  Entries sorted by framebuffer id, entries with the same id keep their order in the list
+	 */
+	Entry entries[MaxEntries] {};
+
+	/**
+	 *  Amount of indexed entries, 0 if the list is not indexed
+	 */
+	size_t count {0};
+
+public:
+	/**
+	 *  Build the index up to the 0xFFFFFFFF terminator of the list
+	 *
+	 *  @param list  PlatformInformationList pointer
+	 *  @param end   End of the memory the list may occupy, e.g. the end of the framebuffer binary
+	 *
+	 *  @return Indexed on success, the index is left empty otherwise.
+	 */
+	template <typename T>
+	Status build(T *list, const uint8_t *end) {
+		count = 0;
+		size_t indexed = 0;
+		auto entry = list;
+		while (reinterpret_cast<const uint8_t *>(entry + 1) <= end && entry->framebufferId != 0xFFFFFFFF) {
+			if (indexed == MaxEntries)
+				return Status::TooManyEntries;
+
+			// Insertion sort, the list is small and built once
+			size_t i = indexed++;
+			while (i > 0 && entries[i - 1].framebufferId > entry->framebufferId) {
+				entries[i] = entries[i - 1];
+				i--;
+			}
+			entries[i] = {entry->framebufferId, reinterpret_cast<uint8_t *>(entry)};
+			entry++;
+		}
+
+		if (reinterpret_cast<const uint8_t *>(entry + 1) > end)
+			return Status::NoTerminator;
+
+		count = indexed;
+		return Status::Indexed;
+	}
+
+	/**
+	 *  Find the entry of a framebuffer
+	 *
+	 *  @param framebufferId  Framebuffer id
+	 *
+	 *  @return The first entry with the framebuffer id in the list or nullptr.
+	 */
+	uint8_t *find(uint32_t framebufferId) const {
+		size_t low = 0, high = count;
+		while (low < high) {
+			size_t mid = (low + high) / 2;
+			if (entries[mid].framebufferId < framebufferId)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		if (low < count && entries[low].framebufferId == framebufferId)
+			return entries[low].address;
+		return nullptr;
+	}
+
+	/**
+	 *  Get the amount of indexed entries
+	 *
+	 *  @return The amount of entries, 0 if the list is not indexed.
+	 */
+	size_t size() const {
+		return count;
+	}
+
+	/**
+	 *  Get the last entry of the list
+	 *
+	 *  @return The entry with the highest address or nullptr if the list is not indexed.
+	 */
+	uint8_t *last() const {
+		uint8_t *address = nullptr;
+		for (size_t i = 0; i < count; i++) {
+			if (entries[i].address > address)
+				address = entries[i].address;
+		}
+		return address;
+	}
+};
+
+#endif /* kern_fb_index_hpp */
@@ -8,16 +8,23 @@
 #ifndef kern_guc_hpp
 #define kern_guc_hpp
 
-#include <libkern/libkern.h>
+#include <stddef.h>
+#include <stdint.h>
 
 static constexpr size_t GuCFirmwareSignatureSize = 256;
+static constexpr size_t GuCFirmwareDigestSize = 32;
+
+// Firmware images are LZSS compressed together with the signature and are only
+// decompressed when GuC loading is requested, see Tools/GuCPack.
 
 extern const uint8_t *GuCFirmwareSKL;
-extern const uint8_t *GuCFirmwareSKLSignature;
+extern const uint8_t *GuCFirmwareSKLDigest;
+extern const size_t GuCFirmwareSKLCompressedSize;
 extern const size_t GuCFirmwareSKLSize;
 
 extern const uint8_t *GuCFirmwareKBL;
-extern const uint8_t *GuCFirmwareKBLSignature;
+extern const uint8_t *GuCFirmwareKBLDigest;
+extern const size_t GuCFirmwareKBLCompressedSize;
 extern const size_t GuCFirmwareKBLSize;
 
 #endif /* kern_guc_hpp */
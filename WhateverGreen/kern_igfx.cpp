@@ -12,9 +12,12 @@
 #include "kern_igfx_kexts.hpp"
 
 #include <Headers/kern_api.hpp>
+#include <Headers/kern_compression.hpp>
+#include <Headers/kern_crypto.hpp>
 #include <Headers/kern_cpu.hpp>
 #include <Headers/kern_file.hpp>
 #include <Headers/kern_iokit.hpp>
+#include <Headers/kern_time.hpp>
 
 #include <IOKit/pci/IOPCIDevice.h>
 
@@ -158,6 +161,8 @@ void IGFX::init() {
 }
 
 void IGFX::deinit() {
+	releaseGuCFirmware();
+
 	// Deinitialize each submodule
 	for (auto submodule : submodules)
 		submodule->deinit();
@@ -218,13 +223,19 @@ void IGFX::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
 		
 		// Note that the order does matter
 		// We first iterate through each submodule and redirect the request
-		for (auto submodule : submodules)
-			submodule->processKernel(patcher, info);
+		for (size_t i = 0; i < arrsize(submodules); i++) {
+			auto start = BootProfile::start();
+			submodules[i]->processKernel(patcher, info);
+			BootProfile::stop("IGFX::Submodule::processKernel", start, submoduleNames[i]);
+		}
 		
 		// Then process shared submodules
 		// A shared submodule will disable itself if no active submodule depends on it
-		for (auto submodule : sharedSubmodules)
-			submodule->processKernel(patcher, info);
+		for (size_t i = 0; i < arrsize(sharedSubmodules); i++) {
+			auto start = BootProfile::start();
+			sharedSubmodules[i]->processKernel(patcher, info);
+			BootProfile::stop("IGFX::SharedSubmodule::processKernel", start, sharedSubmoduleNames[i]);
+		}
 		
 		// Iterate through each submodule and see if we need to patch the graphics and the framebuffer kext
 		auto submodulesRequiresFramebufferPatch = false;
@@ -315,14 +326,27 @@ bool IGFX::processKext(KernelPatcher &patcher, size_t index, mach_vm_address_t a
 		// We first process shared submodules
 		// If a shared submodule fails to process the acceleration driver,
 		// all subdmoules that depend on it will be disabled automatically.
-		for (auto submodule : sharedSubmodules)
-			if (submodule->enabled)
-				submodule->processGraphicsKext(patcher, index, address, size);
+		for (size_t i = 0; i < arrsize(sharedSubmodules); i++) {
+			if (sharedSubmodules[i]->enabled) {
+				auto start = BootProfile::start();
+				sharedSubmodules[i]->processGraphicsKext(patcher, index, address, size);
+				BootProfile::stop("IGFX::SharedSubmodule::processGraphicsKext", start, sharedSubmoduleNames[i]);
+			}
+		}
 		
 		// Then iterate through each submodule and redirect the request if and only if it is enabled
-		for (auto submodule : submodules)
-			if (submodule->enabled)
-				submodule->processGraphicsKext(patcher, index, address, size);
+		routeBatch.begin(patcher, index, address, size);
+		for (size_t i = 0; i < arrsize(submodules); i++) {
+			if (submodules[i]->enabled) {
+				auto start = BootProfile::start();
+				submodules[i]->processGraphicsKext(patcher, index, address, size);
+				BootProfile::stop("IGFX::Submodule::processGraphicsKext", start, submoduleNames[i]);
+			}
+		}
+		
+		auto start = BootProfile::start();
+		routeBatch.flush();
+		BootProfile::stop("IGFX::RouteBatch::flushGraphics", start);
 
 		return true;
 	}
@@ -334,45 +358,50 @@ bool IGFX::processKext(KernelPatcher &patcher, size_t index, mach_vm_address_t a
 		// We first process shared submodules
 		// If a shared submodule fails to process the framebuffer driver,
 		// all subdmoules that depend on it will be disabled automatically.
-		for (auto submodule : sharedSubmodules)
-			if (submodule->enabled)
-				submodule->processFramebufferKext(patcher, index, address, size);
+		// Shared submodules route their functions immediately, so that failures are known before their dependents are processed.
+		for (size_t i = 0; i < arrsize(sharedSubmodules); i++) {
+			if (sharedSubmodules[i]->enabled) {
+				auto start = BootProfile::start();
+				sharedSubmodules[i]->processFramebufferKext(patcher, index, address, size);
+				BootProfile::stop("IGFX::SharedSubmodule::processFramebufferKext", start, sharedSubmoduleNames[i]);
+			}
+		}
 		
 		// Then iterate through each submodule and redirect the request if and only if it is enabled
-		for (auto submodule : submodules)
-			if (submodule->enabled)
-				submodule->processFramebufferKext(patcher, index, address, size);
+		routeBatch.begin(patcher, index, address, size);
+		for (size_t i = 0; i < arrsize(submodules); i++) {
+			if (submodules[i]->enabled) {
+				auto start = BootProfile::start();
+				submodules[i]->processFramebufferKext(patcher, index, address, size);
+				BootProfile::stop("IGFX::Submodule::processFramebufferKext", start, submoduleNames[i]);
+			}
+		}
+		
+		auto start = BootProfile::start();
+		routeBatch.flush();
+		BootProfile::stop("IGFX::RouteBatch::flushFramebuffer", start);
+		
+		// All submodules have registered their MMIO injections by now
+		if (modMMIORegistersReadSupport.enabled && !modMMIORegistersReadSupport.freeze())
+			SYSLOG("igfx", "RRS: Too many injections to build the dispatch table.");
+		if (modMMIORegistersWriteSupport.enabled && !modMMIORegistersWriteSupport.freeze())
+			SYSLOG("igfx", "RWS: Too many injections to build the dispatch table.");
 
 		if (applyFramebufferPatch || dumpFramebufferToDisk || dumpPlatformTable || hdmiAutopatch) {
 			framebufferStart = reinterpret_cast<uint8_t *>(address);
 			framebufferSize = size;
 			
-			if (cpuGeneration >= CPUInfo::CpuGeneration::SandyBridge) {
-				if (cpuGeneration == CPUInfo::CpuGeneration::SandyBridge) {
-					gPlatformListIsSNB = true;
-					gPlatformInformationList = patcher.solveSymbol<void *>(index, "_PlatformInformationList", address, size);
-				} else {
-					gPlatformListIsSNB = false;
-					gPlatformInformationList = patcher.solveSymbol<void *>(index, "_gPlatformInformationList", address, size);
-				}
-
-				DBGLOG("igfx", "platform is snb %d and list " PRIKADDR, gPlatformListIsSNB, CASTKADDR(gPlatformInformationList));
+			framebufferPlatform = getFramebufferPlatform(getRealFramebuffer(index));
+			if (framebufferPlatform && framebufferPlatform->platformInformationList) {
+				gPlatformListIsSNB = framebufferPlatform->kext == &kextIntelSNBFb;
+				gPlatformInformationList = patcher.solveSymbol<void *>(index, framebufferPlatform->platformInformationList, address, size);
+				DBGLOG("igfx", "platform is %s and list " PRIKADDR, framebufferPlatform->name, CASTKADDR(gPlatformInformationList));
+				if (gPlatformInformationList && framebufferPlatform->indexPlatformInformationList)
+					(this->*framebufferPlatform->indexPlatformInformationList)();
 			}
 
-			if ((gPlatformInformationList && cpuGeneration >= CPUInfo::CpuGeneration::SandyBridge) || cpuGeneration == CPUInfo::CpuGeneration::Westmere) {
-				auto fbGetOSInformation = "__ZN31AppleIntelFramebufferController16getOSInformationEv";
-				if (cpuGeneration == CPUInfo::CpuGeneration::Westmere)
-					fbGetOSInformation = "__ZN22AppleIntelHDGraphicsFB16getOSInformationEv";
-				else if (cpuGeneration == CPUInfo::CpuGeneration::SandyBridge)
-					fbGetOSInformation = "__ZN23AppleIntelSNBGraphicsFB16getOSInformationEv";
-				else if (cpuGeneration == CPUInfo::CpuGeneration::IvyBridge)
-					fbGetOSInformation = "__ZN25AppleIntelCapriController16getOSInformationEv";
-				else if (cpuGeneration == CPUInfo::CpuGeneration::Haswell)
-					fbGetOSInformation = "__ZN24AppleIntelAzulController16getOSInformationEv";
-				else if (cpuGeneration == CPUInfo::CpuGeneration::Broadwell)
-					fbGetOSInformation = "__ZN22AppleIntelFBController16getOSInformationEv";
-
-				KernelPatcher::RouteRequest request(fbGetOSInformation, wrapGetOSInformation, orgGetOSInformation);
+			if (framebufferPlatform && (gPlatformInformationList || cpuGeneration == CPUInfo::CpuGeneration::Westmere)) {
+				KernelPatcher::RouteRequest request(framebufferPlatform->getOSInformation, wrapGetOSInformation, orgGetOSInformation);
 				patcher.routeMultiple(index, &request, 1, address, size);
 			} else if (cpuGeneration >= CPUInfo::CpuGeneration::SandyBridge) {
 				SYSLOG("igfx", "failed to obtain gPlatformInformationList pointer with code %d", patcher.getError());
@@ -392,6 +421,81 @@ bool IGFX::processKext(KernelPatcher &patcher, size_t index, mach_vm_address_t a
 	return false;
 }
 
+// MARK: - Route Batch
+
+void IGFX::RouteBatch::begin(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
+	this->patcher = &patcher;
+	this->index = index;
+	this->address = address;
+	this->size = size;
+	count = 0;
+}
+
+void IGFX::RouteBatch::add(const KernelPatcher::RouteRequest &request, const char *failureMessage) {
+	// Guard: Requests can only be collected while a kext is being processed
+	if (patcher == nullptr) {
+		SYSLOG("igfx", "RB: Request for %s is added outside of a batch.", request.symbol);
+		SYSLOG("igfx", "%s", failureMessage);
+		return;
+	}
+	
+	// Make room for the request
+	if (count == kMaxRequests) {
+		DBGLOG("igfx", "RB: The batch is full. Will route pending requests early.");
+		auto current = patcher;
+		flush();
+		begin(*current, index, address, size);
+	}
+	
+	lilu_os_memcpy(&requests()[count], &request, sizeof(KernelPatcher::RouteRequest));
+	failureMessages[count] = failureMessage;
+	count++;
+}
+
+void IGFX::RouteBatch::flush() {
+	if (patcher == nullptr)
+		return;
+	
+	// Resolve every symbol first and drop the ones that are missing
+	auto pending = requests();
+	size_t resolved = 0;
+	for (size_t i = 0; i < count; i++) {
+		pending[i].from = patcher->solveSymbol(index, pending[i].symbol, address, size);
+		if (pending[i].from == 0) {
+			SYSLOG("igfx", "%s", failureMessages[i]);
+			patcher->clearError();
+			continue;
+		}
+		
+		// Clear the original function, so that a partial failure can be told apart
+		if (pending[i].org != nullptr)
+			*pending[i].org = 0;
+		
+		if (resolved != i) {
+			lilu_os_memcpy(&pending[resolved], &pending[i], sizeof(KernelPatcher::RouteRequest));
+			failureMessages[resolved] = failureMessages[i];
+		}
+		resolved++;
+	}
+	
+	// Route the remaining requests at once
+	// The patcher keeps routing after a failed request, so only report the requests without the original function
+	if (resolved > 0 && !patcher->routeMultiple(index, pending, resolved, address, size)) {
+		for (size_t i = 0; i < resolved; i++) {
+			if (pending[i].org == nullptr)
+				SYSLOG("igfx", "RB: %s may not have been routed, it has no original function to check.", pending[i].symbol);
+			else if (*pending[i].org == 0)
+				SYSLOG("igfx", "%s", failureMessages[i]);
+		}
+		patcher->clearError();
+	} else {
+		DBGLOG("igfx", "RB: Routed %lu of %lu functions in a single batch.", resolved, count);
+	}
+	
+	count = 0;
+	patcher = nullptr;
+}
+
 // MARK: - Global Framebuffer Controller Access Support
 
 void IGFX::FramebufferControllerAccessSupport::init() {
@@ -422,6 +526,250 @@ void IGFX::FramebufferControllerAccessSupport::disableDependentSubmodules() {
 			submodule->enabled = false;
 }
 
+// MARK: - MMIO Registers Trace Support
+
+void IGFX::MMIORegistersTraceSupport::deinit() {
+	if (publisher) {
+		thread_call_cancel(publisher);
+		thread_call_free(publisher);
+		publisher = nullptr;
+	}
+	
+	if (records) {
+		Buffer::deleter(records);
+		records = nullptr;
+	}
+}
+
+void IGFX::MMIORegistersTraceSupport::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
+	enabled = checkKernelArgument("-igfxvamregs");
+	if (!enabled)
+		return;
+	
+	// Guard: Parse optional address ranges as pairs of 32-bit inclusive bounds
+	auto rangeData = OSDynamicCast(OSData, info->videoBuiltin->getProperty("mmio-trace-ranges"));
+	if (rangeData) {
+		auto bounds = static_cast<const uint32_t *>(rangeData->getBytesNoCopy());
+		rangeCount = rangeData->getLength() / (sizeof(uint32_t) * 2);
+		if (rangeCount > kMaxRanges) {
+			SYSLOG("igfx", "MTS: Only the first %lu address ranges will be traced.", kMaxRanges);
+			rangeCount = kMaxRanges;
+		}
+		for (size_t i = 0; i < rangeCount; i++) {
+			ranges[i] = {bounds[i * 2], bounds[i * 2 + 1]};
+			DBGLOG("igfx", "MTS: Will trace registers in range [0x%x, 0x%x].", ranges[i].first, ranges[i].second);
+		}
+	}
+	
+	records = Buffer::create<MMIOTraceRecord>(kCapacity);
+	publisher = thread_call_allocate(publish, this);
+	if (records == nullptr || publisher == nullptr) {
+		SYSLOG("igfx", "MTS: Failed to allocate the trace buffer.");
+		deinit();
+		enabled = false;
+		return;
+	}
+	
+	memset(records, 0, sizeof(MMIOTraceRecord) * kCapacity);
+	DBGLOG("igfx", "MTS: Enabled = %d.", enabled);
+}
+
+void IGFX::MMIORegistersTraceSupport::record(void *controller, uint32_t address, uint32_t value, MMIOTraceDirection direction) {
+	// Guard: Check the address ranges
+	if (rangeCount != 0) {
+		bool found = false;
+		for (size_t i = 0; i < rangeCount && !found; i++)
+			found = address >= ranges[i].first && address <= ranges[i].second;
+		if (!found)
+			return;
+	}
+	
+	// Claim a slot and invalidate it until the record is complete
+	auto index = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+	auto &slot = records[index & (kCapacity - 1)];
+	__atomic_store_n(&slot.sequence, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot.timestamp = getCurrentTimeNs();
+	slot.controller = reinterpret_cast<uint64_t>(controller);
+	slot.address = address;
+	slot.value = value;
+	slot.direction = direction;
+	__atomic_store_n(&slot.sequence, index + 1, __ATOMIC_RELEASE);
+	
+	// Publish the buffer in batches
+	if ((index + 1) % kBatchSize == 0)
+		thread_call_enter(publisher);
+}
+
+void IGFX::MMIORegistersTraceSupport::publish(thread_call_param_t param0, thread_call_param_t param1) {
+	auto self = static_cast<MMIORegistersTraceSupport *>(param0);
+	auto end = __atomic_load_n(&self->head, __ATOMIC_ACQUIRE);
+	auto start = end > kCapacity ? end - kCapacity : 0;
+	
+	auto snapshot = Buffer::create<MMIOTraceRecord>(kCapacity);
+	if (snapshot == nullptr) {
+		SYSLOG("igfx", "MTS: Failed to allocate the trace snapshot.");
+		return;
+	}
+	
+	// Copy complete records in order, skipping the ones being overwritten concurrently
+	size_t count = 0;
+	for (auto index = start; index < end; index++) {
+		auto &slot = self->records[index & (kCapacity - 1)];
+		if (__atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) != index + 1)
+			continue;
+		snapshot[count] = slot;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot.sequence, __ATOMIC_RELAXED) == index + 1)
+			count++;
+	}
+	
+	auto entry = IORegistryEntry::fromPath("IOService:/IOResources/WhateverGreen");
+	if (entry) {
+		entry->setProperty("igfx-mmio-trace", snapshot, static_cast<unsigned>(count * sizeof(MMIOTraceRecord)));
+		entry->setProperty("igfx-mmio-trace-count", end, 64);
+		entry->release();
+	}
+	
+	Buffer::deleter(snapshot);
+}
+
+// MARK: - MMIO Registers Statistics Support
+
+void IGFX::MMIORegistersStatisticsSupport::deinit() {
+	if (publisher) {
+		thread_call_cancel(publisher);
+		thread_call_free(publisher);
+		publisher = nullptr;
+	}
+	
+	if (entries) {
+		Buffer::deleter(entries);
+		entries = nullptr;
+	}
+}
+
+void IGFX::MMIORegistersStatisticsSupport::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
+	enabled = checkKernelArgument("-igfxmmiostats");
+	if (!enabled)
+		return;
+	
+	entries = Buffer::create<Entry>(kCapacity);
+	publisher = thread_call_allocate(publish, this);
+	if (entries == nullptr || publisher == nullptr) {
+		SYSLOG("igfx", "MSS: Failed to allocate the statistics table.");
+		deinit();
+		enabled = false;
+		return;
+	}
+	
+	memset(entries, 0, sizeof(Entry) * kCapacity);
+	DBGLOG("igfx", "MSS: Enabled = %d.", enabled);
+}
+
+IGFX::MMIORegistersStatisticsSupport::Entry *IGFX::MMIORegistersStatisticsSupport::getEntry(uint32_t address) {
+	// Registers are 4-byte aligned, so drop the low bits before hashing
+	uint32_t key = address + 1;
+	size_t index = ((address >> 2) * 2654435761U) & (kCapacity - 1);
+	for (size_t probe = 0; probe < kCapacity; probe++, index = (index + 1) & (kCapacity - 1)) {
+		auto &entry = entries[index];
+		uint32_t current = __atomic_load_n(&entry.key, __ATOMIC_ACQUIRE);
+		if (current == 0 && __atomic_compare_exchange_n(&entry.key, &current, key, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return &entry;
+		if (current == key)
+			return &entry;
+	}
+	return nullptr;
+}
+
+void IGFX::MMIORegistersStatisticsSupport::count(uint32_t address, MMIOTraceDirection direction, uint64_t latency) {
+	auto entry = getEntry(address);
+	if (UNLIKELY(entry == nullptr)) {
+		__atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	
+	__atomic_add_fetch(&entry->counts[direction], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&entry->latencies[direction], latency, __ATOMIC_RELAXED);
+	
+	// Publish the summary periodically
+	if (__atomic_add_fetch(&total, 1, __ATOMIC_RELAXED) % kPublishInterval == 0)
+		thread_call_enter(publisher);
+}
+
+void IGFX::MMIORegistersStatisticsSupport::publish(thread_call_param_t param0, thread_call_param_t param1) {
+	auto self = static_cast<MMIORegistersStatisticsSupport *>(param0);
+	
+	// Select the most accessed registers with an insertion sort, the summary is tiny
+	Entry top[kTopCount] {};
+	size_t found = 0;
+	for (size_t i = 0; i < kCapacity; i++) {
+		Entry entry;
+		entry.key = __atomic_load_n(&self->entries[i].key, __ATOMIC_ACQUIRE);
+		if (entry.key == 0)
+			continue;
+		for (size_t d = 0; d < arrsize(entry.counts); d++) {
+			entry.counts[d] = __atomic_load_n(&self->entries[i].counts[d], __ATOMIC_RELAXED);
+			entry.latencies[d] = __atomic_load_n(&self->entries[i].latencies[d], __ATOMIC_RELAXED);
+		}
+		
+		auto accesses = entry.counts[MMIOTraceRead] + entry.counts[MMIOTraceWrite];
+		size_t position = found;
+		while (position > 0 && top[position - 1].counts[MMIOTraceRead] + top[position - 1].counts[MMIOTraceWrite] < accesses) {
+			if (position < kTopCount)
+				top[position] = top[position - 1];
+			position--;
+		}
+		if (position < kTopCount) {
+			top[position] = entry;
+			if (found < kTopCount)
+				found++;
+		}
+	}
+	
+	auto summary = OSArray::withCapacity(static_cast<unsigned>(found));
+	if (summary == nullptr) {
+		SYSLOG("igfx", "MSS: Failed to allocate the statistics summary.");
+		return;
+	}
+	
+	for (size_t i = 0; i < found; i++) {
+		auto dict = OSDictionary::withCapacity(5);
+		if (dict == nullptr)
+			break;
+		
+		uint64_t readTime, writeTime;
+		absolutetime_to_nanoseconds(top[i].latencies[MMIOTraceRead], &readTime);
+		absolutetime_to_nanoseconds(top[i].latencies[MMIOTraceWrite], &writeTime);
+		const ppair<const char *, uint64_t> values[] {
+			{"address", top[i].key - 1},
+			{"reads", top[i].counts[MMIOTraceRead]},
+			{"writes", top[i].counts[MMIOTraceWrite]},
+			{"read-time-ns", readTime},
+			{"write-time-ns", writeTime},
+		};
+		for (auto &value : values) {
+			auto number = OSNumber::withNumber(value.second, 64);
+			if (number) {
+				dict->setObject(value.first, number);
+				number->release();
+			}
+		}
+		
+		summary->setObject(dict);
+		dict->release();
+	}
+	
+	auto entry = IORegistryEntry::fromPath("IOService:/IOResources/WhateverGreen");
+	if (entry) {
+		entry->setProperty("igfx-mmio-stats", summary);
+		entry->setProperty("igfx-mmio-stats-dropped", __atomic_load_n(&self->dropped, __ATOMIC_RELAXED), 64);
+		entry->release();
+	}
+	
+	summary->release();
+}
+
 // MARK: - MMIO Registers Read Support
 
 void IGFX::MMIORegistersReadSupport::init() {
@@ -430,9 +778,10 @@ void IGFX::MMIORegistersReadSupport::init() {
 }
 
 void IGFX::MMIORegistersReadSupport::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
-	// Enable the verbose output if the boot argument is found
-	verbose = checkKernelArgument("-igfxvamregs");
-	enabled |= verbose;
+	// Record register accesses if the trace buffer or the statistics are enabled
+	verbose = callbackIGFX->modMMIORegistersTraceSupport.enabled;
+	counting = callbackIGFX->modMMIORegistersStatisticsSupport.enabled;
+	enabled |= verbose || counting;
 	
 	// Enable if at least one active submodule relies on this shared module
 	for (auto submodule : callbackIGFX->submodules)
@@ -443,32 +792,14 @@ void IGFX::MMIORegistersReadSupport::processKernel(KernelPatcher &patcher, Devic
 }
 
 void IGFX::MMIORegistersReadSupport::processFramebufferKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
-	// Symbol Table:
-	// IVB*: "__ZN25AppleIntelCapriController14ReadRegister32Em"
-	// HSW*: "__ZN24AppleIntelAzulController14ReadRegister32Em"
-	// BDW*: "__ZNK22AppleIntelFBController14ReadRegister32Em"
-	// SKL+: "__ZN31AppleIntelFramebufferController14ReadRegister32Em"
-	const char* symbol = nullptr;
-	
-	auto framebuffer = Value::of(callbackIGFX->getRealFramebuffer(index));
-	if (framebuffer.isOneOf(&kextIntelCapriFb)) {
-		symbol = "__ZN25AppleIntelCapriController14ReadRegister32Em";
-		DBGLOG("igfx", "RRS: Will setup the read register module for IVB platform.");
-	} else if (framebuffer.isOneOf(&kextIntelAzulFb)) {
-		symbol = "__ZN24AppleIntelAzulController14ReadRegister32Em";
-		DBGLOG("igfx", "RRS: Will setup the read register module for HSW platform.");
-	} else if (framebuffer.isOneOf(&kextIntelBDWFb)) {
-		symbol = "__ZNK22AppleIntelFBController14ReadRegister32Em";
-		DBGLOG("igfx", "RRS: Will setup the read register module for BDW platform.");
-	} else if (framebuffer.isOneOf(&kextIntelSKLFb, &kextIntelKBLFb, &kextIntelCFLFb, &kextIntelICLLPFb)) {
-		symbol = "__ZN31AppleIntelFramebufferController14ReadRegister32Em";
-		DBGLOG("igfx", "RRS: Will setup the read register module for SKL/KBL/CFL/ICL platform.");
-	} else {
+	auto platform = getFramebufferPlatform(callbackIGFX->getRealFramebuffer(index));
+	if (!platform || !platform->readRegister32) {
 		SYSLOG("igfx", "RRS: Found an unsupported platform. Will disable all submodules that depend on RRS.");
 		return disableDependentSubmodules();
 	}
-	
-	KernelPatcher::RouteRequest request(symbol, wrapReadRegister32, orgReadRegister32);
+
+	DBGLOG("igfx", "RRS: Will setup the read register module for %s platform.", platform->name);
+	KernelPatcher::RouteRequest request(platform->readRegister32, wrapReadRegister32, orgReadRegister32);
 	if (!patcher.routeMultiple(index, &request, 1, address, size)) {
 		SYSLOG("igfx", "RRS: Failed to resolve the symbol of ReadRegister32. Will disable all submodules that rely on this one.");
 		disableDependentSubmodules();
@@ -481,28 +812,48 @@ void IGFX::MMIORegistersReadSupport::disableDependentSubmodules() {
 			submodule->enabled = false;
 }
 
+uint32_t IGFX::MMIORegistersReadSupport::invokeOriginal(void *controller, uint32_t address) {
+	uint32_t retVal;
+	if (UNLIKELY(counting)) {
+		auto start = mach_absolute_time();
+		retVal = orgReadRegister32(controller, address);
+		callbackIGFX->modMMIORegistersStatisticsSupport.count(address, MMIOTraceRead, mach_absolute_time() - start);
+	} else {
+		retVal = orgReadRegister32(controller, address);
+	}
+	
+	if (verbose)
+		callbackIGFX->modMMIORegistersTraceSupport.record(controller, address, retVal, MMIOTraceRead);
+	return retVal;
+}
+
 uint32_t IGFX::MMIORegistersReadSupport::wrapReadRegister32(void *controller, uint32_t address) {
+	auto &self = callbackIGFX->modMMIORegistersReadSupport;
+	
+	// Guard: Fast path for registers that are not monitored
+	MMIOReadPrologue::Injector prologueInjector {nullptr};
+	MMIOReadReplacer::Injector replacerInjector {nullptr};
+	MMIOReadEpilogue::Injector epilogueInjector {nullptr};
+	if (LIKELY(!self.lookup(address, prologueInjector, replacerInjector, epilogueInjector))) {
+		return self.invokeOriginal(controller, address);
+	}
+	
 	// Guard: Perform prologue injections
-	auto prologueInjector = callbackIGFX->modMMIORegistersReadSupport.prologueList.getInjector(address);
 	if (prologueInjector) {
 		DBGLOG("igfx", "RRS: Found a prologue injector triggered by the register address 0x%x.", address);
 		prologueInjector(controller, address);
 	}
 	
 	// Guard: Perform replacer injections
-	auto replacerInjector = callbackIGFX->modMMIORegistersReadSupport.replacerList.getInjector(address);
 	if (replacerInjector) {
 		DBGLOG("igfx", "RRS: Found a replacer injector triggered by the register value 0x%x.", address);
 		return replacerInjector(controller, address);
 	}
 	
 	// Invoke the original function
-	uint32_t retVal = callbackIGFX->modMMIORegistersReadSupport.orgReadRegister32(controller, address);
-	if (callbackIGFX->modMMIORegistersReadSupport.verbose)
-		DBGLOG("igfx", "RRS: Read MMIO Register = 0x%x; Value = 0x%x.", address, retVal);
+	uint32_t retVal = self.invokeOriginal(controller, address);
 	
 	// Guard: Perform epilogue injections
-	auto epilogueInjector = callbackIGFX->modMMIORegistersReadSupport.epilogueList.getInjector(address);
 	if (epilogueInjector) {
 		DBGLOG("igfx", "RRS: Found a epilogue injector triggered by the register value 0x%x.", address);
 		return epilogueInjector(controller, address, retVal);
@@ -520,9 +871,10 @@ void IGFX::MMIORegistersWriteSupport::init() {
 }
 
 void IGFX::MMIORegistersWriteSupport::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
-	// Enable the verbose output if the boot argument is found
-	verbose = checkKernelArgument("-igfxvamregs");
-	enabled |= verbose;
+	// Record register accesses if the trace buffer or the statistics are enabled
+	verbose = callbackIGFX->modMMIORegistersTraceSupport.enabled;
+	counting = callbackIGFX->modMMIORegistersStatisticsSupport.enabled;
+	enabled |= verbose || counting;
 	
 	// Enable if at least one active submodule relies on this shared module
 	for (auto submodule : callbackIGFX->submodules)
@@ -533,32 +885,14 @@ void IGFX::MMIORegistersWriteSupport::processKernel(KernelPatcher &patcher, Devi
 }
 
 void IGFX::MMIORegistersWriteSupport::processFramebufferKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
-	// Symbol Table:
-	// IVB*: "__ZN25AppleIntelCapriController15WriteRegister32Emj"
-	// HSW*: "__ZN24AppleIntelAzulController15WriteRegister32Emj"
-	// BDW*: "__ZN22AppleIntelFBController15WriteRegister32Emj"
-	// SKL+: "__ZN31AppleIntelFramebufferController15WriteRegister32Emj"
-	const char* symbol = nullptr;
-	
-	auto framebuffer = Value::of(callbackIGFX->getRealFramebuffer(index));
-	if (framebuffer.isOneOf(&kextIntelCapriFb)) {
-		symbol = "__ZN25AppleIntelCapriController15WriteRegister32Emj";
-		DBGLOG("igfx", "RWS: Will setup the read register module for IVB platform.");
-	} else if (framebuffer.isOneOf(&kextIntelAzulFb)) {
-		symbol = "__ZN24AppleIntelAzulController15WriteRegister32Emj";
-		DBGLOG("igfx", "RWS: Will setup the read register module for HSW platform.");
-	} else if (framebuffer.isOneOf(&kextIntelBDWFb)) {
-		symbol = "__ZN22AppleIntelFBController15WriteRegister32Emj";
-		DBGLOG("igfx", "RWS: Will setup the read register module for BDW platform.");
-	} else if (framebuffer.isOneOf(&kextIntelSKLFb, &kextIntelKBLFb, &kextIntelCFLFb, &kextIntelICLLPFb)) {
-		symbol = "__ZN31AppleIntelFramebufferController15WriteRegister32Emj";
-		DBGLOG("igfx", "RWS: Will setup the read register module for SKL/KBL/CFL/ICL platform.");
-	} else {
+	auto platform = getFramebufferPlatform(callbackIGFX->getRealFramebuffer(index));
+	if (!platform || !platform->writeRegister32) {
 		SYSLOG("igfx", "RWS: Found an unsupported platform. Will disable all submodules that depend on RWS.");
 		return disableDependentSubmodules();
 	}
-	
-	KernelPatcher::RouteRequest request(symbol, wrapWriteRegister32, orgWriteRegister32);
+
+	DBGLOG("igfx", "RWS: Will setup the write register module for %s platform.", platform->name);
+	KernelPatcher::RouteRequest request(platform->writeRegister32, wrapWriteRegister32, orgWriteRegister32);
 	if (!patcher.routeMultiple(index, &request, 1, address, size)) {
 		SYSLOG("igfx", "RWS: Failed to resolve the symbol of WriteRegister32. Will disable all submodules that rely on this one.");
 		disableDependentSubmodules();
@@ -571,28 +905,47 @@ void IGFX::MMIORegistersWriteSupport::disableDependentSubmodules() {
 			submodule->enabled = false;
 }
 
+void IGFX::MMIORegistersWriteSupport::invokeOriginal(void *controller, uint32_t address, uint32_t value) {
+	if (UNLIKELY(counting)) {
+		auto start = mach_absolute_time();
+		orgWriteRegister32(controller, address, value);
+		callbackIGFX->modMMIORegistersStatisticsSupport.count(address, MMIOTraceWrite, mach_absolute_time() - start);
+	} else {
+		orgWriteRegister32(controller, address, value);
+	}
+	
+	if (verbose)
+		callbackIGFX->modMMIORegistersTraceSupport.record(controller, address, value, MMIOTraceWrite);
+}
+
 void IGFX::MMIORegistersWriteSupport::wrapWriteRegister32(void *controller, uint32_t address, uint32_t value) {
+	auto &self = callbackIGFX->modMMIORegistersWriteSupport;
+	
+	// Guard: Fast path for registers that are not monitored
+	MMIOWriteInjectionDescriptor::Injector prologueInjector {nullptr};
+	MMIOWriteInjectionDescriptor::Injector replacerInjector {nullptr};
+	MMIOWriteInjectionDescriptor::Injector epilogueInjector {nullptr};
+	if (LIKELY(!self.lookup(address, prologueInjector, replacerInjector, epilogueInjector))) {
+		self.invokeOriginal(controller, address, value);
+		return;
+	}
+	
 	// Guard: Perform prologue injections
-	auto prologueInjector = callbackIGFX->modMMIORegistersWriteSupport.prologueList.getInjector(address);
 	if (prologueInjector) {
 		DBGLOG("igfx", "RWS: Found a prologue injector triggered by the register address 0x%x.", address);
 		prologueInjector(controller, address, value);
 	}
 	
 	// Guard: Perform replacer injections
-	auto replacerInjector = callbackIGFX->modMMIORegistersWriteSupport.replacerList.getInjector(address);
 	if (replacerInjector) {
 		DBGLOG("igfx", "RWS: Found a replacer injector triggered by the register value 0x%x.", address);
 		return replacerInjector(controller, address, value);
 	}
 	
 	// Invoke the original function
-	callbackIGFX->modMMIORegistersWriteSupport.orgWriteRegister32(controller, address, value);
-	if (callbackIGFX->modMMIORegistersWriteSupport.verbose)
-		DBGLOG("igfx", "RWS: Write MMIO Register = 0x%x; Value = 0x%x.", address, value);
+	self.invokeOriginal(controller, address, value);
 	
 	// Guard: Perform epilogue injections
-	auto epilogueInjector = callbackIGFX->modMMIORegistersWriteSupport.epilogueList.getInjector(address);
 	if (epilogueInjector) {
 		DBGLOG("igfx", "RWS: Found a epilogue injector triggered by the register value 0x%x.", address);
 		return epilogueInjector(controller, address, value);
@@ -639,8 +992,7 @@ void IGFX::ForceCompleteModeset::processFramebufferKext(KernelPatcher &patcher,
 		orgHwRegsNeedUpdate
 	};
 	
-	if (!patcher.routeMultiple(index, &request, 1, address, size))
-		SYSLOG("igfx", "FCM: Failed to route the function hwRegsNeedUpdate.");
+	callbackIGFX->routeBatch.add(request, "FCM: Failed to route the function hwRegsNeedUpdate.");
 }
 
 bool IGFX::ForceCompleteModeset::wrapHwRegsNeedUpdate(void *controller, IORegistryEntry *framebuffer, void *displayPath, void *crtParams, void *detailedInfo) {
@@ -714,8 +1066,7 @@ void IGFX::ForceOnlineDisplay::processFramebufferKext(KernelPatcher &patcher, si
 		orgGetDisplayStatus
 	};
 	
-	if (!patcher.routeMultiple(index, &request, 1, address, size))
-		SYSLOG("igfx", "FOD: Failed to route the function getDisplayStatus.");
+	callbackIGFX->routeBatch.add(request, "FOD: Failed to route the function getDisplayStatus.");
 }
 
 uint32_t IGFX::ForceOnlineDisplay::wrapGetDisplayStatus(IORegistryEntry *framebuffer, void *displayPath) {
@@ -752,8 +1103,7 @@ void IGFX::AGDCDisabler::processFramebufferKext(KernelPatcher &patcher, size_t i
 		orgFBClientDoAttribute
 	};
 	
-	if (!patcher.routeMultiple(index, &request, 1, address, size))
-		SYSLOG("igfx", "AGDCD: Failed to route the function FBClientControl::doAttribute.");
+	callbackIGFX->routeBatch.add(request, "AGDCD: Failed to route the function FBClientControl::doAttribute.");
 }
 
 IOReturn IGFX::AGDCDisabler::wrapFBClientDoAttribute(void *fbclient, uint32_t attribute, unsigned long *unk1, unsigned long unk2, unsigned long *unk3, unsigned long *unk4, void *externalMethodArguments) {
@@ -782,8 +1132,7 @@ void IGFX::TypeCCheckDisabler::processFramebufferKext(KernelPatcher &patcher, si
 			"__ZN31AppleIntelFramebufferController17IsTypeCOnlySystemEv",
 			wrapIsTypeCOnlySystem
 		};
-		if (!patcher.routeMultiple(index, &request, 1, address, size))
-			SYSLOG("igfx", "TCCD: Failed to route the function IsTypeCOnlySystem.");
+		callbackIGFX->routeBatch.add(request, "TCCD: Failed to route the function IsTypeCOnlySystem.");
 	}
 }
 
@@ -908,8 +1257,7 @@ void IGFX::PAVPDisabler::processGraphicsKext(KernelPatcher &patcher, size_t inde
 		orgPavpSessionCallback
 	};
 	
-	if (!patcher.routeMultiple(index, &request, 1, address, size))
-		SYSLOG("igfx", "PAVP: Failed to route the function PAVPCommandCallback.");
+	callbackIGFX->routeBatch.add(request, "PAVP: Failed to route the function PAVPCommandCallback.");
 }
 
 IOReturn IGFX::PAVPDisabler::wrapPavpSessionCallback(void *intelAccelerator, int32_t sessionCommand, uint32_t sessionAppId, uint32_t *a4, bool flag) {
@@ -941,8 +1289,7 @@ void IGFX::ReadDescriptorPatch::processGraphicsKext(KernelPatcher &patcher, size
 		globalPageTableRead
 	};
 	
-	if (!patcher.routeMultiple(index, &request, 1, address, size))
-		SYSLOG("igfx", "RDP: Failed to route the function IGHardwareGlobalPageTable::read.");
+	callbackIGFX->routeBatch.add(request, "RDP: Failed to route the function IGHardwareGlobalPageTable::read.");
 }
 
 bool IGFX::ReadDescriptorPatch::globalPageTableRead(void *hardwareGlobalPageTable, uint64_t address, uint64_t &physAddress, uint64_t &flags) {
@@ -1140,6 +1487,8 @@ bool IGFX::wrapAcceleratorStart(IOService *that, IOService *provider) {
 	if (callbackIGFX->disableAccel)
 		return false;
 	
+	auto wrapperStart = BootProfile::start();
+	
 	if (!applyDevelopmentPatches(that))
 		SYSLOG("igfx", "failed to apply dict Development patches");
 
@@ -1162,7 +1511,9 @@ bool IGFX::wrapAcceleratorStart(IOService *that, IOService *provider) {
 		SYSLOG("igfx", "failed to apply patches for Skylake with KBL kexts");
 	}
 
+	auto start = BootProfile::start();
 	bool ret = FunctionCast(wrapAcceleratorStart, callbackIGFX->orgAcceleratorStart)(that, provider);
+	BootProfile::stop("IGFX::orgAcceleratorStart", start);
 
 	if (metalPluginName) {
 		if (callbackIGFX->forceMetal) {
@@ -1171,6 +1522,10 @@ bool IGFX::wrapAcceleratorStart(IOService *that, IOService *provider) {
 		}
 		metalPluginName->release();
 	}
+	
+	// The wrapper time includes the original function, subtract orgAcceleratorStart to get the time spent in WhateverGreen
+	BootProfile::stop("IGFX::wrapAcceleratorStart", wrapperStart);
+	BootProfile::schedulePublish();
 
 	return ret;
 }
@@ -1215,7 +1570,8 @@ bool IGFX::wrapLoadGuCBinary(void *that, bool flag) {
 	DBGLOG("igfx", "attempting to load firmware for %d scheduler for cpu gen %d",
 		   callbackIGFX->fwLoadMode, BaseDeviceInfo::get().cpuGeneration);
 
-	if (callbackIGFX->firmwareSizePointer)
+	// The firmware is only decompressed when it is about to be uploaded for the first time and is kept for wake
+	if (callbackIGFX->firmwareSizePointer && callbackIGFX->prepareGuCFirmware())
 		callbackIGFX->performingFirmwareLoad = true;
 
 	r = FunctionCast(wrapLoadGuCBinary, callbackIGFX->orgLoadGuCBinary)(that, flag);
@@ -1226,6 +1582,60 @@ bool IGFX::wrapLoadGuCBinary(void *that, bool flag) {
 	return r;
 }
 
+bool IGFX::prepareGuCFirmware() {
+	if (decompressedFirmware)
+		return true;
+
+	const uint8_t *fw = GuCFirmwareKBL;
+	const uint8_t *fwdigest = GuCFirmwareKBLDigest;
+	size_t fwcompsize = GuCFirmwareKBLCompressedSize;
+	size_t fwsize = GuCFirmwareKBLSize;
+
+	if (BaseDeviceInfo::get().cpuGeneration == CPUInfo::CpuGeneration::Skylake) {
+		fw = GuCFirmwareSKL;
+		fwdigest = GuCFirmwareSKLDigest;
+		fwcompsize = GuCFirmwareSKLCompressedSize;
+		fwsize = GuCFirmwareSKLSize;
+	}
+
+	auto fullsize = static_cast<uint32_t>(fwsize + GuCFirmwareSignatureSize);
+	auto buffer = Buffer::create<uint8_t>(fullsize);
+	if (!buffer) {
+		SYSLOG("igfx", "failed to allocate %u bytes for GuC firmware", fullsize);
+		return false;
+	}
+
+	if (!Compression::decompress(Compression::ModeLZSS, fullsize, fw, static_cast<uint32_t>(fwcompsize), buffer)) {
+		SYSLOG("igfx", "failed to decompress GuC firmware");
+		Buffer::deleter(buffer);
+		return false;
+	}
+
+	// The RSA signature itself is checked by GuC boot ROM, make sure it gets the image we shipped
+	auto digest = Crypto::hash(buffer, fullsize);
+	bool valid = digest && memcmp(digest, fwdigest, GuCFirmwareDigestSize) == 0;
+	if (digest)
+		Buffer::deleter(digest);
+	if (!valid) {
+		SYSLOG("igfx", "GuC firmware digest mismatch, keeping the original firmware");
+		Buffer::deleter(buffer);
+		return false;
+	}
+
+	DBGLOG("igfx", "prepared GuC firmware of %lu bytes from %lu bytes", fwsize, fwcompsize);
+	decompressedFirmware = buffer;
+	decompressedFirmwareSize = fwsize;
+	return true;
+}
+
+void IGFX::releaseGuCFirmware() {
+	if (decompressedFirmware) {
+		Buffer::deleter(decompressedFirmware);
+		decompressedFirmware = nullptr;
+		decompressedFirmwareSize = 0;
+	}
+}
+
 bool IGFX::wrapLoadFirmware(IOService *that) {
 	DBGLOG("igfx", "load firmware setting sleep overrides %d", BaseDeviceInfo::get().cpuGeneration);
 
@@ -1253,7 +1663,45 @@ void IGFX::wrapSystemDidWake(IOService *that) {
 		GuC = nullptr;
 	}
 
+	auto start = mach_absolute_time();
 	FunctionCast(wrapLoadFirmware, callbackIGFX->orgLoadFirmware)(that);
+	callbackIGFX->publishGuCWakeTime(mach_absolute_time() - start);
+}
+
+void IGFX::publishGuCWakeTime(uint64_t elapsed) {
+	uint64_t ns;
+	absolutetime_to_nanoseconds(elapsed, &ns);
+	gucWakeCount++;
+	gucWakeTotal += ns;
+	if (ns > gucWakeMax)
+		gucWakeMax = ns;
+	DBGLOG("igfx", "GuC firmware reloaded on wake in %llu ns", ns);
+
+	auto dict = OSDictionary::withCapacity(4);
+	if (dict == nullptr)
+		return;
+
+	const ppair<const char *, uint64_t> values[] {
+		{"count", gucWakeCount},
+		{"last-ns", ns},
+		{"max-ns", gucWakeMax},
+		{"total-ns", gucWakeTotal},
+	};
+	for (auto &value : values) {
+		auto number = OSNumber::withNumber(value.second, 64);
+		if (number) {
+			dict->setObject(value.first, number);
+			number->release();
+		}
+	}
+
+	auto entry = IORegistryEntry::fromPath("IOService:/IOResources/WhateverGreen");
+	if (entry) {
+		entry->setProperty("igfx-guc-wake", dict);
+		entry->release();
+	}
+
+	dict->release();
 }
 
 bool IGFX::wrapInitSchedControl(void *that, void *ctrl) {
@@ -1282,51 +1730,45 @@ bool IGFX::wrapInitSchedControl(void *that, void *ctrl) {
 }
 
 void *IGFX::wrapIgBufferWithOptions(void *accelTask, unsigned long size, unsigned int type, unsigned int flags) {
-	auto cpuGeneration = BaseDeviceInfo::get().cpuGeneration;
 	void *r = nullptr;
 
 	if (callbackIGFX->performingFirmwareLoad) {
 		// Allocate a dummy buffer
 		callbackIGFX->dummyFirmwareBuffer = Buffer::create<uint8_t>(size);
 		// Select the latest firmware to upload
-		DBGLOG("igfx", "preparing firmware for cpu gen %d with range 0x%lX", cpuGeneration, size);
-
-		const void *fw = nullptr;
-		const void *fwsig = nullptr;
-		size_t fwsize = 0;
-		size_t fwsigsize = 0;
-
-		if (cpuGeneration == CPUInfo::CpuGeneration::Skylake) {
-			fw = GuCFirmwareSKL;
-			fwsig = GuCFirmwareSKLSignature;
-			fwsize = GuCFirmwareSKLSize;
-			fwsigsize = GuCFirmwareSignatureSize;
-		} else {
-			fw = GuCFirmwareKBL;
-			fwsig = GuCFirmwareKBLSignature;
-			fwsize = GuCFirmwareKBLSize;
-			fwsigsize = GuCFirmwareSignatureSize;
-		}
+		DBGLOG("igfx", "preparing firmware for cpu gen %d with range 0x%lX", BaseDeviceInfo::get().cpuGeneration, size);
+
+		// Decompressed and verified by wrapLoadGuCBinary
+		const uint8_t *fw = callbackIGFX->decompressedFirmware;
+		size_t fwsize = callbackIGFX->decompressedFirmwareSize;
+		const uint8_t *fwsig = fw + fwsize;
+		size_t fwsigsize = GuCFirmwareSignatureSize;
 
 		// Allocate enough memory for the new firmware (should be 64K-aligned)
 		unsigned long newsize = fwsize > size ? ((fwsize + 0xFFFF) & (~0xFFFF)) : size;
 		r = FunctionCast(wrapIgBufferWithOptions, callbackIGFX->orgIgBufferWithOptions)(accelTask, newsize, type, flags);
 		// Replace the real buffer with a dummy buffer
 		if (r && callbackIGFX->dummyFirmwareBuffer) {
-			// Copy firmware contents, update the sizes and signature
-			auto status = MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock);
-			if (status == KERN_SUCCESS) {
+			// The signature and the size live in the driver and survive sleep, so they are only updated on the first load
+			if (!callbackIGFX->firmwareSignaturePatched) {
+				auto status = MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock);
+				if (status == KERN_SUCCESS) {
+					lilu_os_memcpy(callbackIGFX->signaturePointer, fwsig, fwsigsize);
+					// Update the firmware size for IGScheduler4
+					*callbackIGFX->firmwareSizePointer = static_cast<uint32_t>(fwsize);
+					MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
+					callbackIGFX->firmwareSignaturePatched = true;
+				} else {
+					SYSLOG("igfx", "ig buffer protection upgrade failure %d", status);
+				}
+			}
+
+			if (callbackIGFX->firmwareSignaturePatched) {
 				// Upload the firmware ourselves
 				callbackIGFX->realFirmwareBuffer = static_cast<uint8_t **>(r)[7];
 				static_cast<uint8_t **>(r)[7] = callbackIGFX->dummyFirmwareBuffer;
 				lilu_os_memcpy(callbackIGFX->realFirmwareBuffer, fw, fwsize);
-				lilu_os_memcpy(callbackIGFX->signaturePointer, fwsig, fwsigsize);
 				callbackIGFX->realBinarySize = static_cast<uint32_t>(fwsize);
-				// Update the firmware size for IGScheduler4
-				*callbackIGFX->firmwareSizePointer = static_cast<uint32_t>(fwsize);
-				MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
-			} else {
-				SYSLOG("igfx", "ig buffer protection upgrade failure %d", status);
 			}
 		} else if (callbackIGFX->dummyFirmwareBuffer) {
 			SYSLOG("igfx", "ig shared buffer allocation failure");
@@ -1582,9 +2024,28 @@ bool IGFX::loadPatchesFromDevice(IORegistryEntry *igpu, uint32_t currentFramebuf
 	return hasFramebufferPatch;
 }
 
-uint8_t *IGFX::findFramebufferId(uint32_t framebufferId, uint8_t *startingAddress, size_t maxSize) {
+template <typename T>
+void IGFX::indexPlatformInformationList() {
+	switch (platformInformationIndex.build(static_cast<T *>(gPlatformInformationList), framebufferStart + framebufferSize)) {
+		case PlatformInformationIndex::Status::Indexed:
+			DBGLOG("igfx", "indexed %lu platform information entries of %lu bytes", platformInformationIndex.size(), sizeof(T));
+			break;
+		case PlatformInformationIndex::Status::TooManyEntries:
+			SYSLOG("igfx", "platform information list exceeds %lu entries, not indexing", PlatformInformationIndex::MaxEntries);
+			break;
+		case PlatformInformationIndex::Status::NoTerminator:
+			SYSLOG("igfx", "platform information list terminator is not found, not indexing");
+			break;
+	}
+}
+
+uint8_t *IGFX::findFramebufferId(uint32_t framebufferId) {
+	if (platformInformationIndex.size() > 0)
+		return platformInformationIndex.find(framebufferId);
+
+	uint8_t *startingAddress = static_cast<uint8_t *>(gPlatformInformationList);
 	uint32_t *startAddress = reinterpret_cast<uint32_t *>(startingAddress);
-	uint32_t *endAddress = reinterpret_cast<uint32_t *>(startingAddress + maxSize);
+	uint32_t *endAddress = reinterpret_cast<uint32_t *>(startingAddress + PAGE_SIZE);
 	while (startAddress < endAddress) {
 		if (*startAddress == framebufferId)
 			return reinterpret_cast<uint8_t *>(startAddress);
@@ -1675,7 +2136,8 @@ bool IGFX::setDictUInt32(OSDictionary *dict, const char *key, UInt32 value) {
 }
 
 template <>
-bool IGFX::applyPlatformInformationListPatch(uint32_t framebufferId, FramebufferSNB *platformInformationList) {
+bool IGFX::applyPlatformInformationListPatch<FramebufferSNB>(uint32_t framebufferId) {
+	auto platformInformationList = static_cast<FramebufferSNB *>(gPlatformInformationList);
 	bool framebufferFound = false;
 
 	for (size_t i = 0; i < SandyPlatformNum; i++) {
@@ -1763,8 +2225,9 @@ void IGFX::applyPlatformInformationPatchEx(T *frame) {
 }
 
 template <typename T>
-bool IGFX::applyPlatformInformationListPatch(uint32_t framebufferId, T *platformInformationList) {
-	auto frame = reinterpret_cast<T *>(findFramebufferId(framebufferId, reinterpret_cast<uint8_t *>(platformInformationList), PAGE_SIZE));
+bool IGFX::applyPlatformInformationListPatch(uint32_t framebufferId) {
+	auto platformInformationList = static_cast<T *>(gPlatformInformationList);
+	auto frame = reinterpret_cast<T *>(findFramebufferId(framebufferId));
 	if (!frame)
 		return false;
 
@@ -1833,7 +2296,8 @@ bool IGFX::applyPlatformInformationListPatch(uint32_t framebufferId, T *platform
 }
 
 template <>
-bool IGFX::applyDPtoHDMIPatch(uint32_t framebufferId, FramebufferSNB *platformInformationList) {
+bool IGFX::applyDPtoHDMIPatch<FramebufferSNB>(uint32_t framebufferId) {
+	auto platformInformationList = static_cast<FramebufferSNB *>(gPlatformInformationList);
 	bool found = false;
 
 	for (size_t i = 0; i < SandyPlatformNum; i++) {
@@ -1855,8 +2319,9 @@ bool IGFX::applyDPtoHDMIPatch(uint32_t framebufferId, FramebufferSNB *platformIn
 }
 
 template <typename T>
-bool IGFX::applyDPtoHDMIPatch(uint32_t framebufferId, T *platformInformationList) {
-	auto frame = reinterpret_cast<T *>(findFramebufferId(framebufferId, reinterpret_cast<uint8_t *>(platformInformationList), PAGE_SIZE));
+bool IGFX::applyDPtoHDMIPatch(uint32_t framebufferId) {
+	auto platformInformationList = static_cast<T *>(gPlatformInformationList);
+	auto frame = reinterpret_cast<T *>(findFramebufferId(framebufferId));
 	if (!frame)
 		return false;
 
@@ -1875,38 +2340,67 @@ bool IGFX::applyDPtoHDMIPatch(uint32_t framebufferId, T *platformInformationList
 	return found;
 }
 
+const IGFX::FramebufferPlatform IGFX::framebufferPlatforms[] {
+	{&kextIntelHDFb, "Westmere", nullptr, "__ZN22AppleIntelHDGraphicsFB16getOSInformationEv",
+		nullptr, nullptr, nullptr, nullptr, nullptr},
+	{&kextIntelSNBFb, "SNB", "_PlatformInformationList", "__ZN23AppleIntelSNBGraphicsFB16getOSInformationEv",
+		nullptr, nullptr, nullptr,
+		&IGFX::applyPlatformInformationListPatch<FramebufferSNB>, &IGFX::applyDPtoHDMIPatch<FramebufferSNB>},
+	{&kextIntelCapriFb, "IVB", "_gPlatformInformationList", "__ZN25AppleIntelCapriController16getOSInformationEv",
+		"__ZN25AppleIntelCapriController14ReadRegister32Em", "__ZN25AppleIntelCapriController15WriteRegister32Emj",
+		&IGFX::indexPlatformInformationList<FramebufferIVB>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferIVB>, &IGFX::applyDPtoHDMIPatch<FramebufferIVB>},
+	{&kextIntelAzulFb, "HSW", "_gPlatformInformationList", "__ZN24AppleIntelAzulController16getOSInformationEv",
+		"__ZN24AppleIntelAzulController14ReadRegister32Em", "__ZN24AppleIntelAzulController15WriteRegister32Emj",
+		&IGFX::indexPlatformInformationList<FramebufferHSW>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferHSW>, &IGFX::applyDPtoHDMIPatch<FramebufferHSW>},
+	{&kextIntelBDWFb, "BDW", "_gPlatformInformationList", "__ZN22AppleIntelFBController16getOSInformationEv",
+		"__ZNK22AppleIntelFBController14ReadRegister32Em", "__ZN22AppleIntelFBController15WriteRegister32Emj",
+		&IGFX::indexPlatformInformationList<FramebufferBDW>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferBDW>, &IGFX::applyDPtoHDMIPatch<FramebufferBDW>},
+	{&kextIntelSKLFb, "SKL", "_gPlatformInformationList", "__ZN31AppleIntelFramebufferController16getOSInformationEv",
+		"__ZN31AppleIntelFramebufferController14ReadRegister32Em", "__ZN31AppleIntelFramebufferController15WriteRegister32Emj",
+		&IGFX::indexPlatformInformationList<FramebufferSKL>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferSKL>, &IGFX::applyDPtoHDMIPatch<FramebufferSKL>},
+	{&kextIntelKBLFb, "KBL", "_gPlatformInformationList", "__ZN31AppleIntelFramebufferController16getOSInformationEv",
+		"__ZN31AppleIntelFramebufferController14ReadRegister32Em", "__ZN31AppleIntelFramebufferController15WriteRegister32Emj",
+		&IGFX::indexPlatformInformationList<FramebufferSKL>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferSKL>, &IGFX::applyDPtoHDMIPatch<FramebufferSKL>},
+	{&kextIntelCFLFb, "CFL", "_gPlatformInformationList", "__ZN31AppleIntelFramebufferController16getOSInformationEv",
+		"__ZN31AppleIntelFramebufferController14ReadRegister32Em", "__ZN31AppleIntelFramebufferController15WriteRegister32Emj",
+		&IGFX::indexPlatformInformationList<FramebufferCFL>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferCFL>, &IGFX::applyDPtoHDMIPatch<FramebufferCFL>},
+	{&kextIntelCNLFb, "CNL", "_gPlatformInformationList", "__ZN31AppleIntelFramebufferController16getOSInformationEv",
+		nullptr, nullptr,
+		&IGFX::indexPlatformInformationList<FramebufferCNL>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferCNL>, &IGFX::applyDPtoHDMIPatch<FramebufferCNL>},
+	{&kextIntelICLLPFb, "ICL LP", "_gPlatformInformationList", "__ZN31AppleIntelFramebufferController16getOSInformationEv",
+		"__ZN31AppleIntelFramebufferController14ReadRegister32Em", "__ZN31AppleIntelFramebufferController15WriteRegister32Emj",
+		&IGFX::indexPlatformInformationList<FramebufferICLLP>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferICLLP>, &IGFX::applyDPtoHDMIPatch<FramebufferICLLP>},
+	{&kextIntelICLHPFb, "ICL HP", "_gPlatformInformationList", "__ZN31AppleIntelFramebufferController16getOSInformationEv",
+		nullptr, nullptr,
+		&IGFX::indexPlatformInformationList<FramebufferICLHP>,
+		&IGFX::applyPlatformInformationListPatch<FramebufferICLHP>, &IGFX::applyDPtoHDMIPatch<FramebufferICLHP>},
+};
+
+const size_t IGFX::framebufferPlatformCount = arrsize(IGFX::framebufferPlatforms);
+
+const IGFX::FramebufferPlatform *IGFX::getFramebufferPlatform(KernelPatcher::KextInfo *kext) {
+	for (size_t i = 0; i < framebufferPlatformCount; i++)
+		if (framebufferPlatforms[i].kext == kext)
+			return &framebufferPlatforms[i];
+	return nullptr;
+}
+
 void IGFX::applyFramebufferPatches() {
-	auto cpuGeneration = BaseDeviceInfo::get().cpuGeneration;
 	uint32_t framebufferId = framebufferPatch.framebufferId;
 
 	// Not tested prior to 10.10.5, and definitely different on 10.9.5 at least.
 	if (getKernelVersion() >= KernelVersion::Yosemite) {
 		bool success = false;
-		if (cpuGeneration == CPUInfo::CpuGeneration::SandyBridge)
-			success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferSNB *>(gPlatformInformationList));
-		else if (cpuGeneration == CPUInfo::CpuGeneration::IvyBridge)
-			success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferIVB *>(gPlatformInformationList));
-		else if (cpuGeneration == CPUInfo::CpuGeneration::Haswell)
-			success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferHSW *>(gPlatformInformationList));
-		else if (cpuGeneration == CPUInfo::CpuGeneration::Broadwell)
-			success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferBDW *>(gPlatformInformationList));
-		else if (cpuGeneration == CPUInfo::CpuGeneration::Skylake || cpuGeneration == CPUInfo::CpuGeneration::KabyLake ||
-				 (cpuGeneration == CPUInfo::CpuGeneration::CoffeeLake && static_cast<FramebufferSKL *>(gPlatformInformationList)->framebufferId == 0x591E0000))
-			//FIXME: write this in a nicer way (coffee pretending to be Kaby, detecting via first kaby frame)
-			success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferSKL *>(gPlatformInformationList));
-		else if (cpuGeneration == CPUInfo::CpuGeneration::CoffeeLake)
-			success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferCFL *>(gPlatformInformationList));
-		else if (cpuGeneration == CPUInfo::CpuGeneration::CometLake)
-			success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferCFL *>(gPlatformInformationList));
-		else if (cpuGeneration == CPUInfo::CpuGeneration::CannonLake)
-			success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferCNL *>(gPlatformInformationList));
-		else if (cpuGeneration == CPUInfo::CpuGeneration::IceLake) {
-			// FIXME: Need to address possible circumstance of both ICL kexts loaded at the same time
-			if (callbackIGFX->currentFramebuffer->loadIndex != KernelPatcher::KextInfo::Unloaded)
-				success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferICLLP *>(gPlatformInformationList));
-			else if (callbackIGFX->currentFramebufferOpt->loadIndex != KernelPatcher::KextInfo::Unloaded)
-				success = applyPlatformInformationListPatch(framebufferId, static_cast<FramebufferICLHP *>(gPlatformInformationList));
-		}
+		if (framebufferPlatform && framebufferPlatform->applyPlatformInformationListPatch)
+			success = (this->*framebufferPlatform->applyPlatformInformationListPatch)(framebufferId);
 
 		if (success)
 			DBGLOG("igfx", "patching framebufferId 0x%08X successful", framebufferId);
@@ -1914,15 +2408,36 @@ void IGFX::applyFramebufferPatches() {
 			DBGLOG("igfx", "patching framebufferId 0x%08X failed", framebufferId);
 	}
 
-	uint8_t *platformInformationAddress = findFramebufferId(framebufferId, static_cast<uint8_t *>(gPlatformInformationList), PAGE_SIZE);
+	// All patches are matched within a page from their framebuffer entry, so one scan over the platform
+	// table up to a page past its last entry is enough to apply every patch.
+	// Without the index entries are only searched for in the first page of the table.
+	auto tableStart = static_cast<uint8_t *>(gPlatformInformationList);
+	if (tableStart < framebufferStart)
+		tableStart = framebufferStart;
+	auto tableEnd = framebufferStart + framebufferSize;
+	if (tableStart >= tableEnd)
+		return;
+	auto lastEntry = platformInformationIndex.size() > 0 ? platformInformationIndex.last() : tableStart + PAGE_SIZE;
+	if (lastEntry < tableStart)
+		lastEntry = tableStart;
+	if (lastEntry < tableEnd && static_cast<size_t>(tableEnd - lastEntry) > PAGE_SIZE)
+		tableEnd = lastEntry + PAGE_SIZE;
+
+	uint32_t attempted = 0, applied = 0;
+	uint8_t *platformInformationAddress = findFramebufferId(framebufferId);
 	if (platformInformationAddress) {
+		MultiPatternPatcher<MaxFramebufferPatchCount> patcher;
+		int patternIndices[MaxFramebufferPatchCount];
+		bool ordered = false;
+
 		for (size_t i = 0; i < MaxFramebufferPatchCount; i++) {
+			patternIndices[i] = -1;
 			if (!framebufferPatches[i].find || !framebufferPatches[i].replace)
 				continue;
 
-			if (framebufferPatches[i].framebufferId != framebufferId)    {
+			if (framebufferPatches[i].framebufferId != framebufferId) {
 				framebufferId = framebufferPatches[i].framebufferId;
-				platformInformationAddress = findFramebufferId(framebufferId, static_cast<uint8_t *>(gPlatformInformationList), PAGE_SIZE);
+				platformInformationAddress = findFramebufferId(framebufferId);
 			}
 
 			if (!platformInformationAddress) {
@@ -1930,29 +2445,83 @@ void IGFX::applyFramebufferPatches() {
 				continue;
 			}
 
-			if (framebufferPatches[i].find->getLength() != framebufferPatches[i].replace->getLength()) {
+			auto size = framebufferPatches[i].find->getLength();
+			if (size != framebufferPatches[i].replace->getLength()) {
 				DBGLOG("igfx", "patch %lu framebufferId 0x%08X length mistmatch", i, framebufferId);
 				continue;
 			}
 
-			KernelPatcher::LookupPatch patch {};
-			patch.kext = currentFramebuffer;
-			patch.find = static_cast<const uint8_t *>(framebufferPatches[i].find->getBytesNoCopy());
-			patch.replace = static_cast<const uint8_t *>(framebufferPatches[i].replace->getBytesNoCopy());
-			patch.size = framebufferPatches[i].find->getLength();
-			patch.count = framebufferPatches[i].count;
+			// Same window as a linear search of a page starting at the framebuffer entry
+			auto from = platformInformationAddress > tableStart ? static_cast<size_t>(platformInformationAddress - tableStart) : 0;
+			auto end = platformInformationAddress + PAGE_SIZE - size;
+			auto to = end > tableStart ? static_cast<size_t>((end < tableEnd ? end : tableEnd) - tableStart) : 0;
+			patternIndices[i] = patcher.add(framebufferPatches[i].find->getBytesNoCopy(), size,
+											framebufferPatches[i].replace->getBytesNoCopy(), size,
+											framebufferPatches[i].count, from, to);
+			attempted |= 1U << i;
+			if (patternIndices[i] < 0)
+				ordered = true;
+		}
 
-			if (applyPatch(patch, platformInformationAddress, PAGE_SIZE))
-				DBGLOG("igfx", "patch %lu framebufferId 0x%08X successful", i, framebufferId);
-			else
-				DBGLOG("igfx", "patch %lu framebufferId 0x%08X failed", i, framebufferId);
+		// Without the index entries are searched for in the patched table, and were looked up before anything
+		// was patched, so patches must not be able to change framebuffer ids.
+		framebufferId = framebufferPatch.framebufferId;
+		if (platformInformationIndex.size() == 0)
+			ordered = ordered || patcher.touches(&framebufferId, sizeof(framebufferId));
+		for (size_t i = 0; i < MaxFramebufferPatchCount && platformInformationIndex.size() == 0 && !ordered; i++) {
+			if (attempted & (1U << i))
+				ordered = patcher.touches(&framebufferPatches[i].framebufferId, sizeof(framebufferPatches[i].framebufferId));
+		}
+
+		if (!ordered && patcher.independent()) {
+			uint32_t matched = patcher.apply(tableStart, static_cast<size_t>(tableEnd - tableStart));
+			for (size_t i = 0; i < MaxFramebufferPatchCount; i++) {
+				if (patternIndices[i] >= 0 && (matched & (1U << patternIndices[i])))
+					applied |= 1U << i;
+			}
+		} else {
+			// Patches depend on each other, apply them one by one like consecutive searches would.
+			DBGLOG("igfx", "framebuffer patches overlap, applying them in order");
+			attempted = 0;
+			platformInformationAddress = findFramebufferId(framebufferId);
+			for (size_t i = 0; i < MaxFramebufferPatchCount && platformInformationAddress; i++) {
+				if (!framebufferPatches[i].find || !framebufferPatches[i].replace ||
+					framebufferPatches[i].find->getLength() != framebufferPatches[i].replace->getLength())
+					continue;
+
+				if (framebufferPatches[i].framebufferId != framebufferId) {
+					framebufferId = framebufferPatches[i].framebufferId;
+					platformInformationAddress = findFramebufferId(framebufferId);
+				}
+
+				if (!platformInformationAddress)
+					continue;
+
+				KernelPatcher::LookupPatch patch {};
+				patch.kext = currentFramebuffer;
+				patch.find = static_cast<const uint8_t *>(framebufferPatches[i].find->getBytesNoCopy());
+				patch.replace = static_cast<const uint8_t *>(framebufferPatches[i].replace->getBytesNoCopy());
+				patch.size = framebufferPatches[i].find->getLength();
+				patch.count = framebufferPatches[i].count;
 
-			framebufferPatches[i].find->release();
-			framebufferPatches[i].find = nullptr;
-			framebufferPatches[i].replace->release();
-			framebufferPatches[i].replace = nullptr;
+				attempted |= 1U << i;
+				if (applyPatch(patch, platformInformationAddress, PAGE_SIZE))
+					applied |= 1U << i;
+			}
 		}
 	}
+
+	for (size_t i = 0; i < MaxFramebufferPatchCount; i++) {
+		if (attempted & (1U << i)) {
+			if (applied & (1U << i))
+				DBGLOG("igfx", "patch %lu framebufferId 0x%08X successful", i, framebufferPatches[i].framebufferId);
+			else
+				DBGLOG("igfx", "patch %lu framebufferId 0x%08X failed", i, framebufferPatches[i].framebufferId);
+		}
+
+		OSSafeReleaseNULL(framebufferPatches[i].find);
+		OSSafeReleaseNULL(framebufferPatches[i].replace);
+	}
 }
 
 void IGFX::applyHdmiAutopatch() {
@@ -1962,30 +2531,8 @@ void IGFX::applyHdmiAutopatch() {
 	DBGLOG("igfx", "applyHdmiAutopatch framebufferId %X cpugen %X", framebufferId, cpuGeneration);
 
 	bool success = false;
-	if (cpuGeneration == CPUInfo::CpuGeneration::SandyBridge)
-		success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferSNB *>(gPlatformInformationList));
-	else if (cpuGeneration == CPUInfo::CpuGeneration::IvyBridge)
-		success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferIVB *>(gPlatformInformationList));
-	else if (cpuGeneration == CPUInfo::CpuGeneration::Haswell)
-		success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferHSW *>(gPlatformInformationList));
-	else if (cpuGeneration == CPUInfo::CpuGeneration::Broadwell)
-		success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferBDW *>(gPlatformInformationList));
-	else if (cpuGeneration == CPUInfo::CpuGeneration::Skylake || cpuGeneration == CPUInfo::CpuGeneration::KabyLake ||
-			 (cpuGeneration == CPUInfo::CpuGeneration::CoffeeLake && static_cast<FramebufferSKL *>(gPlatformInformationList)->framebufferId == 0x591E0000))
-		success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferSKL *>(gPlatformInformationList));
-	else if (cpuGeneration == CPUInfo::CpuGeneration::CoffeeLake)
-		success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferCFL *>(gPlatformInformationList));
-	else if (cpuGeneration == CPUInfo::CpuGeneration::CometLake)
-		success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferCFL *>(gPlatformInformationList));
-	else if (cpuGeneration == CPUInfo::CpuGeneration::CannonLake)
-		success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferCNL *>(gPlatformInformationList));
-	else if (cpuGeneration == CPUInfo::CpuGeneration::IceLake) {
-		// FIXME: Need to address possible circumstance of both ICL kexts loaded at the same time
-		if (callbackIGFX->currentFramebuffer->loadIndex != KernelPatcher::KextInfo::Unloaded)
-			success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferICLLP *>(gPlatformInformationList));
-		else if (callbackIGFX->currentFramebufferOpt->loadIndex != KernelPatcher::KextInfo::Unloaded)
-			success = applyDPtoHDMIPatch(framebufferId, static_cast<FramebufferICLHP *>(gPlatformInformationList));
-	}
+	if (framebufferPlatform && framebufferPlatform->applyDPtoHDMIPatch)
+		success = (this->*framebufferPlatform->applyDPtoHDMIPatch)(framebufferId);
 
 	if (success)
 		DBGLOG("igfx", "hdmi patching framebufferId 0x%08X successful", framebufferId);
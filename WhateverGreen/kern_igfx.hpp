@@ -9,8 +9,15 @@
 #define kern_igfx_hpp
 
 #include "kern_fb.hpp"
+#include "kern_fb_index.hpp"
 #include "kern_igfx_lspcon.hpp"
 #include "kern_igfx_backlight.hpp"
+#include "kern_igfx_inject.hpp"
+#include "kern_insn.hpp"
+#include "kern_pattern.hpp"
+#include "kern_poll.hpp"
+#include "kern_profile.hpp"
+#include "kern_rps.hpp"
 
 #include <Headers/kern_patcher.hpp>
 #include <Headers/kern_devinfo.hpp>
@@ -18,6 +25,7 @@
 #include <Headers/kern_disasm.hpp>
 #include <IOKit/IOService.h>
 #include <IOKit/IOLocks.h>
+#include <kern/thread_call.h>
 
 class IGFX {
 public:
@@ -210,6 +218,77 @@ private:
 	 */
 	bool gPlatformListIsSNB {false};
 
+	/**
+	 *  Framebuffer kext layout description
+	 */
+	struct FramebufferPlatform {
+		/**
+		 *  Framebuffer kext
+		 */
+		KernelPatcher::KextInfo *kext;
+
+		/**
+		 *  Platform name for logging
+		 */
+		const char *name;
+
+		/**
+		 *  Platform information list symbol or nullptr
+		 */
+		const char *platformInformationList;
+
+		/**
+		 *  Framebuffer controller getOSInformation symbol
+		 */
+		const char *getOSInformation;
+
+		/**
+		 *  Framebuffer controller ReadRegister32 and WriteRegister32 symbols or nullptr if unsupported
+		 */
+		const char *readRegister32;
+		const char *writeRegister32;
+
+		/**
+		 *  Platform information list indexer specialised for the kext entry type or nullptr if the list has no ids
+		 */
+		void (IGFX::*indexPlatformInformationList)();
+
+		/**
+		 *  Platform information list patchers specialised for the kext entry type or nullptr
+		 */
+		bool (IGFX::*applyPlatformInformationListPatch)(uint32_t framebufferId);
+		bool (IGFX::*applyDPtoHDMIPatch)(uint32_t framebufferId);
+	};
+
+	/**
+	 *  Known framebuffer kexts, a new generation only needs a new entry here
+	 */
+	static const FramebufferPlatform framebufferPlatforms[];
+
+	/**
+	 *  Amount of known framebuffer kexts
+	 */
+	static const size_t framebufferPlatformCount;
+
+	/**
+	 *  Description of the framebuffer kext the platform information list comes from
+	 */
+	const FramebufferPlatform *framebufferPlatform {nullptr};
+
+	/**
+	 *  Find the description of a framebuffer kext
+	 *
+	 *  @param kext  Framebuffer kext
+	 *
+	 *  @return framebuffer kext description or nullptr if unsupported
+	 */
+	static const FramebufferPlatform *getFramebufferPlatform(KernelPatcher::KextInfo *kext);
+
+	/**
+	 *  Platform information entries sorted by framebuffer id, empty if the list is not indexed
+	 */
+	PlatformInformationIndex platformInformationIndex;
+
 	/**
 	 *  IGPU support
 	 */
@@ -346,144 +425,9 @@ private:
 	}
 	
 	//
-	// MARK: - Patch Submodule & Injection Kits
+	// MARK: - Patch Submodule
 	//
 	
-	/**
-	 *  Describes how to inject code into a shared submodule
-	 *
-	 *  @tparam T Specify the type of the trigger
-	 *  @tparam I Specify the type of the function to inject code
-	 *  @example The trigger type can be an integer type to inject code based on a register address.
-	 */
-	template <typename T, typename I>
-	struct InjectionDescriptor {
-		/**
-		 *  The trigger value to be monitored by the coordinator
-		 */
-		T trigger {};
-
-		/**
-		 *  A function to invoke when the trigger value is observed
-		 *
-		 *  @example One may monitor a specific register address and modify its value in the injector function.
-		 */
-		I injector {};
-
-		/**
-		 *  A pointer to the next descriptor in a linked list
-		 */
-		InjectionDescriptor *next {nullptr};
-
-		/**
-		 *  Create an injection descriptor conveniently
-		 */
-		InjectionDescriptor(T t, I i) :
-			trigger(t), injector(i), next(nullptr) { }
-		
-		/**
-		 *  Member type `Trigger` is required by the coordinator
-		 */
-		using Trigger = T;
-		
-		/**
-		 *  Member type `Injector` is required by the coordinator
-		 */
-		using Injector = I;
-	};
-	
-	/**
-	 *  Represents a list of injection descriptors
-	 *
-	 *  @tparam D Specify the concrete type of the descriptor
-	 */
-	template <typename D>
-	struct InjectionDescriptorList {
-	private:
-		/**
-		 *  Head of the list
-		 */
-		D *head {nullptr};
-		
-		/**
-		 *  Tail of the list
-		 */
-		D *tail {nullptr};
-		
-	public:
-		/**
-		 *  Get the injector function associated with the given trigger
-		 *
-		 *  @param trigger The trigger value
-		 *  @return The injector function on success, `nullptr` if the given trigger is not in the list.
-		 */
-		typename D::Injector getInjector(typename D::Trigger trigger) {
-			for (auto current = head; current != nullptr; current = current->next)
-				if (current->trigger == trigger)
-					return current->injector;
-			
-			return nullptr;
-		}
-		
-		/**
-		 *  Add an injection descriptor to the list
-		 *
-		 *  @param descriptor A non-null descriptor that specifies the trigger and the injector function
-		 *  @warning Patch developers must ensure that triggers are unique.
-		 *           The coordinator registers injections on a first come, first served basis.
-		 *           i.e. The latter descriptor will NOT overwrite the injection function of the existing one.
-		 *  @note This function assumes that the trigger value of the given descriptor has not been registered yet.
-		 */
-		void add(D *descriptor NONNULL) {
-			// Sanitize garbage value
-			descriptor->next = nullptr;
-			
-			// Append the new descriptor
-			if (head == nullptr)
-				// Empty list
-				head = descriptor;
-			else
-				// Non-empty list
-				tail->next = descriptor;
-			
-			// Update the tail
-			tail = descriptor;
-		}
-	};
-	
-	/**
-	 *  An injection coordinator is capable of coordinating multiple requests of injection to a shared function
-	 *
-	 *  @tparam P Specify the type of the prologue injection descriptor that defines how the coordinator injects code before it calls the original function
-	 *  @tparam R Specify the type of the replacer injection descriptor that defines how the coordinator replaces the original function implementation
-	 *  @tparam E Specify the type of the epilogue injection descriptor that defines how the coordinator injects code after it calls the original function
-	 *  @note Patch submodules inherited from this class get coordination support automatically.
-	 *  @note Patch submodules invoke the `add()` method of a list to register injections.
-	 */
-	template <typename P, typename R, typename E>
-	class InjectionCoordinator {
-	public:
-		/**
-		 *  Virtual destructor
-		 */
-		virtual ~InjectionCoordinator() = default;
-		
-		/**
-		 *  A list of prologue injection descriptors
-		 */
-		InjectionDescriptorList<P> prologueList {};
-		
-		/**
-		 *  A list of replacer injection descriptors
-		 */
-		InjectionDescriptorList<R> replacerList {};
-		
-		/**
-		 *  A list of epilogue injection descriptors
-		 */
-		InjectionDescriptorList<E> epilogueList {};
-	};
-	
 	/**
 	 *  Interface of a submodule to fix Intel graphics drivers
 	 */
@@ -571,6 +515,76 @@ private:
 		virtual void disableDependentSubmodules() {}
 	};
 	
+	/**
+	 *  A batch of function routes collected from submodules while a kext is being processed
+	 *
+	 *  @note Submodules whose routes are independent of each other add them to the batch instead of routing them one by one,
+	 *        so that the main module installs all of them with a single `routeMultiple()` call once every submodule is processed.
+	 */
+	class RouteBatch {
+		/**
+		 *  Maximum number of pending routes, the batch is flushed early when it is full
+		 */
+		static constexpr size_t kMaxRequests = 16;
+		
+		/**
+		 *  Pending route requests
+		 */
+		alignas(KernelPatcher::RouteRequest) uint8_t storage[kMaxRequests * sizeof(KernelPatcher::RouteRequest)];
+		
+		/**
+		 *  Messages to be printed if the corresponding request fails
+		 */
+		const char *failureMessages[kMaxRequests] {};
+		
+		/**
+		 *  The number of pending route requests
+		 */
+		size_t count {0};
+		
+		/**
+		 *  The kext being processed
+		 */
+		KernelPatcher *patcher {nullptr};
+		size_t index {0};
+		mach_vm_address_t address {0};
+		size_t size {0};
+		
+		/**
+		 *  Get pending route requests
+		 */
+		KernelPatcher::RouteRequest *requests() { return reinterpret_cast<KernelPatcher::RouteRequest *>(storage); }
+		
+	public:
+		/**
+		 *  Start collecting route requests for the given kext
+		 *
+		 *  @param patcher KernelPatcher instance
+		 *  @param index   kinfo handle
+		 *  @param address kinfo load address
+		 *  @param size    kinfo memory size
+		 */
+		void begin(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size);
+		
+		/**
+		 *  Add a route request to the batch
+		 *
+		 *  @param request        A route request, copied into the batch
+		 *  @param failureMessage A message to be printed if the function cannot be routed
+		 *  @note Requests added outside of `begin()` and `flush()` are rejected.
+		 */
+		void add(const KernelPatcher::RouteRequest &request, const char *failureMessage);
+		
+		/**
+		 *  Route all pending requests and stop collecting
+		 *
+		 *  @note Symbols are resolved individually first, so that a missing symbol only fails its own request.
+		 *        This takes as many symbol table walks as routing the requests one by one, the batch only saves
+		 *        the per-call routing overhead. See `RouteWalk` tool for the walk cost.
+		 */
+		void flush();
+	} routeBatch;
+	
 	//
 	// MARK: - Shared Submodules
 	//
@@ -597,6 +611,227 @@ private:
 		void disableDependentSubmodules() override;
 	} modFramebufferControllerAccessSupport;
 	
+	/**
+	 *  A record of a single MMIO register access in the trace buffer
+	 *
+	 *  @note This layout is shared with the `MMIOTrace` decoder tool.
+	 */
+	struct PACKED MMIOTraceRecord {
+		/**
+		 *  Sequence number of the record starting at 1, 0 for empty records
+		 */
+		uint64_t sequence;
+		
+		/**
+		 *  Time of the access in nanoseconds
+		 */
+		uint64_t timestamp;
+		
+		/**
+		 *  The framebuffer controller
+		 */
+		uint64_t controller;
+		
+		/**
+		 *  The register address
+		 */
+		uint32_t address;
+		
+		/**
+		 *  The register value
+		 */
+		uint32_t value;
+		
+		/**
+		 *  Direction of the access
+		 */
+		uint32_t direction;
+		
+		/**
+		 *  Reserved for future use
+		 */
+		uint32_t reserved;
+	};
+	
+	/**
+	 *  Direction of a traced MMIO register access
+	 */
+	enum MMIOTraceDirection : uint32_t {
+		MMIOTraceRead = 0,
+		MMIOTraceWrite = 1,
+	};
+	
+	/**
+	 *  A submodule that records MMIO register accesses to a lock-free ring buffer published in ioreg
+	 *
+	 *  @note Enabled by the `-igfxvamregs` boot argument.
+	 *  @note Records are published in batches as `igfx-mmio-trace` at `IOService:/IOResources/WhateverGreen`.
+	 */
+	class MMIORegistersTraceSupport: public PatchSubmodule {
+		/**
+		 *  The number of records in the ring buffer, must be a power of two
+		 */
+		static constexpr size_t kCapacity = 4096;
+		
+		/**
+		 *  The number of new records that triggers publishing the buffer
+		 */
+		static constexpr size_t kBatchSize = 512;
+		
+		/**
+		 *  The maximum number of address ranges to trace
+		 */
+		static constexpr size_t kMaxRanges = 8;
+		
+		/**
+		 *  The ring buffer
+		 */
+		MMIOTraceRecord *records {nullptr};
+		
+		/**
+		 *  The number of records ever appended
+		 */
+		uint64_t head {0};
+		
+		/**
+		 *  Inclusive address ranges to trace specified by the `mmio-trace-ranges` property, all addresses if empty
+		 */
+		ppair<uint32_t, uint32_t> ranges[kMaxRanges] {};
+		
+		/**
+		 *  The number of address ranges to trace
+		 */
+		size_t rangeCount {0};
+		
+		/**
+		 *  A thread call that publishes the buffer outside of the register access context
+		 */
+		thread_call_t publisher {nullptr};
+		
+		/**
+		 *  Publish the content of the ring buffer to ioreg
+		 *
+		 *  @param param0 The submodule instance
+		 *  @param param1 Unused
+		 */
+		static void publish(thread_call_param_t param0, thread_call_param_t param1);
+		
+	public:
+		/**
+		 *  Append an access record to the ring buffer
+		 *
+		 *  @param controller The framebuffer controller
+		 *  @param address The register address
+		 *  @param value The register value
+		 *  @param direction The direction of the access
+		 *  @note This function does not block and can be used in any context.
+		 */
+		void record(void *controller, uint32_t address, uint32_t value, MMIOTraceDirection direction);
+		
+		// MARK: Patch Submodule IMP
+		void deinit() override;
+		void processKernel(KernelPatcher &patcher, DeviceInfo *info) override;
+	} modMMIORegistersTraceSupport;
+	
+	/**
+	 *  A submodule that counts MMIO register accesses and the time spent in the original functions per register
+	 *
+	 *  @note Enabled by the `-igfxmmiostats` boot argument.
+	 *  @note The most accessed registers are published periodically as `igfx-mmio-stats` at `IOService:/IOResources/WhateverGreen`.
+	 */
+	class MMIORegistersStatisticsSupport: public PatchSubmodule {
+		/**
+		 *  The number of registers in the table, must be a power of two
+		 */
+		static constexpr size_t kCapacity = 512;
+		
+		/**
+		 *  The number of registers in the published summary
+		 */
+		static constexpr size_t kTopCount = 16;
+		
+		/**
+		 *  The number of counted accesses that triggers publishing the summary
+		 */
+		static constexpr uint64_t kPublishInterval = 4096;
+		
+		/**
+		 *  Statistics of a single register
+		 */
+		struct Entry {
+			/**
+			 *  The register address plus one, 0 for empty entries
+			 */
+			uint32_t key;
+			
+			/**
+			 *  Reserved for alignment
+			 */
+			uint32_t reserved;
+			
+			/**
+			 *  The number of accesses indexed by `MMIOTraceDirection`
+			 */
+			uint64_t counts[2];
+			
+			/**
+			 *  The cumulative time spent in the original function in absolute time units indexed by `MMIOTraceDirection`
+			 */
+			uint64_t latencies[2];
+		};
+		
+		/**
+		 *  The open-addressed register table
+		 */
+		Entry *entries {nullptr};
+		
+		/**
+		 *  The number of counted accesses
+		 */
+		uint64_t total {0};
+		
+		/**
+		 *  The number of accesses not counted because the table is full
+		 */
+		uint64_t dropped {0};
+		
+		/**
+		 *  A thread call that publishes the summary outside of the register access context
+		 */
+		thread_call_t publisher {nullptr};
+		
+		/**
+		 *  Find or insert the table entry of the given register
+		 *
+		 *  @param address The register address
+		 *  @return The entry on success, `nullptr` if the table is full.
+		 */
+		Entry *getEntry(uint32_t address);
+		
+		/**
+		 *  Publish the summary of the most accessed registers to ioreg
+		 *
+		 *  @param param0 The submodule instance
+		 *  @param param1 Unused
+		 */
+		static void publish(thread_call_param_t param0, thread_call_param_t param1);
+		
+	public:
+		/**
+		 *  Count a register access
+		 *
+		 *  @param address The register address
+		 *  @param direction The direction of the access
+		 *  @param latency The time spent in the original function in absolute time units
+		 *  @note This function does not block and can be used in any context.
+		 */
+		void count(uint32_t address, MMIOTraceDirection direction, uint64_t latency);
+		
+		// MARK: Patch Submodule IMP
+		void deinit() override;
+		void processKernel(KernelPatcher &patcher, DeviceInfo *info) override;
+	} modMMIORegistersStatisticsSupport;
+	
 	/**
 	 *  Defines the prologue injection descriptor for `AppleIntelFramebufferController::ReadRegister32()`
 	 *
@@ -629,11 +864,26 @@ private:
 	 */
 	class MMIORegistersReadSupport: public PatchSubmodule, public InjectionCoordinator<MMIOReadPrologue, MMIOReadReplacer, MMIOReadEpilogue> {
 		/**
-		 *  Set to `true` to print detailed register access information
+		 *  Set to `true` to record register accesses in the trace buffer
 		 */
 		bool verbose {false};
 		
+		/**
+		 *  Set to `true` to count register accesses
+		 */
+		bool counting {false};
+		
 	public:
+		/**
+		 *  Invoke the original function and record the access if requested
+		 *
+		 *  @param controller The framebuffer controller instance
+		 *  @param address The register address
+		 *  @return The register value.
+		 *  @note Submodules reading registers on their own should use this function, so that their accesses are counted and traced.
+		 */
+		uint32_t invokeOriginal(void *controller, uint32_t address);
+		
 		/**
 		 *  Original AppleIntelFramebufferController::ReadRegister32 function
 		 *
@@ -667,16 +917,41 @@ private:
 	 */
 	using MMIOWriteInjectionDescriptor = InjectionDescriptor<uint32_t, void (*)(void *, uint32_t, uint32_t)>;
 	
+	/**
+	 *  Priority of MMIO injections registered by backlight registers fixes (BLR and BLT)
+	 */
+	static constexpr uint32_t kMMIOPriorityBacklightFix = 100;
+	
+	/**
+	 *  Priority of MMIO injections registered by the backlight smoother (BLS)
+	 */
+	static constexpr uint32_t kMMIOPriorityBacklightSmoother = 200;
+	
 	/**
 	 *  A submodule that provides write access to MMIO registers and coordinates injections to the write function
 	 */
 	class MMIORegistersWriteSupport: public PatchSubmodule, public InjectionCoordinator<MMIOWriteInjectionDescriptor, MMIOWriteInjectionDescriptor, MMIOWriteInjectionDescriptor> {
 		/**
-		 *  Set to `true` to print detailed register access information
+		 *  Set to `true` to record register accesses in the trace buffer
 		 */
 		bool verbose {false};
 		
+		/**
+		 *  Set to `true` to count register accesses
+		 */
+		bool counting {false};
+		
 	public:
+		/**
+		 *  Invoke the original function and record the access if requested
+		 *
+		 *  @param controller The framebuffer controller instance
+		 *  @param address The register address
+		 *  @param value The new register value
+		 *  @note Submodules writing registers on their own should use this function, so that their accesses are counted and traced.
+		 */
+		void invokeOriginal(void *controller, uint32_t address, uint32_t value);
+		
 		/**
 		 *  Original AppleIntelFramebufferController::WriteRegister32 function
 		 *
@@ -694,6 +969,23 @@ private:
 		 */
 		static void wrapWriteRegister32(void *controller, uint32_t address, uint32_t value);
 		
+		/**
+		 *  Pass the write request through to the next replacer in the chain
+		 *
+		 *  @param controller The framebuffer controller instance
+		 *  @param address The register address
+		 *  @param value The new register value
+		 *  @param priority The priority of the calling replacer
+		 *  @note The original function is invoked if there is no replacer after the calling one.
+		 */
+		void passThrough(void *controller, uint32_t address, uint32_t value, uint32_t priority) {
+			auto replacer = replacerList.getInjector(address, priority);
+			if (replacer)
+				replacer(controller, address, value);
+			else
+				invokeOriginal(controller, address, value);
+		}
+		
 		// MARK: Patch Submodule IMP
 		void init() override;
 		void processKernel(KernelPatcher &patcher, DeviceInfo *info) override;
@@ -714,9 +1006,10 @@ private:
 	 *  @param controller The framebuffer controller instance
 	 *  @param address The register address
 	 *  @return The register value.
+	 *  @note The access is counted and traced like the ones made by the framebuffer, but skips the injected code.
 	 */
 	uint32_t readRegister32(void *controller, uint32_t address) {
-		return modMMIORegistersReadSupport.orgReadRegister32(controller, address);
+		return modMMIORegistersReadSupport.invokeOriginal(controller, address);
 	}
 	
 	/**
@@ -725,9 +1018,10 @@ private:
 	 *  @param controller The framebuffer controller instance
 	 *  @param address The register address
 	 *  @param value The new register value
+	 *  @note The access is counted and traced like the ones made by the framebuffer, but skips the injected code.
 	 */
 	void writeRegister32(void *controller, uint32_t address, uint32_t value) {
-		modMMIORegistersWriteSupport.orgWriteRegister32(controller, address, value);
+		modMMIORegistersWriteSupport.invokeOriginal(controller, address, value);
 	}
 	
 	//
@@ -1281,10 +1575,59 @@ private:
 	
 	/**
 	 *  A submodule that patches RPS control for all command streamers
+	 *
+	 *  @note The maximum frequency is requested by default. With the `rps-governor` IGPU property the frequency
+	 *        follows the GPU utilization derived from RC6 residency instead, see `RPSGovernor`. Bursty loads
+	 *        may miss frames at the default `rps-governor-down-hold`, see `RPSGovernor::Config::downHold`.
 	 */
 	class RPSControlPatch: public PatchSubmodule {
+		/**
+		 *  The minimum interval between two governor updates in milliseconds
+		 */
+		static constexpr uint32_t kGovernorInterval = 10;
+
 		uint32_t freq_max {0};
-		bool patchRCSCheck(mach_vm_address_t& start);
+
+		/**
+		 *  True if the frequency is picked by the governor
+		 */
+		bool governorEnabled {false};
+
+		/**
+		 *  Utilization governor, configured once the frequency limits are read from the hardware
+		 */
+		RPSGovernor governor;
+
+		/**
+		 *  User tunables of the governor, frequency limits are in MHz and 0 stands for the hardware limit
+		 */
+		RPSGovernor::Config governorConfig;
+
+		/**
+		 *  Time of the last governor update in absolute time units
+		 */
+		uint64_t governorSampleTime {0};
+
+		/**
+		 *  RC6 residency counter value at the last governor update
+		 */
+		uint32_t governorSampleIdle {0};
+
+		/**
+		 *  Pick the frequency to request with the utilization governor
+		 *
+		 *  @param controller The default framebuffer controller
+		 *  @return The frequency in the units of `GEN6_RP_STATE_CAP`.
+		 */
+		uint32_t updateGovernor(void *controller);
+
+		/**
+		 *  Remove the RCS streamer check from `submitExecList()`
+		 *
+		 *  @param start The address of `submitExecList()`
+		 *  @return `true` if the conditional jump has been replaced with nops.
+		 */
+		bool patchRCSCheck(mach_vm_address_t start);
 		int (*orgPmNotifyWrapper)(unsigned int, unsigned int, unsigned long long *, unsigned int *) {nullptr};
 		static int wrapPmNotifyWrapper(unsigned int, unsigned int, unsigned long long *, unsigned int *);
 		
@@ -1303,15 +1646,72 @@ private:
 	
 	/**
 	 *  A submodule that fixes the kernel panic due to a rare force wake timeout on KBL and CFL platforms.
+	 *
+	 *  @note Acknowledgement latencies are published periodically as `igfx-forcewake-ack` at `IOService:/IOResources/WhateverGreen`.
 	 */
 	class ForceWakeWorkaround: public PatchSubmodule {
+		/**
+		 *  The number of force wake domains, i.e. render, media and blitter
+		 */
+		static constexpr size_t kDomainCount = 3;
+
+		/**
+		 *  The number of log2 latency buckets, the last one also counts anything longer
+		 */
+		static constexpr size_t kHistogramBuckets = 20;
+
+		/**
+		 *  The number of acknowledgements that triggers publishing the histograms
+		 */
+		static constexpr uint64_t kPublishInterval = 1024;
+
+		/**
+		 *  Acknowledgement latency histograms per domain, bucket `i > 0` counts latencies in [2^(i-1), 2^i) microseconds
+		 */
+		uint64_t ackHistogram[kDomainCount][kHistogramBuckets] {};
+
+		/**
+		 *  The number of acknowledgements that needed the fallback per domain
+		 */
+		uint64_t ackFallbacks[kDomainCount] {};
+
+		/**
+		 *  The number of recorded acknowledgements
+		 */
+		uint64_t ackTotal {0};
+
+		/**
+		 *  A thread call that publishes the histograms outside of the force wake context
+		 */
+		thread_call_t publisher {nullptr};
+
 		static bool pollRegister(uint32_t, uint32_t, uint32_t, uint32_t);
 		static bool forceWakeWaitAckFallback(uint32_t, uint32_t, uint32_t);
 		static void forceWake(void *, uint8_t set, uint32_t dom, uint32_t);
-		
+
+		/**
+		 *  Record the acknowledgement latency of a force wake domain
+		 *
+		 *  @param domain The domain index
+		 *  @param latency The time from the force wake request to the acknowledgement in absolute time units
+		 *  @param fallback Whether the acknowledgement needed the fallback
+		 *  @note This function does not block and can be used in any context.
+		 */
+		void recordAck(size_t domain, uint64_t latency, bool fallback);
+
+		/**
+		 *  Publish the acknowledgement latency histograms to ioreg
+		 *
+		 *  @param param0 The submodule instance
+		 *  @param param1 Unused
+		 */
+		static void publish(thread_call_param_t param0, thread_call_param_t param1);
+
 	public:
 		// MARK: Patch Submodule IMP
 		void init() override;
+		void deinit() override;
+		void processKernel(KernelPatcher &patcher, DeviceInfo *info) override;
 		void processGraphicsKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) override;
 	} modForceWakeWorkaround;
 	
@@ -1577,22 +1977,22 @@ private:
 		/**
 		 *  [KBL ] A replacer descriptor that injects code when the register of interest is BXT_BLC_PWM_FREQ1
 		 */
-		MMIOWriteInjectionDescriptor dKBLPWMFreq1 {BXT_BLC_PWM_FREQ1, wrapKBLWriteRegisterPWMFreq1};
+		MMIOWriteInjectionDescriptor dKBLPWMFreq1 {BXT_BLC_PWM_FREQ1, wrapKBLWriteRegisterPWMFreq1, kMMIOPriorityBacklightFix};
 		
 		/**
 		 *  [KBL ] A replacer descriptor that injects code when the register of interest is BXT_BLC_PWM_CTL1
 		 */
-		MMIOWriteInjectionDescriptor dKBLPWMCtrl1 {BXT_BLC_PWM_CTL1 , wrapKBLWriteRegisterPWMCtrl1};
+		MMIOWriteInjectionDescriptor dKBLPWMCtrl1 {BXT_BLC_PWM_CTL1 , wrapKBLWriteRegisterPWMCtrl1, kMMIOPriorityBacklightFix};
 		
 		/**
 		 *  [CFL+] A replacer descriptor that injects code when the register of interest is BXT_BLC_PWM_FREQ1
 		 */
-		MMIOWriteInjectionDescriptor dCFLPWMFreq1 {BXT_BLC_PWM_FREQ1, wrapCFLWriteRegisterPWMFreq1};
+		MMIOWriteInjectionDescriptor dCFLPWMFreq1 {BXT_BLC_PWM_FREQ1, wrapCFLWriteRegisterPWMFreq1, kMMIOPriorityBacklightFix};
 		
 		/**
 		 *  [CFL+] A replacer descriptor that injects code when the register of interest is BXT_BLC_PWM_DUTY1
 		 */
-		MMIOWriteInjectionDescriptor dCFLPWMDuty1 {BXT_BLC_PWM_DUTY1, wrapCFLWriteRegisterPWMDuty1};
+		MMIOWriteInjectionDescriptor dCFLPWMDuty1 {BXT_BLC_PWM_DUTY1, wrapCFLWriteRegisterPWMDuty1, kMMIOPriorityBacklightFix};
 		
 	public:
 		// MARK: Patch Submodule IMP
@@ -1767,72 +2167,70 @@ private:
 		struct Patterns {
 			// Pattern: movq %rdi, %r??
 			// Checks: MOV, 64-bit, Direct Mode, Source Register is %rdi
-			static bool movqArg0(const Disassembler::hde_t &handle) {
-				return handle.opcode == 0x89 && handle.rex_w == 1 && handle.modrm_mod == 3 && (handle.rex_r << 3 | handle.modrm_reg) == 7;
+			static constexpr InstructionPattern movqArg0() {
+				return InstructionPattern().opcode(0x89).rexW(1).mod(3).reg(7);
 			}
 			
 			// Pattern: movl %esi, %r??
 			// Checks: MOV, 32-bit, Direct Mode, Source Register is %esi
-			static bool movlArg1(const Disassembler::hde_t &handle) {
-				return handle.opcode == 0x89 && handle.rex_w == 0 && handle.modrm_mod == 3 && (handle.rex_r << 3 | handle.modrm_reg) == 6;
+			static constexpr InstructionPattern movlArg1() {
+				return InstructionPattern().opcode(0x89).rexW(0).mod(3).reg(6);
 			}
 			
 			// Pattern: movl <offset?>(%r<source>), %r??
 			// Checks: MOV, 32-bit, Memory Mode, Source register is identical to the given one
-			static bool movlFromMemory(const Disassembler::hde_t &handle, uint32_t source) {
-				return handle.opcode == 0x8B && handle.rex_w == 0 && handle.modrm_mod == 2 && (handle.rex_b << 3 | handle.modrm_rm) == source;
+			static constexpr InstructionPattern movlFromMemory(uint32_t source) {
+				return InstructionPattern().opcode(0x8B).rexW(0).mod(2).rm(source);
 			}
 
 			// Pattern: movl <offset>(%r??), %r??
 			// Checks: MOV, 32-bit, Memory Mode, The offset is identical to the given one
-			static bool movlFromMemoryWithOffset(const Disassembler::hde_t &handle, size_t offset) {
-				return handle.opcode == 0x8B && handle.rex_w == 0 && handle.modrm_mod == 2 && handle.disp.disp32 == offset;
+			static constexpr InstructionPattern movlFromMemoryWithOffset(size_t offset) {
+				return InstructionPattern().opcode(0x8B).rexW(0).mod(2).disp(static_cast<uint32_t>(offset));
 			}
 			
 			// Pattern: movl %r<source>, <offset?>(%r<destination>)
 			// Checks: MOV, 32-bit, Memory Mode,
 			//         Source register is identical to the given `source`,
 			//         Destination register is identical to the given `destination`
-			static bool movlToMemory(const Disassembler::hde_t &handle, uint32_t source, uint32_t destination) {
-				return handle.opcode == 0x89 && handle.rex_w == 0 && handle.modrm_mod == 2 &&
-				       (handle.rex_r << 3 | handle.modrm_reg) == source &&
-				       (handle.rex_b << 3 | handle.modrm_rm) == destination;
+			static constexpr InstructionPattern movlToMemory(uint32_t source, uint32_t destination) {
+				return InstructionPattern().opcode(0x89).rexW(0).mod(2).reg(source).rm(destination);
 			}
 
 			// Pattern: movl $??????????, <offset>(%r??)
 			// Checks: MOV, 32-bit, Memory Mode, The offset is identical to the given one
-			static bool movlImm32ToMemoryWithOffset(const Disassembler::hde_t &handle, size_t offset) {
-				return handle.opcode == 0xC7 && handle.rex_w == 0 && handle.modrm_mod == 2 && handle.disp.disp32 == offset;
+			static constexpr InstructionPattern movlImm32ToMemoryWithOffset(size_t offset) {
+				return InstructionPattern().opcode(0xC7).rexW(0).mod(2).disp(static_cast<uint32_t>(offset));
 			}
 
 			// Pattern: leal <offset>(%r??), %r??
 			// Checks: LEA, 32-bit, Memory Mode, The offset is identical to the given one
-			static bool lealWithOffset(const Disassembler::hde_t &handle, size_t offset) {
-				return handle.opcode == 0x8D && handle.rex_w == 0 && handle.modrm_mod == 2 && handle.disp.disp32 == offset;
+			static constexpr InstructionPattern lealWithOffset(size_t offset) {
+				return InstructionPattern().opcode(0x8D).rexW(0).mod(2).disp(static_cast<uint32_t>(offset));
 			}
 
 			// Pattern: addl $<imm32>, %r??
 			// Checks: ADD, 32-bit, Direct Mode, The immediate operand is identical to the given one
-			static bool addlWithImm32(const Disassembler::hde_t &handle, uint32_t imm32) {
-				return (handle.opcode == 0x05 || handle.opcode == 0x81) && handle.rex_w == 0 && handle.imm.imm32 == imm32;
+			static constexpr InstructionPattern addlWithImm32(uint32_t imm32) {
+				return InstructionPattern().opcode(0x05, 0x81).rexW(0).imm(imm32);
 			}
 
 			// Pattern: imull %r??, %r??
 			// Checks: IMUL, 32-bit, Direct Mode
-			static bool imull(const Disassembler::hde_t &handle) {
-				return handle.opcode == 0x0F && handle.opcode2 == 0xAF && handle.rex_w == 0 && handle.modrm_mod == 3;
+			static constexpr InstructionPattern imull() {
+				return InstructionPattern().opcode(0x0F).opcode2(0xAF).rexW(0).mod(3);
 			}
 
 			// Pattern: divl <offset?>(%r<source>)
 			// Checks: DIV, 32-bit, Memory Mode, The source register is identical to the given one
-			static bool divlByMemory(const Disassembler::hde_t &handle, uint32_t source) {
-				return handle.opcode == 0xF7 && handle.rex_w == 0 && handle.modrm_mod == 2 && (handle.rex_b << 3 | handle.modrm_rm) == source;
+			static constexpr InstructionPattern divlByMemory(uint32_t source) {
+				return InstructionPattern().opcode(0xF7).rexW(0).mod(2).rm(source);
 			}
 
 			// Pattern: divl <offset>(%r??)
-			// Checks: DIV, 32-bit, Memory Mode, The offset is identical to the given one
-			static bool divlByMemoryWithOffset(const Disassembler::hde_t &handle, size_t offset) {
-				return handle.opcode == 0xF7 && handle.rex_w == 0 && handle.modrm_mod == 2 && handle.disp.disp32 == offset;
+			// Checks: DIV, 32-bit, Memory Mode, The offset is identical to the given one
+			static constexpr InstructionPattern divlByMemoryWithOffset(size_t offset) {
+				return InstructionPattern().opcode(0xF7).rexW(0).mod(2).disp(static_cast<uint32_t>(offset));
 			}
 		};
 		
@@ -1917,15 +2315,9 @@ private:
 		 *  @note This function will pass the given value to the smoother if the user has enabled the BLS submodule.
 		 */
 		void writeDutyCycle(void *controller, uint32_t dutyCycle) const {
-			if (callbackIGFX->modBacklightSmoother.enabled) {
-				// Need to pass the scaled value to the smoother
-				DBGLOG("igfx", "BLS: [COMM] Will pass the new duty cycle value 0x%08x to the smoother version.", dutyCycle);
-				IGFX::BacklightSmoother::smoothCFLWriteRegisterPWMDuty1(controller, BXT_BLC_PWM_DUTY1, dutyCycle);
-			} else {
-				// Otherwise invoke the original function
-				DBGLOG("igfx", "BLT: [COMM] Will pass the new duty cycle value 0x%08x to the original version.", dutyCycle);
-				callbackIGFX->writeRegister32(controller, BXT_BLC_PWM_DUTY1, dutyCycle);
-			}
+			// Pass the value to the smoother if it is enabled, otherwise invoke the original function
+			DBGLOG("igfx", "BLT: [COMM] Will pass the new duty cycle value 0x%08x to the next writer.", dutyCycle);
+			callbackIGFX->modMMIORegistersWriteSupport.passThrough(controller, BXT_BLC_PWM_DUTY1, dutyCycle, kMMIOPriorityBacklightFix);
 		}
 		
 		/**
@@ -2158,21 +2550,11 @@ private:
 	/**
 	 *  A submodule to make brightness transitions smoother
 	 *
-	 *  @note This submodule must be placed AFTER the backlight registers fix (BLR) module.
-	 *        If BLR is enabled, it rescales the value to be written to `BXT_BLC_PWM_DUTY1`
-	 *        and then passes the rescaled value to `smoothCFLWriteRegisterPWMDuty1`.
+	 *  @note The smoother registers its injections with a lower priority than the backlight registers fixes (BLR and BLT).
+	 *        If a fix is enabled, it rescales the value to be written to `BXT_BLC_PWM_DUTY1`
+	 *        and then passes the rescaled value through to `smoothCFLWriteRegisterPWMDuty1`.
 	 */
 	class BacklightSmoother: public PatchSubmodule {
-		/**
-		 *  Backlight registers fix submodule needs access to the smoother version of `WriteRegister32()`
-		 */
-		friend class BacklightRegistersFix;
-		
-		/**
-		 *  Backlight registers alternative fix submodule needs access to the smoother version of `WriteRegister32()`
-		 */
-		friend class BacklightRegistersAltFix;
-
 		/**
 		 *  Brightness request event source needs access to the queue and config parameters
 		 */
@@ -2183,6 +2565,13 @@ private:
 		 */
 		static constexpr uint32_t kDefaultSteps = 35;
 
+		/**
+		 *  Maximum number of steps to reach the target duty value
+		 *
+		 *  @note This also bounds the size of the curve table, i.e. 4 KB.
+		 */
+		static constexpr uint32_t kMaximumSteps = 1023;
+
 		/**
 		 *  Default interval in milliseconds between each step
 		 */
@@ -2228,25 +2617,67 @@ private:
 		 */
 		ppair<uint32_t, uint32_t> brightnessRange {0, UINT32_MAX};
 		
+		/**
+		 *  The curve of brightness transitions, see `BrightnessCurve`
+		 */
+		uint32_t curve {BrightnessCurveLinear};
+		
+		/**
+		 *  Progress of a transition after each step in 16.16 fixed point, `nullptr` for the linear curve
+		 */
+		uint32_t *curveTable {nullptr};
+		
 		/**
 		 *  Owner of the event source
 		 */
 		OSObject *owner {nullptr};
 
 		/**
-		 *  A list of pending brightness adjustment requests
+		 *  A queue of pending brightness adjustment requests
 		 */
-		BrightnessRequest request;
+		BrightnessRequestQueue queue;
 
+		/**
+		 *  Maximum number of controller registers in transition concurrently
+		 */
+		static constexpr size_t kMaxTransitions = 4;
+		
+		/**
+		 *  Brightness transitions in progress, accessed on the workloop only
+		 */
+		BrightnessTransition transitions[kMaxTransitions];
+		
 		/**
 		 *  A workloop that provides a kernel thread to adjust the brightness
 		 */
 		IOWorkLoop *workloop {nullptr};
 
 		/**
-		 *  A custom event source that adjusts the brightness smoothly
+		 *  A custom event source that takes brightness requests from the queue
 		 */
 		BrightnessRequestEventSource *eventSource {nullptr};
+		
+		/**
+		 *  A timer that advances brightness transitions every `interval` milliseconds
+		 */
+		IOTimerEventSource *timer {nullptr};
+		
+		/**
+		 *  Start a transition for the given request or retarget the existing transition of its register
+		 *
+		 *  @param request A brightness adjustment request
+		 *  @note This function must be invoked on the workloop.
+		 */
+		void submitTransition(const BrightnessRequest &request);
+		
+		/**
+		 *  Advance every active transition by a single step
+		 *
+		 *  @param owner The owner of the timer
+		 *  @param sender The timer
+		 *  @note The timer is armed again if any transition has remaining steps.
+		 */
+		static void advanceTransitions(OSObject *owner, IOTimerEventSource *sender);
 
 		/**
 		 *  [IVB ] Wrapper to write to BLC_PWM_CPU_CTL smoothly
@@ -2272,17 +2703,17 @@ private:
 		/**
 		 *  [IVB ] A replacer descriptor that injects code when the register of interest is BLC_PWM_CPU_CTL
 		 */
-		MMIOWriteInjectionDescriptor dIVBPWMCCTRL {BLC_PWM_CPU_CTL,   smoothIVBWriteRegisterPWMCCTRL};
+		MMIOWriteInjectionDescriptor dIVBPWMCCTRL {BLC_PWM_CPU_CTL,   smoothIVBWriteRegisterPWMCCTRL, kMMIOPriorityBacklightSmoother};
 
 		/**
 		 *  [HSW+] A replacer descriptor that injects code when the register of interest is BXT_BLC_PWM_FREQ1
 		 */
-		MMIOWriteInjectionDescriptor dHSWPWMFreq1 {BXT_BLC_PWM_FREQ1, smoothHSWWriteRegisterPWMFreq1};
+		MMIOWriteInjectionDescriptor dHSWPWMFreq1 {BXT_BLC_PWM_FREQ1, smoothHSWWriteRegisterPWMFreq1, kMMIOPriorityBacklightSmoother};
 
 		/**
 		 *  [CFL+] A replacer descriptor that injects code when the register of interest is BXT_BLC_PWM_DUTY1
 		 */
-		MMIOWriteInjectionDescriptor dCFLPWMDuty1 {BXT_BLC_PWM_DUTY1, smoothCFLWriteRegisterPWMDuty1};
+		MMIOWriteInjectionDescriptor dCFLPWMDuty1 {BXT_BLC_PWM_DUTY1, smoothCFLWriteRegisterPWMDuty1, kMMIOPriorityBacklightSmoother};
 
 	public:
 		// MARK: Patch Submodule IMP
@@ -2381,7 +2812,9 @@ private:
 	/**
 	 *  A collection of shared submodules
 	 */
-	PatchSubmodule *sharedSubmodules[3] = {
+	PatchSubmodule *sharedSubmodules[5] = {
+		&modMMIORegistersTraceSupport,
+		&modMMIORegistersStatisticsSupport,
 		&modFramebufferControllerAccessSupport,
 		&modMMIORegistersReadSupport,
 		&modMMIORegistersWriteSupport
@@ -2414,6 +2847,44 @@ private:
 		&modDisplayDataBufferEarlyOptimizer,
 	};
 	
+	/**
+	 *  Names of shared submodules in the order of `sharedSubmodules`, used by the boot profile
+	 */
+	static constexpr const char *sharedSubmoduleNames[5] = {
+		"MMIORegistersTraceSupport",
+		"MMIORegistersStatisticsSupport",
+		"FramebufferControllerAccessSupport",
+		"MMIORegistersReadSupport",
+		"MMIORegistersWriteSupport"
+	};
+	
+	/**
+	 *  Names of submodules in the order of `submodules`, used by the boot profile
+	 */
+	static constexpr const char *submoduleNames[21] = {
+		"DVMTCalcFix",
+		"DPCDMaxLinkRateFix",
+		"CoreDisplayClockFix",
+		"HDMIDividersCalcFix",
+		"LSPCONDriverSupport",
+		"AdvancedI2COverAUXSupport",
+		"RPSControlPatch",
+		"ForceWakeWorkaround",
+		"ForceCompleteModeset",
+		"ForceOnlineDisplay",
+		"AGDCDisabler",
+		"TypeCCheckDisabler",
+		"BlackScreenFix",
+		"PAVPDisabler",
+		"ReadDescriptorPatch",
+		"BacklightRegistersFix",
+		"BacklightRegistersAltFix",
+		"BacklightSmoother",
+		"FramebufferDebugSupport",
+		"MaxPixelClockOverride",
+		"DisplayDataBufferEarlyOptimizer",
+	};
+	
 	/**
 	 * Prevent IntelAccelerator from starting.
 	 */
@@ -2479,6 +2950,55 @@ private:
 	 */
 	uint32_t realBinarySize {};
 
+	/**
+	 *  Decompressed GuC firmware followed by its signature, prepared on the first load and reused on wake
+	 */
+	uint8_t *decompressedFirmware {nullptr};
+
+	/**
+	 *  Decompressed GuC firmware size without the signature
+	 */
+	size_t decompressedFirmwareSize {0};
+
+	/**
+	 *  Decompress the GuC firmware for the current CPU into decompressedFirmware and verify it
+	 *
+	 *  @return true if the firmware is ready to be uploaded
+	 */
+	bool prepareGuCFirmware();
+
+	/**
+	 *  Release the firmware prepared by prepareGuCFirmware
+	 */
+	void releaseGuCFirmware();
+
+	/**
+	 *  True once the GuC signature and the firmware size in the driver are replaced with ours
+	 */
+	bool firmwareSignaturePatched {false};
+
+	/**
+	 *  The number of GuC firmware reloads on wake
+	 */
+	uint64_t gucWakeCount {0};
+
+	/**
+	 *  The longest GuC firmware reload on wake in nanoseconds
+	 */
+	uint64_t gucWakeMax {0};
+
+	/**
+	 *  The total time of GuC firmware reloads on wake in nanoseconds
+	 */
+	uint64_t gucWakeTotal {0};
+
+	/**
+	 *  Account a GuC firmware reload on wake and publish the statistics as `igfx-guc-wake` at `IOService:/IOResources/WhateverGreen`
+	 *
+	 *  @param elapsed The time from systemDidWake to the loaded firmware in absolute time units
+	 */
+	void publishGuCWakeTime(uint64_t elapsed);
+
 	/**
 	 *  Explore the framebuffer structure in Apple's Intel graphics driver
 	 */
@@ -2607,15 +3127,23 @@ private:
 	bool loadPatchesFromDevice(IORegistryEntry *igpu, uint32_t currentFramebuffer);
 
 	/**
-	 *  Find the framebuffer id in data
+	 *  Find the framebuffer id in the platform information list
 	 *
 	 *  @param framebufferId    Framebuffer id to search
-	 *  @param startingAddress  Start address of data to search
-	 *  @param maxSize          Maximum size of data to search
 	 *
-	 *  @return pointer to address in data or nullptr
+	 *  @return pointer to the platform information entry or nullptr
+	 *  @note Looks up the platform information index when it is built,
+	 *        and falls back to a linear search of the first page of the list otherwise.
+	 */
+	uint8_t *findFramebufferId(uint32_t framebufferId);
+
+	/**
+	 *  Build the platform information index by walking gPlatformInformationList with the generation stride
+	 *
+	 *  @note Called once when the list is resolved. The index is left empty if the list terminator is not found.
 	 */
-	uint8_t *findFramebufferId(uint32_t framebufferId, uint8_t *startingAddress, size_t maxSize);
+	template <typename T>
+	void indexPlatformInformationList();
 
 #ifdef DEBUG
 	/**
@@ -2645,7 +3173,7 @@ private:
 	 *  @return true if patched anything
 	 */
 	bool applyPatch(const KernelPatcher::LookupPatch &patch, uint8_t *startingAddress, size_t maxSize);
-	
+
 	/**
 	 *  Add int to dictionary.
 	 *
@@ -2661,12 +3189,13 @@ private:
 	 *  Patch platformInformationList
 	 *
 	 *  @param framebufferId               Framebuffer id
-	 *  @param platformInformationList     PlatformInformationList pointer
+	 *
+	 *  @tparam T Platform information entry type of the framebuffer kext
 	 *
 	 *  @return true if patched anything
 	 */
 	template <typename T>
-	bool applyPlatformInformationListPatch(uint32_t framebufferId, T *platformInformationList);
+	bool applyPlatformInformationListPatch(uint32_t framebufferId);
 
 	/**
 	 *  Extended patching called from applyPlatformInformationListPatch
@@ -2686,12 +3215,13 @@ private:
 	 *  Patch platformInformationList with DP to HDMI connector type replacements
 	 *
 	 *  @param framebufferId               Framebuffer id
-	 *  @param platformInformationList     PlatformInformationList pointer
+	 *
+	 *  @tparam T Platform information entry type of the framebuffer kext
 	 *
 	 *  @return true if patched anything
 	 */
 	template <typename T>
-	bool applyDPtoHDMIPatch(uint32_t framebufferId, T *platformInformationList);
+	bool applyDPtoHDMIPatch(uint32_t framebufferId);
 
 	/**
 	 *  Apply DP to HDMI automatic connector type changes
@@ -9,7 +9,6 @@
 #include "kern_igfx_backlight.hpp"
 #include "kern_igfx_kexts.hpp"
 #include "kern_igfx.hpp"
-#include <Headers/kern_time.hpp>
 #include <Headers/kern_disasm.hpp>
 
 ///
@@ -125,15 +124,9 @@ void IGFX::BacklightRegistersFix::wrapKBLWriteRegisterPWMFreq1(void *controller,
 	callbackIGFX->writeRegister32(controller, BXT_BLC_PWM_FREQ1, frequency ? self->targetBacklightFrequency : 0);
 
 	// Finish by writing the duty cycle.
-	if (callbackIGFX->modBacklightSmoother.enabled) {
-		// Need to pass the scaled value to the smoother
-		DBGLOG("igfx", "BLS: [KBL ] Will pass the rescaled value 0x%08x to the smoother version.", rescaledValue);
-		IGFX::BacklightSmoother::smoothCFLWriteRegisterPWMDuty1(controller, BXT_BLC_PWM_DUTY1, rescaledValue);
-	} else {
-		// Otherwise invoke the original function
-		DBGLOG("igfx", "BLR: [KBL ] Will pass the rescaled value 0x%08x to the original version.", rescaledValue);
-		callbackIGFX->writeRegister32(controller, BXT_BLC_PWM_DUTY1, rescaledValue);
-	}
+	// The smoother picks it up if enabled, otherwise the original function is invoked.
+	DBGLOG("igfx", "BLR: [KBL ] Will pass the rescaled value 0x%08x to the next writer.", rescaledValue);
+	callbackIGFX->modMMIORegistersWriteSupport.passThrough(controller, BXT_BLC_PWM_DUTY1, rescaledValue, kMMIOPriorityBacklightFix);
 }
 
 void IGFX::BacklightRegistersFix::wrapKBLWriteRegisterPWMCtrl1(void *controller, uint32_t reg, uint32_t value) {
@@ -219,15 +212,9 @@ void IGFX::BacklightRegistersFix::wrapCFLWriteRegisterPWMDuty1(void *controller,
 			   self->driverBacklightFrequency, self->targetBacklightFrequency);
 	}
 	
-	if (callbackIGFX->modBacklightSmoother.enabled) {
-		// Need to pass the scaled value to the smoother
-		DBGLOG("igfx", "BLS: [CFL+] Will pass the rescaled value 0x%08x to the smoother version.", value);
-		IGFX::BacklightSmoother::smoothCFLWriteRegisterPWMDuty1(controller, reg, value);
-	} else {
-		// Otherwise invoke the original function
-		DBGLOG("igfx", "BLR: [CFL+] Will pass the rescaled value 0x%08x to the original version.", value);
-		callbackIGFX->writeRegister32(controller, reg, value);
-	}
+	// The smoother picks it up if enabled, otherwise the original function is invoked.
+	DBGLOG("igfx", "BLR: [CFL+] Will pass the rescaled value 0x%08x to the next writer.", value);
+	callbackIGFX->modMMIORegistersWriteSupport.passThrough(controller, reg, value, kMMIOPriorityBacklightFix);
 }
 
 //
@@ -323,7 +310,8 @@ void IGFX::BacklightRegistersAltFix::processFramebufferKext(KernelPatcher &patch
 		}
 		
 		// Guard: Patch the function to invoke `hwSetBacklight()` explicitly
-		if (!descriptor->revert(probeContext, invocationContext, patcher, orgHwSetBacklight)) {
+		bool reverted = descriptor->revert(probeContext, invocationContext, patcher, orgHwSetBacklight);
+		if (!reverted) {
 			SYSLOG("igfx", "BLT: [COMM] Error: Failed to patch the function %s().", descriptor->name);
 			return;
 		} else {
@@ -580,7 +568,7 @@ bool IGFX::BacklightRegistersAltFix::revertInlinedInvocation(const FunctionDescr
  */
 IGFX::BacklightRegistersAltFixKBL::ProbeContext IGFX::BacklightRegistersAltFixKBL::probeMemberOffsets(mach_vm_address_t address, size_t instructions) const {
 	DBGLOG("igfx", "BLT: [KBL ] Analyzing the function at 0x%016llx to probe the offset of each required member field.", address);
-	hde64s handle;
+	DecodedFunction function {Disassembler::hdeDisasm, address, instructions};
 	
 	// Record which register stores the implicit controller instance
 	// By default, %rdi stores the implicit controller instance (i.e., the 1st argument)
@@ -599,8 +587,8 @@ IGFX::BacklightRegistersAltFixKBL::ProbeContext IGFX::BacklightRegistersAltFixKB
 	// Analyze at most the given number instructions to find the offsets
 	for (size_t index = 0; index < instructions; index += 1) {
 		// Guard: Should be able to disassemble the current instruction
-		address += Disassembler::hdeDisasm(address, &handle);
-		if (handle.flags & F_ERROR) {
+		auto instruction = function.at(index);
+		if (instruction == nullptr) {
 			SYSLOG("igfx", "BLT: [KBL ] Error: Cannot disassemble the instruction.");
 			break;
 		}
@@ -608,8 +596,8 @@ IGFX::BacklightRegistersAltFixKBL::ProbeContext IGFX::BacklightRegistersAltFixKB
 		// Guard: Step 1: Identify which register stores the controller instance
 		// Pattern: movq %rdi, %r??
 		// Checks: MOV, 64-bit, Direct Mode, Source Register is %rdi
-		if (Patterns::movqArg0(handle)) {
-			registerController = handle.rex_b << 3 | handle.modrm_rm;
+		if (Patterns::movqArg0().matches(*instruction)) {
+			registerController = instruction->rm();
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movq: Register %s now stores the controller instance.", registerName(registerController));
 			continue;
 		}
@@ -617,8 +605,8 @@ IGFX::BacklightRegistersAltFixKBL::ProbeContext IGFX::BacklightRegistersAltFixKB
 		// Guard: Step 2: Identify which register stores the given brightness level
 		// Pattern: movl %esi, %r??
 		// Checks: MOV, 32-bit, Direct Mode, Source Register is %esi
-		if (Patterns::movlArg1(handle)) {
-			registerBrightnessLevel = handle.rex_b << 3 | handle.modrm_rm;
+		if (Patterns::movlArg1().matches(*instruction)) {
+			registerBrightnessLevel = instruction->rm();
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movl: Register %s now stores the new brightness level.", registerName(registerBrightnessLevel));
 			continue;
 		}
@@ -626,8 +614,8 @@ IGFX::BacklightRegistersAltFixKBL::ProbeContext IGFX::BacklightRegistersAltFixKB
 		// Guard: Step 3: Identify the offset of the member field in the controller that stores the frequency divider
 		// Pattern: movl <offset?>(%r??), %r??
 		// Checks: MOV, 32-bit, Memory Mode, Source register is identical to the one that stores the controller
-		if (Patterns::movlFromMemory(handle, registerController)) {
-			offsetFrequencyDivider = handle.disp.disp32;
+		if (Patterns::movlFromMemory(registerController).matches(*instruction)) {
+			offsetFrequencyDivider = instruction->handle.disp.disp32;
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movl: The frequency divider is stored at offset 0x%zx.", offsetFrequencyDivider);
 			continue;
 		}
@@ -637,8 +625,8 @@ IGFX::BacklightRegistersAltFixKBL::ProbeContext IGFX::BacklightRegistersAltFixKB
 		// Checks: MOV, 32-bit, Memory Mode,
 		//         Source register is identical to the one that stores the brightness level,
 		//         Destination register is identical to the one that stores the controller
-		if (Patterns::movlToMemory(handle, registerBrightnessLevel, registerController)) {
-			offsetBrightnessLevel = handle.disp.disp32;
+		if (Patterns::movlToMemory(registerBrightnessLevel, registerController).matches(*instruction)) {
+			offsetBrightnessLevel = instruction->handle.disp.disp32;
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movl: The brightness level is stored at offset 0x%zx.", offsetBrightnessLevel);
 			break;
 		}
@@ -717,10 +705,7 @@ mach_vm_address_t IGFX::BacklightRegistersAltFixKBL::getHwSetBacklightWrapper()
  */
 IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAltFixKBL::probeInlinedInvocation_LightUpEDP(const FunctionDescriptor &descriptor, const ProbeContext &probeContext) {
 	DBGLOG("igfx", "BLT: [KBL ] Analyzing %s() at 0x%016llx to identify the position of the inlined invocation of hwSetBacklight().", descriptor.name, descriptor.address);
-	hde64s handle;
-	
-	// The address of the current instruction
-	auto current = descriptor.address;
+	DecodedFunction function {Disassembler::hdeDisasm, descriptor.address, kMaxNumInstructions};
 	
 	// The context of the inlined invocation
 	InvocationContext context;
@@ -728,9 +713,9 @@ IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAlt
 	// Analyze at most the given number instructions to find the location of inlined invocation of `hwSetBacklight()`
 	for (size_t index = 0; index < kMaxNumInstructions; index += 1) {
 		// Guard: Should be able to disassemble the current instruction
-		size_t size = Disassembler::hdeDisasm(current, &handle);
-		if (handle.flags & F_ERROR) {
-			SYSLOG("igfx", "BLT: [KBL ] Error: Cannot disassemble the instruction at 0x%016llx.", current);
+		auto instruction = function.at(index);
+		if (instruction == nullptr) {
+			SYSLOG("igfx", "BLT: [KBL ] Error: Cannot disassemble the instruction at 0x%016llx.", function.getEnd());
 			break;
 		}
 		
@@ -738,32 +723,28 @@ IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAlt
 		// Pattern: leal 0xfff37da7(%r??), %r?? where the source register stores the base address of the MMIO region
 		// Note that the start address found in `LightUpEDP()` is after the invocation of `CamelliaBase::SetDPCDBacklight()`
 		// and the retrieval of the base address of the MMIO region
-		if (Patterns::lealWithOffset(handle, 0xFFF37DA7)) {
-			context.start = current - descriptor.address;
+		if (Patterns::lealWithOffset(0xFFF37DA7).matches(*instruction)) {
+			context.start = instruction->address - descriptor.address;
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction leal: The relative start address of the inlined invocation is 0x%zx.", context.start);
-			current += size;
 			continue;
 		}
 		
 		// Guard: Step 2: Identify which register stores the controller instance
 		// Pattern: movl <offset>(%r??), %r??
 		// where the offset is identical to the one found in `hwSetBacklight()`
-		if (Patterns::movlFromMemoryWithOffset(handle, probeContext.offsetFrequencyDivider)) {
-			context.registerController = handle.rex_b << 3 | handle.modrm_rm;
+		if (Patterns::movlFromMemoryWithOffset(probeContext.offsetFrequencyDivider).matches(*instruction)) {
+			context.registerController = instruction->rm();
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movl: Register %s stores the controller instance.", registerName(context.registerController));
-			current += size;
 			continue;
 		}
 		
 		// Guard: Step 3: Find the end address, relative to the given address, of the inlined invocation of `hwSetBacklight()`
 		// Pattern: movl $??????????, 0xc8250(%r??)
-		if (Patterns::movlImm32ToMemoryWithOffset(handle, 0xC8250)) {
-			context.end = current + size - descriptor.address;
+		if (Patterns::movlImm32ToMemoryWithOffset(0xC8250).matches(*instruction)) {
+			context.end = instruction->end() - descriptor.address;
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movl: The relative end address of the inlined invocation is 0x%zx.", context.end);
 			break;
 		}
-		
-		current += size;
 	}
 	
 	// All done
@@ -782,10 +763,7 @@ IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAlt
  */
 IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAltFixKBL::probeInlinedInvocation_DisableDisplay(const FunctionDescriptor &descriptor, const ProbeContext &probeContext) {
 	DBGLOG("igfx", "BLT: [KBL ] Analyzing %s() at 0x%016llx to identify the position of the inlined invocation of hwSetBacklight().", descriptor.name, descriptor.address);
-	hde64s handle;
-	
-	// The address of the current instruction
-	auto current = descriptor.address;
+	DecodedFunction function {Disassembler::hdeDisasm, descriptor.address, kMaxNumInstructions};
 	
 	// The context of the inlined invocation
 	InvocationContext context;
@@ -793,18 +771,17 @@ IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAlt
 	// Analyze at most the given number instructions to find the location of inlined invocation of `hwSetBacklight()`
 	for (size_t index = 0; index < kMaxNumInstructions; index += 1) {
 		// Guard: Should be able to disassemble the current instruction
-		size_t size = Disassembler::hdeDisasm(current, &handle);
-		if (handle.flags & F_ERROR) {
-			SYSLOG("igfx", "BLT: [KBL ] Error: Cannot disassemble the instruction at 0x%016llx.", current);
+		auto instruction = function.at(index);
+		if (instruction == nullptr) {
+			SYSLOG("igfx", "BLT: [KBL ] Error: Cannot disassemble the instruction at 0x%016llx.", function.getEnd());
 			break;
 		}
 		
 		// Guard: Step 1: Identify which register stores the controller instance
 		// Pattern: movq %rdi, %r??
-		if (Patterns::movqArg0(handle)) {
-			context.registerController = handle.rex_b << 3 | handle.modrm_rm;
+		if (Patterns::movqArg0().matches(*instruction)) {
+			context.registerController = instruction->rm();
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movq: Register %s stores the controller instance.", registerName(context.registerController));
-			current += size;
 			continue;
 		}
 		
@@ -812,22 +789,19 @@ IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAlt
 		// Pattern: leal 0xfff37da7(%r??), %r?? where the source register stores the base address of the MMIO region
 		// Note that the start address found in `LightUpEDP()` is after the invocation of `CamelliaBase::SetDPCDBacklight()`
 		// and the retrieval of the base address of the MMIO region
-		if (Patterns::lealWithOffset(handle, 0xFFF37DA7)) {
-			context.start = current - descriptor.address;
+		if (Patterns::lealWithOffset(0xFFF37DA7).matches(*instruction)) {
+			context.start = instruction->address - descriptor.address;
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction leal: The relative start address of the inlined invocation is 0x%zx.", context.start);
-			current += size;
 			continue;
 		}
 		
 		// Guard: Step 3: Find the end address, relative to the given address, of the inlined invocation of `hwSetBacklight()`
 		// Pattern: movl $??????????, 0xc8250(%r??)
-		if (Patterns::movlImm32ToMemoryWithOffset(handle, 0xC8250)) {
-			context.end = current + size - descriptor.address;
+		if (Patterns::movlImm32ToMemoryWithOffset(0xC8250).matches(*instruction)) {
+			context.end = instruction->end() - descriptor.address;
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movl: The relative end address of the inlined invocation is 0x%zx.", context.end);
 			break;
 		}
-		
-		current += size;
 	}
 	
 	// All done
@@ -846,10 +820,7 @@ IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAlt
  */
 IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAltFixKBL::probeInlinedInvocation_HwSetPanelPower(const FunctionDescriptor &descriptor, const ProbeContext &probeContext) {
 	DBGLOG("igfx", "BLT: [KBL ] Analyzing %s() at 0x%016llx to identify the position of the inlined invocation of hwSetBacklight().", descriptor.name, descriptor.address);
-	hde64s handle;
-	
-	// The address of the current instruction
-	auto current = descriptor.address;
+	DecodedFunction function {Disassembler::hdeDisasm, descriptor.address, kMaxNumInstructions};
 	
 	// The context of the inlined invocation
 	InvocationContext context;
@@ -857,18 +828,17 @@ IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAlt
 	// Analyze at most the given number instructions to find the location of inlined invocation of `hwSetBacklight()`
 	for (size_t index = 0; index < kMaxNumInstructions; index += 1) {
 		// Guard: Should be able to disassemble the current instruction
-		size_t size = Disassembler::hdeDisasm(current, &handle);
-		if (handle.flags & F_ERROR) {
-			SYSLOG("igfx", "BLT: [KBL ] Error: Cannot disassemble the instruction at 0x%016llx.", current);
+		auto instruction = function.at(index);
+		if (instruction == nullptr) {
+			SYSLOG("igfx", "BLT: [KBL ] Error: Cannot disassemble the instruction at 0x%016llx.", function.getEnd());
 			break;
 		}
 		
 		// Guard: Step 1: Identify which register stores the controller instance
 		// Pattern: movq %rdi, %r??
-		if (Patterns::movqArg0(handle)) {
-			context.registerController = handle.rex_b << 3 | handle.modrm_rm;
+		if (Patterns::movqArg0().matches(*instruction)) {
+			context.registerController = instruction->rm();
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movq: Register %s now stores the controller instance.", registerName(context.registerController));
-			current += size;
 			continue;
 		}
 		
@@ -876,22 +846,19 @@ IGFX::BacklightRegistersAltFixKBL::InvocationContext IGFX::BacklightRegistersAlt
 		// Unlike the Coffee Lake driver, the Kaby Lake driver writes to the register 0xC8250 without calling hwSetBacklight().
 		// However, we will use our custom implementation of hwSetBacklight() which updates both the backlight and the register 0xC8250.
 		// Pattern: addl $0xfff37dab, %r??
-		if (Patterns::addlWithImm32(handle, 0xFFF37DAB)) {
-			context.start = current - descriptor.address;
+		if (Patterns::addlWithImm32(0xFFF37DAB).matches(*instruction)) {
+			context.start = instruction->address - descriptor.address;
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction addl: The relative start address of the inlined invocation is 0x%zx.", context.start);
-			current += size;
 			continue;
 		}
 		
 		// Guard: Step 3: Find the end address, relative to the given address, of the inlined invocation of `hwSetBacklight()`
 		// Pattern: movl $??????????, 0xc8250(%r??)
-		if (Patterns::movlImm32ToMemoryWithOffset(handle, 0xC8250)) {
-			context.end = current + size - descriptor.address;
+		if (Patterns::movlImm32ToMemoryWithOffset(0xC8250).matches(*instruction)) {
+			context.end = instruction->end() - descriptor.address;
 			DBGLOG("igfx", "BLT: [KBL ] Found the instruction movl: The relative end address of the inlined invocation is 0x%zx.", context.end);
 			break;
 		}
-		
-		current += size;
 	}
 	
 	// All done
@@ -972,7 +939,7 @@ IOReturn IGFX::BacklightRegistersAltFixKBL::wrapHwSetBacklight(void *controller,
  */
 IGFX::BacklightRegistersAltFixCFL::ProbeContext IGFX::BacklightRegistersAltFixCFL::probeMemberOffsets(mach_vm_address_t address, size_t instructions) const {
 	DBGLOG("igfx", "BLT: [CFL ] Analyzing the function at 0x%016llx to probe the offset of each required member field.", address);
-	hde64s handle;
+	DecodedFunction function {Disassembler::hdeDisasm, address, instructions};
 	
 	// Record which register stores the implicit controller instance
 	// By default, %rdi stores the implicit controller instance (i.e., the 1st argument)
@@ -991,8 +958,8 @@ IGFX::BacklightRegistersAltFixCFL::ProbeContext IGFX::BacklightRegistersAltFixCF
 	// Analyze at most the given number instructions to find the offsets
 	for (size_t index = 0; index < instructions; index += 1) {
 		// Guard: Should be able to disassemble the current instruction
-		address += Disassembler::hdeDisasm(address, &handle);
-		if (handle.flags & F_ERROR) {
+		auto instruction = function.at(index);
+		if (instruction == nullptr) {
 			SYSLOG("igfx", "BLT: [CFL ] Error: Cannot disassemble the instruction.");
 			break;
 		}
@@ -1000,8 +967,8 @@ IGFX::BacklightRegistersAltFixCFL::ProbeContext IGFX::BacklightRegistersAltFixCF
 		// Guard: Step 1: Identify which register stores the controller instance
 		// Pattern: movq %rdi, %r??
 		// Checks: MOV, 64-bit, Direct Mode, Source Register is %rdi
-		if (Patterns::movqArg0(handle)) {
-			registerController = handle.rex_b << 3 | handle.modrm_rm;
+		if (Patterns::movqArg0().matches(*instruction)) {
+			registerController = instruction->rm();
 			DBGLOG("igfx", "BLT: [CFL ] Found the instruction movq: Register %s now stores the controller instance.", registerName(registerController));
 			continue;
 		}
@@ -1009,8 +976,8 @@ IGFX::BacklightRegistersAltFixCFL::ProbeContext IGFX::BacklightRegistersAltFixCF
 		// Guard: Step 2: Identify which register stores the given brightness level
 		// Pattern: movl %esi, %r??
 		// Checks: MOV, 32-bit, Direct Mode, Source Register is %esi
-		if (Patterns::movlArg1(handle)) {
-			registerBrightnessLevel = handle.rex_b << 3 | handle.modrm_rm;
+		if (Patterns::movlArg1().matches(*instruction)) {
+			registerBrightnessLevel = instruction->rm();
 			DBGLOG("igfx", "BLT: [CFL ] Found the instruction movl: Register %s now stores the new brightness level.", registerName(registerBrightnessLevel));
 			continue;
 		}
@@ -1018,8 +985,8 @@ IGFX::BacklightRegistersAltFixCFL::ProbeContext IGFX::BacklightRegistersAltFixCF
 		// Guard: Step 3: Verify that the given brightness level is stored in the same register
 		// Pattern: imull %r??, %r?? where the source register stores the given brightness level and the destination register stores the PWM frequency
 		// Checks: IMUL, 32-bit, Direct Mode
-		if (Patterns::imull(handle)) {
-			if (uint32_t source = handle.rex_b << 3 | handle.modrm_rm; source != registerBrightnessLevel) {
+		if (Patterns::imull().matches(*instruction)) {
+			if (uint32_t source = instruction->rm(); source != registerBrightnessLevel) {
 				DBGLOG("igfx", "BLT: [CFL ] Found the instruction imull: Register %s instead of %s now stores the new brightness level.",
 					   registerName(source), registerName(registerBrightnessLevel));
 				registerBrightnessLevel = source;
@@ -1032,8 +999,8 @@ IGFX::BacklightRegistersAltFixCFL::ProbeContext IGFX::BacklightRegistersAltFixCF
 		// Note that even though Apple initializes this field with a hard coded value of `0xFFFF` in `AppleIntelFramebufferController::getOSInformation()`,
 		// we cannot assume that it is always set to `0xFFFF` in future macOS releases, so we will fetch the divider from the controller.
 		// Checks: DIV, 32-bit, Memory Mode, Register is identical to the one found in previous steps
-		if (Patterns::divlByMemory(handle, registerController)) {
-			offsetFrequencyDivider = handle.disp.disp32;
+		if (Patterns::divlByMemory(registerController).matches(*instruction)) {
+			offsetFrequencyDivider = instruction->handle.disp.disp32;
 			DBGLOG("igfx", "BLT: [CFL ] Found the instruction divl: The frequency divider is stored at offset 0x%zx.", offsetFrequencyDivider);
 			continue;
 		}
@@ -1043,8 +1010,8 @@ IGFX::BacklightRegistersAltFixCFL::ProbeContext IGFX::BacklightRegistersAltFixCF
 		// Checks: MOV, 32-bit, Memory Mode,
 		//         Source register is identical to the one that stores the brightness level,
 		//         Destination register is identical to the one that stores the controller
-		if (Patterns::movlToMemory(handle, registerBrightnessLevel, registerController)) {
-			offsetBrightnessLevel = handle.disp.disp32;
+		if (Patterns::movlToMemory(registerBrightnessLevel, registerController).matches(*instruction)) {
+			offsetBrightnessLevel = instruction->handle.disp.disp32;
 			DBGLOG("igfx", "BLT: [CFL ] Found the instruction movl: The brightness level is stored at offset 0x%zx.", offsetBrightnessLevel);
 			break;
 		}
@@ -1114,10 +1081,7 @@ mach_vm_address_t IGFX::BacklightRegistersAltFixCFL::getHwSetBacklightWrapper()
  */
 IGFX::BacklightRegistersAltFixCFL::InvocationContext IGFX::BacklightRegistersAltFixCFL::probeInlinedInvocation(const FunctionDescriptor &descriptor, const ProbeContext &probeContext) {
 	DBGLOG("igfx", "BLT: [CFL ] Analyzing %s() at 0x%016llx to identify the position of the inlined invocation of hwSetBacklight().", descriptor.name, descriptor.address);
-	hde64s handle;
-	
-	// The address of the current instruction
-	auto current = descriptor.address;
+	DecodedFunction function {Disassembler::hdeDisasm, descriptor.address, kMaxNumInstructions};
 	
 	// The context of the inlined invocation
 	InvocationContext context;
@@ -1125,8 +1089,8 @@ IGFX::BacklightRegistersAltFixCFL::InvocationContext IGFX::BacklightRegistersAlt
 	// Analyze at most the given number instructions to find the location of inlined invocation of `hwSetBacklight()`
 	for (size_t index = 0; index < kMaxNumInstructions; index += 1) {
 		// Guard: Should be able to disassemble the current instruction
-		size_t size = Disassembler::hdeDisasm(current, &handle);
-		if (handle.flags & F_ERROR) {
+		auto instruction = function.at(index);
+		if (instruction == nullptr) {
 			SYSLOG("igfx", "BLT: [CFL ] Error: Cannot disassemble the instruction.");
 			break;
 		}
@@ -1135,32 +1099,28 @@ IGFX::BacklightRegistersAltFixCFL::InvocationContext IGFX::BacklightRegistersAlt
 		// Pattern: leal 0xfff37da7(%r??), %r?? where the source register stores the base address of the MMIO region
 		// Note that the start address found in `LightUpEDP()` is after the invocation of `CamelliaBase::SetDPCDBacklight()`
 		// and the retrieval of the base address of the MMIO region
-		if (Patterns::lealWithOffset(handle, 0xFFF37DA7)) {
-			context.start = current - descriptor.address;
+		if (Patterns::lealWithOffset(0xFFF37DA7).matches(*instruction)) {
+			context.start = instruction->address - descriptor.address;
 			DBGLOG("igfx", "BLT: [CFL ] Found the instruction leal: The relative start address of the inlined invocation is 0x%zx.", context.start);
-			current += size;
 			continue;
 		}
 		
 		// Guard: Step 2: Identify which register stores the controller instance
 		// Pattern: divl <offset?>(%r??)
 		// where the offset is identical to the one found in `hwSetBacklight()`
-		if (Patterns::divlByMemoryWithOffset(handle, probeContext.offsetFrequencyDivider)) {
-			context.registerController = handle.rex_b << 3 | handle.modrm_rm;
+		if (Patterns::divlByMemoryWithOffset(probeContext.offsetFrequencyDivider).matches(*instruction)) {
+			context.registerController = instruction->rm();
 			DBGLOG("igfx", "BLT: [CFL ] Found the instruction divl: Register %s stores the controller instance.", registerName(context.registerController));
-			current += size;
 			continue;
 		}
 		
 		// Guard: Step 3: Find the end address, relative to the given address, of the inlined invocation of `hwSetBacklight()`
 		// Pattern: addl $0xfff37dab, %r??
-		if (Patterns::addlWithImm32(handle, 0xFFF37DAB)) {
-			context.end = current - descriptor.address;
+		if (Patterns::addlWithImm32(0xFFF37DAB).matches(*instruction)) {
+			context.end = instruction->address - descriptor.address;
 			DBGLOG("igfx", "BLT: [CFL ] Found the instruction addl: The relative end address of the inlined invocation is 0x%zx.", context.end);
 			break;
 		}
-		
-		current += size;
 	}
 	
 	// All done
@@ -1214,6 +1174,125 @@ IOReturn IGFX::BacklightRegistersAltFixCFL::wrapHwSetBacklight(void *controller,
 	return kIOReturnSuccess;
 }
 
+//
+// MARK: - Brightness Request Queue
+//
+
+bool BrightnessRequestQueue::init(uint32_t size) {
+	uint32_t capacity = 1;
+	while (capacity < size && capacity < kMaxCapacity)
+		capacity <<= 1;
+	
+	slots = Buffer::create<BrightnessRequest>(capacity);
+	if (slots == nullptr)
+		return false;
+	
+	for (uint32_t index = 0; index < capacity; index++)
+		slots[index] = BrightnessRequest();
+	mask = capacity - 1;
+	DBGLOG("igfx", "BLS: [COMM] The request queue has %u slots.", capacity);
+	return true;
+}
+
+void BrightnessRequestQueue::deinit() {
+	if (slots != nullptr) {
+		Buffer::deleter(slots);
+		slots = nullptr;
+	}
+	mask = 0;
+}
+
+void BrightnessRequestQueue::push(BrightnessRequest request) {
+	request.id = ++lastId;
+	
+	// Publish the request to the ring if the consumer has made room for it
+	uint32_t index = tail;
+	if (slots != nullptr && index - __atomic_load_n(&head, __ATOMIC_ACQUIRE) <= mask) {
+		slots[index & mask] = request;
+		__atomic_store_n(&tail, index + 1, __ATOMIC_RELEASE);
+		return;
+	}
+	
+	// Otherwise replace the overflow request of the register, the consumer retries if it observes an odd sequence
+	for (auto &slot : overflows) {
+		if (slot.request.controller != nullptr && !slot.request.isSameTarget(request))
+			continue;
+		
+		DBGLOG("igfx", "BLS: [COMM] The request queue is full. Will publish the request to the overflow slot.");
+		uint32_t sequence = slot.sequence;
+		__atomic_store_n(&slot.sequence, sequence + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		slot.request = request;
+		__atomic_store_n(&slot.sequence, sequence + 2, __ATOMIC_RELEASE);
+		return;
+	}
+	
+	SYSLOG("igfx", "BLS: [COMM] The request queue is full. Will drop the request.");
+}
+
+bool BrightnessRequestQueue::coalesce(const BrightnessRequest &request) {
+	Target *unused = nullptr;
+	for (auto &target : targets) {
+		if (target.request.controller == nullptr) {
+			if (unused == nullptr)
+				unused = &target;
+		} else if (target.request.isSameTarget(request)) {
+			// Identifiers may wrap around, so compare their distance instead
+			if (static_cast<int32_t>(request.id - target.request.id) <= 0)
+				return false;
+			target.request = request;
+			target.pending = true;
+			return true;
+		}
+	}
+	
+	if (unused == nullptr) {
+		SYSLOG("igfx", "BLS: [COMM] Too many registers are adjusted concurrently. Will drop the request.");
+		return false;
+	}
+	
+	unused->request = request;
+	unused->pending = true;
+	return true;
+}
+
+bool BrightnessRequestQueue::collect() {
+	bool updated = false;
+	
+	// Drain the ring
+	uint32_t end = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+	for (uint32_t index = head; index != end; index++)
+		updated |= coalesce(slots[index & mask]);
+	__atomic_store_n(&head, end, __ATOMIC_RELEASE);
+	
+	// Read the overflow requests consistently
+	for (auto &slot : overflows) {
+		BrightnessRequest request;
+		uint32_t sequence;
+		do {
+			sequence = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE);
+			request = slot.request;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		} while ((sequence & 1) != 0 || sequence != __atomic_load_n(&slot.sequence, __ATOMIC_RELAXED));
+		
+		if (request.controller != nullptr)
+			updated |= coalesce(request);
+	}
+	return updated;
+}
+
+bool BrightnessRequestQueue::pop(BrightnessRequest &request) {
+	collect();
+	for (auto &target : targets) {
+		if (target.pending) {
+			target.pending = false;
+			request = target.request;
+			return true;
+		}
+	}
+	return false;
+}
+
 //
 // MARK: - Brightness Request Event Source
 //
@@ -1224,74 +1303,21 @@ IOReturn IGFX::BacklightRegistersAltFixCFL::wrapHwSetBacklight(void *controller,
 OSDefineMetaClassAndStructors(BrightnessRequestEventSource, IOEventSource);
 
 /**
- *  Check whether a brightness adjustment request is pending and if so process the request on the workloop
+ *  Take pending brightness adjustment requests and start or retarget their transitions on the workloop
  *
- *  @return `true` if the work loop should invoke this function again.
- *          i.e., One or more requests are pending after the workloop has processed the current one.
+ *  @return `false`, the event source is enabled again when a new request is submitted.
  */
 bool BrightnessRequestEventSource::checkForWork() {
 	// Get the brightness smoother submodule
 	IGFX::BacklightSmoother *smoother = &IGFX::callbackIGFX->modBacklightSmoother;
 	
-	// Get a pending request
-	// No work if the queue is empty
-	BrightnessRequest request = smoother->request; // TODO: read it atomically, or compare the whole requests instead of ID
-	if (!request.controller) {
-		DBGLOG("igfx", "BLS: [COMM] The request is empty. Will wait for the next invocation.");
-		return false;
-	}
+	// Take all pending requests
+	// Bursts have been coalesced into a single request per register by the queue
+	BrightnessRequest request;
+	while (smoother->queue.pop(request))
+		smoother->submitTransition(request);
 	
-	// Prepare the request
-	[[maybe_unused]] uint64_t snanosecs = getCurrentTimeNs();
-	uint32_t current = IGFX::callbackIGFX->readRegister32(request.controller, request.address);
-	uint32_t cbrightness = request.getCurrentBrightness(current);
-	uint32_t tbrightness = request.getTargetBrightness();
-
-	if (cbrightness == tbrightness) {
-		DBGLOG("igfx", "BLS: [COMM] The request is already completed. Will wait for the next invocation.");
-		return false;		
-	}
-	
-	tbrightness = max(tbrightness, smoother->brightnessRange.first);  // Ensure that target >= lowerbound
-	tbrightness = min(tbrightness, smoother->brightnessRange.second); // Ensure that target <= upperbound
-	uint32_t distance = max(cbrightness, tbrightness) - min(cbrightness, tbrightness);
-	DBGLOG("igfx", "BLS: [COMM] Processing the request: Current = 0x%08x; Target = 0x%08x; Distance = %04u; Steps = %u.",
-		   cbrightness, tbrightness, distance, smoother->steps);
-	
-	// Process the request
-	if (distance > smoother->threshold) {
-		if (cbrightness < tbrightness) {
-			// Increase the brightness
-			for (uint32_t i = 1; i < smoother->steps; i++) {
-				uint32_t value = cbrightness + i * distance / smoother->steps;
-				IGFX::callbackIGFX->writeRegister32(request.controller, request.address, request.getTargetRegisterValue(value));
-				IOSleep(smoother->interval);
-				if (smoother->request.id != request.id) {
-					return true; // Start again, because there is a new request
-				}
-			}
-		} else if (cbrightness > tbrightness) {
-			// Decrease the brightness
-			for (uint32_t i = 1; i < smoother->steps; i++) {
-				uint32_t value = cbrightness - i * distance / smoother->steps;
-				IGFX::callbackIGFX->writeRegister32(request.controller, request.address, request.getTargetRegisterValue(value));
-				IOSleep(smoother->interval);
-				if (smoother->request.id != request.id) {
-					return true; // Start again, because there is a new request
-				}
-			}
-		}
-	} else {
-		DBGLOG("igfx", "BLS: [COMM] Distance is too short. Will set the target value directly.");
-	}
-	
-	// Finish by writting the target value
-	IGFX::callbackIGFX->writeRegister32(request.controller, request.address, request.getTargetRegisterValue(tbrightness));
-	[[maybe_unused]] uint64_t enanosecs = getCurrentTimeNs();
-	DBGLOG("igfx", "BLS: [COMM] The request completed in %llu nanoseconds.", enanosecs - snanosecs);
-	
-	// No need to invoke this function again if the request is the same
-	return smoother->request.id != request.id;
+	return false;
 }
 
 /**
@@ -1317,6 +1343,133 @@ BrightnessRequestEventSource *BrightnessRequestEventSource::create(OSObject *own
 // MARK: - Backlight Smoother
 //
 
+/**
+ *  Progress of each brightness curve sampled at 65 evenly spaced points in 16.16 fixed point
+ *
+ *  @note Generated offline, since floating point is not available to kernel extensions.
+ *        Gamma: t^2.2. Logarithmic: (101^t - 1) / 100. Ease-in-out: 3t^2 - 2t^3.
+ */
+static constexpr uint32_t BrightnessCurveAnchors[BrightnessCurveCount][BrightnessCurveAnchorCount] {
+	// Linear
+	{
+		    0,  1024,  2048,  3072,  4096,  5120,  6144,  7168,
+		 8192,  9216, 10240, 11264, 12288, 13312, 14336, 15360,
+		16384, 17408, 18432, 19456, 20480, 21504, 22528, 23552,
+		24576, 25600, 26624, 27648, 28672, 29696, 30720, 31744,
+		32768, 33792, 34816, 35840, 36864, 37888, 38912, 39936,
+		40960, 41984, 43008, 44032, 45056, 46080, 47104, 48128,
+		49152, 50176, 51200, 52224, 53248, 54272, 55296, 56320,
+		57344, 58368, 59392, 60416, 61440, 62464, 63488, 64512,
+		65536
+	},
+	// Gamma 2.2
+	{
+		    0,     7,    32,    78,   147,   240,   359,   504,
+		  676,   875,  1104,  1361,  1648,  1966,  2314,  2693,
+		 3104,  3547,  4022,  4530,  5072,  5646,  6255,  6897,
+		 7574,  8286,  9033,  9815, 10632, 11486, 12375, 13301,
+		14263, 15262, 16298, 17371, 18482, 19630, 20817, 22041,
+		23303, 24604, 25944, 27322, 28740, 30196, 31692, 33228,
+		34803, 36418, 38073, 39768, 41504, 43280, 45097, 46955,
+		48854, 50794, 52775, 54797, 56861, 58967, 61115, 63304,
+		65536
+	},
+	// Logarithmic
+	{
+		    0,    49,   102,   158,   219,   285,   355,   430,
+		  512,   599,   693,   793,   902,  1018,  1143,  1278,
+		 1422,  1578,  1745,  1924,  2117,  2324,  2547,  2786,
+		 3044,  3320,  3618,  3937,  4281,  4650,  5046,  5473,
+		 5931,  6423,  6953,  7522,  8133,  8790,  9497, 10256,
+		11071, 11948, 12891, 13904, 14992, 16162, 17420, 18772,
+		20224, 21785, 23463, 25267, 27205, 29289, 31528, 33934,
+		36521, 39300, 42288, 45499, 48950, 52660, 56646, 60931,
+		65536
+	},
+	// Ease-in-out
+	{
+		    0,    48,   188,   418,   736,  1138,  1620,  2180,
+		 2816,  3524,  4300,  5142,  6048,  7014,  8036,  9112,
+		10240, 11416, 12636, 13898, 15200, 16538, 17908, 19308,
+		20736, 22188, 23660, 25150, 26656, 28174, 29700, 31232,
+		32768, 34304, 35836, 37362, 38880, 40386, 41876, 43348,
+		44800, 46228, 47628, 48998, 50336, 51638, 52900, 54120,
+		55296, 56424, 57500, 58522, 59488, 60394, 61236, 62012,
+		62720, 63356, 63916, 64398, 64800, 65118, 65348, 65488,
+		65536
+	},
+};
+
+void IGFX::BacklightSmoother::submitTransition(const BrightnessRequest &request) {
+	// The timer is running as long as any transition is in progress
+	bool ticking = false;
+	for (auto &candidate : transitions)
+		ticking |= candidate.request.controller != nullptr && candidate.ramp.isActive();
+	
+	// Clamp the target to the user-defined range
+	BrightnessRequest adjusted = request;
+	uint32_t tbrightness = adjusted.getTargetBrightness();
+	tbrightness = max(tbrightness, brightnessRange.first);  // Ensure that target >= lowerbound
+	tbrightness = min(tbrightness, brightnessRange.second); // Ensure that target <= upperbound
+	
+	// Find the transition of the register
+	BrightnessTransition *transition = nullptr;
+	for (auto &candidate : transitions) {
+		if (candidate.request.controller == nullptr && transition == nullptr)
+			transition = &candidate;
+		else if (candidate.request.isSameTarget(request)) {
+			transition = &candidate;
+			break;
+		}
+	}
+	
+	if (transition == nullptr) {
+		SYSLOG("igfx", "BLS: [COMM] Too many registers are adjusted concurrently. Will set the target value directly.");
+		callbackIGFX->writeRegister32(request.controller, request.address, adjusted.getTargetRegisterValue(tbrightness));
+		return;
+	}
+	
+	// Retarget the transition from the last written level if it is still in progress,
+	// otherwise start a new one from the current register value
+	bool active = transition->request.controller != nullptr && transition->ramp.isActive();
+	transition->request = adjusted;
+	if (active) {
+		DBGLOG("igfx", "BLS: [COMM] Retargeting the transition to 0x%08x.", tbrightness);
+		transition->ramp.retarget(tbrightness);
+	} else {
+		uint32_t current = callbackIGFX->readRegister32(request.controller, request.address);
+		uint32_t cbrightness = adjusted.getCurrentBrightness(current);
+		DBGLOG("igfx", "BLS: [COMM] Starting the transition: Current = 0x%08x; Target = 0x%08x; Steps = %u.", cbrightness, tbrightness, steps);
+		transition->ramp.configure(steps, threshold, curveTable);
+		transition->ramp.start(cbrightness, tbrightness);
+		if (!transition->ramp.isActive()) {
+			DBGLOG("igfx", "BLS: [COMM] The request is already completed.");
+			return;
+		}
+	}
+	
+	// Advance immediately unless the timer is already running
+	if (!ticking)
+		advanceTransitions(owner, timer);
+}
+
+void IGFX::BacklightSmoother::advanceTransitions(OSObject *owner, IOTimerEventSource *sender) {
+	auto self = &callbackIGFX->modBacklightSmoother;
+	
+	bool pending = false;
+	for (auto &transition : self->transitions) {
+		if (transition.request.controller == nullptr || !transition.ramp.isActive())
+			continue;
+		
+		uint32_t value = transition.ramp.advance();
+		callbackIGFX->writeRegister32(transition.request.controller, transition.request.address, transition.request.getTargetRegisterValue(value));
+		pending |= transition.ramp.isActive();
+	}
+	
+	if (pending)
+		sender->setTimeoutMS(self->interval);
+}
+
 void IGFX::BacklightSmoother::init() {
 	// We only need to patch the framebuffer driver
 	requiresPatchingFramebuffer = true;
@@ -1333,9 +1486,19 @@ void IGFX::BacklightSmoother::deinit() {
 			workloop->removeEventSource(eventSource);
 			OSSafeReleaseNULL(eventSource);
 		}
+		if (timer != nullptr) {
+			timer->cancelTimeout();
+			workloop->removeEventSource(timer);
+			OSSafeReleaseNULL(timer);
+		}
 		OSSafeReleaseNULL(workloop);
 	}
 	OSSafeReleaseNULL(owner);
+	queue.deinit();
+	if (curveTable != nullptr) {
+		Buffer::deleter(curveTable);
+		curveTable = nullptr;
+	}
 }
 
 void IGFX::BacklightSmoother::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
@@ -1359,9 +1522,11 @@ void IGFX::BacklightSmoother::processKernel(KernelPatcher &patcher, DeviceInfo *
 		DBGLOG("igfx", "BLS: User requested brightness lower bound = %u.", brightnessRange.first);
 	if (WIOKit::getOSDataValue(info->videoBuiltin, "backlight-smoother-upperbound", brightnessRange.second))
 		DBGLOG("igfx", "BLS: User requested brightness upper bound = %u.", brightnessRange.second);
+	if (WIOKit::getOSDataValue(info->videoBuiltin, "backlight-smoother-curve", curve))
+		DBGLOG("igfx", "BLS: User requested curve = %u.", curve);
 	
 	// Sanitize user configurations
-	if (steps == 0) {
+	if (steps == 0 || steps > kMaximumSteps) {
 		SYSLOG("igfx", "BLS: Warning: User requested steps value is invalid. Will use the default value %u.", kDefaultSteps);
 		steps = kDefaultSteps;
 	}
@@ -1377,6 +1542,33 @@ void IGFX::BacklightSmoother::processKernel(KernelPatcher &patcher, DeviceInfo *
 		brightnessRange.second = UINT32_MAX;
 	}
 	
+	if (curve >= BrightnessCurveCount) {
+		SYSLOG("igfx", "BLS: Warning: User requested curve is invalid. Will use the linear curve.");
+		curve = BrightnessCurveLinear;
+	}
+	
+	// Sample the curve at each step, so that transitions only need a table lookup per step
+	if (curve != BrightnessCurveLinear) {
+		size_t tableSize = static_cast<size_t>(steps) + 1;
+		curveTable = Buffer::create<uint32_t>(tableSize);
+		if (curveTable == nullptr) {
+			SYSLOG("igfx", "BLS: Failed to allocate the curve table. Will use the linear curve.");
+			curve = BrightnessCurveLinear;
+		} else {
+			auto anchors = BrightnessCurveAnchors[curve];
+			for (size_t step = 0; step < tableSize; step++) {
+				// Position between anchors in 16.16 fixed point
+				uint64_t position = (static_cast<uint64_t>(step) * (BrightnessCurveAnchorCount - 1) << 16) / steps;
+				size_t index = static_cast<size_t>(position >> 16);
+				uint64_t fraction = position & 0xFFFF;
+				if (index + 1 >= BrightnessCurveAnchorCount)
+					curveTable[step] = anchors[BrightnessCurveAnchorCount - 1];
+				else
+					curveTable[step] = anchors[index] + static_cast<uint32_t>(((anchors[index + 1] - anchors[index]) * fraction) >> 16);
+			}
+		}
+	}
+	
 	// Wrap this submodule as an OSObject
 	owner = OSObjectWrapper::with(this);
 	if (owner == nullptr) {
@@ -1387,7 +1579,12 @@ void IGFX::BacklightSmoother::processKernel(KernelPatcher &patcher, DeviceInfo *
 	}
 	
 	// Initialize the request queue
-	request = BrightnessRequest();
+	if (!queue.init(queueSize)) {
+		SYSLOG("igfx", "BLS: Failed to allocate the request queue.");
+		deinit();
+		enabled = false;
+		return;
+	}
 	
 	// Initialize the workloop
 	workloop = IOWorkLoop::workLoop();
@@ -1412,6 +1609,24 @@ void IGFX::BacklightSmoother::processKernel(KernelPatcher &patcher, DeviceInfo *
 		SYSLOG("igfx", "BLS: Failed to register the request event source.");
 		deinit();
 		enabled = false;
+		return;
+	}
+	
+	// Initialize the transition timer
+	timer = IOTimerEventSource::timerEventSource(owner, advanceTransitions);
+	if (timer == nullptr) {
+		SYSLOG("igfx", "BLS: Failed to create the transition timer.");
+		deinit();
+		enabled = false;
+		return;
+	}
+	
+	// Register the transition timer
+	if (workloop->addEventSource(timer) != kIOReturnSuccess) {
+		SYSLOG("igfx", "BLS: Failed to register the transition timer.");
+		OSSafeReleaseNULL(timer);
+		deinit();
+		enabled = false;
 	}
 }
 
@@ -1420,9 +1635,15 @@ void IGFX::BacklightSmoother::processFramebufferKext(KernelPatcher &patcher, siz
 	if (framebuffer.isOneOf(&kextIntelCapriFb)) {
 		DBGLOG("igfx", "BLS: [IVB ] Will setup the smoother for IVB platform.");
 		callbackIGFX->modMMIORegistersWriteSupport.replacerList.add(&dIVBPWMCCTRL);
-	} else if (framebuffer.isOneOf(&kextIntelAzulFb, &kextIntelBDWFb, &kextIntelSKLFb, &kextIntelKBLFb)) {
-		DBGLOG("igfx", "BLS: [HSW+] Will setup the smoother for HSW/BDW/SKL/KBL platform.");
+	} else if (framebuffer.isOneOf(&kextIntelAzulFb, &kextIntelBDWFb, &kextIntelSKLFb)) {
+		DBGLOG("igfx", "BLS: [HSW+] Will setup the smoother for HSW/BDW/SKL platform.");
+		callbackIGFX->modMMIORegistersWriteSupport.replacerList.add(&dHSWPWMFreq1);
+	} else if (framebuffer.isOneOf(&kextIntelKBLFb)) {
+		// The KBL driver never writes to BXT_BLC_PWM_DUTY1 itself, so the second descriptor
+		// only receives duty cycle values rescaled by the backlight registers fixes on CFL hardware.
+		DBGLOG("igfx", "BLS: [KBL ] Will setup the smoother for KBL platform.");
 		callbackIGFX->modMMIORegistersWriteSupport.replacerList.add(&dHSWPWMFreq1);
+		callbackIGFX->modMMIORegistersWriteSupport.replacerList.add(&dCFLPWMDuty1);
 	} else if (framebuffer.isOneOf(&kextIntelCFLFb, &kextIntelICLLPFb)) {
 		DBGLOG("igfx", "BLS: [CFL+] Will setup the smoother for CFL/ICL platform.");
 		callbackIGFX->modMMIORegistersWriteSupport.replacerList.add(&dCFLPWMDuty1);
@@ -1436,7 +1657,7 @@ void IGFX::BacklightSmoother::smoothIVBWriteRegisterPWMCCTRL(void *controller, u
 	PANIC_COND(address != BLC_PWM_CPU_CTL, "igfx", "Fatal Error: Register should be BLC_PWM_CPU_CTL.");
 	
 	// Submit the request and notify the event source
-	callbackIGFX->modBacklightSmoother.request = BrightnessRequest(callbackIGFX->modBacklightSmoother.request.id + 1, controller, address, value);
+	callbackIGFX->modBacklightSmoother.queue.push(BrightnessRequest(0, controller, address, value));
 	callbackIGFX->modBacklightSmoother.eventSource->enable();
 	DBGLOG("igfx", "BLS: [IVB ] WriteRegister32<BLC_PWM_CPU_CTL>: The brightness request has been submitted.");
 }
@@ -1446,7 +1667,7 @@ void IGFX::BacklightSmoother::smoothHSWWriteRegisterPWMFreq1(void *controller, u
 	PANIC_COND(address != BXT_BLC_PWM_FREQ1, "igfx", "Fatal Error: Register should be BXT_BLC_PWM_FREQ1.");
 	
 	// Submit the request and notify the event source
-	callbackIGFX->modBacklightSmoother.request = BrightnessRequest(callbackIGFX->modBacklightSmoother.request.id + 1, controller, address, value, 0xFFFF);
+	callbackIGFX->modBacklightSmoother.queue.push(BrightnessRequest(0, controller, address, value, 0xFFFF));
 	callbackIGFX->modBacklightSmoother.eventSource->enable();
 	DBGLOG("igfx", "BLS: [HSW+] WriteRegister32<BXT_BLC_PWM_FREQ1>: The brightness request has been submitted.");
 }
@@ -1456,7 +1677,7 @@ void IGFX::BacklightSmoother::smoothCFLWriteRegisterPWMDuty1(void *controller, u
 	PANIC_COND(address != BXT_BLC_PWM_DUTY1, "igfx", "Fatal Error: Register should be BXT_BLC_PWM_DUTY1.");
 	
 	// Submit the request and notify the event source
-	callbackIGFX->modBacklightSmoother.request = BrightnessRequest(callbackIGFX->modBacklightSmoother.request.id + 1, controller, address, value);
+	callbackIGFX->modBacklightSmoother.queue.push(BrightnessRequest(0, controller, address, value));
 	callbackIGFX->modBacklightSmoother.eventSource->enable();
 	DBGLOG("igfx", "BLS: [CFL+] WriteRegister32<BXT_BLC_PWM_DUTY1>: The brightness request has been submitted.");
 }
@@ -10,7 +10,9 @@
 #define kern_igfx_backlight_hpp
 
 #include <IOKit/IOEventSource.h>
+#include <IOKit/IOTimerEventSource.h>
 #include "kern_util.hpp"
+#include "kern_igfx_ramp.hpp"
 
 /**
  *  Backlight registers
@@ -98,10 +100,163 @@ struct BrightnessRequest {
 	inline uint32_t getTargetRegisterValue(uint32_t brightness) {
 		return brightness | (target & ~mask);
 	}
+	
+	/**
+	 *  Check whether the given request adjusts the same register of the same controller
+	 *
+	 *  @param other Another request
+	 *  @return `true` if both requests target the same register.
+	 */
+	inline bool isSameTarget(const BrightnessRequest &other) const {
+		return controller == other.controller && address == other.address;
+	}
+};
+
+/**
+ *  A single-producer single-consumer queue of brightness adjustment requests
+ *
+ *  @note The producer is the `WriteRegister32()` replacer and the consumer is the smoother workloop.
+ *  @note The queue relies on a single producer: `push()` updates `tail`, `lastId` and the overflow slots without atomic
+ *        read-modify-write operations, so it must never run on two threads at once. This assumes the framebuffer does not
+ *        write backlight registers from several threads concurrently. If it ever does, the callers of `push()` must be serialized.
+ *  @note Requests are published by a release store of the tail index, so the consumer never observes a torn request.
+ *        If the ring is full, the producer publishes the request to a per-register overflow slot guarded by a sequence lock instead.
+ *  @note The consumer coalesces pending requests into a single target per controller register,
+ *        so a burst of requests results in a single transition to the latest target.
+ */
+class BrightnessRequestQueue {
+	/**
+	 *  Maximum number of controller registers adjusted concurrently
+	 */
+	static constexpr size_t kMaxTargets = 4;
+	
+	/**
+	 *  Maximum number of slots in the ring buffer
+	 */
+	static constexpr uint32_t kMaxCapacity = 4096;
+	
+	/**
+	 *  The ring buffer of published requests
+	 */
+	BrightnessRequest *slots {nullptr};
+	
+	/**
+	 *  The number of slots in the ring buffer minus one
+	 *
+	 *  @note The number of slots is a power of two, so that free-running indices map to slots by masking
+	 *        and stay contiguous when they wrap around.
+	 */
+	uint32_t mask {0};
+	
+	/**
+	 *  The index of the next request to be consumed, written by the consumer only
+	 */
+	uint32_t head {0};
+	
+	/**
+	 *  The index of the next request to be published, written by the producer only
+	 */
+	uint32_t tail {0};
+	
+	/**
+	 *  The identifier of the last published request, written by the producer only
+	 */
+	uint32_t lastId {0};
+	
+	/**
+	 *  The latest request of a register that did not fit into the ring buffer
+	 */
+	struct Overflow {
+		/**
+		 *  The sequence lock of the slot, odd while the producer is writing
+		 */
+		uint32_t sequence {0};
+		
+		/**
+		 *  The request, written by the producer only
+		 */
+		BrightnessRequest request;
+	} overflows[kMaxTargets];
+	
+	/**
+	 *  Coalesced targets owned by the consumer
+	 */
+	struct Target {
+		/**
+		 *  The latest request for the register, its identifier is kept after the request is taken
+		 */
+		BrightnessRequest request;
+		
+		/**
+		 *  `true` if the request has not been taken yet
+		 */
+		bool pending {false};
+	} targets[kMaxTargets];
+	
+	/**
+	 *  Merge a request into the coalesced targets
+	 *
+	 *  @param request A published request
+	 *  @return `true` if the request is newer than the known target of the same register.
+	 */
+	bool coalesce(const BrightnessRequest &request);
+	
+	/**
+	 *  Move all published requests to the coalesced targets
+	 *
+	 *  @return `true` if at least one target has been updated.
+	 */
+	bool collect();
+	
+public:
+	/**
+	 *  Allocate the queue
+	 *
+	 *  @param size The number of requests that can be published before the consumer catches up,
+	 *              rounded up to a power of two and limited to `kMaxCapacity`
+	 *  @return `true` on success, `false` otherwise.
+	 */
+	bool init(uint32_t size);
+	
+	/**
+	 *  Release the queue
+	 */
+	void deinit();
+	
+	/**
+	 *  [Producer] Publish a request
+	 *
+	 *  @param request A request, its identifier is assigned by the queue
+	 */
+	void push(BrightnessRequest request);
+	
+	/**
+	 *  [Consumer] Take the latest pending request of a register
+	 *
+	 *  @param request The pending request on return
+	 *  @return `true` if a request is pending, `false` otherwise.
+	 */
+	bool pop(BrightnessRequest &request);
+	
+};
+
+/**
+ *  A brightness transition of a single controller register
+ */
+struct BrightnessTransition {
+	/**
+	 *  The latest request of the register
+	 */
+	BrightnessRequest request;
+	
+	/**
+	 *  The step engine of the transition
+	 */
+	BrightnessRamp ramp;
 };
 
 /**
- *  An event source that adjusts the brightness smoothly
+ *  An event source that starts or retargets brightness transitions when requests are submitted
  */
 class BrightnessRequestEventSource: public IOEventSource {
 	/**
@@ -112,10 +267,9 @@ class BrightnessRequestEventSource: public IOEventSource {
 	using super = IOEventSource;
 	
 	/**
-	 *  Check whether a brightness adjustment request is pending and if so process the request on the workloop
+	 *  Take pending brightness adjustment requests and start or retarget their transitions on the workloop
 	 *
-	 *  @return `true` if the work loop should invoke this function again.
-	 *          i.e., One or more requests are pending after the workloop has processed the current one.
+	 *  @return `false`, the event source is enabled again when a new request is submitted.
 	 */
 	bool checkForWork() override;
 	
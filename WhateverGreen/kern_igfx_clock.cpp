@@ -152,10 +152,7 @@ void IGFX::DPCDMaxLinkRateFix::processFramebufferKextForCFL(KernelPatcher &patch
 		orgCFLReadAUX
 	};
 	
-	if (patcher.routeMultiple(index, &request, 1, address, size))
-		DBGLOG("igfx", "MLR: [CFL-] Functions have been routed successfully.");
-	else
-		SYSLOG("igfx", "MLR: [CFL-] Failed to route functions.");
+	callbackIGFX->routeBatch.add(request, "MLR: [CFL-] Failed to route functions.");
 }
 
 void IGFX::DPCDMaxLinkRateFix::processFramebufferKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
@@ -687,8 +684,7 @@ void IGFX::HDMIDividersCalcFix::processKernel(KernelPatcher &patcher, DeviceInfo
 
 void IGFX::HDMIDividersCalcFix::processFramebufferKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
 	KernelPatcher::RouteRequest request("__ZN31AppleIntelFramebufferController17ComputeHdmiP0P1P2EjP21AppleIntelDisplayPathPNS_10CRTCParamsE", wrapComputeHdmiP0P1P2);
-	if (!patcher.routeMultiple(index, &request, 1, address, size))
-		SYSLOG("igfx", "HDC: Failed to route the function.");
+	callbackIGFX->routeBatch.add(request, "HDC: Failed to route the function.");
 }
 
 void IGFX::HDMIDividersCalcFix::populateP0P1P2(struct ProbeContext *context) {
@@ -914,8 +910,7 @@ void IGFX::MaxPixelClockOverride::processFramebufferKext(KernelPatcher &patcher,
 		orgConnectionProbe
 	};
 
-	if (!patcher.routeMultiple(index, &routeRequest, 1, address, size))
-		SYSLOG("igfx", "MPC: Failed to route the function.");
+	callbackIGFX->routeBatch.add(routeRequest, "MPC: Failed to route the function.");
 }
 
 IOReturn IGFX::MaxPixelClockOverride::wrapConnectionProbe(IOService *that, unsigned int unk1, unsigned int unk2) {
@@ -0,0 +1,374 @@
+//
+//  kern_igfx_inject.hpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_igfx_inject_hpp
+#define kern_igfx_inject_hpp
+
+#include <Headers/kern_util.hpp>
+
+//
+// MARK: - Injection Kits
+//
+// The kits have no dependencies on the kernel, so that they can be tested and measured on any host.
+//
+
+/**
+ *  Describes how to inject code into a shared submodule
+ *
+ *  @tparam T Specify the type of the trigger
+ *  @tparam I Specify the type of the function to inject code
+ *  @example The trigger type can be an integer type to inject code based on a register address.
+ */
+template <typename T, typename I>
+struct InjectionDescriptor {
+	/**
+	 *  The trigger value to be monitored by the coordinator
+	 */
+	T trigger {};
+
+	/**
+	 *  A function to invoke when the trigger value is observed
+	 *
+	 *  @example One may monitor a specific register address and modify its value in the injector function.
+	 */
+	I injector {};
+
+	/**
+	 *  Default priority of a descriptor
+	 */
+	static constexpr uint32_t kDefaultPriority = 1000;
+	
+	/**
+	 *  Priority of the descriptor among descriptors sharing the same trigger
+	 *
+	 *  @note Descriptors with a smaller value are invoked first.
+	 */
+	uint32_t priority {kDefaultPriority};
+
+	/**
+	 *  A pointer to the next descriptor in a linked list
+	 */
+	InjectionDescriptor *next {nullptr};
+
+	/**
+	 *  Create an injection descriptor conveniently
+	 */
+	InjectionDescriptor(T t, I i, uint32_t p = kDefaultPriority) :
+		trigger(t), injector(i), priority(p), next(nullptr) { }
+	
+	/**
+	 *  Member type `Trigger` is required by the coordinator
+	 */
+	using Trigger = T;
+	
+	/**
+	 *  Member type `Injector` is required by the coordinator
+	 */
+	using Injector = I;
+};
+
+/**
+ *  Represents a list of injection descriptors
+ *
+ *  @tparam D Specify the concrete type of the descriptor
+ */
+template <typename D>
+struct InjectionDescriptorList {
+private:
+	/**
+	 *  Head of the list
+	 */
+	D *head {nullptr};
+	
+	/**
+	 *  Tail of the list
+	 */
+	D *tail {nullptr};
+	
+public:
+	/**
+	 *  Get the injector function associated with the given trigger
+	 *
+	 *  @param trigger The trigger value
+	 *  @return The injector function on success, `nullptr` if the given trigger is not in the list.
+	 */
+	typename D::Injector getInjector(typename D::Trigger trigger) {
+		for (auto current = head; current != nullptr; current = current->next)
+			if (current->trigger == trigger)
+				return current->injector;
+		
+		return nullptr;
+	}
+	
+	/**
+	 *  Get the next injector function in the chain associated with the given trigger
+	 *
+	 *  @param trigger The trigger value
+	 *  @param priority The priority of the calling injector
+	 *  @return The first injector function invoked after the calling one, `nullptr` if there is none.
+	 *  @note Injectors use this function to pass the request through to the next injector in the chain.
+	 */
+	typename D::Injector getInjector(typename D::Trigger trigger, uint32_t priority) {
+		for (auto current = head; current != nullptr; current = current->next)
+			if (current->trigger == trigger && current->priority > priority)
+				return current->injector;
+		
+		return nullptr;
+	}
+	
+	/**
+	 *  Add an injection descriptor to the list
+	 *
+	 *  @param descriptor A non-null descriptor that specifies the trigger, the injector function and its priority
+	 *  @note Multiple descriptors may share the same trigger and form a chain ordered by their priorities.
+	 *        The coordinator invokes the first one, which may pass the request through to the next one.
+	 *        Descriptors of the same priority are ordered on a first come, first served basis.
+	 */
+	void add(D *descriptor NONNULL) {
+		// Sanitize garbage value
+		descriptor->next = nullptr;
+		
+		// Empty list
+		if (head == nullptr) {
+			head = tail = descriptor;
+			return;
+		}
+		
+		// New head
+		if (descriptor->priority < head->priority) {
+			descriptor->next = head;
+			head = descriptor;
+			return;
+		}
+		
+		// Insert after all descriptors with the same or a smaller priority value
+		auto current = head;
+		while (current->next != nullptr && current->next->priority <= descriptor->priority)
+			current = current->next;
+		
+		descriptor->next = current->next;
+		current->next = descriptor;
+		
+		// Update the tail
+		if (descriptor->next == nullptr)
+			tail = descriptor;
+	}
+	
+	/**
+	 *  Invoke the given function on each descriptor in the list
+	 *
+	 *  @param function A function that takes a pointer to the descriptor
+	 */
+	template <typename F>
+	void forEach(F function) {
+		for (auto current = head; current != nullptr; current = current->next)
+			function(current);
+	}
+};
+
+/**
+ *  An injection coordinator is capable of coordinating multiple requests of injection to a shared function
+ *
+ *  @tparam P Specify the type of the prologue injection descriptor that defines how the coordinator injects code before it calls the original function
+ *  @tparam R Specify the type of the replacer injection descriptor that defines how the coordinator replaces the original function implementation
+ *  @tparam E Specify the type of the epilogue injection descriptor that defines how the coordinator injects code after it calls the original function
+ *  @note Patch submodules inherited from this class get coordination support automatically.
+ *  @note Patch submodules invoke the `add()` method of a list to register injections.
+ *  @note The coordinator invokes `freeze()` once all submodules have registered their injections,
+ *        so that `lookup()` no longer walks the lists on each call.
+ */
+template <typename P, typename R, typename E>
+class InjectionCoordinator {
+	/**
+	 *  Maximum number of unique triggers supported by the frozen dispatch table
+	 */
+	static constexpr size_t MaxDispatchEntries = 16;
+	
+	/**
+	 *  Injectors associated with a single trigger
+	 */
+	struct DispatchEntry {
+		typename P::Trigger trigger;
+		typename P::Injector prologue;
+		typename R::Injector replacer;
+		typename E::Injector epilogue;
+	};
+	
+	/**
+	 *  A frozen dispatch table sorted by the trigger value
+	 */
+	struct DispatchTable {
+		/**
+		 *  A 256-bit filter of registered triggers to reject unmonitored triggers with a single memory access
+		 */
+		uint64_t filter[4];
+		
+		/**
+		 *  Number of entries in the table
+		 */
+		size_t count;
+		
+		/**
+		 *  Entries sorted by the trigger value
+		 */
+		DispatchEntry entries[MaxDispatchEntries];
+	};
+	
+	/**
+	 *  Dispatch tables
+	 *
+	 *  @note A new table is built in the inactive slot and then published,
+	 *        so concurrent lookups never observe a partially built table.
+	 */
+	DispatchTable dispatchTables[2] {};
+	
+	/**
+	 *  The active dispatch table or `nullptr` if the coordinator is not frozen yet
+	 */
+	DispatchTable *activeDispatchTable {nullptr};
+	
+	/**
+	 *  Get the filter bit index of the given trigger
+	 */
+	static size_t getFilterIndex(typename P::Trigger trigger) {
+		return (static_cast<size_t>(trigger) >> 2) & 0xFF;
+	}
+	
+	/**
+	 *  Insert the injector of the given descriptor into the table being built
+	 *
+	 *  @param table The table being built
+	 *  @param trigger The trigger value
+	 *  @return The entry associated with the trigger, `nullptr` if the table is full.
+	 */
+	static DispatchEntry *getOrInsertEntry(DispatchTable *table, typename P::Trigger trigger) {
+		// Keep the entries sorted by the trigger value
+		size_t i = 0;
+		while (i < table->count && table->entries[i].trigger < trigger)
+			i++;
+		
+		if (i < table->count && table->entries[i].trigger == trigger)
+			return &table->entries[i];
+		
+		if (table->count == MaxDispatchEntries)
+			return nullptr;
+		
+		for (size_t j = table->count; j > i; j--)
+			table->entries[j] = table->entries[j - 1];
+		
+		table->entries[i] = {trigger, nullptr, nullptr, nullptr};
+		table->count++;
+		table->filter[getFilterIndex(trigger) / 64] |= 1ULL << (getFilterIndex(trigger) % 64);
+		return &table->entries[i];
+	}
+	
+public:
+	/**
+	 *  Virtual destructor
+	 */
+	virtual ~InjectionCoordinator() = default;
+	
+	/**
+	 *  A list of prologue injection descriptors
+	 */
+	InjectionDescriptorList<P> prologueList {};
+	
+	/**
+	 *  A list of replacer injection descriptors
+	 */
+	InjectionDescriptorList<R> replacerList {};
+	
+	/**
+	 *  A list of epilogue injection descriptors
+	 */
+	InjectionDescriptorList<E> epilogueList {};
+	
+	/**
+	 *  Build the dispatch table from the registered injection descriptors
+	 *
+	 *  @return `true` on success, `false` if there are too many unique triggers.
+	 *  @note The coordinator keeps walking the lists if the table cannot be built.
+	 *  @note The table holds the first injector in the chain of each trigger, same as `InjectionDescriptorList::getInjector()`.
+	 */
+	bool freeze() {
+		auto table = &dispatchTables[activeDispatchTable == &dispatchTables[0] ? 1 : 0];
+		*table = {};
+		
+		bool success = true;
+		prologueList.forEach([&](P *descriptor) {
+			auto entry = getOrInsertEntry(table, descriptor->trigger);
+			if (entry == nullptr)
+				success = false;
+			else if (entry->prologue == nullptr)
+				entry->prologue = descriptor->injector;
+		});
+		replacerList.forEach([&](R *descriptor) {
+			auto entry = getOrInsertEntry(table, descriptor->trigger);
+			if (entry == nullptr)
+				success = false;
+			else if (entry->replacer == nullptr)
+				entry->replacer = descriptor->injector;
+		});
+		epilogueList.forEach([&](E *descriptor) {
+			auto entry = getOrInsertEntry(table, descriptor->trigger);
+			if (entry == nullptr)
+				success = false;
+			else if (entry->epilogue == nullptr)
+				entry->epilogue = descriptor->injector;
+		});
+		
+		__atomic_store_n(&activeDispatchTable, success ? table : nullptr, __ATOMIC_RELEASE);
+		return success;
+	}
+	
+	/**
+	 *  Get the injectors associated with the given trigger
+	 *
+	 *  @param trigger The trigger value
+	 *  @param prologue Set to the prologue injector on return
+	 *  @param replacer Set to the replacer injector on return
+	 *  @param epilogue Set to the epilogue injector on return
+	 *  @return `true` if at least one injector is associated with the trigger, `false` otherwise.
+	 */
+	bool lookup(typename P::Trigger trigger, typename P::Injector &prologue, typename R::Injector &replacer, typename E::Injector &epilogue) {
+		auto table = __atomic_load_n(&activeDispatchTable, __ATOMIC_ACQUIRE);
+		if (UNLIKELY(table == nullptr)) {
+			// Not frozen yet
+			prologue = prologueList.getInjector(trigger);
+			replacer = replacerList.getInjector(trigger);
+			epilogue = epilogueList.getInjector(trigger);
+			return prologue != nullptr || replacer != nullptr || epilogue != nullptr;
+		}
+		
+		// Guard: Most triggers are not monitored
+		auto index = getFilterIndex(trigger);
+		if (LIKELY((table->filter[index / 64] & (1ULL << (index % 64))) == 0))
+			return false;
+		
+		// Binary search in the sorted table
+		size_t low = 0, high = table->count;
+		while (low < high) {
+			size_t mid = (low + high) / 2;
+			auto &entry = table->entries[mid];
+			if (entry.trigger == trigger) {
+				prologue = entry.prologue;
+				replacer = entry.replacer;
+				epilogue = entry.epilogue;
+				return true;
+			}
+			
+			if (entry.trigger < trigger)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		
+		return false;
+	}
+};
+
+#endif /* kern_igfx_inject_hpp */
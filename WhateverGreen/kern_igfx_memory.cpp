@@ -123,11 +123,6 @@ void IGFX::DVMTCalcFix::processFramebufferKext(KernelPatcher &patcher, size_t in
 	// - FireWolf
 	// - 2020.08
 	//
-	hde64s handle;
-	uint64_t shllAddr = 0, andlAddr = 0; /* Instruction Address  */
-	uint32_t shllSize = 0, andlSize = 0; /* Instruction Length   */
-	uint32_t shllDstr = 0, andlDstr = 0; /* Destination Register */
-	
 	// e.g. movl $0x03C00000, %eax (60MB DVMT)
 	// Apply the middle 5 bytes if the target register is %eax;
 	// Apply the last 6 bytes if the target register is below %r8d;
@@ -141,78 +136,73 @@ void IGFX::DVMTCalcFix::processFramebufferKext(KernelPatcher &patcher, size_t in
 	// As such, we need to first figure out which register is of interest, and
 	// we need 5 or 6 bytes to move a 32-bit integer to the register manipulated by the above instructions.
 	// Since `andl` is 5 - 7 bytes long, we could just replace it with a "movl" and then erases `shll` by filling `nop`s.
-	for (auto index = 0; index < 64; index += 1) {
-		auto size = Disassembler::hdeDisasm(startAddress, &handle);
-		
-		// Guard: Should be able to disassemble the function
-		if (handle.flags & F_ERROR) {
-			SYSLOG("igfx", "DVMT: Failed to disassemble FBMemMgr_Init().");
-			break;
-		}
-		
+	static constexpr InstructionPattern patterns[] {
 		// Instruction: shll $0x11, %???
 		// 3 bytes long if DSTReg < %r8d, otherwise 4 bytes long
-		if (handle.opcode == 0xC1 && handle.imm.imm8 == 0x11) {
-			shllAddr = startAddress;
-			shllSize = handle.len;
-			shllDstr = (handle.rex_b << 3) | handle.modrm_rm;
-			SYSLOG("igfx", "DVMT: Found the shll instruction. Length = %d; DSTReg = %d.", shllSize, shllDstr);
-		}
-		
+		InstructionPattern().opcode(0xC1).imm(0x11),
 		// Instruction: andl $0xFE000000, %???
 		// 5 bytes long if DSTReg is %eax; 6 bytes long if DSTReg < %r8d; otherwise 7 bytes long.
-		if ((handle.opcode == 0x25 || handle.opcode == 0x81) && handle.imm.imm32 == 0xFE000000) {
-			andlAddr = startAddress;
-			andlSize = handle.len;
-			andlDstr = (handle.rex_b << 3) | handle.modrm_rm;
-			SYSLOG("igfx", "DVMT: Found the andl instruction. Length = %d; DSTReg = %d.", andlSize, andlDstr);
-		}
-		
-		// Guard: Calculate and apply the binary patch if we have found both instructions
-		if (shllAddr && andlAddr) {
-			// Update the `movl` instruction with the actual amount of DVMT preallocated memory
-			*reinterpret_cast<uint32_t*>(movl + 2) = dvmt;
-			
-			// Update the `movl` instruction with the actual destination register
-			// Find the actual starting point of the patch and the number of bytes to patch
-			uint8_t* patchStart;
-			uint32_t patchSize;
-			if (andlDstr >= 8) {
-				// %r8d, %r9d, ..., %r15d
-				movl[1] += (andlDstr - 8);
-				patchStart = movl;
-				patchSize = 7;
-			} else {
-				// %eax, %ecx, ..., %edi
-				movl[1] += andlDstr;
-				patchStart = (movl + 1);
-				patchSize = andlDstr == 0 ? /* %eax */ 5 : /* others */ 6;
-			}
-			
-			// Guard: Prepare to apply the binary patch
-			if (MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) != KERN_SUCCESS) {
-				SYSLOG("igfx", "DVMT: Failed to set kernel writing. Aborted patching.");
-				return;
-			}
-			
-			// Replace `shll` with `nop`s
-			// The number of nops is determined by the actual instruction length
-			lilu_os_memcpy(reinterpret_cast<void*>(shllAddr), nops, shllSize);
-			
-			// Replace `andl` with `movl`
-			// The patch contents and size are determined by the destination register of `andl`
-			lilu_os_memcpy(reinterpret_cast<void*>(andlAddr), patchStart, patchSize);
-			
-			// Finished applying the binary patch
-			MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
-			DBGLOG("igfx", "DVMT: Calculation patch has been applied successfully.");
-			return;
-		}
-		
-		startAddress += size;
+		InstructionPattern().opcode(0x25, 0x81).imm(0xFE000000),
+	};
+	
+	// The instructions may appear in any order
+	DecodedFunction function {Disassembler::hdeDisasm, startAddress, 64};
+	const DecodedInstruction *matches[arrsize(patterns)];
+	InstructionCaptures captures;
+	if (!function.find(patterns, arrsize(patterns), matches, captures, 64, false)) {
+		// Guard: Should be able to disassemble the function
+		if (function.hasError())
+			SYSLOG("igfx", "DVMT: Failed to disassemble FBMemMgr_Init().");
+		SYSLOG("igfx", "DVMT: Failed to find instructions of interest. Aborted patching.");
+		return;
+	}
+	
+	auto shllAddr = matches[0]->address;
+	uint32_t shllSize = matches[0]->handle.len;
+	uint32_t shllDstr = matches[0]->rm();
+	SYSLOG("igfx", "DVMT: Found the shll instruction. Length = %d; DSTReg = %d.", shllSize, shllDstr);
+	
+	auto andlAddr = matches[1]->address;
+	uint32_t andlSize = matches[1]->handle.len;
+	uint32_t andlDstr = matches[1]->rm();
+	SYSLOG("igfx", "DVMT: Found the andl instruction. Length = %d; DSTReg = %d.", andlSize, andlDstr);
+	
+	// Update the `movl` instruction with the actual amount of DVMT preallocated memory
+	*reinterpret_cast<uint32_t*>(movl + 2) = dvmt;
+	
+	// Update the `movl` instruction with the actual destination register
+	// Find the actual starting point of the patch and the number of bytes to patch
+	uint8_t* patchStart;
+	uint32_t patchSize;
+	if (andlDstr >= 8) {
+		// %r8d, %r9d, ..., %r15d
+		movl[1] += (andlDstr - 8);
+		patchStart = movl;
+		patchSize = 7;
+	} else {
+		// %eax, %ecx, ..., %edi
+		movl[1] += andlDstr;
+		patchStart = (movl + 1);
+		patchSize = andlDstr == 0 ? /* %eax */ 5 : /* others */ 6;
 	}
 	
-	SYSLOG("igfx", "DVMT: Failed to find instructions of interest. Aborted patching.");
+	// Guard: Prepare to apply the binary patch
+	if (MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock) != KERN_SUCCESS) {
+		SYSLOG("igfx", "DVMT: Failed to set kernel writing. Aborted patching.");
+		return;
+	}
+	
+	// Replace `shll` with `nop`s
+	// The number of nops is determined by the actual instruction length
+	lilu_os_memcpy(reinterpret_cast<void*>(shllAddr), nops, shllSize);
+	
+	// Replace `andl` with `movl`
+	// The patch contents and size are determined by the destination register of `andl`
+	lilu_os_memcpy(reinterpret_cast<void*>(andlAddr), patchStart, patchSize);
+	
+	// Finished applying the binary patch
+	MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
+	DBGLOG("igfx", "DVMT: Calculation patch has been applied successfully.");
 }
 
 // MARK: - Display Data Buffer Early Optimizer
@@ -308,5 +298,5 @@ void IGFX::DisplayDataBufferEarlyOptimizer::processKernel(KernelPatcher &patcher
 
 void IGFX::DisplayDataBufferEarlyOptimizer::processFramebufferKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
 	KernelPatcher::RouteRequest request("__ZN31AppleIntelFramebufferController17getFeatureControlEv", wrapGetFeatureControl, orgGetFeatureControl);
-	SYSLOG_COND(!patcher.routeMultiple(index, &request, 1, address, size), "igfx", "DBEO: Failed to route the function.");
+	callbackIGFX->routeBatch.add(request, "DBEO: Failed to route the function.");
 }
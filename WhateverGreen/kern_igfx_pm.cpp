@@ -55,8 +55,12 @@ struct [[gnu::packed]] IGHwCsDesc {
 constexpr uint32_t MCHBAR_MIRROR_BASE_SNB = 0x140000;
 constexpr uint32_t GEN6_RP_STATE_CAP = MCHBAR_MIRROR_BASE_SNB + 0x5998;
 
+constexpr uint32_t GEN6_GT_GFX_RC6 = 0x138108;
+constexpr uint32_t GEN6_RC6_RESIDENCY_UNIT_NS = 1280;
+
 constexpr uint32_t GEN9_FREQUENCY_SHIFT = 23;
 constexpr uint32_t GEN9_FREQ_SCALER  = 3;
+constexpr uint32_t GEN9_FREQ_UNIT_MHZ = 50;
 
 constexpr uint32_t FORCEWAKE_KERNEL_FALLBACK = 1 << 15;
 
@@ -144,6 +148,19 @@ void IGFX::RPSControlPatch::processKernel(KernelPatcher &patcher, DeviceInfo *in
 		enabled = rpsc > 0 && available;
 		DBGLOG("weg", "RPS control patch overriden (%u) availabile %d", rpsc, available);
 	}
+	
+	uint32_t rpsg = 0;
+	if (enabled && WIOKit::getOSDataValue(info->videoBuiltin, "rps-governor", rpsg) && rpsg > 0) {
+		governorEnabled = true;
+		WIOKit::getOSDataValue(info->videoBuiltin, "rps-governor-floor", governorConfig.floor);
+		WIOKit::getOSDataValue(info->videoBuiltin, "rps-governor-ceiling", governorConfig.ceiling);
+		WIOKit::getOSDataValue(info->videoBuiltin, "rps-governor-up", governorConfig.upThreshold);
+		WIOKit::getOSDataValue(info->videoBuiltin, "rps-governor-down", governorConfig.downThreshold);
+		WIOKit::getOSDataValue(info->videoBuiltin, "rps-governor-up-hold", governorConfig.upHold);
+		WIOKit::getOSDataValue(info->videoBuiltin, "rps-governor-down-hold", governorConfig.downHold);
+		DBGLOG(log, "RPS governor enabled floor %u ceiling %u MHz up %u down %u hold %u/%u", governorConfig.floor, governorConfig.ceiling,
+			   governorConfig.upThreshold, governorConfig.downThreshold, governorConfig.upHold, governorConfig.downHold);
+	}
 }
 
 void IGFX::RPSControlPatch::processFramebufferKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
@@ -153,8 +170,7 @@ void IGFX::RPSControlPatch::processFramebufferKext(KernelPatcher &patcher, size_
 		orgPmNotifyWrapper
 	};
 	
-	if (!patcher.routeMultiple(index, &routeRequest, 1, address, size))
-		SYSLOG(log, "Failed to route pmNotifyWrapper.");
+	callbackIGFX->routeBatch.add(routeRequest, "RPSC: Failed to route pmNotifyWrapper.");
 }
 
 void IGFX::RPSControlPatch::processGraphicsKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
@@ -178,53 +194,76 @@ void IGFX::RPSControlPatch::processGraphicsKext(KernelPatcher &patcher, size_t i
 }
 
 int IGFX::RPSControlPatch::wrapPmNotifyWrapper(unsigned int a0, unsigned int a1, unsigned long long *a2, unsigned int *freq) {
-	// Request the maximum RPS at exec list submission
+	// Request the maximum RPS at exec list submission, or the governor pick when it is enabled
 	// While this sounds dangerous, we are still getting proper power management due to force wake clears.
 	uint32_t cfreq = 0;
-	callbackIGFX->modRPSControlPatch.orgPmNotifyWrapper(a0, a1, a2, &cfreq);
+	auto &rps = callbackIGFX->modRPSControlPatch;
+	rps.orgPmNotifyWrapper(a0, a1, a2, &cfreq);
 	
-	if (!callbackIGFX->modRPSControlPatch.freq_max) {
-		callbackIGFX->modRPSControlPatch.freq_max = callbackIGFX->readRegister32(callbackIGFX->defaultController(), GEN6_RP_STATE_CAP) & 0xFF;
-		DBGLOG("log", "Read RP0 %d", callbackIGFX->modRPSControlPatch.freq_max);
+	auto controller = callbackIGFX->defaultController();
+	if (!rps.freq_max) {
+		auto cap = callbackIGFX->readRegister32(controller, GEN6_RP_STATE_CAP);
+		rps.freq_max = cap & 0xFF;
+		DBGLOG("log", "Read RP0 %d", rps.freq_max);
+		
+		if (rps.governorEnabled) {
+			// Clamp the user limits to RPn..RP0
+			uint32_t freq_min = (cap >> 16) & 0xFF;
+			auto clamp = [&](uint32_t mhz, uint32_t fallback) {
+				uint32_t value = mhz != 0 ? mhz / GEN9_FREQ_UNIT_MHZ : fallback;
+				return value < freq_min ? freq_min : (value > rps.freq_max ? rps.freq_max : value);
+			};
+			auto config = rps.governorConfig;
+			config.floor = clamp(config.floor, freq_min);
+			config.ceiling = clamp(config.ceiling, rps.freq_max);
+			if (!rps.governor.configure(config))
+				SYSLOG(log, "RPS governor got invalid tunables, using defaults where needed");
+			rps.governorSampleTime = mach_absolute_time();
+			rps.governorSampleIdle = callbackIGFX->readRegister32(controller, GEN6_GT_GFX_RC6);
+			DBGLOG(log, "RPS governor limits %u..%u", rps.governor.getConfig().floor, rps.governor.getConfig().ceiling);
+		}
 	}
 	
-	*freq = (GEN9_FREQ_SCALER << GEN9_FREQUENCY_SHIFT) * callbackIGFX->modRPSControlPatch.freq_max;
+	uint32_t target = rps.governorEnabled ? rps.updateGovernor(controller) : rps.freq_max;
+	*freq = (GEN9_FREQ_SCALER << GEN9_FREQUENCY_SHIFT) * target;
 	return 0;
 }
 
-bool IGFX::RPSControlPatch::patchRCSCheck(mach_vm_address_t& start) {
-	constexpr unsigned ninsts_max {256};
+uint32_t IGFX::RPSControlPatch::updateGovernor(void *controller) {
+	auto now = mach_absolute_time();
+	uint64_t elapsed;
+	absolutetime_to_nanoseconds(now - governorSampleTime, &elapsed);
+	if (elapsed < kGovernorInterval * 1000000ULL)
+		return governor.current();
 	
-	hde64s dis;
+	// RC6 residency ticks every 1.28 us while the GPU idles, the difference is valid across a single wraparound
+	auto idle = callbackIGFX->readRegister32(controller, GEN6_GT_GFX_RC6);
+	uint64_t idleTime = static_cast<uint64_t>(idle - governorSampleIdle) * GEN6_RC6_RESIDENCY_UNIT_NS;
+	governorSampleTime = now;
+	governorSampleIdle = idle;
 	
-	bool found_cmp = false;
-	bool found_jmp = false;
-
-	for (size_t i = 0; i < ninsts_max; i++) {
-		auto sz = Disassembler::hdeDisasm(start, &dis);
-
-		if (dis.flags & F_ERROR) {
-			SYSLOG(log, "Error disassembling submitExecList");
-			break;
-		}
+	return governor.update(elapsed > idleTime ? elapsed - idleTime : 0, elapsed);
+}
 
+bool IGFX::RPSControlPatch::patchRCSCheck(mach_vm_address_t start) {
+	constexpr unsigned ninsts_max {256};
+	
+	static constexpr InstructionPattern patterns[] {
 		/* cmp byte ptr [rcx], 0 */
-		if (!found_cmp && dis.opcode == 0x80 && dis.modrm_reg == 7 && dis.modrm_rm == 1)
-			found_cmp = true;
+		InstructionPattern().opcode(0x80).reg(7).rm(1),
 		/* jnz rel32 */
-		if (found_cmp && dis.opcode == 0x0f && dis.opcode2 == 0x85) {
-			found_jmp = true;
-			break;
-		}
-
-		start += sz;
-	}
+		InstructionPattern().opcode(0x0f).opcode2(0x85),
+	};
+	
+	DecodedFunction function {Disassembler::hdeDisasm, start, ninsts_max};
+	const DecodedInstruction *matches[arrsize(patterns)];
+	InstructionCaptures captures;
 	
-	if (found_jmp) {
+	if (function.find(patterns, arrsize(patterns), matches, captures, ninsts_max)) {
 		auto status = MachInfo::setKernelWriting(true, KernelPatcher::kernelWriteLock);
 		if (status == KERN_SUCCESS) {
 			constexpr uint8_t nop6[] {0x90, 0x90, 0x90, 0x90, 0x90, 0x90};
-			lilu_os_memcpy(reinterpret_cast<void*>(start), nop6, arrsize(nop6));
+			lilu_os_memcpy(reinterpret_cast<void*>(matches[1]->address), nop6, arrsize(nop6));
 			MachInfo::setKernelWriting(false, KernelPatcher::kernelWriteLock);
 			DBGLOG(log, "Patched submitExecList");
 			return true;
@@ -233,6 +272,8 @@ bool IGFX::RPSControlPatch::patchRCSCheck(mach_vm_address_t& start) {
 			return false;
 		}
 	} else {
+		if (function.hasError())
+			SYSLOG(log, "Error disassembling submitExecList");
 		SYSLOG(log, "jnz in submitExecList not found");
 		return false;
 	}
@@ -244,17 +285,25 @@ bool IGFX::ForceWakeWorkaround::pollRegister(uint32_t reg, uint32_t val, uint32_
 	AbsoluteTime now, deadline;
 
 	clock_interval_to_deadline(timeout, kMillisecondScale, &deadline);
+	auto controller = callbackIGFX->defaultController();
 	
-	for (clock_get_uptime(&now); now < deadline; clock_get_uptime(&now)) {
-		auto rd = callbackIGFX->readRegister32(callbackIGFX->defaultController(), reg);
+	for (uint32_t attempt = 0; ; attempt++) {
+		auto rd = callbackIGFX->readRegister32(controller, reg);
 
 //		DBGLOG(log, "Rd 0x%x = 0x%x, expected 0x%x", reg, rd, val);
 
 		if ((rd & mask) == val)
 			return true;
+		
+		clock_get_uptime(&now);
+		if (now >= deadline)
+			return false;
+		
+		// We cannot sleep here, so back off with busy waits to leave the bus alone
+		auto delay = PollBackoff::delay(attempt);
+		if (delay != 0)
+			IODelay(delay);
 	}
-
-	return false;
 }
 
 bool IGFX::ForceWakeWorkaround::forceWakeWaitAckFallback(uint32_t d, uint32_t val, uint32_t mask) {
@@ -296,15 +345,93 @@ void IGFX::ForceWakeWorkaround::forceWake(void*, uint8_t set, uint32_t dom, uint
 	
 	for (unsigned d = DOM_FIRST; d <= DOM_LAST; d <<= 1)
 	if (dom & d) {
+		auto start = mach_absolute_time();
 		callbackIGFX->writeRegister32(callbackIGFX->defaultController(), regForDom(d), wr);
 		IOPause(100);
-		if (!pollRegister(ackForDom(d), ack_exp, mask, FORCEWAKE_ACK_TIMEOUT_MS) &&
-			!forceWakeWaitAckFallback(d, ack_exp, mask) &&
-			!pollRegister(ackForDom(d), ack_exp, mask, FORCEWAKE_ACK_TIMEOUT_MS))
-			PANIC(log, "ForceWake timeout for domain %s, expected 0x%x", strForDom(dom), ack_exp);
+		bool fallback = false;
+		if (!pollRegister(ackForDom(d), ack_exp, mask, FORCEWAKE_ACK_TIMEOUT_MS)) {
+			fallback = true;
+			if (!forceWakeWaitAckFallback(d, ack_exp, mask) &&
+				!pollRegister(ackForDom(d), ack_exp, mask, FORCEWAKE_ACK_TIMEOUT_MS))
+				PANIC(log, "ForceWake timeout for domain %s, expected 0x%x", strForDom(dom), ack_exp);
+		}
+		callbackIGFX->modForceWakeWorkaround.recordAck(__builtin_ctz(d), mach_absolute_time() - start, fallback);
 	}
 }
 
+void IGFX::ForceWakeWorkaround::recordAck(size_t domain, uint64_t latency, bool fallback) {
+	uint64_t ns;
+	absolutetime_to_nanoseconds(latency, &ns);
+	uint64_t us = ns / 1000;
+	size_t bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+	if (bucket >= kHistogramBuckets)
+		bucket = kHistogramBuckets - 1;
+	
+	__atomic_add_fetch(&ackHistogram[domain][bucket], 1, __ATOMIC_RELAXED);
+	if (fallback)
+		__atomic_add_fetch(&ackFallbacks[domain], 1, __ATOMIC_RELAXED);
+	
+	// Publish the histograms periodically
+	if (publisher && __atomic_add_fetch(&ackTotal, 1, __ATOMIC_RELAXED) % kPublishInterval == 0)
+		thread_call_enter(publisher);
+}
+
+void IGFX::ForceWakeWorkaround::publish(thread_call_param_t param0, thread_call_param_t param1) {
+	auto self = static_cast<ForceWakeWorkaround *>(param0);
+	
+	auto summary = OSDictionary::withCapacity(kDomainCount);
+	if (summary == nullptr) {
+		SYSLOG(log, "FWW: Failed to allocate the acknowledgement summary.");
+		return;
+	}
+	
+	for (size_t domain = 0; domain < kDomainCount; domain++) {
+		auto dict = OSDictionary::withCapacity(3);
+		auto histogram = OSArray::withCapacity(kHistogramBuckets);
+		if (dict == nullptr || histogram == nullptr) {
+			OSSafeReleaseNULL(dict);
+			OSSafeReleaseNULL(histogram);
+			break;
+		}
+		
+		uint64_t acks = 0;
+		for (size_t bucket = 0; bucket < kHistogramBuckets; bucket++) {
+			auto value = __atomic_load_n(&self->ackHistogram[domain][bucket], __ATOMIC_RELAXED);
+			acks += value;
+			auto number = OSNumber::withNumber(value, 64);
+			if (number) {
+				histogram->setObject(number);
+				number->release();
+			}
+		}
+		
+		const ppair<const char *, uint64_t> values[] {
+			{"acks", acks},
+			{"fallbacks", __atomic_load_n(&self->ackFallbacks[domain], __ATOMIC_RELAXED)},
+		};
+		for (auto &value : values) {
+			auto number = OSNumber::withNumber(value.second, 64);
+			if (number) {
+				dict->setObject(value.first, number);
+				number->release();
+			}
+		}
+		
+		dict->setObject("latency-log2-us", histogram);
+		histogram->release();
+		summary->setObject(strForDom(1U << domain), dict);
+		dict->release();
+	}
+	
+	auto entry = IORegistryEntry::fromPath("IOService:/IOResources/WhateverGreen");
+	if (entry) {
+		entry->setProperty("igfx-forcewake-ack", summary);
+		entry->release();
+	}
+	
+	summary->release();
+}
+
 void IGFX::ForceWakeWorkaround::init() {
 	// We only need to patch the acceleration driver
 	requiresPatchingGraphics = true;
@@ -317,12 +444,29 @@ void IGFX::ForceWakeWorkaround::init() {
 	requiresMMIORegistersWriteAccess = true;
 }
 
+void IGFX::ForceWakeWorkaround::deinit() {
+	if (publisher) {
+		thread_call_cancel(publisher);
+		thread_call_free(publisher);
+		publisher = nullptr;
+	}
+}
+
+void IGFX::ForceWakeWorkaround::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
+	if (!enabled)
+		return;
+	
+	// The histograms are diagnostics only, the workaround works without them
+	publisher = thread_call_allocate(publish, this);
+	if (publisher == nullptr)
+		SYSLOG(log, "FWW: Failed to allocate the acknowledgement publisher.");
+}
+
 void IGFX::ForceWakeWorkaround::processGraphicsKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
 	KernelPatcher::RouteRequest request = {
 		"__ZN16IntelAccelerator26SafeForceWakeMultithreadedEbjj",
 		forceWake
 	};
 	
-	if (!patcher.routeMultiple(index, &request, 1, address, size))
-		SYSLOG("igfx", "Failed to route SafeForceWake.");
+	callbackIGFX->routeBatch.add(request, "FWW: Failed to route SafeForceWake.");
 }
@@ -0,0 +1,159 @@
+//
+//  kern_igfx_ramp.hpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_igfx_ramp_hpp
+#define kern_igfx_ramp_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  Curves of brightness transitions
+ *
+ *  @note Curves are applied to the progress of a transition from the lower level to the higher one,
+ *        and mirrored when the brightness decreases, so transitions spend more steps at low levels.
+ */
+enum BrightnessCurve : uint32_t {
+	BrightnessCurveLinear = 0,
+	BrightnessCurveGamma = 1,
+	BrightnessCurveLogarithmic = 2,
+	BrightnessCurveEaseInOut = 3,
+	BrightnessCurveCount
+};
+
+/**
+ *  Number of points at which each brightness curve is sampled
+ */
+static constexpr size_t BrightnessCurveAnchorCount = 65;
+
+/**
+ *  One in the 16.16 fixed point format used by brightness curves
+ */
+static constexpr uint32_t BrightnessCurveOne = 1 << 16;
+
+/**
+ *  A step engine that moves a brightness level towards a target one step at a time
+ *
+ *  @note This class has no dependencies on the kernel, so that transitions can be simulated on any host.
+ *  @note The target can be changed in the middle of a transition, in which case the new transition
+ *        starts from the last level produced by the engine rather than from the register value.
+ */
+class BrightnessRamp {
+	/**
+	 *  The total number of steps of a transition
+	 */
+	uint32_t steps {1};
+	
+	/**
+	 *  Transitions shorter than or equal to the threshold complete in a single step
+	 */
+	uint32_t threshold {0};
+	
+	/**
+	 *  Progress of the transition after each step in 16.16 fixed point, `steps + 1` entries, or `nullptr` for a linear curve
+	 */
+	const uint32_t *curve {nullptr};
+	
+	/**
+	 *  The brightness level at the beginning of the transition
+	 */
+	uint32_t origin {0};
+	
+	/**
+	 *  The brightness level produced by the last step
+	 */
+	uint32_t current {0};
+	
+	/**
+	 *  The brightness level at the end of the transition
+	 */
+	uint32_t target {0};
+	
+	/**
+	 *  The number of completed steps in the transition
+	 */
+	uint32_t step {0};
+	
+	/**
+	 *  The number of steps in the transition
+	 */
+	uint32_t total {0};
+	
+public:
+	/**
+	 *  Configure the engine
+	 *
+	 *  @param steps The total number of steps of a transition, must not be zero
+	 *  @param threshold Transitions shorter than or equal to this distance complete in a single step
+	 *  @param curve Progress of the transition after each step in 16.16 fixed point, `steps + 1` entries, or `nullptr` for a linear curve
+	 */
+	void configure(uint32_t steps, uint32_t threshold, const uint32_t *curve = nullptr) {
+		this->steps = steps;
+		this->threshold = threshold;
+		this->curve = curve;
+	}
+	
+	/**
+	 *  Start a transition
+	 *
+	 *  @param from The current brightness level
+	 *  @param to The target brightness level
+	 */
+	void start(uint32_t from, uint32_t to) {
+		origin = current = from;
+		target = to;
+		step = 0;
+		uint32_t distance = from > to ? from - to : to - from;
+		total = distance == 0 ? 0 : (distance > threshold ? steps : 1);
+	}
+	
+	/**
+	 *  Change the target of the current transition
+	 *
+	 *  @param to The new target brightness level
+	 *  @note The new transition starts from the last level produced by the engine.
+	 */
+	void retarget(uint32_t to) {
+		start(current, to);
+	}
+	
+	/**
+	 *  Check whether the transition has remaining steps
+	 */
+	bool isActive() const {
+		return step < total;
+	}
+	
+	/**
+	 *  Advance the transition by a single step
+	 *
+	 *  @return The brightness level to be written for this step.
+	 *  @note The last step always produces the target level.
+	 */
+	uint32_t advance() {
+		if (step < total)
+			step++;
+		
+		if (step >= total) {
+			current = target;
+		} else {
+			uint64_t distance = origin > target ? origin - target : target - origin;
+			uint64_t delta;
+			if (curve == nullptr)
+				delta = distance * step / total;
+			else if (origin < target)
+				delta = (distance * curve[step]) >> 16;
+			else
+				delta = (distance * (BrightnessCurveOne - curve[total - step])) >> 16;
+			current = origin > target ? origin - static_cast<uint32_t>(delta) : origin + static_cast<uint32_t>(delta);
+		}
+		
+		return current;
+	}
+};
+
+#endif /* kern_igfx_ramp_hpp */
@@ -0,0 +1,458 @@
+//
+//  kern_insn.hpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_insn_hpp
+#define kern_insn_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <Headers/hde64.h>
+#include <Headers/kern_util.hpp>
+
+/**
+ *  A single decoded instruction
+ */
+struct DecodedInstruction {
+	/**
+	 *  Address of the instruction
+	 */
+	uint64_t address;
+
+	/**
+	 *  Decoder output
+	 */
+	hde64s handle;
+
+	/**
+	 *  Get the ModR/M reg operand extended by REX.R
+	 */
+	uint32_t reg() const {
+		return handle.rex_r << 3 | handle.modrm_reg;
+	}
+
+	/**
+	 *  Get the ModR/M r/m operand extended by REX.B
+	 */
+	uint32_t rm() const {
+		return handle.rex_b << 3 | handle.modrm_rm;
+	}
+
+	/**
+	 *  Get the address right after the instruction
+	 */
+	uint64_t end() const {
+		return address + handle.len;
+	}
+};
+
+/**
+ *  Values captured by instruction patterns while matching
+ */
+struct InstructionCaptures {
+	static constexpr size_t MaxCaptures = 4;
+	uint64_t value[MaxCaptures] {};
+};
+
+/**
+ *  A declarative instruction predicate, every field not set explicitly is a wildcard
+ *
+ *  e.g. `InstructionPattern().opcode(0x80).reg(7).rm(1)` matches `cmpb $imm8, (%rcx)`.
+ *
+ *  @note Register operands are compared with the REX extension applied, immediates and displacements
+ *        are compared against the zero-extended raw encoding.
+ */
+class InstructionPattern {
+	/**
+	 *  Fields to check
+	 */
+	enum : uint32_t {
+		CheckOpcode  = 1U << 0,
+		CheckOpcode2 = 1U << 1,
+		CheckMod     = 1U << 2,
+		CheckReg     = 1U << 3,
+		CheckRm      = 1U << 4,
+		CheckRexW    = 1U << 5,
+		CheckImm     = 1U << 6,
+		CheckDisp    = 1U << 7,
+		CheckRegSlot = 1U << 8,
+		CheckRmSlot  = 1U << 9,
+	};
+
+public:
+	/**
+	 *  Instruction fields a pattern can capture
+	 */
+	enum class Field : uint8_t {
+		None,
+		Reg,
+		Rm,
+		Imm,
+		Disp,
+	};
+
+private:
+	uint32_t checks {0};
+	uint8_t opcodeValue[2] {};
+	uint8_t opcode2Value {0};
+	uint8_t modValue {0};
+	uint8_t regValue {0};
+	uint8_t rmValue {0};
+	uint8_t rexWValue {0};
+	uint8_t regSlot {0};
+	uint8_t rmSlot {0};
+	uint64_t immValue {0};
+	uint32_t dispValue {0};
+	Field captureField {Field::None};
+	uint8_t captureSlot {0};
+
+	static uint64_t fieldValue(const DecodedInstruction &insn, Field field) {
+		switch (field) {
+			case Field::Reg:
+				return insn.reg();
+			case Field::Rm:
+				return insn.rm();
+			case Field::Imm:
+				return insn.handle.imm.imm64;
+			case Field::Disp:
+				return insn.handle.disp.disp32;
+			default:
+				return 0;
+		}
+	}
+
+public:
+	/**
+	 *  Match the primary opcode, or either of the two given
+	 */
+	constexpr InstructionPattern opcode(uint8_t value, uint8_t alternative) const {
+		auto copy = *this;
+		copy.checks |= CheckOpcode;
+		copy.opcodeValue[0] = value;
+		copy.opcodeValue[1] = alternative;
+		return copy;
+	}
+
+	constexpr InstructionPattern opcode(uint8_t value) const {
+		return opcode(value, value);
+	}
+
+	/**
+	 *  Match the secondary opcode of a two byte instruction
+	 */
+	constexpr InstructionPattern opcode2(uint8_t value) const {
+		auto copy = *this;
+		copy.checks |= CheckOpcode2;
+		copy.opcode2Value = value;
+		return copy;
+	}
+
+	/**
+	 *  Match the ModR/M addressing mode
+	 */
+	constexpr InstructionPattern mod(uint8_t value) const {
+		auto copy = *this;
+		copy.checks |= CheckMod;
+		copy.modValue = value;
+		return copy;
+	}
+
+	/**
+	 *  Match the ModR/M reg operand or opcode extension
+	 */
+	constexpr InstructionPattern reg(uint8_t value) const {
+		auto copy = *this;
+		copy.checks |= CheckReg;
+		copy.regValue = value;
+		return copy;
+	}
+
+	/**
+	 *  Match the ModR/M r/m operand
+	 */
+	constexpr InstructionPattern rm(uint8_t value) const {
+		auto copy = *this;
+		copy.checks |= CheckRm;
+		copy.rmValue = value;
+		return copy;
+	}
+
+	/**
+	 *  Match the operand size, 1 for 64-bit operands
+	 */
+	constexpr InstructionPattern rexW(uint8_t value) const {
+		auto copy = *this;
+		copy.checks |= CheckRexW;
+		copy.rexWValue = value;
+		return copy;
+	}
+
+	/**
+	 *  Match the immediate operand
+	 */
+	constexpr InstructionPattern imm(uint64_t value) const {
+		auto copy = *this;
+		copy.checks |= CheckImm;
+		copy.immValue = value;
+		return copy;
+	}
+
+	/**
+	 *  Match the 32-bit displacement
+	 */
+	constexpr InstructionPattern disp(uint32_t value) const {
+		auto copy = *this;
+		copy.checks |= CheckDisp;
+		copy.dispValue = value;
+		return copy;
+	}
+
+	/**
+	 *  Match the ModR/M reg operand against a value captured earlier
+	 */
+	constexpr InstructionPattern regCaptured(uint8_t slot) const {
+		auto copy = *this;
+		copy.checks |= CheckRegSlot;
+		copy.regSlot = slot;
+		return copy;
+	}
+
+	/**
+	 *  Match the ModR/M r/m operand against a value captured earlier
+	 */
+	constexpr InstructionPattern rmCaptured(uint8_t slot) const {
+		auto copy = *this;
+		copy.checks |= CheckRmSlot;
+		copy.rmSlot = slot;
+		return copy;
+	}
+
+	/**
+	 *  Store the given field of a matching instruction into a capture slot
+	 */
+	constexpr InstructionPattern capture(Field field, uint8_t slot) const {
+		auto copy = *this;
+		copy.captureField = field;
+		copy.captureSlot = slot;
+		return copy;
+	}
+
+	/**
+	 *  Check whether the instruction matches the pattern, ignoring the captured values
+	 */
+	bool matches(const DecodedInstruction &insn) const {
+		InstructionCaptures none;
+		return (checks & (CheckRegSlot | CheckRmSlot)) == 0 && matches(insn, none, false);
+	}
+
+	/**
+	 *  Check whether the instruction matches the pattern
+	 *
+	 *  @param insn      decoded instruction
+	 *  @param captures  values captured so far
+	 *  @param update    store the capture of a matching instruction
+	 *
+	 *  @return true on match
+	 */
+	bool matches(const DecodedInstruction &insn, InstructionCaptures &captures, bool update = true) const {
+		auto &h = insn.handle;
+		if ((checks & CheckOpcode) && h.opcode != opcodeValue[0] && h.opcode != opcodeValue[1])
+			return false;
+		if ((checks & CheckOpcode2) && h.opcode2 != opcode2Value)
+			return false;
+		if ((checks & CheckMod) && h.modrm_mod != modValue)
+			return false;
+		if ((checks & CheckReg) && insn.reg() != regValue)
+			return false;
+		if ((checks & CheckRm) && insn.rm() != rmValue)
+			return false;
+		if ((checks & CheckRexW) && h.rex_w != rexWValue)
+			return false;
+		if ((checks & CheckImm) && h.imm.imm64 != immValue)
+			return false;
+		if ((checks & CheckDisp) && h.disp.disp32 != dispValue)
+			return false;
+		if ((checks & CheckRegSlot) && (regSlot >= InstructionCaptures::MaxCaptures || insn.reg() != captures.value[regSlot]))
+			return false;
+		if ((checks & CheckRmSlot) && (rmSlot >= InstructionCaptures::MaxCaptures || insn.rm() != captures.value[rmSlot]))
+			return false;
+		if (update && captureField != Field::None && captureSlot < InstructionCaptures::MaxCaptures)
+			captures.value[captureSlot] = fieldValue(insn, captureField);
+		return true;
+	}
+};
+
+/**
+ *  A function decoded lazily, every instruction is decoded at most once no matter how many times it is walked
+ *
+ *  @note Decoding stops at the first instruction the decoder rejects, so the function is never read past
+ *        the point a plain disassembly loop would reach.
+ *  @note Storage for every instruction is allocated at once on first access, so instructions returned earlier
+ *        stay valid until the function is reinitialised or destroyed.
+ */
+class DecodedFunction {
+public:
+	/**
+	 *  Instruction decoder, e.g. `Disassembler::hdeDisasm`
+	 */
+	using Decoder = size_t (*)(uint64_t address, hde64s *handle);
+
+private:
+	Decoder decoder {nullptr};
+	uint64_t start {0};
+	DecodedInstruction *instructions {nullptr};
+	size_t allocated {0};
+	size_t capacity {0};
+	size_t count {0};
+	bool error {false};
+
+public:
+	DecodedFunction() = default;
+	DecodedFunction(const DecodedFunction &) = delete;
+	DecodedFunction &operator=(const DecodedFunction &) = delete;
+
+	/**
+	 *  Create a function ready for decoding, see `init`
+	 */
+	DecodedFunction(Decoder decode, uint64_t address, size_t maxInstructions) {
+		init(decode, address, maxInstructions);
+	}
+
+	~DecodedFunction() {
+		deinit();
+	}
+
+	/**
+	 *  Prepare the function for decoding, no memory is read until an instruction is requested
+	 *
+	 *  @param decode           instruction decoder
+	 *  @param address          function start
+	 *  @param maxInstructions  the number of instructions to decode at most
+	 *
+	 *  @note Storage allocated for a previous function is reused when it is large enough.
+	 */
+	void init(Decoder decode, uint64_t address, size_t maxInstructions) {
+		if (maxInstructions > allocated)
+			deinit();
+		decoder = decode;
+		start = address;
+		capacity = maxInstructions;
+		count = 0;
+		error = false;
+	}
+
+	/**
+	 *  Release the decoded instructions
+	 */
+	void deinit() {
+		if (instructions)
+			Buffer::deleter(instructions);
+		instructions = nullptr;
+		start = 0;
+		allocated = capacity = count = 0;
+		error = false;
+	}
+
+	/**
+	 *  Get the function start, 0 when unused
+	 */
+	uint64_t getStart() const {
+		return start;
+	}
+
+	/**
+	 *  Get the number of instructions the function may decode
+	 */
+	size_t getCapacity() const {
+		return capacity;
+	}
+
+	/**
+	 *  Get the address right after the last decoded instruction, i.e. the rejected one if any
+	 */
+	uint64_t getEnd() const {
+		return count > 0 ? instructions[count - 1].end() : start;
+	}
+
+	/**
+	 *  Check whether decoding stopped at an instruction the decoder rejected
+	 */
+	bool hasError() const {
+		return error;
+	}
+
+	/**
+	 *  Get the instruction by its index, decoding the preceding instructions on first access
+	 *
+	 *  @param index  instruction index
+	 *
+	 *  @return instruction or nullptr past the capacity or a rejected instruction
+	 */
+	const DecodedInstruction *at(size_t index) {
+		while (count <= index) {
+			if (error || count >= capacity || !decoder)
+				return nullptr;
+			if (!instructions) {
+				instructions = Buffer::create<DecodedInstruction>(capacity);
+				if (!instructions)
+					return nullptr;
+				allocated = capacity;
+			}
+			auto &insn = instructions[count];
+			insn.address = count > 0 ? instructions[count - 1].end() : start;
+			decoder(insn.address, &insn.handle);
+			if (insn.handle.flags & F_ERROR) {
+				error = true;
+				return nullptr;
+			}
+			count++;
+		}
+		return &instructions[index];
+	}
+
+	/**
+	 *  Find the patterns in the function
+	 *
+	 *  @param patterns  patterns to find
+	 *  @param num       the number of patterns
+	 *  @param matches   instructions matching each pattern
+	 *  @param captures  captured values, may be preset by the caller
+	 *  @param limit     the number of instructions to look through
+	 *  @param ordered   find the patterns in order with any instructions in between, otherwise in any order
+	 *                   with the last matching instruction before the search ends recorded for each pattern
+	 *
+	 *  @return true when every pattern was matched
+	 */
+	bool find(const InstructionPattern *patterns, size_t num, const DecodedInstruction **matches, InstructionCaptures &captures, size_t limit, bool ordered = true) {
+		size_t found = 0;
+		for (size_t i = 0; i < num; i++)
+			matches[i] = nullptr;
+
+		for (size_t index = 0; index < limit && found < num; index++) {
+			auto insn = at(index);
+			if (!insn)
+				break;
+
+			if (ordered) {
+				if (patterns[found].matches(*insn, captures))
+					matches[found++] = insn;
+				continue;
+			}
+
+			for (size_t i = 0; i < num; i++) {
+				if (patterns[i].matches(*insn, captures)) {
+					if (!matches[i])
+						found++;
+					matches[i] = insn;
+				}
+			}
+		}
+
+		return found == num;
+	}
+};
+
+#endif /* kern_insn_hpp */
@@ -6,9 +6,11 @@
 //
 
 #include "kern_ngfx.hpp"
+#include "kern_insn.hpp"
 
 #include <Headers/kern_api.hpp>
 #include <Headers/kern_iokit.hpp>
+#include <Headers/kern_disasm.hpp>
 
 #include <sys/types.h>
 #include <sys/sysctl.h>
@@ -64,7 +66,11 @@ void NGFX::init() {
 }
 
 void NGFX::deinit() {
-
+	if (teamIdPublisher) {
+		thread_call_cancel(teamIdPublisher);
+		thread_call_free(teamIdPublisher);
+		teamIdPublisher = nullptr;
+	}
 }
 
 void NGFX::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
@@ -84,6 +90,7 @@ void NGFX::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
 				orgCsfgGetTeamId = reinterpret_cast<decltype(orgCsfgGetTeamId)>(patcher.solveSymbol(KernelPatcher::KernelID, "_csfg_get_teamid"));
 				if (orgCsfgGetTeamId) {
 					DBGLOG("ngfx", "obtained csfg_get_teamid");
+					initTeamIdCache();
 					KernelPatcher::RouteRequest request("_csfg_get_platform_binary", wrapCsfgGetPlatformBinary, orgCsfgGetPlatformBinary);
 					patcher.routeMultiple(KernelPatcher::KernelID, &request, 1);
 				} else {
@@ -222,6 +229,8 @@ void NGFX::restoreLegacyOptimisations(KernelPatcher &patcher, size_t index, mach
 			size_t dispOff = 3;
 			// Pick something reasonably high to ensure the sequence is found.
 			size_t maxLookup = 0x1000;
+			// x86-64 code averages about 4 bytes per instruction, decoding stops at whichever bound comes first.
+			size_t maxInstructions = maxLookup / 4;
 
 			struct {
 				uint8_t *patch;
@@ -233,36 +242,73 @@ void NGFX::restoreLegacyOptimisations(KernelPatcher &patcher, size_t index, mach
 				{seqR12, repR12, sizeof(seqR12)}
 			};
 
+			// movb $0x0, 0x37c(%r??), the exact encodings are checked against the sequences above.
+			static constexpr InstructionPattern movb = InstructionPattern().opcode(0xC6).reg(0).mod(2).disp(0x37C).imm(0);
+
+			DecodedFunction function;
 			for (auto &sym : symbols) {
 				auto addr = patcher.solveSymbol(index, sym, address, size);
 				if (addr) {
 					DBGLOG("ngfx", "obtained %s", sym);
 
-					for (size_t off = 0; off < maxLookup; off++) {
+					function.init(Disassembler::hdeDisasm, addr, maxInstructions);
+					const DecodedInstruction *insn = nullptr;
+					decltype(&patches[0]) found = nullptr;
+					size_t off = 0;
+					for (size_t i = 0; !found && (insn = function.at(i)) != nullptr && insn->address - addr < maxLookup; i++) {
+						if (!movb.matches(*insn))
+							continue;
 						for (auto &patch : patches) {
-							if (!memcmp(reinterpret_cast<uint8_t *>(addr+off), patch.patch, patch.sz)) {
-								// Calculate the jump offset
-								auto disp = static_cast<int32_t>(presubmitBase - (addr+off+dispOff + 5));
-								DBGLOG("ngfx", "found pattern of %lu bytes at %lu offset, disp %X", patch.sz, off, disp);
-								*reinterpret_cast<int32_t *>(patch.code + dispOff) = disp;
-								patcher.routeBlock(addr+off, patch.code, patch.sz);
-								if (patcher.getError() == KernelPatcher::Error::NoError) {
-									DBGLOG("ngfx", "successfully patched %s", sym);
-								} else {
-									SYSLOG("ngfx", "failed to patch %s", sym);
-									patcher.clearError();
-								}
-								off = maxLookup;
+							if (insn->handle.len == patch.sz && !memcmp(reinterpret_cast<uint8_t *>(insn->address), patch.patch, patch.sz)) {
+								found = &patch;
+								off = static_cast<size_t>(insn->address - addr);
 								break;
 							}
 						}
 					}
 
+					// Unsupported instructions or inline data stop decoding early, search the bytes like before then.
+					// Reaching the instruction cap stops it early too, only the bytes past the decoded instructions are searched then.
+					auto decodedSize = static_cast<size_t>(function.getEnd() - addr);
+					if (!found && decodedSize < maxLookup) {
+						size_t from = 0;
+						if (function.hasError())
+							SYSLOG("ngfx", "failed to decode %s at %lu offset, searching bytes", sym, decodedSize);
+						else
+							from = decodedSize;
+						for (size_t i = from; !found && i < maxLookup; i++) {
+							for (auto &patch : patches) {
+								if (!memcmp(reinterpret_cast<uint8_t *>(addr+i), patch.patch, patch.sz)) {
+									found = &patch;
+									off = i;
+									break;
+								}
+							}
+						}
+					}
+
+					if (found) {
+						// Calculate the jump offset
+						auto disp = static_cast<int32_t>(presubmitBase - (addr+off+dispOff + 5));
+						DBGLOG("ngfx", "found pattern of %lu bytes at %lu offset, disp %X", found->sz, off, disp);
+						*reinterpret_cast<int32_t *>(found->code + dispOff) = disp;
+						patcher.routeBlock(addr+off, found->code, found->sz);
+						if (patcher.getError() == KernelPatcher::Error::NoError) {
+							DBGLOG("ngfx", "successfully patched %s", sym);
+						} else {
+							SYSLOG("ngfx", "failed to patch %s", sym);
+							patcher.clearError();
+						}
+					} else {
+						SYSLOG("ngfx", "failed to find pattern in %s", sym);
+					}
+
 				} else {
 					SYSLOG("ngfx", "failed to obtain %s", sym);
 					patcher.clearError();
 				}
 			}
+			function.deinit();
 		}
 	}
 }
@@ -292,14 +338,77 @@ void NGFX::applyAcceleratorProperties(IOService *that) {
 	}
 }
 
+void NGFX::initTeamIdCache() {
+	// The counters are diagnostics only, the cache works without them
+	teamIdPublisher = thread_call_allocate(publishTeamIdCache, this);
+	if (!teamIdPublisher)
+		SYSLOG("ngfx", "failed to allocate team id cache stats publisher");
+}
+
+void NGFX::publishTeamIdCache(thread_call_param_t param0, thread_call_param_t param1) {
+	auto self = static_cast<NGFX *>(param0);
+
+	static const char *statNames[TeamIdCacheStatCount] {"hits", "misses"};
+	auto dict = OSDictionary::withCapacity(TeamIdCacheStatCount);
+	if (!dict)
+		return;
+
+	for (size_t i = 0; i < TeamIdCacheStatCount; i++) {
+		auto num = OSNumber::withNumber(__atomic_load_n(&self->teamIdCacheStats[i], __ATOMIC_RELAXED), 64);
+		if (num) {
+			dict->setObject(statNames[i], num);
+			num->release();
+		}
+	}
+
+	auto entry = IORegistryEntry::fromPath("/", gIODTPlane);
+	if (entry) {
+		entry->setProperty("ngfx-teamid-cache", dict);
+		entry->release();
+	} else {
+		SYSLOG("ngfx", "failed to obtain iodt tree for team id cache stats");
+	}
+
+	dict->release();
+}
+
+bool NGFX::isNvidiaBinary(void *fg) {
+	// Only vnode-backed fileglobs carry code signatures, others are looked up uncached.
+	vnode_t vp = nullptr;
+	auto ops = getMember<int *>(fg, FileglobOpsOffset);
+	if (ops && *ops == FileglobTypeVnode)
+		vp = getMember<vnode_t>(fg, FileglobDataOffset);
+
+	TeamIdEntry *slot = nullptr;
+	uint32_t vid = 0;
+	if (vp) {
+		vid = vnode_vid(vp);
+		slot = &getTeamIdSlot(vp);
+		if (LIKELY(matchTeamIdEntry(*slot, vp, vid))) {
+			countTeamIdCache(TeamIdCacheHits);
+			return false;
+		}
+	}
+
+	countTeamIdCache(TeamIdCacheMisses);
+	const char *teamId = orgCsfgGetTeamId(fg);
+	bool nvidia = teamId && !strcmp(teamId, NvidiaTeamId);
+
+	// Binaries without a signature yet may get one later, so only remember definite answers.
+	// NVIDIA binaries are always checked, so that a recycled vnode can never inherit platform binary rights.
+	if (slot && teamId && !nvidia)
+		storeTeamIdEntry(*slot, vp, vid);
+
+	return nvidia;
+}
+
 int NGFX::wrapCsfgGetPlatformBinary(void *fg) {
 	//DBGLOG("ngfx", "csfg_get_platform_binary is called"); // is called quite often
 
 	int result = FunctionCast(wrapCsfgGetPlatformBinary, callbackNGFX->orgCsfgGetPlatformBinary)(fg);
 	if (!result) {
 		// Special case NVIDIA drivers
-		const char *teamId = callbackNGFX->orgCsfgGetTeamId(fg);
-		if (teamId && !strcmp(teamId, NvidiaTeamId)) {
+		if (callbackNGFX->isNvidiaBinary(fg)) {
 			DBGLOG("ngfx", "platform binary override for %s", NvidiaTeamId);
 			return 1;
 		}
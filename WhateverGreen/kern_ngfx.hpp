@@ -14,6 +14,8 @@
 #include <Headers/kern_devinfo.hpp>
 #include <IOKit/IOService.h>
 #include <IOKit/ndrvsupport/IONDRVFramebuffer.h>
+#include <sys/vnode.h>
+#include <kern/thread_call.h>
 
 // Assembly exports for restoreLegacyOptimisations
 extern "C" bool wrapVaddrPreSubmitTrampoline(void *that);
@@ -101,6 +103,154 @@ private:
 	 */
 	mach_vm_address_t orgCsfgGetPlatformBinary {};
 
+	/**
+	 *  struct fileglob field offsets, the layout is the same on 10.10 to 10.12 where the team id override is used.
+	 */
+	static constexpr size_t FileglobOpsOffset = 0x28;
+	static constexpr size_t FileglobDataOffset = 0x38;
+
+	/**
+	 *  DTYPE_VNODE file type stored at the start of struct fileops
+	 */
+	static constexpr int FileglobTypeVnode = 1;
+
+	/**
+	 *  Team id cache size, must be a power of two.
+	 */
+	static constexpr size_t TeamIdCacheSize = 64;
+
+	/**
+	 *  Team id cache entry
+	 *
+	 *  @note The tag holds the full vnode id in the lower 32 bits and a sequence count in the upper 32 bits,
+	 *        which is odd while the entry is being written, so that concurrent lookups may read and write
+	 *        entries without locking and never observe the vnode of one entry with the vnode id of another.
+	 */
+	struct TeamIdEntry {
+		vnode_t vp;
+		uint64_t tag;
+	};
+
+	/**
+	 *  Team id entry sequence increment, the entry is being written while this bit is set
+	 */
+	static constexpr uint64_t TeamIdEntryWriting = 1ULL << 32;
+
+	/**
+	 *  Direct-mapped cache of binaries known not to be signed with NVIDIA team id, keyed by the vnode backing the fileglob.
+	 *
+	 *  @note Only negative decisions are cached, and an entry only matches the same vnode with the same full
+	 *        vnode id. A recycled vnode gets a new vnode id, so it always takes the uncached path.
+	 */
+	TeamIdEntry teamIdCache[TeamIdCacheSize] {};
+
+	/**
+	 *  Team id cache statistics.
+	 */
+	enum : size_t {
+		TeamIdCacheHits,
+		TeamIdCacheMisses,
+		TeamIdCacheStatCount,
+	};
+
+	/**
+	 *  The number of lookups that triggers publishing the counters
+	 */
+	static constexpr uint64_t TeamIdPublishInterval = 1024;
+
+	/**
+	 *  Team id cache counters.
+	 */
+	uint64_t teamIdCacheStats[TeamIdCacheStatCount] {};
+
+	/**
+	 *  A thread call that publishes the counters in ngfx-teamid-cache property of IODT root
+	 */
+	thread_call_t teamIdPublisher {nullptr};
+
+	/**
+	 *  Allocate the team id cache counter publisher
+	 */
+	void initTeamIdCache();
+
+	/**
+	 *  Publish team id cache counters
+	 *
+	 *  @param param0  NGFX instance
+	 *  @param param1  unused
+	 */
+	static void publishTeamIdCache(thread_call_param_t param0, thread_call_param_t param1);
+
+	/**
+	 *  Increment team id cache counter
+	 *
+	 *  @param stat  counter index
+	 */
+	void countTeamIdCache(size_t stat) {
+		auto value = __atomic_add_fetch(&teamIdCacheStats[stat], 1, __ATOMIC_RELAXED);
+		// Publish the first miss so that the property shows up early, and then every interval
+		if (teamIdPublisher && (value % TeamIdPublishInterval == 0 || (stat == TeamIdCacheMisses && value == 1)))
+			thread_call_enter(teamIdPublisher);
+	}
+
+	/**
+	 *  Obtain team id cache slot
+	 *
+	 *  @param vp  vnode
+	 *
+	 *  @return cache slot reference
+	 */
+	TeamIdEntry &getTeamIdSlot(vnode_t vp) {
+		auto addr = reinterpret_cast<uintptr_t>(vp);
+		return teamIdCache[((addr >> 4) ^ (addr >> 12)) & (TeamIdCacheSize - 1)];
+	}
+
+	/**
+	 *  Check whether a team id cache entry describes the vnode
+	 *
+	 *  @param entry  cache slot
+	 *  @param vp     vnode
+	 *  @param vid    vnode id
+	 *
+	 *  @return true if the entry was stored for the same vnode and vnode id
+	 */
+	static bool matchTeamIdEntry(TeamIdEntry &entry, vnode_t vp, uint32_t vid) {
+		auto tag = __atomic_load_n(&entry.tag, __ATOMIC_ACQUIRE);
+		if ((tag & TeamIdEntryWriting) || static_cast<uint32_t>(tag) != vid)
+			return false;
+		auto owner = __atomic_load_n(&entry.vp, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		return owner == vp && __atomic_load_n(&entry.tag, __ATOMIC_RELAXED) == tag;
+	}
+
+	/**
+	 *  Store a team id cache entry, the store is skipped while another one is in progress
+	 *
+	 *  @param entry  cache slot
+	 *  @param vp     vnode
+	 *  @param vid    vnode id
+	 */
+	static void storeTeamIdEntry(TeamIdEntry &entry, vnode_t vp, uint32_t vid) {
+		auto tag = __atomic_load_n(&entry.tag, __ATOMIC_RELAXED);
+		if (tag & TeamIdEntryWriting)
+			return;
+		auto sequence = (tag & 0xFFFFFFFF00000000ULL) + TeamIdEntryWriting;
+		if (!__atomic_compare_exchange_n(&entry.tag, &tag, sequence, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return;
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		__atomic_store_n(&entry.vp, vp, __ATOMIC_RELAXED);
+		__atomic_store_n(&entry.tag, (sequence + TeamIdEntryWriting) | vid, __ATOMIC_RELEASE);
+	}
+
+	/**
+	 *  Check whether the binary backing the fileglob is signed with NVIDIA team id, caching the result
+	 *
+	 *  @param fg  codesign information
+	 *
+	 *  @return true for NVIDIA binaries
+	 */
+	bool isNvidiaBinary(void *fg);
+
 	/**
 	 * Original SetAccelProperties functions for official and web drivers
 	 */
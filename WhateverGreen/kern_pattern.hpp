@@ -0,0 +1,247 @@
+//
+//  kern_pattern.hpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_pattern_hpp
+#define kern_pattern_hpp
+
+#include <Headers/kern_util.hpp>
+
+/**
+ *  Applies several find/replace patterns to a buffer in a single pass
+ *
+ *  @tparam MaxPatterns Maximum amount of patterns, cannot exceed 32
+ *  @note Each pattern replaces its first occurrence by default, same as `KernelPatcher::findAndReplace`.
+ *        A larger count replaces non-overlapping occurrences in order until the count is exhausted.
+ *  @note Candidates are filtered by the first and the last byte of every pattern before comparing
+ *        the whole pattern, and the scan stops as soon as every pattern has been applied.
+ *  @note Patterns matching at the same offset are applied in registration order, so a later pattern
+ *        sees the bytes replaced by an earlier one. Patterns that may overlap at different offsets are
+ *        resolved by position, use `independent` to check that this matches applying them one by one.
+ */
+template <size_t MaxPatterns>
+class MultiPatternPatcher {
+	static_assert(MaxPatterns > 0 && MaxPatterns <= 32, "Unsupported amount of patterns");
+
+	/**
+	 *  Pattern description
+	 */
+	struct Pattern {
+		const uint8_t *find;
+		size_t findSize;
+		const void *replace;
+		size_t replaceSize;
+		size_t count;
+		size_t from;
+		size_t to;
+	};
+
+	/**
+	 *  Registered patterns
+	 */
+	Pattern patterns[MaxPatterns] {};
+
+	/**
+	 *  Amount of registered patterns
+	 */
+	size_t count {0};
+
+	/**
+	 *  Shortest registered pattern size
+	 */
+	size_t minSize {0};
+
+	/**
+	 *  Lowest offset any registered pattern may match at
+	 */
+	size_t minFrom {SIZE_MAX};
+
+	/**
+	 *  Bitmask of patterns starting with the given byte
+	 */
+	uint32_t firstByte[256] {};
+
+	/**
+	 *  Check whether two byte sequences agree at any relative offset where they overlap
+	 *
+	 *  @param a      first sequence
+	 *  @param aSize  first sequence size
+	 *  @param b      second sequence
+	 *  @param bSize  second sequence size
+	 *
+	 *  @return true if the sequences may describe overlapping bytes of the same buffer
+	 */
+	static bool mayOverlap(const uint8_t *a, size_t aSize, const uint8_t *b, size_t bSize) {
+		if (aSize == 0 || bSize == 0)
+			return false;
+		// b starts at a + shift - (bSize - 1)
+		for (size_t shift = 0; shift + 1 < aSize + bSize; shift++) {
+			size_t aStart = shift >= bSize - 1 ? shift - (bSize - 1) : 0;
+			size_t bStart = shift >= bSize - 1 ? 0 : (bSize - 1) - shift;
+			size_t length = aSize - aStart < bSize - bStart ? aSize - aStart : bSize - bStart;
+			if (memcmp(a + aStart, b + bStart, length) == 0)
+				return true;
+		}
+		return false;
+	}
+
+public:
+	/**
+	 *  Register a pattern
+	 *
+	 *  @param find        pattern to find
+	 *  @param findSize    pattern size
+	 *  @param replace     replacement written at the pattern start
+	 *  @param replaceSize replacement size, must not exceed findSize
+	 *  @param maxCount    maximum amount of occurrences to replace
+	 *  @param from        lowest offset the pattern may match at
+	 *  @param to          offset the pattern may no longer match at
+	 *
+	 *  @return pattern index on success or -1
+	 */
+	int add(const void *find, size_t findSize, const void *replace, size_t replaceSize,
+			size_t maxCount = 1, size_t from = 0, size_t to = SIZE_MAX) {
+		if (count == MaxPatterns || findSize == 0 || replaceSize > findSize || maxCount == 0 || from >= to)
+			return -1;
+
+		auto f = static_cast<const uint8_t *>(find);
+		patterns[count] = {f, findSize, replace, replaceSize, maxCount, from, to};
+		firstByte[f[0]] |= 1U << count;
+		if (minSize == 0 || findSize < minSize)
+			minSize = findSize;
+		if (from < minFrom)
+			minFrom = from;
+		return static_cast<int>(count++);
+	}
+
+	/**
+	 *  Check whether no patterns were registered
+	 */
+	bool empty() const {
+		return count == 0;
+	}
+
+	/**
+	 *  Check whether the result does not depend on the order patterns are applied in
+	 *
+	 *  @return true if no pattern can match bytes another pattern matched or replaced
+	 *
+	 *  @note When this fails the caller should apply the patterns one by one in registration order
+	 *        to keep the semantics of consecutive `KernelPatcher::findAndReplace` calls.
+	 */
+	bool independent() const {
+		for (size_t a = 0; a < count; a++) {
+			auto &pa = patterns[a];
+			for (size_t b = 0; b < count; b++) {
+				auto &pb = patterns[b];
+				// Patterns that cannot meet within their windows never interact
+				if (a == b || (pa.from >= pb.to && pa.from - pb.to >= pb.findSize) ||
+					(pb.from >= pa.to && pb.from - pa.to >= pa.findSize))
+					continue;
+				if (mayOverlap(pa.find, pa.findSize, pb.find, pb.findSize) ||
+					mayOverlap(static_cast<const uint8_t *>(pa.replace), pa.replaceSize, pb.find, pb.findSize))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	/**
+	 *  Check whether any pattern may match or replace the given bytes
+	 *
+	 *  @param data  bytes to check
+	 *  @param size  bytes size
+	 *
+	 *  @return true if a pattern find or replacement may overlap the bytes
+	 */
+	bool touches(const void *data, size_t size) const {
+		auto d = static_cast<const uint8_t *>(data);
+		for (size_t j = 0; j < count; j++) {
+			if (mayOverlap(patterns[j].find, patterns[j].findSize, d, size) ||
+				mayOverlap(static_cast<const uint8_t *>(patterns[j].replace), patterns[j].replaceSize, d, size))
+				return true;
+		}
+		return false;
+	}
+
+	/**
+	 *  Apply registered patterns
+	 *
+	 *  @param data  buffer to patch
+	 *  @param size  buffer size
+	 *
+	 *  @return bitmask of applied pattern indices
+	 */
+	uint32_t apply(void *data, size_t size) const {
+		return scan<true>(static_cast<uint8_t *>(data), size);
+	}
+
+	/**
+	 *  Find registered patterns without replacing them
+	 *
+	 *  @param data  buffer to check
+	 *  @param size  buffer size
+	 *
+	 *  @return bitmask of pattern indices occurring in the buffer
+	 */
+	uint32_t match(const void *data, size_t size) const {
+		return scan<false>(static_cast<uint8_t *>(const_cast<void *>(data)), size);
+	}
+
+private:
+	/**
+	 *  Scan the buffer for registered patterns
+	 *
+	 *  @tparam Replace  write replacements, otherwise every pattern is only looked up once
+	 *
+	 *  @param d     buffer to scan
+	 *  @param size  buffer size
+	 *
+	 *  @return bitmask of found pattern indices
+	 */
+	template <bool Replace>
+	uint32_t scan(uint8_t *d, size_t size) const {
+		if (count == 0 || size < minSize)
+			return 0;
+
+		uint32_t pending = count == 32 ? 0xFFFFFFFFU : (1U << count) - 1;
+		uint32_t applied = 0;
+
+		// Remaining replacements and the next offset each pattern may match at
+		size_t remaining[MaxPatterns];
+		size_t resume[MaxPatterns];
+		for (size_t j = 0; j < count; j++) {
+			remaining[j] = Replace ? patterns[j].count : 1;
+			resume[j] = patterns[j].from;
+		}
+
+		for (size_t i = minFrom; i + minSize <= size && pending != 0; i++) {
+			uint32_t candidates = firstByte[d[i]] & pending;
+			while (UNLIKELY(candidates != 0)) {
+				auto j = static_cast<uint32_t>(__builtin_ctz(candidates));
+				candidates &= candidates - 1;
+				auto &p = patterns[j];
+				if (i >= p.to) {
+					pending &= ~(1U << j);
+					continue;
+				}
+				if (i >= resume[j] && i + p.findSize <= size && d[i + p.findSize - 1] == p.find[p.findSize - 1] &&
+					memcmp(d + i, p.find, p.findSize) == 0) {
+					if (Replace)
+						lilu_os_memcpy(d + i, p.replace, p.replaceSize);
+					applied |= 1U << j;
+					resume[j] = i + p.findSize;
+					if (--remaining[j] == 0)
+						pending &= ~(1U << j);
+				}
+			}
+		}
+
+		return applied;
+	}
+};
+
+#endif /* kern_pattern_hpp */
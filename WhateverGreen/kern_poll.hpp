@@ -0,0 +1,50 @@
+//
+//  kern_poll.hpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_poll_hpp
+#define kern_poll_hpp
+
+#include <stdint.h>
+
+/**
+ *  Busy wait backoff for polling hardware registers where sleeping is not allowed
+ *
+ *  @note The backoff has no dependencies on the kernel, so that it can be simulated against acknowledgement
+ *        latency distributions on any host.
+ */
+struct PollBackoff {
+	/**
+	 *  The number of register reads done back to back before backing off
+	 */
+	static constexpr uint32_t kSpinReads = 32;
+
+	/**
+	 *  The longest delay between two register reads in microseconds
+	 */
+	static constexpr uint32_t kMaxDelay = 64;
+
+	/**
+	 *  Get the delay before the next register read
+	 *
+	 *  @param attempt The number of register reads done so far
+	 *  @return The delay in microseconds, 0 to read the register right away.
+	 *  @note The register is read back to back first, as most acknowledgements arrive within a few reads,
+	 *        then the delay doubles up to `kMaxDelay`.
+	 */
+	static constexpr uint32_t delay(uint32_t attempt) {
+		if (attempt < kSpinReads)
+			return 0;
+		attempt -= kSpinReads;
+		return attempt < static_cast<uint32_t>(__builtin_ctz(kMaxDelay)) ? 1U << attempt : kMaxDelay;
+	}
+};
+
+static_assert(PollBackoff::delay(0) == 0 && PollBackoff::delay(PollBackoff::kSpinReads - 1) == 0, "Spin reads must not delay");
+static_assert(PollBackoff::delay(PollBackoff::kSpinReads) == 1 && PollBackoff::delay(UINT32_MAX) == PollBackoff::kMaxDelay,
+			  "Delays must double from 1 up to the maximum");
+
+#endif /* kern_poll_hpp */
@@ -0,0 +1,140 @@
+//
+//  kern_profile.cpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#include "kern_profile.hpp"
+
+#include <Headers/kern_api.hpp>
+#include <IOKit/IORegistryEntry.h>
+#include <libkern/c++/OSDictionary.h>
+#include <libkern/c++/OSNumber.h>
+
+BootProfile::Entry BootProfile::entries[BootProfile::MaxEntries];
+size_t BootProfile::entryCount;
+bool BootProfile::enabled;
+IOSimpleLock *BootProfile::lock;
+thread_call_t BootProfile::publisher;
+
+void BootProfile::init() {
+	if (!checkKernelArgument("-wegprof"))
+		return;
+	
+	lock = IOSimpleLockAlloc();
+	publisher = thread_call_allocate(publish, nullptr);
+	if (lock == nullptr || publisher == nullptr) {
+		SYSLOG("prof", "failed to allocate the boot profile");
+		if (lock != nullptr) {
+			IOSimpleLockFree(lock);
+			lock = nullptr;
+		}
+		if (publisher != nullptr) {
+			thread_call_free(publisher);
+			publisher = nullptr;
+		}
+		return;
+	}
+	
+	enabled = true;
+	DBGLOG("prof", "boot profiling is enabled");
+}
+
+void BootProfile::record(const char *name, const char *instance, uint64_t duration) {
+	IOInterruptState state = IOSimpleLockLockDisableInterrupt(lock);
+	
+	Entry *entry = nullptr;
+	for (size_t i = 0; i < entryCount; i++) {
+		if (entries[i].name == name && entries[i].instance == instance) {
+			entry = &entries[i];
+			break;
+		}
+	}
+	
+	if (entry == nullptr && entryCount < MaxEntries) {
+		entry = &entries[entryCount++];
+		entry->name = name;
+		entry->instance = instance;
+	}
+	
+	if (entry != nullptr) {
+		entry->count++;
+		entry->total += duration;
+		if (duration > entry->max)
+			entry->max = duration;
+	}
+	
+	IOSimpleLockUnlockEnableInterrupt(lock, state);
+}
+
+void BootProfile::schedulePublish() {
+	if (UNLIKELY(enabled))
+		thread_call_enter(publisher);
+}
+
+void BootProfile::publish(thread_call_param_t, thread_call_param_t) {
+	// Take a consistent snapshot, allocations are not allowed under the lock
+	auto snapshot = Buffer::create<Entry>(MaxEntries);
+	if (snapshot == nullptr) {
+		SYSLOG("prof", "failed to allocate the boot profile snapshot");
+		return;
+	}
+	
+	IOInterruptState state = IOSimpleLockLockDisableInterrupt(lock);
+	size_t count = entryCount;
+	lilu_os_memcpy(snapshot, entries, sizeof(Entry) * count);
+	IOSimpleLockUnlockEnableInterrupt(lock, state);
+	
+	auto profile = OSDictionary::withCapacity(static_cast<unsigned>(count));
+	if (profile == nullptr) {
+		SYSLOG("prof", "failed to allocate the boot profile dictionary");
+		Buffer::deleter(snapshot);
+		return;
+	}
+	
+	for (size_t i = 0; i < count; i++) {
+		auto &entry = snapshot[i];
+		char key[128];
+		if (entry.instance == nullptr)
+			snprintf(key, sizeof(key), "%s", entry.name);
+		else
+			snprintf(key, sizeof(key), "%s[%s]", entry.name, entry.instance);
+		
+		uint64_t totalNs, maxNs;
+		absolutetime_to_nanoseconds(entry.total, &totalNs);
+		absolutetime_to_nanoseconds(entry.max, &maxNs);
+		
+		auto phase = OSDictionary::withCapacity(3);
+		if (phase == nullptr)
+			continue;
+		
+		const ppair<const char *, uint64_t> values[] {
+			{"count", entry.count},
+			{"total-ns", totalNs},
+			{"max-ns", maxNs},
+		};
+		for (auto &value : values) {
+			auto number = OSNumber::withNumber(value.second, 64);
+			if (number) {
+				phase->setObject(value.first, number);
+				number->release();
+			}
+		}
+		
+		profile->setObject(key, phase);
+		phase->release();
+	}
+	
+	// The resource is only available once the kext personality has started, so later phases publish it again
+	auto resource = IORegistryEntry::fromPath("IOService:/IOResources/WhateverGreen");
+	if (resource) {
+		resource->setProperty("weg-boot-profile", profile);
+		resource->release();
+	} else {
+		DBGLOG("prof", "WhateverGreen resource is not yet published");
+	}
+	
+	profile->release();
+	Buffer::deleter(snapshot);
+}
@@ -0,0 +1,111 @@
+//
+//  kern_profile.hpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_profile_hpp
+#define kern_profile_hpp
+
+#include <Headers/kern_util.hpp>
+#include <IOKit/IOLocks.h>
+#include <kern/clock.h>
+#include <kern/thread_call.h>
+
+/**
+ *  Aggregates the time spent in patching phases and publishes it as `weg-boot-profile` at `IOService:/IOResources/WhateverGreen`
+ *
+ *  @note Enabled by the `-wegprof` boot argument. When disabled, profiling a phase costs a single branch.
+ *  @note Phases are identified by a static name and an optional static instance name, e.g. the name of an IGFX submodule.
+ */
+class BootProfile {
+	/**
+	 *  Maximum number of distinct phases
+	 */
+	static constexpr size_t MaxEntries = 128;
+	
+	/**
+	 *  Statistics of a single phase
+	 */
+	struct Entry {
+		const char *name;
+		const char *instance;
+		uint32_t count;
+		uint64_t total;
+		uint64_t max;
+	};
+	
+	/**
+	 *  Phase statistics in the order of their first completion
+	 */
+	static Entry entries[MaxEntries];
+	
+	/**
+	 *  The number of used entries
+	 */
+	static size_t entryCount;
+	
+	/**
+	 *  Set to `true` if profiling is enabled
+	 */
+	static bool enabled;
+	
+	/**
+	 *  A lock that protects the entries
+	 */
+	static IOSimpleLock *lock;
+	
+	/**
+	 *  A thread call that publishes the profile outside of the profiled code
+	 */
+	static thread_call_t publisher;
+	
+	/**
+	 *  Publish the profile to ioreg
+	 */
+	static void publish(thread_call_param_t param0, thread_call_param_t param1);
+	
+public:
+	/**
+	 *  Enable profiling if requested by the boot argument
+	 */
+	static void init();
+	
+	/**
+	 *  Mark the beginning of a phase
+	 *
+	 *  @return The current absolute time, or 0 if profiling is disabled.
+	 */
+	static inline uint64_t start() {
+		return LIKELY(!enabled) ? 0 : mach_absolute_time();
+	}
+	
+	/**
+	 *  Mark the end of a phase
+	 *
+	 *  @param name     A static name of the phase
+	 *  @param start    The value returned by `start()`
+	 *  @param instance An optional static name of the phase instance
+	 */
+	static inline void stop(const char *name, uint64_t start, const char *instance = nullptr) {
+		if (UNLIKELY(enabled))
+			record(name, instance, mach_absolute_time() - start);
+	}
+	
+	/**
+	 *  Add the duration of a phase to the profile
+	 *
+	 *  @param name     A static name of the phase
+	 *  @param instance A static name of the phase instance or `nullptr`
+	 *  @param duration The duration in absolute time units
+	 */
+	static void record(const char *name, const char *instance, uint64_t duration);
+	
+	/**
+	 *  Request publishing the profile once the current phase is complete
+	 */
+	static void schedulePublish();
+};
+
+#endif /* kern_profile_hpp */
@@ -15,6 +15,16 @@
 
 #include "kern_rad.hpp"
 
+/**
+ *  Exposes the update stamp OSCollection bumps on every modification
+ */
+class OSCollectionStamp : public OSCollection {
+public:
+	static unsigned int get(OSCollection *collection) {
+		return static_cast<OSCollectionStamp *>(collection)->updateStamp;
+	}
+};
+
 static const char *pathFramebuffer[]		{ "/System/Library/Extensions/AMDFramebuffer.kext/Contents/MacOS/AMDFramebuffer" };
 static const char *pathRedeonX6000Framebuffer[]	{ "/System/Library/Extensions/AMDRadeonX6000Framebuffer.kext/Contents/MacOS/AMDRadeonX6000Framebuffer" };
 static const char *pathLegacyFramebuffer[]	{ "/System/Library/Extensions/AMDLegacyFramebuffer.kext/Contents/MacOS/AMDLegacyFramebuffer" };
@@ -80,6 +90,21 @@ static const char *powerGatingFlags[] {
 	"CAIL_DisableSAMUPowerGating"
 };
 
+static const char *mergedPropertyNames[] {
+	"aty_config",
+	"aty_properties",
+	"cail_properties"
+};
+
+static const char *mergedPropertyPrefixes[] {
+	"CFG,",
+	"PP,",
+	"CAIL,"
+};
+
+static_assert(arrsize(mergedPropertyNames) == RAD::MergedPropertyKeyCount, "Merged property names are out of sync");
+static_assert(arrsize(mergedPropertyPrefixes) == RAD::MergedPropertyKeyCount, "Merged property prefixes are out of sync");
+
 RAD *RAD::callbackRAD;
 
 void RAD::init(bool enableNavi10Bkl) {
@@ -88,6 +113,10 @@ void RAD::init(bool enableNavi10Bkl) {
 	currentPropProvider.init();
 	currentLegacyPropProvider.init();
 
+	mergedPropertiesLock = IOSimpleLockAlloc();
+	if (!mergedPropertiesLock)
+		SYSLOG("rad", "failed to allocate merged property cache lock");
+
 	force24BppMode = checkKernelArgument("-rad24");
 	useCustomAgdpDecision = getKernelVersion() >= KernelVersion::Catalina;
 
@@ -137,12 +166,33 @@ void RAD::init(bool enableNavi10Bkl) {
 			powerGatingFlags[i] = nullptr;
 		} else {
 			DBGLOG("rad", "enabling %s", powerGatingFlags[i]);
+			static_assert(arrsize(powerGatingFlags) == arrsize(powerGatingSymbols), "Power gating flags are out of sync");
+			// Symbol lookups compare pointers instead of strings
+			powerGatingSymbols[powerGatingCount] = OSSymbol::withCString(powerGatingFlags[i]);
+			if (powerGatingSymbols[powerGatingCount])
+				powerGatingCount++;
+			else
+				SYSLOG("rad", "failed to allocate %s symbol", powerGatingFlags[i]);
 		}
 	}
 }
 
 void RAD::deinit() {
+	for (auto &entry : mergedProperties)
+		OSSafeReleaseNULL(entry.merged);
 
+	for (auto &entry : providerPropertyNames)
+		for (auto &names : entry.names)
+			OSSafeReleaseNULL(names);
+
+	for (size_t i = 0; i < powerGatingCount; i++)
+		OSSafeReleaseNULL(powerGatingSymbols[i]);
+	powerGatingCount = 0;
+
+	if (mergedPropertiesLock) {
+		IOSimpleLockFree(mergedPropertiesLock);
+		mergedPropertiesLock = nullptr;
+	}
 }
 
 void RAD::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
@@ -621,42 +671,134 @@ void RAD::mergeProperty(OSDictionary *props, const char *name, OSObject *value)
 	DBGLOG("rad", "prop %s was merged", name);
 }
 
-void RAD::mergeProperties(OSDictionary *props, const char *prefix, IOService *provider) {
+OSArray *RAD::copyProviderPropertyNames(IOService *provider, OSDictionary *table, MergedPropertyKey key) {
+	auto tableGeneration = OSCollectionStamp::get(table);
+	OSArray *names = nullptr;
+
+	if (mergedPropertiesLock) {
+		IOSimpleLockLock(mergedPropertiesLock);
+		for (auto &entry : providerPropertyNames) {
+			if (entry.provider == provider && entry.table == table && entry.tableGeneration == tableGeneration && entry.names[key]) {
+				names = entry.names[key];
+				names->retain();
+				break;
+			}
+		}
+		IOSimpleLockUnlock(mergedPropertiesLock);
+
+		if (names)
+			return names;
+	}
+
+	OSArray *groups[MergedPropertyKeyCount] {};
+	for (auto &group : groups) {
+		group = OSArray::withCapacity(4);
+		if (!group) {
+			SYSLOG("rad", "prop merge failed to allocate property groups");
+			for (auto &allocated : groups)
+				OSSafeReleaseNULL(allocated);
+			return nullptr;
+		}
+	}
+
+	// Bucket all prefixed properties in one pass, most of them are rejected by the first character.
+	auto iterator = OSCollectionIterator::withCollection(table);
+	if (!iterator) {
+		SYSLOG("rad", "prop merge failed to iterate over properties");
+		for (auto &group : groups)
+			OSSafeReleaseNULL(group);
+		return nullptr;
+	}
+
+	OSSymbol *propname;
+	while ((propname = OSDynamicCast(OSSymbol, iterator->getNextObject())) != nullptr) {
+		auto name = propname->getCStringNoCopy();
+		if (!name || (name[0] != 'C' && name[0] != 'P'))
+			continue;
+
+		for (size_t i = 0; i < MergedPropertyKeyCount; i++) {
+			size_t prefixlen = strlen(mergedPropertyPrefixes[i]);
+			if (propname->getLength() > prefixlen && !strncmp(name, mergedPropertyPrefixes[i], prefixlen)) {
+				groups[i]->setObject(propname);
+				break;
+			}
+		}
+	}
+	iterator->release();
+
+	DBGLOG("rad", "prop merge classified %u CFG, %u PP, %u CAIL properties", groups[MergedPropertyConfig]->getCount(),
+		   groups[MergedPropertyPowerPlay]->getCount(), groups[MergedPropertyCail]->getCount());
+
+	names = groups[key];
+	names->retain();
+
+	if (!mergedPropertiesLock) {
+		for (auto &group : groups)
+			OSSafeReleaseNULL(group);
+		return names;
+	}
+
+	IOSimpleLockLock(mergedPropertiesLock);
+	ProviderPropertyNames *slot = nullptr;
+	for (auto &entry : providerPropertyNames) {
+		if (entry.provider == provider) {
+			slot = &entry;
+			break;
+		}
+		if (!slot && !entry.provider)
+			slot = &entry;
+	}
+	if (!slot) {
+		slot = &providerPropertyNames[providerPropertyNamesEvict];
+		providerPropertyNamesEvict = (providerPropertyNamesEvict + 1) % MaxProviderPropertyNames;
+	}
+	slot->provider = provider;
+	slot->table = table;
+	slot->tableGeneration = tableGeneration;
+	for (size_t i = 0; i < MergedPropertyKeyCount; i++) {
+		// Swap, so that the previous arrays are released outside of the lock
+		auto previous = slot->names[i];
+		slot->names[i] = groups[i];
+		groups[i] = previous;
+	}
+	IOSimpleLockUnlock(mergedPropertiesLock);
+
+	for (auto &group : groups)
+		OSSafeReleaseNULL(group);
+
+	return names;
+}
+
+void RAD::mergeProperties(OSDictionary *props, MergedPropertyKey key, IOService *provider) {
 	// Should be ok, but in case there are issues switch to dictionaryWithProperties();
 	auto dict = provider->getPropertyTable();
 	if (dict) {
-		auto iterator = OSCollectionIterator::withCollection(dict);
-		if (iterator) {
-			OSSymbol *propname;
-			size_t prefixlen = strlen(prefix);
-			while ((propname = OSDynamicCast(OSSymbol, iterator->getNextObject())) != nullptr) {
+		auto names = copyProviderPropertyNames(provider, dict, key);
+		if (names) {
+			size_t prefixlen = strlen(mergedPropertyPrefixes[key]);
+			for (unsigned int i = 0; i < names->getCount(); i++) {
+				auto propname = static_cast<const OSSymbol *>(names->getObject(i));
 				auto name = propname->getCStringNoCopy();
-				if (name && propname->getLength() > prefixlen && !strncmp(name, prefix, prefixlen)) {
-					auto prop = dict->getObject(propname);
-					if (prop)
-						mergeProperty(props, name + prefixlen, prop);
-					else
-						DBGLOG("rad", "prop %s was not merged due to no value", name);
-				} else {
-					//DBGLOG("rad", "prop %s does not match %s prefix", safeString(name), prefix);
-				}
+				auto prop = dict->getObject(propname);
+				if (prop)
+					mergeProperty(props, name + prefixlen, prop);
+				else
+					DBGLOG("rad", "prop %s was not merged due to no value", name);
 			}
 
-			iterator->release();
-		} else {
-			SYSLOG("rad", "prop merge failed to iterate over properties");
+			names->release();
 		}
 	} else {
 		SYSLOG("rad", "prop merge failed to get properties");
 	}
 
-	if (!strcmp(prefix, "CAIL,")) {
-		for (size_t i = 0; i < arrsize(powerGatingFlags); i++) {
-			if (powerGatingFlags[i] && props->getObject(powerGatingFlags[i])) {
-				DBGLOG("rad", "cail prop merge found %s, replacing", powerGatingFlags[i]);
+	if (key == MergedPropertyCail) {
+		for (size_t i = 0; i < powerGatingCount; i++) {
+			if (props->getObject(powerGatingSymbols[i])) {
+				DBGLOG("rad", "cail prop merge found %s, replacing", powerGatingSymbols[i]->getCStringNoCopy());
 				auto num = OSNumber::withNumber(1, 32);
 				if (num) {
-					props->setObject(powerGatingFlags[i], num);
+					props->setObject(powerGatingSymbols[i], num);
 					num->release();
 				}
 			}
@@ -664,6 +806,54 @@ void RAD::mergeProperties(OSDictionary *props, const char *prefix, IOService *pr
 	}
 }
 
+bool RAD::isMergedPropertiesCached(IORegistryEntry *service, MergedPropertyKey key, OSDictionary *props, OSDictionary *table) {
+	if (!mergedPropertiesLock)
+		return false;
+
+	bool cached = false;
+	IOSimpleLockLock(mergedPropertiesLock);
+	for (auto &entry : mergedProperties) {
+		if (entry.merged && entry.service == service && entry.key == key) {
+			// The driver may replace or modify the dictionary, and the provider may get new properties.
+			cached = entry.merged == props && entry.table == table &&
+				entry.tableGeneration == OSCollectionStamp::get(table) &&
+				entry.mergedGeneration == OSCollectionStamp::get(props);
+			break;
+		}
+	}
+	IOSimpleLockUnlock(mergedPropertiesLock);
+
+	return cached;
+}
+
+void RAD::cacheMergedProperties(IORegistryEntry *service, MergedPropertyKey key, OSDictionary *merged, OSDictionary *table, unsigned int tableGeneration) {
+	if (!mergedPropertiesLock)
+		return;
+
+	merged->retain();
+
+	IOSimpleLockLock(mergedPropertiesLock);
+	MergedProperties *slot = nullptr;
+	for (auto &entry : mergedProperties) {
+		if (entry.merged && entry.service == service && entry.key == key) {
+			slot = &entry;
+			break;
+		}
+		if (!slot && !entry.merged)
+			slot = &entry;
+	}
+	if (!slot) {
+		slot = &mergedProperties[mergedPropertiesEvict];
+		mergedPropertiesEvict = (mergedPropertiesEvict + 1) % MaxMergedProperties;
+	}
+	auto evicted = slot->merged;
+	*slot = {service, key, merged, table, tableGeneration, OSCollectionStamp::get(merged)};
+	IOSimpleLockUnlock(mergedPropertiesLock);
+
+	// Release outside of the lock, this may free the dictionary
+	OSSafeReleaseNULL(evicted);
+}
+
 void RAD::applyPropertyFixes(IOService *service, uint32_t connectorNum) {
 	if (service && getKernelVersion() >= KernelVersion::HighSierra) {
 		// Starting with 10.13.2 this is important to fix sleep issues due to enforced 6 screens
@@ -742,6 +932,12 @@ void RAD::updateConnectorsInfo(void *atomutils, t_getAtomObjectTableForType gett
 
 void RAD::autocorrectConnectors(uint8_t *baseAddr, AtomDisplayObjectPath *displayPaths, uint8_t displayPathNum, AtomConnectorObject *connectorObjects,
 								uint8_t connectorObjectNum, RADConnectors::Connector *connectors, uint8_t sz) {
+	RADConnectors::ConnectorView view;
+	if (!view.load(connectors, sz)) {
+		SYSLOG("rad", "autocorrectConnectors got too many connectors %u", sz);
+		return;
+	}
+
 	for (uint8_t i = 0; i < displayPathNum; i++) {
 		if (!isEncoder(displayPaths[i].usGraphicObjIds)) {
 			DBGLOG("rad", "autocorrectConnectors not encoder %X at %u", displayPaths[i].usGraphicObjIds, i);
@@ -760,11 +956,13 @@ void RAD::autocorrectConnectors(uint8_t *baseAddr, AtomDisplayObjectPath *displa
 
 		DBGLOG("rad", "autocorrectConnectors found txmit %02X enc %02X sense %02X for %u connector", txmit, enc, sense, i);
 
-		autocorrectConnector(getConnectorID(displayPaths[i].usConnObjectId), sense, txmit, enc, connectors, sz);
+		autocorrectConnector(getConnectorID(displayPaths[i].usConnObjectId), sense, txmit, enc, view);
 	}
+
+	view.store(connectors);
 }
 
-void RAD::autocorrectConnector(uint8_t connector, uint8_t sense, uint8_t txmit, uint8_t enc, RADConnectors::Connector *connectors, uint8_t sz) {
+void RAD::autocorrectConnector(uint8_t connector, uint8_t sense, uint8_t txmit, uint8_t enc, RADConnectors::ConnectorView &view) {
 	// This function attempts to fix the following issues:
 	//
 	// 1. Incompatible DVI transmitter on 290X, 370 and probably some other models
@@ -781,76 +979,29 @@ void RAD::autocorrectConnector(uint8_t connector, uint8_t sense, uint8_t txmit,
 			return;
 		}
 
-		auto fixTransmit = [](auto &con, uint8_t idx, uint8_t sense, uint8_t txmit) {
-			if (con.sense == sense) {
-				if (con.transmitter != txmit && (con.transmitter & 0xCF) == con.transmitter) {
-					DBGLOG("rad", "autocorrectConnector replacing txmit %02X with %02X for %u connector sense %02X",
-						   con.transmitter, txmit, idx, sense);
-					con.transmitter = txmit;
-				}
-				return true;
-			}
-			return false;
-		};
-
-		bool isModern = RADConnectors::modern();
-		for (uint8_t j = 0; j < sz; j++) {
-			if (isModern) {
-				auto &con = (&connectors->modern)[j];
-				if (fixTransmit(con, j, sense, txmit))
-					break;
-			} else {
-				auto &con = (&connectors->legacy)[j];
-				if (fixTransmit(con, j, sense, txmit))
-					break;
-			}
-		}
+		auto idx = view.correctTransmitter(sense, txmit);
+		if (idx != RADConnectors::ConnectorView::None)
+			DBGLOG("rad", "autocorrectConnector replaced txmit with %02X for %u connector sense %02X", txmit, idx, sense);
 	} else {
 		DBGLOG("rad", "autocorrectConnector use -raddvi to enable dvi autocorrection");
 	}
 }
 
 void RAD::reprioritiseConnectors(const uint8_t *senseList, uint8_t senseNum, RADConnectors::Connector *connectors, uint8_t sz) {
-	static constexpr uint32_t typeList[] {
-		RADConnectors::ConnectorLVDS,
-		RADConnectors::ConnectorDigitalDVI,
-		RADConnectors::ConnectorHDMI,
-		RADConnectors::ConnectorDP,
-		RADConnectors::ConnectorVGA
-	};
-	static constexpr uint8_t typeNum {static_cast<uint8_t>(arrsize(typeList))};
+	static_assert(RADConnectors::PriorityTypeNum <= RADConnectors::ConnectorView::MaxTypes, "Too many connector types");
+
+	RADConnectors::ConnectorView view;
+	if (!view.load(connectors, sz)) {
+		SYSLOG("rad", "reprioritiseConnectors got too many connectors %u", sz);
+		return;
+	}
 
-	bool isModern = RADConnectors::modern();
-	uint16_t priCount = 1;
 	// Automatically detected connectors have equal priority (0), which often results in black screen
 	// This allows to change this firstly by user-defined list, then by type list.
 	//TODO: priority is ignored for 5xxx and 6xxx GPUs, should we manually reorder items?
-	for (uint8_t i = 0; i < senseNum + typeNum + 1; i++) {
-		for (uint8_t j = 0; j < sz; j++) {
-			auto reorder = [&](auto &con) {
-				if (i == senseNum + typeNum) {
-					if (con.priority == 0)
-						con.priority = priCount++;
-				} else if (i < senseNum) {
-					if (con.sense == senseList[i]) {
-						DBGLOG("rad", "reprioritiseConnectors setting priority of sense %02X to %u by sense", con.sense, priCount);
-						con.priority = priCount++;
-						return true;
-					}
-				} else {
-					if (con.priority == 0 && con.type == typeList[i-senseNum]) {
-						DBGLOG("rad", "reprioritiseConnectors setting priority of sense %02X to %u by type", con.sense, priCount);
-						con.priority = priCount++;
-					}
-				}
-				return false;
-			};
+	view.prioritise(senseList, senseNum, RADConnectors::PriorityTypes, RADConnectors::PriorityTypeNum);
 
-			if ((isModern && reorder((&connectors->modern)[j])) ||
-				(!isModern && reorder((&connectors->legacy)[j])))
-				break;
-		}
-	}
+	view.store(connectors);
 }
 
 void RAD::setGvaProperties(IOService *accelService) {
@@ -1039,27 +1190,36 @@ OSObject *RAD::wrapGetProperty(IORegistryEntry *that, const char *aKey) {
 	auto props = OSDynamicCast(OSDictionary, obj);
 
 	if (props && aKey) {
-		const char *prefix {nullptr};
+		auto key = MergedPropertyKeyCount;
 		auto provider = OSDynamicCast(IOService, that->getParentEntry(gIOServicePlane));
 		if (provider) {
-			if (aKey[0] == 'a') {
-				if (!strcmp(aKey, "aty_config"))
-					prefix = "CFG,";
-				else if (!strcmp(aKey, "aty_properties"))
-					prefix = "PP,";
-			} else if (aKey[0] == 'c' && !strcmp(aKey, "cail_properties")) {
-				prefix = "CAIL,";
+			if (aKey[0] == 'a' || aKey[0] == 'c') {
+				for (size_t i = 0; i < MergedPropertyKeyCount; i++) {
+					if (!strcmp(aKey, mergedPropertyNames[i])) {
+						key = static_cast<MergedPropertyKey>(i);
+						break;
+					}
+				}
 			}
 
-			if (prefix) {
+			if (key != MergedPropertyKeyCount) {
+				// The merged dictionary stays set as the property, so it can be returned as is
+				// until the driver or the provider change anything.
+				auto table = provider->getPropertyTable();
+				if (table && callbackRAD->isMergedPropertiesCached(that, key, props, table))
+					return obj;
+
 				DBGLOG("rad", "GetProperty discovered property merge request for %s", aKey);
+				auto tableGeneration = table ? OSCollectionStamp::get(table) : 0;
 				auto rawProps = props->copyCollection();
 				if (rawProps) {
 					auto newProps = OSDynamicCast(OSDictionary, rawProps);
 					if (newProps) {
-						callbackRAD->mergeProperties(newProps, prefix, provider);
+						callbackRAD->mergeProperties(newProps, key, provider);
 						that->setProperty(aKey, newProps);
 						obj = newProps;
+						if (table)
+							callbackRAD->cacheMergedProperties(that, key, newProps, table, tableGeneration);
 					}
 					rawProps->release();
 				}
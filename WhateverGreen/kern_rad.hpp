@@ -39,6 +39,16 @@ public:
 		MaxRadeonHardwareModernHighSierra = IndexRadeonHardwareX3000 + 1
 	};
 
+	/**
+	 *  Controller properties merged with prefixed provider properties
+	 */
+	enum MergedPropertyKey {
+		MergedPropertyConfig,
+		MergedPropertyPowerPlay,
+		MergedPropertyCail,
+		MergedPropertyKeyCount
+	};
+
 	/**
 	 *  Property patching routine
 	 *
@@ -353,10 +363,141 @@ private:
 	 *  Merge configuration properties from ioreg
 	 *
 	 *  @param props     target dictionary with original properties
-	 *  @param prefix    property name prefix in provider
+	 *  @param key       merged property key
 	 *  @param provider  property provider for merging
 	 */
-	void mergeProperties(OSDictionary *props, const char *prefix, IOService *provider);
+	void mergeProperties(OSDictionary *props, MergedPropertyKey key, IOService *provider);
+
+	/**
+	 *  Prefixed provider property names grouped by merged property key
+	 */
+	struct ProviderPropertyNames {
+		/**
+		 *  Property provider
+		 */
+		IOService *provider;
+
+		/**
+		 *  Provider property table and its update stamp at classification time
+		 */
+		OSDictionary *table;
+		unsigned int tableGeneration;
+
+		/**
+		 *  Prefixed property names (OSSymbol) per merged property key, retained
+		 */
+		OSArray *names[MergedPropertyKeyCount];
+	};
+
+	/**
+	 *  Maximum amount of providers with classified properties
+	 */
+	static constexpr size_t MaxProviderPropertyNames = 4;
+
+	/**
+	 *  Classified provider properties
+	 */
+	ProviderPropertyNames providerPropertyNames[MaxProviderPropertyNames] {};
+
+	/**
+	 *  Next classified provider entry to evict when the cache is full
+	 */
+	size_t providerPropertyNamesEvict {0};
+
+	/**
+	 *  Obtain prefixed provider property names, classifying all provider properties in one pass if needed
+	 *
+	 *  @param provider  property provider
+	 *  @param table     provider property table
+	 *  @param key       merged property key
+	 *
+	 *  @return retained array of OSSymbol property names or nullptr
+	 */
+	OSArray *copyProviderPropertyNames(IOService *provider, OSDictionary *table, MergedPropertyKey key);
+
+	/**
+	 *  Enabled power gating flags looked up in merged cail_properties
+	 */
+	const OSSymbol *powerGatingSymbols[8] {};
+
+	/**
+	 *  Amount of enabled power gating flags
+	 */
+	size_t powerGatingCount {0};
+
+	/**
+	 *  Merged property dictionary cache entry
+	 */
+	struct MergedProperties {
+		/**
+		 *  Registry entry the dictionary was merged for
+		 */
+		IORegistryEntry *service;
+
+		/**
+		 *  Merged property key
+		 */
+		MergedPropertyKey key;
+
+		/**
+		 *  Merged dictionary set as the property, retained
+		 */
+		OSDictionary *merged;
+
+		/**
+		 *  Provider property table the values were merged from
+		 */
+		OSDictionary *table;
+
+		/**
+		 *  Provider property table and merged dictionary update stamps at merge time
+		 */
+		unsigned int tableGeneration;
+		unsigned int mergedGeneration;
+	};
+
+	/**
+	 *  Maximum amount of cached merged dictionaries, enough for 4 GPUs
+	 */
+	static constexpr size_t MaxMergedProperties = 12;
+
+	/**
+	 *  Merged property dictionaries for controllers already seen by wrapGetProperty
+	 */
+	MergedProperties mergedProperties[MaxMergedProperties] {};
+
+	/**
+	 *  Next cache entry to evict when the cache is full
+	 */
+	size_t mergedPropertiesEvict {0};
+
+	/**
+	 *  Merged property cache lock
+	 */
+	IOSimpleLock *mergedPropertiesLock {nullptr};
+
+	/**
+	 *  Check whether the dictionary returned by getProperty is still the up to date merged dictionary
+	 *
+	 *  @param service   registry entry the property belongs to
+	 *  @param key       merged property key
+	 *  @param props     dictionary returned by the original getProperty
+	 *  @param table     provider property table
+	 *
+	 *  @return true if no merge is needed
+	 */
+	bool isMergedPropertiesCached(IORegistryEntry *service, MergedPropertyKey key, OSDictionary *props, OSDictionary *table);
+
+	/**
+	 *  Remember a freshly merged dictionary
+	 *
+	 *  @param service          registry entry the property belongs to
+	 *  @param key              merged property key
+	 *  @param merged           merged dictionary set as the property
+	 *  @param table            provider property table
+	 *  @param tableGeneration  provider property table update stamp before merging
+	 */
+	void cacheMergedProperties(IORegistryEntry *service, MergedPropertyKey key, OSDictionary *merged, OSDictionary *table, unsigned int tableGeneration);
 
 	/**
 	 *  Automatically add properties to fix various bugs
@@ -397,10 +538,9 @@ private:
 	 *  @param sense       sense id
 	 *  @param txmit       transmitter
 	 *  @param enc         encoder
-	 *  @param connectors  pointer to autodetected connectors
-	 *  @param sz          number of autodetected connectors
+	 *  @param view        autodetected connectors
 	 */
-	void autocorrectConnector(uint8_t connector, uint8_t sense, uint8_t txmit, uint8_t enc, RADConnectors::Connector *connectors, uint8_t sz);
+	void autocorrectConnector(uint8_t connector, uint8_t sense, uint8_t txmit, uint8_t enc, RADConnectors::ConnectorView &view);
 
 	/**
 	 *  Changes connector priority according to provided sense id list
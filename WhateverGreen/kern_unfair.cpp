@@ -20,6 +20,23 @@
 
 UNFAIR *UNFAIR::callbackUNFAIR;
 
+static const uint8_t relaxedDrmModelFind[29] = {
+	0x4D, 0x61, 0x63, 0x50, 0x72, 0x6F, 0x35, 0x2C, 0x31, 0x00, 0x4D, 0x61, 0x63, 0x50, 0x72, 0x6F,
+	0x36, 0x2C, 0x31, 0x00, 0x49, 0x4F, 0x53, 0x65, 0x72, 0x76, 0x69, 0x63, 0x65
+};
+
+static const uint8_t hwgvaIdFind[18] = {
+	0x62, 0x6F, 0x61, 0x72, 0x64, 0x2D, 0x69, 0x64, 0x00, 0x68, 0x77, 0x2E, 0x6D, 0x6F, 0x64, 0x65,
+	0x6C
+};
+
+static const uint8_t hwgvaIdReplace[5] = {
+	0x68, 0x77, 0x67, 0x76, 0x61
+};
+
+static const uint8_t streamingCpuidFind[] = {0xC7, 0xC0, 0x01, 0x00, 0x00, 0x00, 0x0F, 0xA2};
+static const uint8_t streamingCpuidReplace[] = {0xC7, 0xC0, 0xC3, 0x06, 0x03, 0x00, 0x90, 0x90};
+
 void UNFAIR::init() {
 	callbackUNFAIR = this;
 
@@ -31,47 +48,135 @@ void UNFAIR::init() {
 }
 
 void UNFAIR::deinit() {
+	if (sharedCacheIndexPublisher) {
+		thread_call_cancel(sharedCacheIndexPublisher);
+		thread_call_free(sharedCacheIndexPublisher);
+		sharedCacheIndexPublisher = nullptr;
+	}
 
+	for (size_t i = 0; i < SharedCachePageIndex::Slots; i++) {
+		auto cleanPages = sharedCacheIndex.detach(i);
+		if (cleanPages)
+			Buffer::deleter(cleanPages);
+	}
 }
 
-void UNFAIR::csValidatePage(vnode *vp, memory_object_t pager, memory_object_offset_t page_offset, const void *data, int *validated_p, int *tainted_p, int *nx_p) {
-	FunctionCast(csValidatePage, callbackUNFAIR->orgCsValidatePage)(vp, pager, page_offset, data, validated_p, tainted_p, nx_p);
+void UNFAIR::initSharedCacheIndex() {
+	for (size_t i = 0; i < SharedCachePageIndex::Slots; i++) {
+		auto cleanPages = Buffer::create<uint64_t>(SharedCachePageIndex::BitmapWords);
+		if (!cleanPages) {
+			SYSLOG("unfair", "failed to allocate shared cache page index");
+			return;
+		}
+		memset(cleanPages, 0, SharedCachePageIndex::BitmapWords * sizeof(uint64_t));
+		sharedCacheIndex.attach(i, cleanPages);
+	}
+
+	// The counters are diagnostics only, the index works without them
+	sharedCacheIndexPublisher = thread_call_allocate(publishSharedCacheIndex, this);
+	if (!sharedCacheIndexPublisher)
+		SYSLOG("unfair", "failed to allocate page index stats publisher");
+}
+
+void UNFAIR::publishSharedCacheIndex(thread_call_param_t param0, thread_call_param_t param1) {
+	auto self = static_cast<UNFAIR *>(param0);
+
+	static const char *statNames[SharedCacheIndexStatCount] {"hits", "misses", "matches"};
+	auto dict = OSDictionary::withCapacity(SharedCacheIndexStatCount);
+	if (!dict)
+		return;
+
+	for (size_t i = 0; i < SharedCacheIndexStatCount; i++) {
+		auto num = OSNumber::withNumber(__atomic_load_n(&self->sharedCacheIndexStats[i], __ATOMIC_RELAXED), 64);
+		if (num) {
+			dict->setObject(statNames[i], num);
+			num->release();
+		}
+	}
+
+	auto entry = IORegistryEntry::fromPath("/", gIODTPlane);
+	if (entry) {
+		entry->setProperty("unfair-page-index", dict);
+		entry->release();
+	} else {
+		SYSLOG("unfair", "failed to obtain iodt tree for page index stats");
+	}
+
+	dict->release();
+}
+
+void UNFAIR::patchSharedCachePage(vnode *vp, uint32_t vid, memory_object_offset_t page_offset, const void *data) {
+	auto page = page_offset / PAGE_SIZE;
+	SharedCachePageIndex::Slot *index = nullptr;
+	if (page < SharedCachePageIndex::Pages) {
+		index = sharedCacheIndex.acquire(vp, vid);
+		if (index && SharedCachePageIndex::isClean(index, page)) {
+			sharedCacheIndex.release(index);
+			countSharedCacheIndex(SharedCacheIndexHits);
+			return;
+		}
+	}
+
+	countSharedCacheIndex(SharedCacheIndexMisses);
+
+	auto applied = sharedCachePatcher.apply(const_cast<void *>(data), PAGE_SIZE);
+	if (applied == 0) {
+		// Pages patched in memory before must be scanned when they come from disk again
+		if (index) {
+			if (sharedCachePatchedMatcher.match(data, PAGE_SIZE) == 0)
+				SharedCachePageIndex::markClean(index, page);
+			sharedCacheIndex.release(index);
+		}
+		return;
+	}
+
+	if (index)
+		sharedCacheIndex.release(index);
+
+	countSharedCacheIndex(SharedCacheIndexMatches);
+	if (relaxedDrmModelPatch >= 0 && (applied & (1U << relaxedDrmModelPatch)))
+		DBGLOG("unfair", "patched relaxed drm model");
+	if (hwgvaIdPatch >= 0 && (applied & (1U << hwgvaIdPatch)))
+		DBGLOG("unfair", "patched board-id -> hwgva-id");
+}
+
+uint64_t UNFAIR::classifyVnode(vnode *vp, uint32_t vid) {
+	auto kind = vnodeCache.lookup(vp, vid);
+	if (LIKELY(kind != VnodeKindCache::Unknown))
+		return kind;
 
 	char path[PATH_MAX];
 	int pathlen = PATH_MAX;
-	if (vn_getpath(vp, path, &pathlen) == 0) {
-		//DBGLOG("unfair", "csValidatePage %s", path);
-
-		if ((callbackUNFAIR->unfairGva & UnfairDyldSharedCache) != 0 && UserPatcher::matchSharedCachePath(path)) {
-			if ((callbackUNFAIR->unfairGva & UnfairRelaxHdcpRequirements) != 0) {
-				static const uint8_t find[29] = {
-					0x4D, 0x61, 0x63, 0x50, 0x72, 0x6F, 0x35, 0x2C, 0x31, 0x00, 0x4D, 0x61, 0x63, 0x50, 0x72, 0x6F,
-					0x36, 0x2C, 0x31, 0x00, 0x49, 0x4F, 0x53, 0x65, 0x72, 0x76, 0x69, 0x63, 0x65
-				};
-				if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), PAGE_SIZE, find, sizeof(find), BaseDeviceInfo::get().modelIdentifier, 20)))
-					DBGLOG("unfair", "patched relaxed drm model");
-			}
-
-			if ((callbackUNFAIR->unfairGva & UnfairCustomAppleGvaBoardId) != 0) {
-				static const uint8_t find[18] = {
-					0x62, 0x6F, 0x61, 0x72, 0x64, 0x2D, 0x69, 0x64, 0x00, 0x68, 0x77, 0x2E, 0x6D, 0x6F, 0x64, 0x65,
-					0x6C
-				};
-				static const uint8_t repl[5] = {
-					0x68, 0x77, 0x67, 0x76, 0x61
-				};
-				if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), PAGE_SIZE, find, sizeof(find), repl, sizeof(repl))))
-					DBGLOG("unfair", "patched board-id -> hwgva-id");
-			}
-
-		} else if ((callbackUNFAIR->unfairGva & UnfairAllowHardwareDrmStreamDecoderOnOldCpuid) != 0 &&
-				   (UNLIKELY(strcmp(path, "/System/Library/PrivateFrameworks/CoreLSKDMSE.framework/Versions/A/CoreLSKDMSE") == 0) ||
-				   UNLIKELY(strcmp(path, "/System/Library/PrivateFrameworks/CoreLSKD.framework/Versions/A/CoreLSKD") == 0))) {
-			static const uint8_t find[] = {0xC7, 0xC0, 0x01, 0x00, 0x00, 0x00, 0x0F, 0xA2};
-			static const uint8_t repl[] = {0xC7, 0xC0, 0xC3, 0x06, 0x03, 0x00, 0x90, 0x90};
-			if (UNLIKELY(KernelPatcher::findAndReplace(const_cast<void *>(data), PAGE_SIZE, find, sizeof(find), repl, sizeof(repl))))
-				DBGLOG("unfair", "patched streaming cpuid to haswell");
-		}
+	if (vn_getpath(vp, path, &pathlen) != 0)
+		return VnodeKindCache::Unknown;
+
+	//DBGLOG("unfair", "csValidatePage %s", path);
+
+	kind = VnodeKindCache::Irrelevant;
+	if (UserPatcher::matchSharedCachePath(path))
+		kind = VnodeKindCache::SharedCache;
+	else if (UNLIKELY(strcmp(path, "/System/Library/PrivateFrameworks/CoreLSKDMSE.framework/Versions/A/CoreLSKDMSE") == 0) ||
+			 UNLIKELY(strcmp(path, "/System/Library/PrivateFrameworks/CoreLSKD.framework/Versions/A/CoreLSKD") == 0))
+		kind = VnodeKindCache::CoreLSKD;
+
+	vnodeCache.store(vp, vid, kind);
+	return kind;
+}
+
+void UNFAIR::csValidatePage(vnode *vp, memory_object_t pager, memory_object_offset_t page_offset, const void *data, int *validated_p, int *tainted_p, int *nx_p) {
+	FunctionCast(csValidatePage, callbackUNFAIR->orgCsValidatePage)(vp, pager, page_offset, data, validated_p, tainted_p, nx_p);
+
+	auto vid = vnode_vid(vp);
+	auto kind = callbackUNFAIR->classifyVnode(vp, vid);
+	if (LIKELY(kind == VnodeKindCache::Irrelevant || kind == VnodeKindCache::Unknown))
+		return;
+
+	if (kind == VnodeKindCache::SharedCache) {
+		if (!callbackUNFAIR->sharedCachePatcher.empty())
+			callbackUNFAIR->patchSharedCachePage(vp, vid, page_offset, data);
+	} else if (kind == VnodeKindCache::CoreLSKD) {
+		if (UNLIKELY(callbackUNFAIR->coreLSKDPatcher.apply(const_cast<void *>(data), PAGE_SIZE) != 0))
+			DBGLOG("unfair", "patched streaming cpuid to haswell");
 	}
 }
 
@@ -100,6 +205,26 @@ void UNFAIR::processKernel(KernelPatcher &patcher, DeviceInfo *info) {
 		}
 	}
 
+	static_assert(sizeof(relaxedDrmModelFind) == sizeof(relaxedDrmModelPatched) &&
+				  sizeof(hwgvaIdFind) == sizeof(hwgvaIdPatched), "Patched pattern sizes must match");
+	if ((unfairGva & UnfairRelaxHdcpRequirements) != 0) {
+		relaxedDrmModelPatch = sharedCachePatcher.add(relaxedDrmModelFind, sizeof(relaxedDrmModelFind), BaseDeviceInfo::get().modelIdentifier, 20);
+		memcpy(relaxedDrmModelPatched, relaxedDrmModelFind, sizeof(relaxedDrmModelPatched));
+		memcpy(relaxedDrmModelPatched, BaseDeviceInfo::get().modelIdentifier, 20);
+		sharedCachePatchedMatcher.add(relaxedDrmModelPatched, sizeof(relaxedDrmModelPatched), relaxedDrmModelPatched, 0);
+	}
+	if ((unfairGva & UnfairCustomAppleGvaBoardId) != 0) {
+		hwgvaIdPatch = sharedCachePatcher.add(hwgvaIdFind, sizeof(hwgvaIdFind), hwgvaIdReplace, sizeof(hwgvaIdReplace));
+		memcpy(hwgvaIdPatched, hwgvaIdFind, sizeof(hwgvaIdPatched));
+		memcpy(hwgvaIdPatched, hwgvaIdReplace, sizeof(hwgvaIdReplace));
+		sharedCachePatchedMatcher.add(hwgvaIdPatched, sizeof(hwgvaIdPatched), hwgvaIdPatched, 0);
+	}
+	if ((unfairGva & UnfairAllowHardwareDrmStreamDecoderOnOldCpuid) != 0)
+		coreLSKDPatcher.add(streamingCpuidFind, sizeof(streamingCpuidFind), streamingCpuidReplace, sizeof(streamingCpuidReplace));
+
+	if (!sharedCachePatcher.empty())
+		initSharedCacheIndex();
+
 	KernelPatcher::RouteRequest csRoute("_cs_validate_page", csValidatePage, orgCsValidatePage);
 	if (!patcher.routeMultipleLong(KernelPatcher::KernelID, &csRoute, 1)) {
 		SYSLOG("unfair", "failed to route cs validation pages");
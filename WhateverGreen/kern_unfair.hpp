@@ -12,6 +12,10 @@
 #include <Headers/kern_devinfo.hpp>
 #include <Headers/kern_cpu.hpp>
 #include <Headers/kern_user.hpp>
+#include <kern/thread_call.h>
+
+#include "kern_pattern.hpp"
+#include "kern_unfair_cache.hpp"
 
 class UNFAIR {
 public:
@@ -52,6 +56,115 @@ private:
 	 */
 	uint32_t unfairGva {0};
 
+	/**
+	 *  Dyld shared cache patches applied in a single pass.
+	 */
+	MultiPatternPatcher<2> sharedCachePatcher;
+
+	/**
+	 *  Dyld shared cache patch indices for logging.
+	 */
+	int relaxedDrmModelPatch {-1};
+	int hwgvaIdPatch {-1};
+
+	/**
+	 *  Dyld shared cache patterns as they look after patching.
+	 *  A page validated again after it was patched in memory no longer matches the patches,
+	 *  but it must not be marked clean, as it comes unpatched when paged in from disk.
+	 */
+	MultiPatternPatcher<2> sharedCachePatchedMatcher;
+
+	/**
+	 *  Patched dyld shared cache pattern contents.
+	 */
+	uint8_t relaxedDrmModelPatched[29] {};
+	uint8_t hwgvaIdPatched[18] {};
+
+	/**
+	 *  CoreLSKD and CoreLSKDMSE patches.
+	 */
+	MultiPatternPatcher<1> coreLSKDPatcher;
+
+	/**
+	 *  Dyld shared cache page index.
+	 */
+	SharedCachePageIndex sharedCacheIndex;
+
+	/**
+	 *  Dyld shared cache page index statistics.
+	 */
+	enum : size_t {
+		SharedCacheIndexHits,
+		SharedCacheIndexMisses,
+		SharedCacheIndexMatches,
+		SharedCacheIndexStatCount,
+	};
+
+	/**
+	 *  The number of validations that triggers publishing the counters
+	 */
+	static constexpr uint64_t SharedCacheIndexPublishInterval = 1024;
+
+	/**
+	 *  Dyld shared cache page index counters.
+	 */
+	uint64_t sharedCacheIndexStats[SharedCacheIndexStatCount] {};
+
+	/**
+	 *  A thread call that publishes the counters in unfair-page-index property of IODT root
+	 */
+	thread_call_t sharedCacheIndexPublisher {nullptr};
+
+	/**
+	 *  Allocate dyld shared cache page index and its counter publisher
+	 */
+	void initSharedCacheIndex();
+
+	/**
+	 *  Publish dyld shared cache page index counters
+	 *
+	 *  @param param0  UNFAIR instance
+	 *  @param param1  unused
+	 */
+	static void publishSharedCacheIndex(thread_call_param_t param0, thread_call_param_t param1);
+
+	/**
+	 *  Increment dyld shared cache page index counter
+	 *
+	 *  @param stat  counter index
+	 */
+	void countSharedCacheIndex(size_t stat) {
+		auto value = __atomic_add_fetch(&sharedCacheIndexStats[stat], 1, __ATOMIC_RELAXED);
+		// Publish the first miss so that the property shows up early, and then every interval
+		if (sharedCacheIndexPublisher && (value % SharedCacheIndexPublishInterval == 0 || (stat == SharedCacheIndexMisses && value == 1)))
+			thread_call_enter(sharedCacheIndexPublisher);
+	}
+
+	/**
+	 *  Apply dyld shared cache patches to the page
+	 *
+	 *  @param vp           vnode
+	 *  @param vid          vnode id
+	 *  @param page_offset  page offset in file
+	 *  @param data         page contents
+	 */
+	void patchSharedCachePage(vnode *vp, uint32_t vid, memory_object_offset_t page_offset, const void *data);
+
+	/**
+	 *  Vnode classification cache.
+	 */
+	VnodeKindCache vnodeCache;
+
+	/**
+	 *  Classify vnode by its path, caching the result
+	 *
+	 *  @param vp   vnode
+	 *  @param vid  vnode id
+	 *
+	 *  @return vnode kind or VnodeKindCache::Unknown if the path cannot be resolved
+	 */
+	uint64_t classifyVnode(vnode *vp, uint32_t vid);
+
 	/**
 	 *  Codesign page validation wrapper used for userspace patching
 	 */
@@ -0,0 +1,301 @@
+//
+//  kern_unfair_cache.hpp
+//  WhateverGreen
+//
+//  Copyright © 2026 vit9696. All rights reserved.
+//
+
+#ifndef kern_unfair_cache_hpp
+#define kern_unfair_cache_hpp
+
+#include <Headers/kern_util.hpp>
+
+/**
+ *  Direct-mapped vnode classification cache used to avoid path resolution for every validated page
+ *
+ *  @note Each entry packs the vnode pointer, the lower 16 bits of its vnode id, and its kind into a single
+ *        64-bit word, so that concurrent validations may read and write entries without locking.
+ *  @note The cache has no dependencies on the kernel, so that it can be replayed against page streams on any host.
+ */
+class VnodeKindCache {
+public:
+	/**
+	 *  Vnode classification for codesign page validation.
+	 */
+	enum Kind : uint64_t {
+		Unknown,
+		Irrelevant,
+		SharedCache,
+		CoreLSKD,
+		KindMask = 0x7,
+	};
+
+	/**
+	 *  Vnode classification cache size, must be a power of two.
+	 */
+	static constexpr size_t Size = 256;
+
+	/**
+	 *  Obtain the cached vnode kind
+	 *
+	 *  @param vp   vnode
+	 *  @param vid  vnode id
+	 *
+	 *  @return vnode kind or Unknown if the vnode is not cached
+	 */
+	uint64_t lookup(const void *vp, uint32_t vid) {
+		auto entry = __atomic_load_n(&getSlot(vp), __ATOMIC_RELAXED);
+		if ((entry & ~static_cast<uint64_t>(KindMask)) == makeEntry(vp, vid, Unknown))
+			return entry & KindMask;
+		return Unknown;
+	}
+
+	/**
+	 *  Cache the vnode kind
+	 *
+	 *  @param vp    vnode
+	 *  @param vid   vnode id
+	 *  @param kind  vnode kind
+	 */
+	void store(const void *vp, uint32_t vid, uint64_t kind) {
+		__atomic_store_n(&getSlot(vp), makeEntry(vp, vid, kind), __ATOMIC_RELAXED);
+	}
+
+private:
+	/**
+	 *  Cache entries
+	 */
+	uint64_t entries[Size] {};
+
+	/**
+	 *  Build a vnode classification cache entry
+	 *
+	 *  @param vp    vnode
+	 *  @param vid   vnode id
+	 *  @param kind  vnode kind
+	 *
+	 *  @return packed cache entry
+	 */
+	static uint64_t makeEntry(const void *vp, uint32_t vid, uint64_t kind) {
+		// Kernel pointers are canonical (upper 16 bits set) and vnodes are at least 8-byte aligned.
+		return (static_cast<uint64_t>(vid & 0xFFFF) << 48) | (reinterpret_cast<uintptr_t>(vp) & 0x0000FFFFFFFFFFF8ULL) | kind;
+	}
+
+	/**
+	 *  Obtain vnode cache slot
+	 *
+	 *  @param vp  vnode
+	 *
+	 *  @return cache slot reference
+	 */
+	uint64_t &getSlot(const void *vp) {
+		auto addr = reinterpret_cast<uintptr_t>(vp);
+		return entries[((addr >> 4) ^ (addr >> 12)) & (Size - 1)];
+	}
+
+	static_assert((Size & (Size - 1)) == 0, "Vnode cache size must be a power of two");
+};
+
+/**
+ *  Dyld shared cache page index
+ *
+ *  Shared cache files are immutable, so a page that was once scanned without matching any patch will never match,
+ *  and it is not scanned again when it is paged back in. Pages that matched are always scanned, as they come
+ *  unpatched from disk. The caller must not mark pages clean that were patched in memory and validated again.
+ *
+ *  @note Every slot tracks one file by its vnode pointer and full vnode id. A slot is only reassigned while no
+ *        validation holds it, so a page is never marked clean in the bitmap of another file. Slots of recycled
+ *        vnodes are reused first, then free ones, then the one assigned the longest time ago. The index never
+ *        fills permanently, a reassigned file is simply scanned again.
+ *  @note The index has no dependencies on the kernel, the caller provides zeroed bitmap storage for every slot.
+ */
+class SharedCachePageIndex {
+public:
+	/**
+	 *  Maximum amount of dyld shared cache files tracked by the page index.
+	 *  Newer systems split the shared cache into several subcache files.
+	 */
+	static constexpr size_t Slots = 8;
+
+	/**
+	 *  Maximum amount of pages tracked per dyld shared cache file (1 GB).
+	 *  Pages beyond this limit are always scanned.
+	 */
+	static constexpr size_t Pages = 1 << 18;
+
+	/**
+	 *  Bitmap storage size per slot in 64-bit words.
+	 */
+	static constexpr size_t BitmapWords = Pages / 64;
+
+	/**
+	 *  Index slot of a single file
+	 */
+	class Slot {
+		friend class SharedCachePageIndex;
+
+		/**
+		 *  Slot is being reassigned.
+		 */
+		static constexpr uint32_t Claimed = 0x80000000;
+
+		/**
+		 *  Vnode owning this slot (nullptr for free slots).
+		 */
+		const void *owner {nullptr};
+
+		/**
+		 *  Full vnode id of the owner.
+		 */
+		uint32_t vid {0};
+
+		/**
+		 *  Amount of validations holding the slot, ored with Claimed while reassigning.
+		 */
+		uint32_t users {0};
+
+		/**
+		 *  Assignment order for reuse.
+		 */
+		uint64_t assigned {0};
+
+		/**
+		 *  Bitmap of pages that did not match any patch.
+		 */
+		uint64_t *cleanPages {nullptr};
+	};
+
+	/**
+	 *  Provide bitmap storage for a slot
+	 *
+	 *  @param slot    slot number
+	 *  @param bitmap  zeroed storage of BitmapWords
+	 */
+	void attach(size_t slot, uint64_t *bitmap) {
+		slots[slot].cleanPages = bitmap;
+	}
+
+	/**
+	 *  Detach bitmap storage of a slot, must not be called with validations in progress
+	 *
+	 *  @param slot  slot number
+	 *
+	 *  @return attached storage or nullptr
+	 */
+	uint64_t *detach(size_t slot) {
+		auto bitmap = slots[slot].cleanPages;
+		slots[slot] = Slot();
+		return bitmap;
+	}
+
+	/**
+	 *  Obtain and hold the slot of a file, assigning one if needed
+	 *
+	 *  @param vp   vnode
+	 *  @param vid  vnode id
+	 *
+	 *  @return held slot, nullptr if no slot is available right now
+	 */
+	Slot *acquire(const void *vp, uint32_t vid) {
+		for (auto &slot : slots) {
+			if (!slot.cleanPages)
+				return nullptr;
+			if (hold(slot)) {
+				if (__atomic_load_n(&slot.owner, __ATOMIC_RELAXED) == vp && __atomic_load_n(&slot.vid, __ATOMIC_RELAXED) == vid)
+					return &slot;
+				release(&slot);
+			}
+		}
+
+		// Prefer the slot of a recycled vnode, then a free slot, then the oldest one
+		Slot *victim = nullptr;
+		const void *victimOwner = nullptr;
+		uint64_t victimAssigned = 0;
+		for (auto &slot : slots) {
+			if (__atomic_load_n(&slot.users, __ATOMIC_RELAXED) != 0)
+				continue;
+			auto owner = __atomic_load_n(&slot.owner, __ATOMIC_RELAXED);
+			auto assigned = __atomic_load_n(&slot.assigned, __ATOMIC_RELAXED);
+			if (owner == vp) {
+				victim = &slot;
+				break;
+			}
+			if (!victim || (owner == nullptr && victimOwner != nullptr) ||
+				((owner == nullptr) == (victimOwner == nullptr) && assigned < victimAssigned)) {
+				victim = &slot;
+				victimOwner = owner;
+				victimAssigned = assigned;
+			}
+		}
+
+		uint32_t expected = 0;
+		if (!victim || !__atomic_compare_exchange_n(&victim->users, &expected, Slot::Claimed, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return nullptr;
+
+		memset(victim->cleanPages, 0, BitmapWords * sizeof(uint64_t));
+		__atomic_store_n(&victim->owner, vp, __ATOMIC_RELAXED);
+		__atomic_store_n(&victim->vid, vid, __ATOMIC_RELAXED);
+		__atomic_store_n(&victim->assigned, __atomic_add_fetch(&assignments, 1, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+		// Hold the slot and publish it, validations that bumped the count meanwhile drop their references
+		__atomic_fetch_add(&victim->users, 1 - Slot::Claimed, __ATOMIC_RELEASE);
+		return victim;
+	}
+
+	/**
+	 *  Release a held slot
+	 *
+	 *  @param slot  slot returned by acquire
+	 */
+	void release(Slot *slot) {
+		__atomic_fetch_sub(&slot->users, 1, __ATOMIC_RELEASE);
+	}
+
+	/**
+	 *  Check whether a page is known not to match any patch
+	 *
+	 *  @param slot  held slot
+	 *  @param page  page number
+	 */
+	static bool isClean(Slot *slot, size_t page) {
+		return page < Pages && (__atomic_load_n(&slot->cleanPages[page / 64], __ATOMIC_RELAXED) & (1ULL << (page % 64)));
+	}
+
+	/**
+	 *  Remember that a page does not match any patch
+	 *
+	 *  @param slot  held slot
+	 *  @param page  page number
+	 */
+	static void markClean(Slot *slot, size_t page) {
+		if (page < Pages)
+			__atomic_fetch_or(&slot->cleanPages[page / 64], 1ULL << (page % 64), __ATOMIC_RELAXED);
+	}
+
+private:
+	/**
+	 *  Try to hold a slot that is not being reassigned
+	 *
+	 *  @param slot  slot to hold
+	 *
+	 *  @return true on success
+	 */
+	static bool hold(Slot &slot) {
+		if (__atomic_fetch_add(&slot.users, 1, __ATOMIC_ACQUIRE) & Slot::Claimed) {
+			__atomic_fetch_sub(&slot.users, 1, __ATOMIC_RELAXED);
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 *  Index slots
+	 */
+	Slot slots[Slots];
+
+	/**
+	 *  Slot assignment counter
+	 */
+	uint64_t assignments {0};
+};
+
+#endif /* kern_unfair_cache_hpp */
@@ -10,6 +10,7 @@
 #include <Headers/kern_iokit.hpp>
 #include <Headers/kern_cpu.hpp>
 #include "kern_weg.hpp"
+#include "kern_profile.hpp"
 
 #include <IOKit/graphics/IOFramebuffer.h>
 
@@ -94,6 +95,7 @@ WEG *WEG::callbackWEG;
 
 void WEG::init() {
 	callbackWEG = this;
+	BootProfile::init();
 
 	// Background init fix is only necessary on 10.10 and newer.
 	// Former boot-arg name is igfxrst.
@@ -166,6 +168,8 @@ void WEG::deinit() {
 }
 
 void WEG::processKernel(KernelPatcher &patcher) {
+	auto processKernelStart = BootProfile::start();
+	
 	// Correct GPU properties
 	auto devInfo = DeviceInfo::create();
 	if (devInfo) {
@@ -296,15 +300,30 @@ void WEG::processKernel(KernelPatcher &patcher) {
 				processManagementEngineProperties(devInfo->managementEngine);
 		}
 
+		auto start = BootProfile::start();
 		igfx.processKernel(patcher, devInfo);
+		BootProfile::stop("IGFX::processKernel", start);
+		
+		start = BootProfile::start();
 		ngfx.processKernel(patcher, devInfo);
+		BootProfile::stop("NGFX::processKernel", start);
+		
+		start = BootProfile::start();
 		rad.processKernel(patcher, devInfo);
+		BootProfile::stop("RAD::processKernel", start);
 
 		if (getKernelVersion() >= KernelVersion::BigSur) {
+			start = BootProfile::start();
 			unfair.processKernel(patcher, devInfo);
+			BootProfile::stop("UNFAIR::processKernel", start);
 		} else {
+			start = BootProfile::start();
 			shiki.processKernel(patcher, devInfo);
+			BootProfile::stop("SHIKI::processKernel", start);
+			
+			start = BootProfile::start();
 			cdf.processKernel(patcher, devInfo);
+			BootProfile::stop("CDF::processKernel", start);
 		}
 
 		DeviceInfo::deleter(devInfo);
@@ -336,6 +355,8 @@ void WEG::processKernel(KernelPatcher &patcher) {
 			patcher.clearError();
 		}
 	}
+	
+	BootProfile::stop("WEG::processKernel", processKernelStart);
 }
 
 size_t WEG::wrapFunctionReturnZero() {
@@ -343,6 +364,13 @@ size_t WEG::wrapFunctionReturnZero() {
 }
 
 void WEG::processKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
+	auto start = BootProfile::start();
+	auto module = processKextModules(patcher, index, address, size);
+	BootProfile::stop("WEG::processKext", start, module != nullptr ? module : "Other");
+	BootProfile::schedulePublish();
+}
+
+const char *WEG::processKextModules(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size) {
 	if (kextIOGraphics.loadIndex == index) {
 		gIOFBVerboseBootPtr = patcher.solveSymbol<uint8_t *>(index, "__ZL16gIOFBVerboseBoot", address, size);
 		if (gIOFBVerboseBootPtr) {
@@ -352,7 +380,7 @@ void WEG::processKext(KernelPatcher &patcher, size_t index, mach_vm_address_t ad
 			SYSLOG("weg", "failed to resolve gIOFBVerboseBoot");
 			patcher.clearError();
 		}
-		return;
+		return "IOGraphics";
 	}
 
 	if (kextMCCSControl.loadIndex == index) {
@@ -361,12 +389,12 @@ void WEG::processKext(KernelPatcher &patcher, size_t index, mach_vm_address_t ad
 			{"__ZN21AppleMCCSControlCello5probeEP9IOServicePi", wrapFunctionReturnZero},
 		};
 		patcher.routeMultiple(index, request, address, size);
-		return;
+		return "MCCSControl";
 	}
 
 	if (kextAGDPolicy.loadIndex == index) {
 		processGraphicsPolicyMods(patcher, address, size);
-		return;
+		return "AGDPolicy";
 	}
 
 	if (kextBacklight.loadIndex == index) {
@@ -380,17 +408,34 @@ void WEG::processKext(KernelPatcher &patcher, size_t index, mach_vm_address_t ad
 		}
 	}
 
-	if (igfx.processKext(patcher, index, address, size))
-		return;
+	// Modules check the kext index themselves, so time them separately to see the cost of the kexts they skip as well
+	auto start = BootProfile::start();
+	bool processed = igfx.processKext(patcher, index, address, size);
+	BootProfile::stop("IGFX::processKext", start);
+	if (processed)
+		return "IGFX";
+
+	start = BootProfile::start();
+	processed = ngfx.processKext(patcher, index, address, size);
+	BootProfile::stop("NGFX::processKext", start);
+	if (processed)
+		return "NGFX";
 
-	if (ngfx.processKext(patcher, index, address, size))
-		return;
+	start = BootProfile::start();
+	processed = rad.processKext(patcher, index, address, size);
+	BootProfile::stop("RAD::processKext", start);
+	if (processed)
+		return "RAD";
 
-	if (rad.processKext(patcher, index, address, size))
-		return;
+	if (getKernelVersion() < KernelVersion::BigSur) {
+		start = BootProfile::start();
+		processed = cdf.processKext(patcher, index, address, size);
+		BootProfile::stop("CDF::processKext", start);
+		if (processed)
+			return "CDF";
+	}
 
-	if (getKernelVersion() < KernelVersion::BigSur && cdf.processKext(patcher, index, address, size))
-		return;
+	return kextBacklight.loadIndex == index ? "Backlight" : nullptr;
 }
 
 void WEG::processBuiltinProperties(IORegistryEntry *device, DeviceInfo *info) {
@@ -670,6 +715,7 @@ bool WEG::isGraphicsPolicyModRequired(DeviceInfo *info) {
 }
 
 void WEG::wrapFramebufferInit(IOFramebuffer *fb) {
+	auto wrapperStart = BootProfile::start();
 	bool backCopy = callbackWEG->gotConsoleVinfo && callbackWEG->resetFramebuffer == FB_COPY;
 	bool zeroFill  = callbackWEG->gotConsoleVinfo && callbackWEG->resetFramebuffer == FB_ZEROFILL;
 	auto &info = callbackWEG->consoleVinfo;
@@ -717,7 +763,9 @@ void WEG::wrapFramebufferInit(IOFramebuffer *fb) {
 
 	// For whatever reason not resetting Intel framebuffer (back copy mode) twice works better.
 	if (!backCopy) *callbackWEG->gIOFBVerboseBootPtr = 1;
+	auto start = BootProfile::start();
 	FunctionCast(wrapFramebufferInit, callbackWEG->orgFramebufferInit)(fb);
+	BootProfile::stop("WEG::orgFramebufferInit", start);
 	if (!backCopy) *callbackWEG->gIOFBVerboseBootPtr = verboseBoot;
 
 	// Finish the framebuffer initialisation by filling with black or copying the image back.
@@ -735,6 +783,10 @@ void WEG::wrapFramebufferInit(IOFramebuffer *fb) {
 			memset(dst, 0, info.v_rowbytes * info.v_height);
 		}
 	}
+	
+	// The wrapper time includes the original function, subtract orgFramebufferInit to get the time spent in WhateverGreen
+	BootProfile::stop("WEG::wrapFramebufferInit", wrapperStart);
+	BootProfile::schedulePublish();
 }
 
 uint16_t WEG::wrapConfigRead16(IORegistryEntry *service, uint32_t space, uint8_t offset) {
@@ -273,6 +273,18 @@ private:
 	 */
 	void processKext(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size);
 
+	/**
+	 *  Dispatch kext processing to the modules
+	 *
+	 *  @param patcher KernelPatcher instance
+	 *  @param index   kinfo handle
+	 *  @param address kinfo load address
+	 *  @param size    kinfo memory size
+	 *
+	 *  @return The name of the module that processed the kext, or `nullptr` if none did.
+	 */
+	const char *processKextModules(KernelPatcher &patcher, size_t index, mach_vm_address_t address, size_t size);
+
 	/**
 	 *  Apply builtin GPU properties and renamings
 	 *